@@ -1,9 +1,215 @@
 #include "animation.h"
+#include <psp2/kernel/threadmgr.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ANIM_HASH_NEON 1
+#endif
+
 #define INITIAL_FRAMES 16
 
+// Costanti hash (xxHash)
+#define HASH_PRIME32_1 0x9E3779B1U
+#define HASH_PRIME32_2 0x85EBCA77U
+#define HASH_PRIME32_3 0xC2B2AE3DU
+#define HASH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME64_3 0x165667B19E3779F9ULL
+#define HASH_PRIME64_5 0x27D4EB2F165667C5ULL
+#define HASH_LANES     8
+#define HASH_BLOCK     (HASH_LANES * 4)
+
+/* ========== LOG DEI TRATTI ========== */
+void animation_frame_free_strokes(Frame *frame) {
+    for (int l = 0; l < MAX_LAYERS; l++) {
+        strokes_destroy(frame->strokes[l]);
+        frame->strokes[l] = NULL;
+    }
+}
+
+// dst ha appena ricevuto i campi di src con memcpy: i log vanno copiati,
+// non condivisi. Senza memoria i layer restano solo raster (false).
+bool animation_frame_copy_strokes(Frame *dst, const Frame *src) {
+    bool ok = true;
+    for (int l = 0; l < MAX_LAYERS; l++) {
+        dst->strokes[l] = src->strokes[l] ? strokes_clone(src->strokes[l]) : NULL;
+        if (src->strokes[l] && !dst->strokes[l]) ok = false;
+    }
+    return ok;
+}
+
+/* ========== SNAPSHOT COPY-ON-WRITE ========== */
+static void snapshot_copy_frame(AnimationSnapshot *snap, int i) {
+    if (snap->done[i] || snap->copies[i]) return;
+    snap->copies[i] = (Frame *)malloc(sizeof(Frame));
+    if (snap->copies[i]) {
+        memcpy(snap->copies[i], &snap->base[i], sizeof(Frame));
+        if (!animation_frame_copy_strokes(snap->copies[i], &snap->base[i])) snap->broken = true;
+    } else {
+        snap->broken = true;
+    }
+}
+
+static void snapshot_free_copy(AnimationSnapshot *snap, int i) {
+    if (!snap->copies[i]) return;
+    animation_frame_free_strokes(snap->copies[i]);
+    free(snap->copies[i]);
+    snap->copies[i] = NULL;
+}
+
+// Da chiamare prima di modificare i frame [from, to] dell'animazione.
+// Ogni modifica passa di qui: i frame vengono anche segnati come
+// modificati, cosi' il journal non si affida al solo hash
+static void snapshot_preserve_range(AnimationContext *anim, int from, int to) {
+    AnimationSnapshot *snap = anim->snapshot;
+    int i;
+
+    for (i = from < 0 ? 0 : from; i <= to && i < anim->frame_count; i++)
+        anim->frames[i].dirty = true;
+    if (!snap) return;
+    if (from < 0) from = 0;
+    if (to >= snap->frame_count) to = snap->frame_count - 1;
+    if (from > to) return;
+
+    sceKernelLockMutex(snap->lock, 1, NULL);
+    for (i = from; i <= to; i++) snapshot_copy_frame(snap, i);
+    sceKernelUnlockMutex(snap->lock, 1);
+}
+
+// Prima di spostare o liberare l'array: lo snapshot non puo' piu'
+// leggere da anim->frames e viene scollegato
+static void snapshot_detach(AnimationContext *anim) {
+    AnimationSnapshot *snap = anim->snapshot;
+    int i;
+
+    if (!snap) return;
+    sceKernelLockMutex(snap->lock, 1, NULL);
+    for (i = 0; i < snap->frame_count; i++) snapshot_copy_frame(snap, i);
+    snap->detached = true;
+    sceKernelUnlockMutex(snap->lock, 1);
+    anim->snapshot = NULL;
+}
+
+AnimationSnapshot *animation_snapshot_begin(AnimationContext *anim) {
+    AnimationSnapshot *snap;
+    int i;
+
+    // Un solo snapshot collegato alla volta
+    if (anim->snapshot) snapshot_detach(anim);
+
+    snap = (AnimationSnapshot *)calloc(1, sizeof(AnimationSnapshot));
+    if (!snap) return NULL;
+
+    snap->copies = (Frame **)calloc(anim->frame_count, sizeof(Frame *));
+    snap->done = (uint8_t *)calloc(anim->frame_count, 1);
+    snap->layer_hash = (uint64_t *)malloc(anim->frame_count * MAX_LAYERS * sizeof(uint64_t));
+    snap->hash_valid = (uint8_t *)malloc(anim->frame_count);
+    snap->lock = sceKernelCreateMutex("anim_snapshot", 0, 0, NULL);
+    if (!snap->copies || !snap->done || !snap->layer_hash || !snap->hash_valid || snap->lock < 0) {
+        if (snap->lock >= 0) sceKernelDeleteMutex(snap->lock);
+        free(snap->copies);
+        free(snap->done);
+        free(snap->layer_hash);
+        free(snap->hash_valid);
+        free(snap);
+        return NULL;
+    }
+
+    // Solo il thread principale scrive la cache degli hash: si copia qui
+    for (i = 0; i < anim->frame_count; i++) {
+        memcpy(&snap->layer_hash[i * MAX_LAYERS], anim->frames[i].layer_hash,
+               MAX_LAYERS * sizeof(uint64_t));
+        snap->hash_valid[i] = anim->frames[i].hash_valid;
+    }
+
+    memcpy(snap->title, anim->title, sizeof(snap->title));
+    memcpy(snap->author, anim->author, sizeof(snap->author));
+    snap->playback_speed = anim->playback_speed;
+    snap->loop = anim->loop;
+    snap->frame_count = anim->frame_count;
+    snap->base = anim->frames;
+
+    anim->snapshot = snap;
+    return snap;
+}
+
+void animation_snapshot_end(AnimationContext *anim, AnimationSnapshot *snap) {
+    int i;
+
+    if (!snap) return;
+    if (anim->snapshot == snap) anim->snapshot = NULL;
+
+    for (i = 0; i < snap->frame_count; i++) snapshot_free_copy(snap, i);
+    sceKernelDeleteMutex(snap->lock);
+    free(snap->copies);
+    free(snap->done);
+    free(snap->layer_hash);
+    free(snap->hash_valid);
+    free(snap);
+}
+
+// Il frame resta valido (e bloccato) fino a animation_snapshot_release
+const Frame *animation_snapshot_acquire(AnimationSnapshot *snap, int frame_idx) {
+    sceKernelLockMutex(snap->lock, 1, NULL);
+    if (frame_idx < 0 || frame_idx >= snap->frame_count) return NULL;
+    if (snap->copies[frame_idx]) return snap->copies[frame_idx];
+    if (snap->detached) return NULL;
+    return &snap->base[frame_idx];
+}
+
+void animation_snapshot_release(AnimationSnapshot *snap, int frame_idx) {
+    if (frame_idx >= 0 && frame_idx < snap->frame_count) {
+        snap->done[frame_idx] = 1;
+        snapshot_free_copy(snap, frame_idx);
+    }
+    sceKernelUnlockMutex(snap->lock, 1);
+}
+
+// Frame non ancora consumato dal lettore, senza consumarlo (sotto lock)
+static const Frame *snapshot_peek(AnimationSnapshot *snap, int frame_idx) {
+    if (snap->done[frame_idx]) return NULL;
+    if (snap->copies[frame_idx]) return snap->copies[frame_idx];
+    return snap->detached ? NULL : &snap->base[frame_idx];
+}
+
+bool animation_snapshot_layer_hashes(AnimationSnapshot *snap, int frame_idx, uint64_t *hashes) {
+    const Frame *f;
+    int l;
+
+    if (frame_idx < 0 || frame_idx >= snap->frame_count) return false;
+
+    sceKernelLockMutex(snap->lock, 1, NULL);
+    f = snapshot_peek(snap, frame_idx);
+    // Quelli mancanti si calcolano sotto lock, senza toccare la cache
+    for (l = 0; f && l < MAX_LAYERS; l++) {
+        if (snap->hash_valid[frame_idx] & (1 << l))
+            hashes[l] = snap->layer_hash[frame_idx * MAX_LAYERS + l];
+        else
+            hashes[l] = animation_hash_layer(&f->layers[l]);
+    }
+    sceKernelUnlockMutex(snap->lock, 1);
+    return f != NULL;
+}
+
+bool animation_snapshot_layers_equal(AnimationSnapshot *snap, int frame_a, int layer_a,
+                                     int frame_b, int layer_b)
+{
+    const Frame *a, *b;
+    bool equal;
+
+    if (frame_a < 0 || frame_a >= snap->frame_count || frame_b < 0 || frame_b >= snap->frame_count)
+        return false;
+
+    sceKernelLockMutex(snap->lock, 1, NULL);
+    a = snapshot_peek(snap, frame_a);
+    b = snapshot_peek(snap, frame_b);
+    equal = a && b && memcmp(&a->layers[layer_a], &b->layers[layer_b], sizeof(LayerData)) == 0;
+    sceKernelUnlockMutex(snap->lock, 1);
+    return equal;
+}
+
 void animation_init(AnimationContext *anim) {
     memset(anim, 0, sizeof(AnimationContext));
     
@@ -18,6 +224,7 @@ void animation_init(AnimationContext *anim) {
     for (int i = 0; i < INITIAL_FRAMES; i++) {
         anim->frames[i].frame_speed = -1;
         anim->frames[i].is_keyframe = false;
+        anim->frames[i].exposure = 1;
     }
     
     strcpy(anim->author, "Player");
@@ -25,14 +232,29 @@ void animation_init(AnimationContext *anim) {
 }
 
 void animation_free(AnimationContext *anim) {
+    snapshot_detach(anim);
+    if (anim->frame_clipboard_valid) animation_frame_free_strokes(&anim->frame_clipboard);
+    anim->frame_clipboard_valid = false;
     if (anim->frames) {
+        for (int i = 0; i < anim->frame_count; i++) animation_frame_free_strokes(&anim->frames[i]);
         free(anim->frames);
         anim->frames = NULL;
     }
 }
 
+void animation_replace(AnimationContext *anim, AnimationContext *loaded) {
+    animation_free(anim);
+    snapshot_detach(loaded);
+    memcpy(anim, loaded, sizeof(AnimationContext));
+    loaded->frame_clipboard_valid = false;
+    loaded->frames = NULL;
+    loaded->frame_count = 0;
+    loaded->max_frames_allocated = 0;
+}
+
 static void animation_ensure_capacity(AnimationContext *anim, int needed) {
     if (needed <= anim->max_frames_allocated) return;
+    snapshot_detach(anim);
     
     int new_size = anim->max_frames_allocated * 2;
     while (new_size < needed) new_size *= 2;
@@ -45,6 +267,7 @@ static void animation_ensure_capacity(AnimationContext *anim, int needed) {
         for (int i = anim->max_frames_allocated; i < new_size; i++) {
             memset(&anim->frames[i], 0, sizeof(Frame));
             anim->frames[i].frame_speed = -1;
+            anim->frames[i].exposure = 1;
         }
         anim->max_frames_allocated = new_size;
     }
@@ -58,6 +281,8 @@ int animation_add_frame(AnimationContext *anim) {
     int idx = anim->frame_count;
     memset(&anim->frames[idx], 0, sizeof(Frame));
     anim->frames[idx].frame_speed = -1;
+    anim->frames[idx].exposure = 1;
+    anim->frames[idx].dirty = true;
     anim->frame_count++;
     return idx;
 }
@@ -68,6 +293,7 @@ int animation_insert_frame(AnimationContext *anim, int position) {
     if (position > anim->frame_count) position = anim->frame_count;
     
     animation_ensure_capacity(anim, anim->frame_count + 1);
+    snapshot_preserve_range(anim, position, anim->frame_count - 1);
     
     // Sposta frame successivi
     for (int i = anim->frame_count; i > position; i--) {
@@ -76,6 +302,8 @@ int animation_insert_frame(AnimationContext *anim, int position) {
     
     memset(&anim->frames[position], 0, sizeof(Frame));
     anim->frames[position].frame_speed = -1;
+    anim->frames[position].exposure = 1;
+    anim->frames[position].dirty = true;
     anim->frame_count++;
     
     if (anim->current_frame >= position) {
@@ -91,6 +319,7 @@ int animation_duplicate_frame(AnimationContext *anim, int frame_idx) {
     
     int new_pos = frame_idx + 1;
     animation_ensure_capacity(anim, anim->frame_count + 1);
+    snapshot_preserve_range(anim, new_pos, anim->frame_count - 1);
     
     // Sposta frame successivi
     for (int i = anim->frame_count; i > new_pos; i--) {
@@ -98,6 +327,8 @@ int animation_duplicate_frame(AnimationContext *anim, int frame_idx) {
     }
     
     memcpy(&anim->frames[new_pos], &anim->frames[frame_idx], sizeof(Frame));
+    animation_frame_copy_strokes(&anim->frames[new_pos], &anim->frames[frame_idx]);
+    anim->frames[new_pos].dirty = true;
     anim->frame_count++;
     
     return new_pos;
@@ -107,6 +338,8 @@ void animation_delete_frame(AnimationContext *anim, int frame_idx) {
     if (anim->frame_count <= 1) return; // Almeno 1 frame
     if (frame_idx < 0 || frame_idx >= anim->frame_count) return;
     
+    snapshot_preserve_range(anim, frame_idx, anim->frame_count - 1);
+    animation_frame_free_strokes(&anim->frames[frame_idx]);
     for (int i = frame_idx; i < anim->frame_count - 1; i++) {
         memcpy(&anim->frames[i], &anim->frames[i + 1], sizeof(Frame));
     }
@@ -123,6 +356,7 @@ void animation_move_frame(AnimationContext *anim, int from, int to) {
     if (to < 0 || to >= anim->frame_count) return;
     if (from == to) return;
     
+    snapshot_preserve_range(anim, from < to ? from : to, from < to ? to : from);
     Frame temp;
     memcpy(&temp, &anim->frames[from], sizeof(Frame));
     
@@ -143,6 +377,8 @@ void animation_swap_frames(AnimationContext *anim, int a, int b) {
     if (a < 0 || a >= anim->frame_count) return;
     if (b < 0 || b >= anim->frame_count) return;
     
+    snapshot_preserve_range(anim, a, a);
+    snapshot_preserve_range(anim, b, b);
     Frame temp;
     memcpy(&temp, &anim->frames[a], sizeof(Frame));
     memcpy(&anim->frames[a], &anim->frames[b], sizeof(Frame));
@@ -151,18 +387,55 @@ void animation_swap_frames(AnimationContext *anim, int a, int b) {
 
 void animation_clear_frame(AnimationContext *anim, int frame_idx) {
     if (frame_idx < 0 || frame_idx >= anim->frame_count) return;
+    snapshot_preserve_range(anim, frame_idx, frame_idx);
     for (int l = 0; l < MAX_LAYERS; l++) {
         memset(&anim->frames[frame_idx].layers[l], 0, sizeof(LayerData));
     }
+    animation_frame_free_strokes(&anim->frames[frame_idx]);
+    anim->frames[frame_idx].hash_valid = 0;
+}
+
+void animation_set_exposure(AnimationContext *anim, int frame_idx, int exposure) {
+    if (frame_idx < 0 || frame_idx >= anim->frame_count) return;
+    if (exposure < 1) exposure = 1;
+    if (exposure > MAX_EXPOSURE) exposure = MAX_EXPOSURE;
+    if (anim->frames[frame_idx].exposure == exposure) return;
+    snapshot_preserve_range(anim, frame_idx, frame_idx);
+    anim->frames[frame_idx].exposure = exposure;
+}
+
+int animation_get_exposure(AnimationContext *anim, int frame_idx) {
+    if (frame_idx < 0 || frame_idx >= anim->frame_count) return 1;
+    if (anim->frames[frame_idx].exposure < 1) return 1;
+    return anim->frames[frame_idx].exposure;
+}
+
+// Durata totale in tick, contando gli hold
+int animation_get_display_length(AnimationContext *anim) {
+    int total = 0;
+    for (int i = 0; i < anim->frame_count; i++) {
+        total += animation_get_exposure(anim, i);
+    }
+    return total;
 }
 
 void animation_save_current_to_draw(AnimationContext *anim, DrawingContext *draw) {
     int idx = anim->current_frame;
     if (idx < 0 || idx >= anim->frame_count) return;
     
+    // Disegno invariato (cambio frame, autosave): il frame non si tocca
+    if (memcmp(anim->frames[idx].layers, draw->layers, sizeof(anim->frames[idx].layers)) == 0)
+        return;
+
+    snapshot_preserve_range(anim, idx, idx);
     for (int l = 0; l < MAX_LAYERS; l++) {
         memcpy(&anim->frames[idx].layers[l], &draw->layers[l], sizeof(LayerData));
+        // Il log segue i pixel: se il disegno non ne ha uno valido il
+        // layer resta solo raster
+        strokes_destroy(anim->frames[idx].strokes[l]);
+        anim->frames[idx].strokes[l] = strokes_clone(&draw->strokes[l]);
     }
+    anim->frames[idx].hash_valid = 0;
 }
 
 void animation_load_current_from_draw(AnimationContext *anim, DrawingContext *draw) {
@@ -172,6 +445,10 @@ void animation_load_current_from_draw(AnimationContext *anim, DrawingContext *dr
     for (int l = 0; l < MAX_LAYERS; l++) {
         memcpy(&draw->layers[l], &anim->frames[idx].layers[l], sizeof(LayerData));
     }
+    drawing_reset_strokes(draw);
+    for (int l = 0; l < MAX_LAYERS; l++) {
+        if (anim->frames[idx].strokes[l]) strokes_copy(&draw->strokes[l], anim->frames[idx].strokes[l]);
+    }
 }
 
 void animation_goto_frame(AnimationContext *anim, DrawingContext *draw, int frame) {
@@ -182,6 +459,7 @@ void animation_goto_frame(AnimationContext *anim, DrawingContext *draw, int fram
     if (frame >= anim->frame_count) frame = anim->frame_count - 1;
     
     anim->current_frame = frame;
+    anim->hold_ticks = 0;
     
     // Carica nuovo frame
     animation_load_current_from_draw(anim, draw);
@@ -217,6 +495,7 @@ void animation_last_frame(AnimationContext *anim, DrawingContext *draw) {
 void animation_play(AnimationContext *anim) {
     anim->is_playing = true;
     anim->frame_timer = 0;
+    anim->hold_ticks = 0;
 }
 
 void animation_stop(AnimationContext *anim) {
@@ -243,6 +522,11 @@ void animation_update(AnimationContext *anim, DrawingContext *draw, float delta_
     if (anim->frame_timer >= frame_duration) {
         anim->frame_timer -= frame_duration;
         
+        // Frame tenuto per piu' tick: resta dov'e'
+        anim->hold_ticks++;
+        if (anim->hold_ticks < animation_get_exposure(anim, anim->current_frame)) return;
+        anim->hold_ticks = 0;
+        
         int start = anim->play_range_set ? anim->play_start_frame : 0;
         int end = anim->play_range_set ? anim->play_end_frame : anim->frame_count - 1;
         
@@ -281,7 +565,9 @@ void animation_clear_play_range(AnimationContext *anim) {
 
 void animation_copy_frame(AnimationContext *anim, int frame_idx) {
     if (frame_idx < 0 || frame_idx >= anim->frame_count) return;
+    if (anim->frame_clipboard_valid) animation_frame_free_strokes(&anim->frame_clipboard);
     memcpy(&anim->frame_clipboard, &anim->frames[frame_idx], sizeof(Frame));
+    animation_frame_copy_strokes(&anim->frame_clipboard, &anim->frames[frame_idx]);
     anim->frame_clipboard_valid = true;
 }
 
@@ -290,7 +576,152 @@ void animation_paste_frame(AnimationContext *anim, int position) {
     int idx = animation_insert_frame(anim, position);
     if (idx >= 0) {
         memcpy(&anim->frames[idx], &anim->frame_clipboard, sizeof(Frame));
+        animation_frame_copy_strokes(&anim->frames[idx], &anim->frame_clipboard);
+        anim->frames[idx].dirty = true;
+    }
+}
+
+static inline uint32_t hash_rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint64_t hash_rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// 8 lane da 32 bit in parallelo (round xxh32): su Vita ogni blocco da
+// 32 byte sono due registri NEON, altrove il compilatore vettorizza il loop.
+// I due percorsi producono lo stesso valore, l'hash e' stabile tra build.
+uint64_t animation_hash_data(const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *end = p + size;
+    uint32_t lanes[HASH_LANES];
+    uint64_t h;
+    int i;
+
+    for (i = 0; i < HASH_LANES; i++) {
+        lanes[i] = (uint32_t)i * HASH_PRIME32_3 + HASH_PRIME32_2;
+    }
+
+#ifdef ANIM_HASH_NEON
+    {
+        const uint32x4_t p1 = vdupq_n_u32(HASH_PRIME32_1);
+        const uint32x4_t p2 = vdupq_n_u32(HASH_PRIME32_2);
+        uint32x4_t a0 = vld1q_u32(&lanes[0]);
+        uint32x4_t a1 = vld1q_u32(&lanes[4]);
+
+        for (; end - p >= HASH_BLOCK; p += HASH_BLOCK) {
+            uint32x4_t d0 = vreinterpretq_u32_u8(vld1q_u8(p));
+            uint32x4_t d1 = vreinterpretq_u32_u8(vld1q_u8(p + 16));
+            a0 = vmlaq_u32(a0, d0, p2);
+            a1 = vmlaq_u32(a1, d1, p2);
+            a0 = vorrq_u32(vshlq_n_u32(a0, 13), vshrq_n_u32(a0, 19));
+            a1 = vorrq_u32(vshlq_n_u32(a1, 13), vshrq_n_u32(a1, 19));
+            a0 = vmulq_u32(a0, p1);
+            a1 = vmulq_u32(a1, p1);
+        }
+
+        vst1q_u32(&lanes[0], a0);
+        vst1q_u32(&lanes[4], a1);
+    }
+#else
+    for (; end - p >= HASH_BLOCK; p += HASH_BLOCK) {
+        uint32_t words[HASH_LANES];
+        memcpy(words, p, HASH_BLOCK);
+        for (i = 0; i < HASH_LANES; i++) {
+            lanes[i] = hash_rotl32(lanes[i] + words[i] * HASH_PRIME32_2, 13) * HASH_PRIME32_1;
+        }
+    }
+#endif
+
+    // Coda (< 32 byte)
+    for (i = 0; end - p >= 4; p += 4, i++) {
+        uint32_t w;
+        memcpy(&w, p, 4);
+        lanes[i] = hash_rotl32(lanes[i] + w * HASH_PRIME32_2, 13) * HASH_PRIME32_1;
+    }
+
+    h = (uint64_t)size * HASH_PRIME64_5;
+    for (i = 0; i < HASH_LANES; i++) {
+        h ^= (uint64_t)lanes[i] * HASH_PRIME64_1;
+        h = hash_rotl64(h, 27) * HASH_PRIME64_2 + HASH_PRIME64_3;
+    }
+    for (; p < end; p++) {
+        h ^= (uint64_t)(*p) * HASH_PRIME64_5;
+        h = hash_rotl64(h, 11) * HASH_PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= HASH_PRIME64_2;
+    h ^= h >> 29;
+    h *= HASH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t animation_hash_layer(const LayerData *layer) {
+    return animation_hash_data(layer->pixels, sizeof(layer->pixels));
+}
+
+uint64_t animation_get_layer_hash(AnimationContext *anim, int frame_idx, int layer) {
+    Frame *f;
+    if (frame_idx < 0 || frame_idx >= anim->frame_count) return 0;
+    if (layer < 0 || layer >= MAX_LAYERS) return 0;
+
+    f = &anim->frames[frame_idx];
+    if (!(f->hash_valid & (1 << layer))) {
+        f->layer_hash[layer] = animation_hash_layer(&f->layers[layer]);
+        f->hash_valid |= (uint8_t)(1 << layer);
+    }
+    return f->layer_hash[layer];
+}
+
+uint64_t animation_get_frame_hash(AnimationContext *anim, int frame_idx) {
+    uint64_t h = HASH_PRIME64_5;
+    int l;
+    if (frame_idx < 0 || frame_idx >= anim->frame_count) return 0;
+
+    for (l = 0; l < MAX_LAYERS; l++) {
+        h ^= animation_get_layer_hash(anim, frame_idx, l) * HASH_PRIME64_2;
+        h = hash_rotl64(h, 31) * HASH_PRIME64_1;
+    }
+    return h;
+}
+
+// Hash dell'intera animazione (contenuto, ordine, velocita' ed esposizione)
+uint64_t animation_get_hash(AnimationContext *anim) {
+    uint64_t h = (uint64_t)anim->frame_count * HASH_PRIME64_5;
+    int f;
+
+    h ^= animation_hash_data(&anim->playback_speed, sizeof(float)) + anim->loop;
+    for (f = 0; f < anim->frame_count; f++) {
+        h ^= animation_get_frame_hash(anim, f) * HASH_PRIME64_2;
+        h ^= animation_hash_data(&anim->frames[f].frame_speed, sizeof(float));
+        h += (uint64_t)animation_get_exposure(anim, f) * HASH_PRIME64_3;
+        h = hash_rotl64(h, 31) * HASH_PRIME64_1;
+    }
+    return h;
+}
+
+void animation_invalidate_frame_hash(AnimationContext *anim, int frame_idx) {
+    if (frame_idx < 0 || frame_idx >= anim->frame_count) return;
+    anim->frames[frame_idx].hash_valid = 0;
+    anim->frames[frame_idx].dirty = true;
+}
+
+// Confronto per fingerprint: niente memcmp sui 590 KB del frame
+bool animation_frames_equal(AnimationContext *anim, int a, int b) {
+    int l;
+    if (a < 0 || a >= anim->frame_count) return false;
+    if (b < 0 || b >= anim->frame_count) return false;
+    if (a == b) return true;
+
+    for (l = 0; l < MAX_LAYERS; l++) {
+        if (animation_get_layer_hash(anim, a, l) != animation_get_layer_hash(anim, b, l)) {
+            return false;
+        }
     }
+    return true;
 }
 
 LayerData* animation_get_frame_layers(AnimationContext *anim, int frame_idx) {
@@ -2,17 +2,27 @@
 #define ANIMATION_H
 
 #include "drawing.h"
+#include <psp2/types.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define MAX_FRAMES      999
 #define MIN_SPEED       1
 #define MAX_SPEED        24
 #define DEFAULT_SPEED   8
+#define MAX_EXPOSURE    24
 
 typedef struct {
     LayerData layers[MAX_LAYERS];
     float frame_speed;    // Velocità specifica per frame (-1 = usa globale)
     bool is_keyframe;
+    int exposure;         // Durata in tick (hold: 2 = "a due", 0/1 = singolo)
+    StrokeLog *strokes[MAX_LAYERS];   // Log vettoriale dei layer (NULL = solo raster)
+    
+    // Fingerprint contenuto (cache, ricalcolata on demand)
+    uint64_t layer_hash[MAX_LAYERS];
+    uint8_t hash_valid;   // Bitmask dei layer con hash valido
+    bool dirty;           // Modificato dall'ultima cattura del journal
 } Frame;
 
 typedef struct {
@@ -26,6 +36,7 @@ typedef struct {
     bool loop;
     float playback_speed;   // FPS
     float frame_timer;
+    int hold_ticks;         // Tick trascorsi sul frame corrente (esposizione)
     int play_start_frame;
     int play_end_frame;
     bool play_range_set;
@@ -38,10 +49,35 @@ typedef struct {
     // Copia frame
     bool frame_clipboard_valid;
     Frame frame_clipboard;
+    
+    // Snapshot letto da un salvataggio in background (NULL = nessuno)
+    struct AnimationSnapshot *snapshot;
 } AnimationContext;
 
+// Vista immutabile dell'animazione per il thread di salvataggio.
+// I frame restano condivisi finche' il thread principale non li modifica:
+// prima della modifica ne viene fatta una copia privata (copy-on-write).
+typedef struct AnimationSnapshot {
+    char title[64];
+    char author[64];
+    float playback_speed;
+    bool loop;
+    int frame_count;
+    
+    const Frame *base;      // anim->frames al momento dello snapshot
+    Frame **copies;         // Copie private (NULL = ancora condiviso)
+    uint8_t *done;          // Frame gia' consumati dal lettore
+    uint64_t *layer_hash;   // Hash in cache al momento dello snapshot
+    uint8_t *hash_valid;    // (frame * MAX_LAYERS + layer), bitmask per frame
+    bool detached;          // Tutti i frame non consumati sono copie private
+    bool broken;            // Copia fallita (memoria): snapshot non coerente
+    SceUID lock;
+} AnimationSnapshot;
+
 void animation_init(AnimationContext *anim);
 void animation_free(AnimationContext *anim);
+// Prende il contenuto di loaded (che resta vuoto) al posto del proprio
+void animation_replace(AnimationContext *anim, AnimationContext *loaded);
 
 // Frame management
 int animation_add_frame(AnimationContext *anim);
@@ -52,6 +88,16 @@ void animation_move_frame(AnimationContext *anim, int from, int to);
 void animation_swap_frames(AnimationContext *anim, int a, int b);
 void animation_clear_frame(AnimationContext *anim, int frame_idx);
 
+// I Frame si spostano con memcpy (il log resta del frame di arrivo);
+// una copia che resta accanto all'originale deve duplicarne i log
+void animation_frame_free_strokes(Frame *frame);
+bool animation_frame_copy_strokes(Frame *dst, const Frame *src);
+
+// Esposizione (hold) dei frame
+void animation_set_exposure(AnimationContext *anim, int frame_idx, int exposure);
+int animation_get_exposure(AnimationContext *anim, int frame_idx);
+int animation_get_display_length(AnimationContext *anim);
+
 // Frame navigation
 void animation_goto_frame(AnimationContext *anim, DrawingContext *draw, int frame);
 void animation_next_frame(AnimationContext *anim, DrawingContext *draw);
@@ -76,6 +122,27 @@ void animation_clear_play_range(AnimationContext *anim);
 void animation_copy_frame(AnimationContext *anim, int frame_idx);
 void animation_paste_frame(AnimationContext *anim, int position);
 
+// Fingerprint contenuto (hash 64 bit)
+uint64_t animation_hash_data(const void *data, size_t size);
+uint64_t animation_hash_layer(const LayerData *layer);
+uint64_t animation_get_layer_hash(AnimationContext *anim, int frame_idx, int layer);
+uint64_t animation_get_frame_hash(AnimationContext *anim, int frame_idx);
+uint64_t animation_get_hash(AnimationContext *anim);
+void animation_invalidate_frame_hash(AnimationContext *anim, int frame_idx);
+bool animation_frames_equal(AnimationContext *anim, int a, int b);
+
+// Snapshot copy-on-write (begin/end dal thread principale,
+// acquire/release dal lettore)
+AnimationSnapshot *animation_snapshot_begin(AnimationContext *anim);
+void animation_snapshot_end(AnimationContext *anim, AnimationSnapshot *snap);
+const Frame *animation_snapshot_acquire(AnimationSnapshot *snap, int frame_idx);
+void animation_snapshot_release(AnimationSnapshot *snap, int frame_idx);
+// Hash dei layer senza consumare il frame (false se gia' consumato)
+bool animation_snapshot_layer_hashes(AnimationSnapshot *snap, int frame_idx, uint64_t *hashes);
+// Confronto pixel per pixel di due layer (false se un frame e' consumato)
+bool animation_snapshot_layers_equal(AnimationSnapshot *snap, int frame_a, int layer_a,
+                                     int frame_b, int layer_b);
+
 // Onion skin helpers
 LayerData* animation_get_frame_layers(AnimationContext *anim, int frame_idx);
 
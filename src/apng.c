@@ -0,0 +1,137 @@
+#include "apng.h"
+#include <string.h>
+#include <zlib.h>
+
+static const uint8_t png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+// I campi PNG sono big-endian
+static void put_u16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)((v >> 8) & 0xFF);
+    p[1] = (uint8_t)(v & 0xFF);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v >> 16);
+    put_u16(p + 2, v & 0xFFFF);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// Chunk PNG: lunghezza, tipo, dati, CRC di tipo + dati. prefix (4 byte,
+// puo' essere NULL) precede i dati: il numero di sequenza di fdAT.
+static bool write_chunk(FileWriter *w, const char *type, const uint8_t *prefix,
+                        const uint8_t *data, uint32_t size)
+{
+    uint8_t header[8];
+    uint8_t crc_bytes[4];
+    uint32_t crc;
+
+    put_u32(header, size + (prefix ? 4 : 0));
+    memcpy(header + 4, type, 4);
+    fileio_write(w, header, 8);
+
+    crc = crc32(0, header + 4, 4);
+    if (prefix) {
+        fileio_write(w, prefix, 4);
+        crc = crc32(crc, prefix, 4);
+    }
+    if (size > 0) {
+        fileio_write(w, data, size);
+        crc = crc32(crc, data, size);
+    }
+
+    put_u32(crc_bytes, crc);
+    return fileio_write(w, crc_bytes, 4);
+}
+
+bool apng_begin(ApngWriter *apng, int width, int height, const unsigned int *palette,
+                int colors, int level, uint32_t frames, uint32_t plays)
+{
+    memset(apng, 0, sizeof(ApngWriter));
+    apng->width = width;
+    apng->height = height;
+    apng->palette = palette;
+    apng->colors = colors;
+    apng->level = level;
+    apng->frames = frames;
+    apng->plays = plays;
+    pngfile_buffer_init(&apng->png);
+    return frames > 0;
+}
+
+static bool write_frame_control(FileWriter *w, ApngWriter *apng, int x, int y, int width, int height,
+                                uint16_t delay_num, uint16_t delay_den, int blend)
+{
+    uint8_t fctl[26];
+
+    put_u32(fctl, apng->sequence++);
+    put_u32(fctl + 4, width);
+    put_u32(fctl + 8, height);
+    put_u32(fctl + 12, x);
+    put_u32(fctl + 16, y);
+    put_u16(fctl + 20, delay_num);
+    put_u16(fctl + 22, delay_den);
+    fctl[24] = 0;                       // APNG_DISPOSE_OP_NONE
+    fctl[25] = (uint8_t)blend;
+    return write_chunk(w, "fcTL", NULL, fctl, sizeof(fctl));
+}
+
+bool apng_add_frame(FileWriter *w, ApngWriter *apng, const uint8_t *pixels, int stride,
+                    int x, int y, int width, int height,
+                    uint16_t delay_num, uint16_t delay_den, int blend)
+{
+    const uint8_t *p, *end;
+    uint8_t actl[8], seq[4];
+    uint32_t size;
+    bool first = apng->written == 0;
+    bool control = false;
+
+    if (apng->written >= apng->frames) return false;
+    if (first && (x != 0 || y != 0 || width != apng->width || height != apng->height)) return false;
+    if (!pngfile_encode(&apng->png, pixels, width, height, stride,
+                        apng->palette, apng->colors, apng->level))
+        return false;
+
+    // Il primo frame tiene IHDR, PLTE e tRNS di libpng; degli altri
+    // servono solo i dati compressi
+    if (first) fileio_write(w, png_signature, sizeof(png_signature));
+    p = apng->png.data + sizeof(png_signature);
+    end = apng->png.data + apng->png.size;
+    while (end - p >= 12) {
+        size = get_u32(p);
+        if (size > (uint32_t)(end - p) - 12) return false;
+
+        if (memcmp(p + 4, "IDAT", 4) == 0) {
+            if (!control) {
+                write_frame_control(w, apng, x, y, width, height, delay_num, delay_den, blend);
+                control = true;
+            }
+            if (first) {
+                fileio_write(w, p, size + 12);
+            } else {
+                put_u32(seq, apng->sequence++);
+                write_chunk(w, "fdAT", seq, p + 8, size);
+            }
+        } else if (first && memcmp(p + 4, "IEND", 4) != 0) {
+            fileio_write(w, p, size + 12);
+            if (memcmp(p + 4, "IHDR", 4) == 0) {
+                put_u32(actl, apng->frames);
+                put_u32(actl + 4, apng->plays);
+                write_chunk(w, "acTL", NULL, actl, sizeof(actl));
+            }
+        }
+        p += size + 12;
+    }
+
+    apng->written++;
+    return control && !w->error;
+}
+
+bool apng_end(FileWriter *w, ApngWriter *apng) {
+    bool ok = apng->written == apng->frames;
+
+    pngfile_buffer_free(&apng->png);
+    return write_chunk(w, "IEND", NULL, NULL, 0) && ok;
+}
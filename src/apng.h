@@ -0,0 +1,41 @@
+#ifndef APNG_H
+#define APNG_H
+
+#include "fileio.h"
+#include "pngfile.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// PNG animati (APNG) a tavolozza. Ogni frame passa da pngfile_encode:
+// del PNG prodotto da libpng si tengono gli IDAT, che per i frame dopo
+// il primo diventano fdAT preceduti da un fcTL con posizione e durata.
+// libpng non scrive i chunk APNG, quindi acTL, fcTL e fdAT sono qui.
+#define APNG_BLEND_SOURCE 0         // Il rettangolo sostituisce la tela
+#define APNG_BLEND_OVER   1         // I pixel trasparenti lasciano la tela
+
+typedef struct {
+    int width, height;
+    const unsigned int *palette;    // RGBA8, resta valida fino a apng_end
+    int colors;
+    int level;                      // Livello zlib
+    uint32_t frames;                // Dichiarati in acTL
+    uint32_t plays;
+    uint32_t written;
+    uint32_t sequence;              // Numero di sequenza di fcTL/fdAT
+    PngBuffer png;
+} ApngWriter;
+
+// plays: ripetizioni dell'animazione, 0 = all'infinito
+bool apng_begin(ApngWriter *apng, int width, int height, const unsigned int *palette,
+                int colors, int level, uint32_t frames, uint32_t plays);
+
+// Il primo frame copre tutta la tela. La durata e' delay_num / delay_den
+// secondi; pixels punta al pixel (x, y) con passo stride.
+bool apng_add_frame(FileWriter *w, ApngWriter *apng, const uint8_t *pixels, int stride,
+                    int x, int y, int width, int height,
+                    uint16_t delay_num, uint16_t delay_den, int blend);
+
+// false se i frame scritti non sono quelli dichiarati
+bool apng_end(FileWriter *w, ApngWriter *apng);
+
+#endif
@@ -0,0 +1,75 @@
+#include "atlas.h"
+#include <stdlib.h>
+
+typedef struct {
+    int page;
+    int y, h;                   // Altezza del rettangolo che l'ha aperto
+    int used;                   // Larghezza gia' occupata
+} Shelf;
+
+// Altezza decrescente, poi larghezza; a parita' l'ordine d'ingresso
+static int cmp_rect(const void *a, const void *b) {
+    const AtlasRect *ra = *(const AtlasRect *const *)a;
+    const AtlasRect *rb = *(const AtlasRect *const *)b;
+
+    if (ra->h != rb->h) return rb->h - ra->h;
+    if (ra->w != rb->w) return rb->w - ra->w;
+    return (ra > rb) - (ra < rb);
+}
+
+int atlas_pack(AtlasRect *rects, int count, int page_w, int page_h, int padding) {
+    AtlasRect **order;
+    Shelf *shelves;
+    AtlasRect *r;
+    int i, s, shelf_count, pages, bottom;
+
+    order = (AtlasRect **)malloc(count * sizeof(AtlasRect *) + 1);
+    shelves = (Shelf *)malloc(count * sizeof(Shelf) + 1);
+    if (!order || !shelves) {
+        free(order);
+        free(shelves);
+        return -1;
+    }
+    for (i = 0; i < count; i++) order[i] = &rects[i];
+    qsort(order, count, sizeof(AtlasRect *), cmp_rect);
+
+    shelf_count = 0;
+    pages = 0;
+    for (i = 0; i < count; i++) {
+        r = order[i];
+        r->x = r->y = r->page = 0;
+        if (r->w <= 0 || r->h <= 0) continue;
+        if (r->w > page_w || r->h > page_h) {
+            pages = -1;
+            break;
+        }
+
+        for (s = 0; s < shelf_count; s++) {
+            if (shelves[s].h >= r->h && shelves[s].used + r->w <= page_w) break;
+        }
+        if (s == shelf_count) {
+            // Scaffale nuovo sotto l'ultimo della pagina corrente
+            bottom = 0;
+            if (shelf_count > 0)
+                bottom = shelves[shelf_count - 1].y + shelves[shelf_count - 1].h + padding;
+            if (pages == 0 || bottom + r->h > page_h) {
+                pages++;
+                bottom = 0;
+            }
+            shelves[s].page = pages - 1;
+            shelves[s].y = bottom;
+            shelves[s].h = r->h;
+            shelves[s].used = 0;
+            shelf_count++;
+        }
+
+        r->page = shelves[s].page;
+        r->x = shelves[s].used;
+        r->y = shelves[s].y;
+        shelves[s].used += r->w + padding;
+    }
+
+    free(order);
+    free(shelves);
+    return pages;
+}
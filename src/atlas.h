@@ -0,0 +1,19 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <stdbool.h>
+
+// Impacchettamento di rettangoli in pagine di dimensione fissa: scaffali
+// riempiti in ordine di altezza decrescente (first fit). Ogni
+// rettangolo va nel primo scaffale, di qualsiasi pagina, dove entra;
+// altrimenti apre uno scaffale sotto l'ultimo, o una pagina nuova.
+typedef struct {
+    int w, h;                   // Ingresso; 0 x 0 = non occupa spazio
+    int x, y, page;             // Uscita
+} AtlasRect;
+
+// Restituisce il numero di pagine, -1 se un rettangolo non entra in una
+// pagina o manca memoria. padding: spazio libero tra i rettangoli.
+int atlas_pack(AtlasRect *rects, int count, int page_w, int page_h, int padding);
+
+#endif
@@ -1,4 +1,5 @@
 #include "audio.h"
+#include "animation.h"
 #include <psp2/audioout.h>
 #include <psp2/audioin.h>
 #include <stdlib.h>
@@ -78,6 +79,20 @@ void audio_free(AudioContext *audio) {
     }
 }
 
+uint64_t audio_get_hash(AudioContext *audio) {
+    uint64_t h;
+    int i;
+
+    h = animation_hash_data(audio->se_triggers, sizeof(audio->se_triggers));
+    for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
+        if (audio->sound_effects[i].data) {
+            h = h * 31 + animation_hash_data(audio->sound_effects[i].data,
+                                             audio->sound_effects[i].sample_count * sizeof(int16_t));
+        }
+    }
+    return h;
+}
+
 void audio_generate_click(SoundClip *clip) {
     int i, samples;
     float t, envelope, wave;
@@ -56,6 +56,9 @@ void audio_stop_se(AudioContext *audio);
 void audio_set_se_trigger(AudioContext *audio, int frame, int se_index, int enabled);
 int audio_get_se_trigger(AudioContext *audio, int frame, int se_index);
 
+// Fingerprint di trigger e clip (per autosave)
+uint64_t audio_get_hash(AudioContext *audio);
+
 void audio_generate_click(SoundClip *clip);
 void audio_generate_beep(SoundClip *clip, float frequency, float duration);
 void audio_generate_drum(SoundClip *clip);
@@ -0,0 +1,190 @@
+#include "avi.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define AVI_HEADER_SIZE   (12 + 12 + 64 + 12 + 64 + 48 + 12 + 64 + 26 + 12)
+#define AVIF_HASINDEX     0x10
+#define AVIF_INTERLEAVED  0x100
+#define AVIIF_KEYFRAME    0x10
+
+static void put_u16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)((v >> 8) & 0xFF);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+static void put_chunk(uint8_t *p, const char *fourcc, uint32_t size) {
+    memcpy(p, fourcc, 4);
+    put_u32(p + 4, size);
+}
+
+static void put_list(uint8_t *p, const char *type, uint32_t size) {
+    put_chunk(p, "LIST", size);
+    memcpy(p + 8, type, 4);
+}
+
+// strh: 56 byte dopo l'header del chunk
+static void put_stream_header(uint8_t *p, const char *type, const char *handler,
+                              uint32_t scale, uint32_t rate, uint32_t length,
+                              uint32_t buffer_size, uint32_t sample_size, int width, int height)
+{
+    put_chunk(p, "strh", 56);
+    memset(p + 8, 0, 56);
+    memcpy(p + 8, type, 4);
+    memcpy(p + 12, handler, 4);
+    put_u32(p + 28, scale);
+    put_u32(p + 32, rate);
+    put_u32(p + 40, length);
+    put_u32(p + 44, buffer_size);
+    put_u32(p + 48, 0xFFFFFFFF);        // Qualita' predefinita
+    put_u32(p + 52, sample_size);
+    put_u16(p + 60, width);
+    put_u16(p + 62, height);
+}
+
+// RIFF, hdrl e l'inizio della lista movi; a dimensione fissa, cosi'
+// avi_end la riscrive al suo posto
+static bool write_headers(FileWriter *w, const AviWriter *avi, uint32_t riff_size, uint32_t movi_size) {
+    uint8_t h[AVI_HEADER_SIZE];
+    uint8_t *p = h;
+    uint32_t frame_us;
+
+    memset(h, 0, sizeof(h));
+    put_chunk(p, "RIFF", riff_size);
+    memcpy(p + 8, "AVI ", 4);
+    p += 12;
+    put_list(p, "hdrl", 4 + 64 + 12 + 64 + 48 + 12 + 64 + 26);
+    p += 12;
+
+    // avih
+    frame_us = (uint32_t)((uint64_t)1000000 * avi->scale / avi->rate);
+    put_chunk(p, "avih", 56);
+    put_u32(p + 8, frame_us);
+    put_u32(p + 12, (uint32_t)((uint64_t)avi->max_video_size * avi->rate / avi->scale +
+                               avi->sample_rate * 2));
+    put_u32(p + 20, AVIF_HASINDEX | AVIF_INTERLEAVED);
+    put_u32(p + 24, avi->video_frames);
+    put_u32(p + 32, 2);
+    put_u32(p + 36, avi->max_video_size > avi->max_audio_size ? avi->max_video_size
+                                                              : avi->max_audio_size);
+    put_u32(p + 40, avi->width);
+    put_u32(p + 44, avi->height);
+    p += 64;
+
+    // Video: strh + BITMAPINFOHEADER
+    put_list(p, "strl", 4 + 64 + 48);
+    p += 12;
+    put_stream_header(p, "vids", "MJPG", avi->scale, avi->rate, avi->video_frames,
+                      avi->max_video_size, 0, avi->width, avi->height);
+    p += 64;
+    put_chunk(p, "strf", 40);
+    put_u32(p + 8, 40);
+    put_u32(p + 12, avi->width);
+    put_u32(p + 16, avi->height);
+    put_u16(p + 20, 1);
+    put_u16(p + 22, 24);
+    memcpy(p + 24, "MJPG", 4);
+    put_u32(p + 28, avi->width * avi->height * 3);
+    p += 48;
+
+    // Audio: strh + WAVEFORMATEX
+    put_list(p, "strl", 4 + 64 + 26);
+    p += 12;
+    put_stream_header(p, "auds", "\0\0\0\0", 1, avi->sample_rate, avi->audio_samples,
+                      avi->max_audio_size, 2, 0, 0);
+    p += 64;
+    put_chunk(p, "strf", 18);
+    put_u16(p + 8, 1);                  // PCM
+    put_u16(p + 10, 1);                 // Mono
+    put_u32(p + 12, avi->sample_rate);
+    put_u32(p + 16, avi->sample_rate * 2);
+    put_u16(p + 20, 2);
+    put_u16(p + 22, 16);
+    p += 26;
+
+    put_list(p, "movi", movi_size);
+    return fileio_write(w, h, sizeof(h));
+}
+
+bool avi_begin(FileWriter *w, AviWriter *avi, int width, int height,
+               uint32_t rate, uint32_t scale, uint32_t sample_rate)
+{
+    memset(avi, 0, sizeof(AviWriter));
+    avi->width = width;
+    avi->height = height;
+    avi->rate = rate;
+    avi->scale = scale;
+    avi->sample_rate = sample_rate;
+    avi->movi_pos = fileio_tell_write(w) + AVI_HEADER_SIZE - 4;
+    return write_headers(w, avi, 0, 4);
+}
+
+static bool add_chunk(FileWriter *w, AviWriter *avi, const char *id, const void *data, uint32_t size) {
+    AviIndexEntry *grown;
+    AviIndexEntry *e;
+    uint8_t header[8];
+    int capacity;
+
+    if (avi->index_count == avi->index_capacity) {
+        capacity = avi->index_capacity ? avi->index_capacity * 2 : 256;
+        grown = (AviIndexEntry *)realloc(avi->index, capacity * sizeof(AviIndexEntry));
+        if (!grown) return false;
+        avi->index = grown;
+        avi->index_capacity = capacity;
+    }
+    e = &avi->index[avi->index_count++];
+    memcpy(&e->id, id, 4);
+    e->offset = (uint32_t)(fileio_tell_write(w) - avi->movi_pos);
+    e->size = size;
+
+    put_chunk(header, id, size);
+    fileio_write(w, header, 8);
+    fileio_write(w, data, size);
+    if (size & 1) fileio_put(w, 0);     // I chunk partono a indirizzi pari
+    return !w->error;
+}
+
+bool avi_add_video(FileWriter *w, AviWriter *avi, const uint8_t *jpeg, uint32_t size) {
+    if (size > avi->max_video_size) avi->max_video_size = size;
+    avi->video_frames++;
+    return add_chunk(w, avi, "00dc", jpeg, size);
+}
+
+bool avi_add_audio(FileWriter *w, AviWriter *avi, const int16_t *samples, uint32_t count) {
+    if (count == 0) return !w->error;
+    if (count * 2 > avi->max_audio_size) avi->max_audio_size = count * 2;
+    avi->audio_samples += count;
+    return add_chunk(w, avi, "01wb", samples, count * 2);
+}
+
+bool avi_end(FileWriter *w, AviWriter *avi) {
+    uint8_t entry[16];
+    SceOff end;
+    uint32_t movi_size;
+    int i;
+
+    movi_size = (uint32_t)(fileio_tell_write(w) - avi->movi_pos);
+
+    put_chunk(entry, "idx1", avi->index_count * 16);
+    fileio_write(w, entry, 8);
+    for (i = 0; i < avi->index_count; i++) {
+        memcpy(entry, &avi->index[i].id, 4);
+        put_u32(entry + 4, AVIIF_KEYFRAME);
+        put_u32(entry + 8, avi->index[i].offset);
+        put_u32(entry + 12, avi->index[i].size);
+        fileio_write(w, entry, 16);
+    }
+    free(avi->index);
+    avi->index = NULL;
+    avi->index_count = avi->index_capacity = 0;
+
+    end = fileio_tell_write(w);
+    fileio_seek_write(w, avi->movi_pos + 4 - AVI_HEADER_SIZE);
+    write_headers(w, avi, (uint32_t)(end - 8), movi_size);
+    fileio_seek_write(w, end);
+    return !w->error;
+}
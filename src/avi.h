@@ -0,0 +1,39 @@
+#ifndef AVI_H
+#define AVI_H
+
+#include "fileio.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Scrittura di AVI 1.0 con due flussi: video MJPEG ("00dc", ogni frame
+// un JPEG completo) e audio PCM 16 bit mono ("01wb"). I chunk vanno
+// scritti gia' interleaved; avi_end aggiunge l'indice idx1 e riscrive
+// gli header con i totali.
+typedef struct {
+    uint32_t id;                // "00dc" o "01wb"
+    uint32_t offset;            // Dalla FourCC "movi"
+    uint32_t size;
+} AviIndexEntry;
+
+typedef struct {
+    int width, height;
+    uint32_t rate, scale;       // Frame al secondo = rate / scale
+    uint32_t sample_rate;
+    SceOff movi_pos;            // Posizione della FourCC "movi"
+    uint32_t video_frames;
+    uint32_t audio_samples;
+    uint32_t max_video_size;
+    uint32_t max_audio_size;
+    AviIndexEntry *index;
+    int index_count, index_capacity;
+} AviWriter;
+
+bool avi_begin(FileWriter *w, AviWriter *avi, int width, int height,
+               uint32_t rate, uint32_t scale, uint32_t sample_rate);
+bool avi_add_video(FileWriter *w, AviWriter *avi, const uint8_t *jpeg, uint32_t size);
+bool avi_add_audio(FileWriter *w, AviWriter *avi, const int16_t *samples, uint32_t count);
+
+// Libera l'indice anche in caso di errore
+bool avi_end(FileWriter *w, AviWriter *avi);
+
+#endif
@@ -0,0 +1,192 @@
+#include "codec.h"
+#include <stdlib.h>
+#include <string.h>
+
+void codec_init(CodecContext *ctx, FrameCodec codec, int level) {
+    memset(ctx, 0, sizeof(CodecContext));
+    if (codec < 0 || codec >= CODEC_COUNT) codec = CODEC_RLE;
+    if (level < 1) level = 1;
+    if (level > 9) level = 9;
+    ctx->codec = codec;
+    ctx->level = level;
+}
+
+void codec_free(CodecContext *ctx) {
+    if (ctx->deflate_ready) deflateEnd(&ctx->deflater);
+    if (ctx->inflate_ready) inflateEnd(&ctx->inflater);
+    free(ctx->packed);
+    ctx->packed = NULL;
+    ctx->deflate_ready = false;
+    ctx->inflate_ready = false;
+}
+
+const char *codec_name(FrameCodec codec) {
+    switch (codec) {
+        case CODEC_RLE:      return "RLE";
+        case CODEC_DEFLATE2: return "Deflate";
+        default:             return "?";
+    }
+}
+
+static bool codec_ensure_packed(CodecContext *ctx) {
+    if (!ctx->packed) ctx->packed = (uint8_t *)malloc(CODEC_PACKED_SIZE);
+    return ctx->packed != NULL;
+}
+
+static uint32_t rle_encode_layer(const uint8_t *pixels, uint8_t *out) {
+    uint32_t n = 0;
+    int i = 0, count;
+    uint8_t val;
+
+    while (i < LAYER_PIXELS) {
+        val = pixels[i];
+        count = 1;
+        while (i + count < LAYER_PIXELS && pixels[i + count] == val && count < 255) {
+            count++;
+        }
+        out[n++] = (uint8_t)count;
+        out[n++] = val;
+        i += count;
+    }
+    out[n++] = 0;
+    out[n++] = 0xFF;
+    return n;
+}
+
+// Ritorna i byte consumati, 0 se il buffer finisce prima del terminatore
+static uint32_t rle_decode_layer(const uint8_t *in, uint32_t size, uint8_t *pixels) {
+    uint32_t n = 0;
+    int pos = 0, count;
+
+    while (n + 2 <= size) {
+        count = in[n];
+        if (count == 0 && in[n + 1] == 0xFF) return n + 2;
+        if (count > LAYER_PIXELS - pos) count = LAYER_PIXELS - pos;
+        memset(&pixels[pos], in[n + 1], count);
+        pos += count;
+        n += 2;
+    }
+    return 0;
+}
+
+// 0 se qualche indice non sta in 2 bit
+static bool pack_layers(const LayerData *layers, uint8_t *packed) {
+    const uint8_t *p;
+    uint8_t over = 0;
+    int l, i;
+
+    for (l = 0; l < MAX_LAYERS; l++) {
+        p = layers[l].pixels;
+        for (i = 0; i < LAYER_PIXELS; i += 4) {
+            over |= p[i] | p[i + 1] | p[i + 2] | p[i + 3];
+            *packed++ = (uint8_t)(p[i] | (p[i + 1] << 2) | (p[i + 2] << 4) | (p[i + 3] << 6));
+        }
+    }
+    return (over & ~3) == 0;
+}
+
+static void unpack_layers(const uint8_t *packed, LayerData *layers) {
+    uint8_t *p, b;
+    int l, i;
+
+    for (l = 0; l < MAX_LAYERS; l++) {
+        p = layers[l].pixels;
+        for (i = 0; i < LAYER_PIXELS; i += 4) {
+            b = *packed++;
+            p[i] = b & 3;
+            p[i + 1] = (b >> 2) & 3;
+            p[i + 2] = (b >> 4) & 3;
+            p[i + 3] = b >> 6;
+        }
+    }
+}
+
+static uint32_t deflate_encode(CodecContext *ctx, const LayerData *layers, uint8_t *out) {
+    z_stream *zs = &ctx->deflater;
+
+    if (!codec_ensure_packed(ctx)) return 0;
+    if (!pack_layers(layers, ctx->packed)) return 0;
+
+    if (!ctx->deflate_ready) {
+        if (deflateInit(zs, ctx->level) != Z_OK) return 0;
+        ctx->deflate_ready = true;
+    } else if (deflateReset(zs) != Z_OK) {
+        return 0;
+    }
+
+    zs->next_in = ctx->packed;
+    zs->avail_in = CODEC_PACKED_SIZE;
+    zs->next_out = out;
+    zs->avail_out = CODEC_MAX_SIZE;
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END) return 0;
+    return (uint32_t)zs->total_out;
+}
+
+static bool deflate_decode(CodecContext *ctx, const uint8_t *in, uint32_t size,
+                           LayerData *layers)
+{
+    z_stream *zs = &ctx->inflater;
+
+    if (!codec_ensure_packed(ctx)) return false;
+
+    if (!ctx->inflate_ready) {
+        if (inflateInit(zs) != Z_OK) return false;
+        ctx->inflate_ready = true;
+    } else if (inflateReset(zs) != Z_OK) {
+        return false;
+    }
+
+    zs->next_in = (Bytef *)in;
+    zs->avail_in = size;
+    zs->next_out = ctx->packed;
+    zs->avail_out = CODEC_PACKED_SIZE;
+    if (inflate(zs, Z_FINISH) != Z_STREAM_END || zs->total_out != CODEC_PACKED_SIZE)
+        return false;
+
+    unpack_layers(ctx->packed, layers);
+    return true;
+}
+
+uint32_t codec_encode(CodecContext *ctx, const LayerData *layers, uint8_t *out,
+                      uint8_t *used)
+{
+    uint32_t n;
+    int l;
+
+    if (ctx->codec == CODEC_DEFLATE2) {
+        n = deflate_encode(ctx, layers, out);
+        if (n > 0) {
+            *used = CODEC_DEFLATE2;
+            return n;
+        }
+    }
+
+    n = 0;
+    for (l = 0; l < MAX_LAYERS; l++) {
+        n += rle_encode_layer(layers[l].pixels, out + n);
+    }
+    *used = CODEC_RLE;
+    return n;
+}
+
+bool codec_decode(CodecContext *ctx, uint8_t codec, const uint8_t *in, uint32_t size,
+                  LayerData *layers)
+{
+    uint32_t n, used;
+    int l;
+
+    switch (codec) {
+        case CODEC_RLE:
+            n = 0;
+            for (l = 0; l < MAX_LAYERS; l++) {
+                used = rle_decode_layer(in + n, size - n, layers[l].pixels);
+                if (used == 0) return false;
+                n += used;
+            }
+            return true;
+        case CODEC_DEFLATE2:
+            return deflate_decode(ctx, in, size, layers);
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include "drawing.h"
+#include <zlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LAYER_PIXELS (CANVAS_WIDTH * CANVAS_HEIGHT)
+
+typedef enum {
+    CODEC_RLE,          // Coppie (count, indice) + terminatore 0x00 0xFF per layer
+    CODEC_DEFLATE2,     // Indici a 2 bit (4 per byte), layer concatenati, deflate
+    CODEC_COUNT
+} FrameCodec;
+
+#define CODEC_DEFAULT_LEVEL 6
+
+// Caso peggiore RLE: una coppia per pixel + terminatore, per layer.
+// Maggiore anche del limite di deflate sui dati impacchettati.
+#define CODEC_MAX_SIZE (MAX_LAYERS * (LAYER_PIXELS * 2 + 2))
+#define CODEC_PACKED_SIZE (MAX_LAYERS * LAYER_PIXELS / 4)
+
+// Stato riutilizzabile tra un frame e l'altro (uno per thread)
+typedef struct {
+    FrameCodec codec;
+    int level;              // Livello zlib 1..9
+    uint8_t *packed;
+    z_stream deflater;
+    z_stream inflater;
+    bool deflate_ready;
+    bool inflate_ready;
+} CodecContext;
+
+void codec_init(CodecContext *ctx, FrameCodec codec, int level);
+void codec_free(CodecContext *ctx);
+
+// Ritorna i byte scritti (0 = errore). *used riceve il codec usato davvero:
+// i layer con indici > 3 ricadono su RLE.
+uint32_t codec_encode(CodecContext *ctx, const LayerData *layers, uint8_t *out,
+                      uint8_t *used);
+bool codec_decode(CodecContext *ctx, uint8_t codec, const uint8_t *in, uint32_t size,
+                  LayerData *layers);
+
+const char *codec_name(FrameCodec codec);
+
+#endif
@@ -1,4 +1,5 @@
 #include "drawing.h"
+#include "selection.h"
 #include "colors.h"
 #include <vita2d.h>
 #include <string.h>
@@ -11,6 +12,42 @@ static const unsigned int LAYER_PALETTE[3][4] = {
     { COLOR_TRANSPARENT, COLOR_BLACK, COLOR_RED, COLOR_BLUE }
 };
 
+static StrokeLog *drawing_active_log(DrawingContext *ctx) {
+    return &ctx->strokes[ctx->active_layer];
+}
+
+static void drawing_record(DrawingContext *ctx, StrokeKind kind, int filled) {
+    if (ctx->stroke_replay) return;
+    if (!ctx->record_strokes) {
+        strokes_invalidate(drawing_active_log(ctx));
+        return;
+    }
+    strokes_begin(drawing_active_log(ctx), kind, ctx->current_tool,
+                  ctx->current_color, ctx->brush_size, filled);
+}
+
+static void drawing_record_point(DrawingContext *ctx, int x, int y) {
+    if (ctx->stroke_replay) return;
+    strokes_add_point(drawing_active_log(ctx), x, y);
+}
+
+// Punto successivo di un tratto a mano libera gia' iniziato
+static void drawing_record_continue(DrawingContext *ctx, int x, int y) {
+    StrokeLog *log;
+    if (ctx->stroke_replay) return;
+    log = drawing_active_log(ctx);
+    if (log->valid && !log->open) {
+        strokes_invalidate(log);
+        return;
+    }
+    strokes_add_point(log, x, y);
+}
+
+static void drawing_invalidate_strokes(DrawingContext *ctx, int layer) {
+    if (ctx->stroke_replay) return;
+    strokes_invalidate(&ctx->strokes[layer]);
+}
+
 static void drawing_line_internal(DrawingContext *ctx, int x0, int y0, int x1, int y1, int use_brush) {
     int dx, dy, sx, sy, err, e2;
     uint8_t color;
@@ -58,7 +95,9 @@ void drawing_init(DrawingContext *ctx) {
     for (i = 0; i < MAX_LAYERS; i++) {
         ctx->layer_visible[i] = 1;
         memset(&ctx->layers[i], 0, sizeof(LayerData));
+        strokes_init(&ctx->strokes[i]);
     }
+    ctx->record_strokes = 1;
 
     ctx->undo.current = -1;
     ctx->undo.count = 0;
@@ -69,13 +108,26 @@ void drawing_reset(DrawingContext *ctx) {
     int i;
     for (i = 0; i < MAX_LAYERS; i++) {
         memset(&ctx->layers[i], 0, sizeof(LayerData));
+        strokes_clear(&ctx->strokes[i]);
     }
     ctx->has_selection = 0;
     ctx->has_stamp = 0;
+    free(ctx->stamp_runs);
+    ctx->stamp_runs = NULL;
     ctx->undo.current = -1;
     ctx->undo.count = 0;
 }
 
+void drawing_free(DrawingContext *ctx) {
+    int i;
+    for (i = 0; i < MAX_LAYERS; i++) {
+        strokes_free(&ctx->strokes[i]);
+    }
+    free(ctx->stamp_runs);
+    ctx->stamp_runs = NULL;
+    ctx->has_stamp = 0;
+}
+
 unsigned int drawing_get_rgba_color(uint8_t color_index, int layer) {
     if (color_index == 0) {
         if (layer == 0) return COLOR_WHITE;
@@ -123,10 +175,13 @@ void drawing_pen_stroke(DrawingContext *ctx, int x, int y) {
         ctx->is_drawing = 1;
         ctx->last_x = x;
         ctx->last_y = y;
+        drawing_record(ctx, STROKE_PEN, 0);
+        drawing_record_point(ctx, x, y);
         drawing_draw_brush(ctx, x, y);
         return;
     }
 
+    drawing_record_continue(ctx, x, y);
     drawing_line_internal(ctx, ctx->last_x, ctx->last_y, x, y, 1);
     ctx->last_x = x;
     ctx->last_y = y;
@@ -140,6 +195,9 @@ void drawing_eraser_stroke(DrawingContext *ctx, int x, int y) {
 }
 
 void drawing_line(DrawingContext *ctx, int x0, int y0, int x1, int y1) {
+    drawing_record(ctx, STROKE_LINE, 0);
+    drawing_record_point(ctx, x0, y0);
+    drawing_record_point(ctx, x1, y1);
     drawing_line_internal(ctx, x0, y0, x1, y1, 1);
 }
 
@@ -147,6 +205,10 @@ void drawing_rect(DrawingContext *ctx, int x0, int y0, int x1, int y1, int fille
     int x, y, t;
     uint8_t color;
 
+    drawing_record(ctx, STROKE_RECT, filled);
+    drawing_record_point(ctx, x0, y0);
+    drawing_record_point(ctx, x1, y1);
+
     if (x0 > x1) { t = x0; x0 = x1; x1 = t; }
     if (y0 > y1) { t = y0; y0 = y1; y1 = t; }
 
@@ -174,6 +236,10 @@ void drawing_circle(DrawingContext *ctx, int cx, int cy, int radius, int filled)
     int x, y, err;
     uint8_t color = ctx->current_color;
 
+    drawing_record(ctx, STROKE_CIRCLE, filled);
+    drawing_record_point(ctx, cx, cy);
+    drawing_record_point(ctx, radius, 0);
+
     if (filled) {
         for (y = -radius; y <= radius; y++) {
             for (x = -radius; x <= radius; x++) {
@@ -215,6 +281,9 @@ void drawing_bucket_fill(DrawingContext *ctx, int x, int y) {
 
     if (x < 0 || x >= CANVAS_WIDTH || y < 0 || y >= CANVAS_HEIGHT) return;
 
+    drawing_record(ctx, STROKE_FILL, 1);
+    drawing_record_point(ctx, x, y);
+
     target_color = drawing_get_pixel(ctx, x, y);
     fill_color = ctx->current_color;
 
@@ -271,12 +340,14 @@ void drawing_toggle_layer_visibility(DrawingContext *ctx, int layer) {
 void drawing_clear_layer(DrawingContext *ctx, int layer) {
     if (layer >= 0 && layer < MAX_LAYERS) {
         memset(&ctx->layers[layer], 0, sizeof(LayerData));
+        strokes_clear(&ctx->strokes[layer]);
     }
 }
 
 void drawing_copy_layer(DrawingContext *ctx, int src, int dst) {
     if (src >= 0 && src < MAX_LAYERS && dst >= 0 && dst < MAX_LAYERS) {
         memcpy(&ctx->layers[dst], &ctx->layers[src], sizeof(LayerData));
+        drawing_invalidate_strokes(ctx, dst);
     }
 }
 
@@ -293,77 +364,353 @@ void drawing_merge_layers(DrawingContext *ctx) {
             }
         }
     }
+    drawing_invalidate_strokes(ctx, 0);
+    for (l = 1; l < MAX_LAYERS; l++) {
+        strokes_clear(&ctx->strokes[l]);
+    }
 }
 
 void drawing_swap_layers(DrawingContext *ctx, int a, int b) {
     LayerData temp;
+    StrokeLog temp_log;
     if (a >= 0 && a < MAX_LAYERS && b >= 0 && b < MAX_LAYERS) {
         memcpy(&temp, &ctx->layers[a], sizeof(LayerData));
         memcpy(&ctx->layers[a], &ctx->layers[b], sizeof(LayerData));
         memcpy(&ctx->layers[b], &temp, sizeof(LayerData));
+
+        temp_log = ctx->strokes[a];
+        ctx->strokes[a] = ctx->strokes[b];
+        ctx->strokes[b] = temp_log;
+        strokes_retag(&ctx->strokes[a]);
+        strokes_retag(&ctx->strokes[b]);
+    }
+}
+
+typedef void (*MaskSpanFn)(DrawingContext *ctx, int y, int x, int len, void *user);
+
+// Percorre le righe della maschera dentro il bounding box e chiama fn per
+// ogni run di bit a 1: parole piene o vuote costano un confronto
+static void drawing_mask_spans(DrawingContext *ctx, MaskSpanFn fn, void *user) {
+    const uint32_t *row;
+    uint32_t word, rest;
+    int y, w, w0, w1, pos, run;
+
+    w0 = ctx->sel_x >> 5;
+    w1 = (ctx->sel_x + ctx->sel_w - 1) >> 5;
+
+    for (y = ctx->sel_y; y < ctx->sel_y + ctx->sel_h; y++) {
+        row = &ctx->selection_mask.bits[y * SEL_ROW_WORDS];
+        run = -1;
+
+        for (w = w0; w <= w1; w++) {
+            word = row[w];
+            if (word == 0xFFFFFFFFu) {
+                if (run < 0) run = w * 32;
+                continue;
+            }
+
+            pos = 0;
+            while (pos < 32) {
+                rest = word >> pos;
+                if (rest & 1) {
+                    if (run < 0) run = w * 32 + pos;
+                    pos += __builtin_ctz(~rest);
+                    if (pos < 32) {
+                        fn(ctx, y, run, w * 32 + pos - run, user);
+                        run = -1;
+                    }
+                } else {
+                    if (run >= 0) {
+                        fn(ctx, y, run, w * 32 + pos - run, user);
+                        run = -1;
+                    }
+                    if (!rest) break;
+                    pos += __builtin_ctz(rest);
+                }
+            }
+        }
+
+        if (run >= 0) fn(ctx, y, run, (w1 + 1) * 32 - run, user);
+    }
+}
+
+static void span_copy(DrawingContext *ctx, int y, int x, int len, void *user) {
+    (void)user;
+    memcpy(&ctx->selection_buffer[(y - ctx->sel_y) * CANVAS_WIDTH + (x - ctx->sel_x)],
+           &ctx->layers[ctx->active_layer].pixels[y * CANVAS_WIDTH + x], len);
+}
+
+static void span_set(DrawingContext *ctx, int y, int x, int len, void *user) {
+    memset(&ctx->layers[ctx->active_layer].pixels[y * CANVAS_WIDTH + x],
+           *(const uint8_t *)user, len);
+}
+
+static void span_invert(DrawingContext *ctx, int y, int x, int len, void *user) {
+    uint8_t *p = &ctx->layers[ctx->active_layer].pixels[y * CANVAS_WIDTH + x];
+    int i;
+    (void)user;
+    for (i = 0; i < len; i++) {
+        if (p[i] == 0) p[i] = 1;
+        else if (p[i] == 1) p[i] = 0;
     }
 }
 
+static void drawing_update_selection_bounds(DrawingContext *ctx) {
+    ctx->has_selection = selection_bounds(&ctx->selection_mask, &ctx->sel_x, &ctx->sel_y,
+                                          &ctx->sel_w, &ctx->sel_h);
+}
+
+void drawing_select_mask(DrawingContext *ctx, const SelectionMask *mask, SelectionOp op) {
+    if (!ctx->has_selection) selection_clear(&ctx->selection_mask);
+    selection_combine(&ctx->selection_mask, mask, op);
+    drawing_update_selection_bounds(ctx);
+}
+
 void drawing_select_area(DrawingContext *ctx, int x, int y, int w, int h) {
-    ctx->has_selection = 1;
-    ctx->sel_x = x;
-    ctx->sel_y = y;
-    ctx->sel_w = w;
-    ctx->sel_h = h;
+    selection_rect(&ctx->selection_mask, x, y, w, h);
+    drawing_update_selection_bounds(ctx);
+}
+
+void drawing_select_lasso(DrawingContext *ctx, const int *xs, const int *ys, int n, SelectionOp op) {
+    SelectionMask *m = (SelectionMask *)malloc(sizeof(SelectionMask));
+    if (!m) return;
+    selection_lasso(m, xs, ys, n);
+    drawing_select_mask(ctx, m, op);
+    free(m);
+}
+
+// Buffer pieno: un punto si' e uno no, cosi' il tracciato resta intero
+// a risoluzione dimezzata invece di perdere la coda
+void drawing_lasso_add_point(DrawingContext *ctx, int x, int y) {
+    int i, n = ctx->lasso_count;
+
+    if (n > 0) {
+        int dx = x - ctx->lasso_x[n - 1], dy = y - ctx->lasso_y[n - 1];
+        if (dx * dx + dy * dy < LASSO_MIN_DIST * LASSO_MIN_DIST) return;
+    }
+    if (n >= MAX_LASSO_POINTS) {
+        for (i = 0; i < n / 2; i++) {
+            ctx->lasso_x[i] = ctx->lasso_x[i * 2];
+            ctx->lasso_y[i] = ctx->lasso_y[i * 2];
+        }
+        n /= 2;
+    }
+    ctx->lasso_x[n] = x;
+    ctx->lasso_y[n] = y;
+    ctx->lasso_count = n + 1;
+}
+
+void drawing_select_magic_wand(DrawingContext *ctx, int x, int y, SelectionOp op) {
+    SelectionMask *m = (SelectionMask *)malloc(sizeof(SelectionMask));
+    if (!m) return;
+    selection_magic_wand(m, &ctx->layers[ctx->active_layer], x, y);
+    drawing_select_mask(ctx, m, op);
+    free(m);
 }
 
 void drawing_copy_selection(DrawingContext *ctx) {
-    int x, y, sx, sy;
     if (!ctx->has_selection) return;
     memset(ctx->selection_buffer, 0, sizeof(ctx->selection_buffer));
-    for (y = 0; y < ctx->sel_h; y++) {
-        for (x = 0; x < ctx->sel_w; x++) {
-            sx = ctx->sel_x + x;
-            sy = ctx->sel_y + y;
-            if (sx >= 0 && sx < CANVAS_WIDTH && sy >= 0 && sy < CANVAS_HEIGHT) {
-                ctx->selection_buffer[y * CANVAS_WIDTH + x] = drawing_get_pixel(ctx, sx, sy);
-            }
-        }
-    }
+    drawing_mask_spans(ctx, span_copy, NULL);
     ctx->has_stamp = 1;
     ctx->stamp_w = ctx->sel_w;
     ctx->stamp_h = ctx->sel_h;
     memcpy(ctx->stamp_buffer, ctx->selection_buffer, sizeof(ctx->selection_buffer));
+    drawing_encode_stamp(ctx);
 }
 
 void drawing_cut_selection(DrawingContext *ctx) {
-    int x, y;
+    uint8_t clear = 0;
     drawing_copy_selection(ctx);
     if (!ctx->has_selection) return;
-    for (y = 0; y < ctx->sel_h; y++) {
-        for (x = 0; x < ctx->sel_w; x++) {
-            drawing_set_pixel(ctx, ctx->sel_x + x, ctx->sel_y + y, 0);
+    drawing_invalidate_strokes(ctx, ctx->active_layer);
+    drawing_mask_spans(ctx, span_set, &clear);
+}
+
+void drawing_fill_selection(DrawingContext *ctx) {
+    uint8_t color = ctx->current_color;
+    if (!ctx->has_selection) return;
+    drawing_invalidate_strokes(ctx, ctx->active_layer);
+    drawing_mask_spans(ctx, span_set, &color);
+}
+
+// Solleva i pixel selezionati e li riappoggia specchiati o ruotati di 90
+// gradi (orario) attorno al centro del bounding box; la maschera segue il
+// contenuto e cio' che esce dal canvas va perso
+static void drawing_transform_selection(DrawingContext *ctx, int flip_h, int flip_v, int rotate) {
+    LayerData *layer = &ctx->layers[ctx->active_layer];
+    LayerData *src;
+    SelectionMask *old;
+    uint8_t clear = 0;
+    uint32_t word;
+    int x0, x1, y0, y1, y, w, x, nx, ny;
+
+    src = (LayerData *)malloc(sizeof(LayerData));
+    old = (SelectionMask *)malloc(sizeof(SelectionMask));
+    if (!src || !old) {
+        free(src);
+        free(old);
+        return;
+    }
+
+    drawing_invalidate_strokes(ctx, ctx->active_layer);
+    memcpy(src, layer, sizeof(LayerData));
+    selection_copy(old, &ctx->selection_mask);
+    drawing_mask_spans(ctx, span_set, &clear);
+    selection_clear(&ctx->selection_mask);
+
+    x0 = ctx->sel_x; x1 = ctx->sel_x + ctx->sel_w - 1;
+    y0 = ctx->sel_y; y1 = ctx->sel_y + ctx->sel_h - 1;
+
+    for (y = y0; y <= y1; y++) {
+        for (w = x0 >> 5; w <= x1 >> 5; w++) {
+            word = old->bits[y * SEL_ROW_WORDS + w];
+            while (word) {
+                x = w * 32 + __builtin_ctz(word);
+                word &= word - 1;
+                if (rotate) {
+                    // Centro in coordinate doppie: (x0+x1, y0+y1) / 2
+                    nx = (x0 + x1 + y0 + y1 - 2 * y) >> 1;
+                    ny = (y0 + y1 - x0 - x1 + 2 * x) >> 1;
+                    if (nx < 0 || nx >= CANVAS_WIDTH || ny < 0 || ny >= CANVAS_HEIGHT) continue;
+                } else {
+                    nx = flip_h ? (x0 + x1 - x) : x;
+                    ny = flip_v ? (y0 + y1 - y) : y;
+                }
+                layer->pixels[ny * CANVAS_WIDTH + nx] = src->pixels[y * CANVAS_WIDTH + x];
+                ctx->selection_mask.bits[ny * SEL_ROW_WORDS + (nx >> 5)] |= 1u << (nx & 31);
+            }
+        }
+    }
+
+    free(src);
+    free(old);
+    if (rotate) drawing_update_selection_bounds(ctx);
+}
+
+// Pre-codifica lo stamp in run opachi per riga: il paste diventa una
+// serie di memcpy senza test di trasparenza ne' bounds check per pixel.
+// I run sono contati in una prima passata e allocati su misura; senza
+// memoria lo stamp viene scartato.
+static int stamp_scan(DrawingContext *ctx, StampRun *runs) {
+    const uint8_t *row;
+    int x, y, n, start;
+
+    n = 0;
+    for (y = 0; y < ctx->stamp_h; y++) {
+        if (runs) ctx->stamp_row_start[y] = n;
+        row = &ctx->stamp_buffer[y * CANVAS_WIDTH];
+        x = 0;
+        while (x < ctx->stamp_w) {
+            while (x < ctx->stamp_w && row[x] == 0) x++;
+            if (x >= ctx->stamp_w) break;
+            start = x;
+            while (x < ctx->stamp_w && row[x] != 0) x++;
+            if (runs) {
+                runs[n].x = (uint16_t)start;
+                runs[n].len = (uint16_t)(x - start);
+            }
+            n++;
         }
     }
+    if (runs) ctx->stamp_row_start[ctx->stamp_h] = n;
+    return n;
+}
+
+void drawing_encode_stamp(DrawingContext *ctx) {
+    int n = stamp_scan(ctx, NULL);
+
+    free(ctx->stamp_runs);
+    ctx->stamp_runs = (StampRun *)malloc((n > 0 ? n : 1) * sizeof(StampRun));
+    if (!ctx->stamp_runs) {
+        ctx->has_stamp = 0;
+        return;
+    }
+    stamp_scan(ctx, ctx->stamp_runs);
 }
 
 void drawing_paste_selection(DrawingContext *ctx, int x, int y) {
-    int px, py;
-    uint8_t color;
+    uint8_t *layer;
+    const StampRun *run, *run_end;
+    int py, py0, py1, cx0, cx1, rx0, rx1;
+
     if (!ctx->has_stamp) return;
-    for (py = 0; py < ctx->stamp_h; py++) {
-        for (px = 0; px < ctx->stamp_w; px++) {
-            color = ctx->stamp_buffer[py * CANVAS_WIDTH + px];
-            if (color != 0) {
-                drawing_set_pixel(ctx, x + px, y + py, color);
-            }
+
+    // Clip una volta sola, in coordinate dello stamp
+    py0 = (y < 0) ? -y : 0;
+    py1 = ctx->stamp_h;
+    if (y + py1 > CANVAS_HEIGHT) py1 = CANVAS_HEIGHT - y;
+    cx0 = (x < 0) ? -x : 0;
+    cx1 = ctx->stamp_w;
+    if (x + cx1 > CANVAS_WIDTH) cx1 = CANVAS_WIDTH - x;
+    if (py0 >= py1 || cx0 >= cx1) return;
+
+    drawing_invalidate_strokes(ctx, ctx->active_layer);
+    layer = ctx->layers[ctx->active_layer].pixels;
+    for (py = py0; py < py1; py++) {
+        const uint8_t *src = &ctx->stamp_buffer[py * CANVAS_WIDTH];
+        uint8_t *dst = &layer[(y + py) * CANVAS_WIDTH + x];
+
+        run = &ctx->stamp_runs[ctx->stamp_row_start[py]];
+        run_end = &ctx->stamp_runs[ctx->stamp_row_start[py + 1]];
+        for (; run < run_end; run++) {
+            rx0 = run->x;
+            rx1 = run->x + run->len;
+            if (rx0 < cx0) rx0 = cx0;
+            if (rx1 > cx1) rx1 = cx1;
+            if (rx0 < rx1) memcpy(dst + rx0, src + rx0, rx1 - rx0);
         }
     }
 }
 
+// Timbro lungo il trascinamento: centrato sul tocco, un'impronta ogni
+// quarto di stamp tra un campione touch e il successivo
+void drawing_stamp_stroke(DrawingContext *ctx, int x, int y) {
+    int spacing, steps, i;
+    float dx, dy, dist;
+
+    if (!ctx->has_stamp) return;
+
+    if (!ctx->is_drawing) {
+        ctx->is_drawing = 1;
+        ctx->last_x = x;
+        ctx->last_y = y;
+        drawing_paste_selection(ctx, x - ctx->stamp_w / 2, y - ctx->stamp_h / 2);
+        return;
+    }
+
+    spacing = (ctx->stamp_w > ctx->stamp_h ? ctx->stamp_w : ctx->stamp_h) / 4;
+    if (spacing < 1) spacing = 1;
+
+    dx = (float)(x - ctx->last_x);
+    dy = (float)(y - ctx->last_y);
+    dist = sqrtf(dx * dx + dy * dy);
+    steps = (int)(dist / (float)spacing);
+    if (steps <= 0) return;
+
+    for (i = 1; i <= steps; i++) {
+        int sx = ctx->last_x + (int)(dx * (float)(i * spacing) / dist);
+        int sy = ctx->last_y + (int)(dy * (float)(i * spacing) / dist);
+        drawing_paste_selection(ctx, sx - ctx->stamp_w / 2, sy - ctx->stamp_h / 2);
+    }
+    ctx->last_x += (int)(dx * (float)(steps * spacing) / dist);
+    ctx->last_y += (int)(dy * (float)(steps * spacing) / dist);
+}
+
 void drawing_clear_selection(DrawingContext *ctx) {
     ctx->has_selection = 0;
+    ctx->lasso_count = 0;
 }
 
 void drawing_flip_horizontal(DrawingContext *ctx) {
     int x, y, idx1, idx2;
     uint8_t temp;
     LayerData *layer = &ctx->layers[ctx->active_layer];
+    if (ctx->has_selection) {
+        drawing_transform_selection(ctx, 1, 0, 0);
+        return;
+    }
+    drawing_invalidate_strokes(ctx, ctx->active_layer);
     for (y = 0; y < CANVAS_HEIGHT; y++) {
         for (x = 0; x < CANVAS_WIDTH / 2; x++) {
             idx1 = y * CANVAS_WIDTH + x;
@@ -379,6 +726,11 @@ void drawing_flip_vertical(DrawingContext *ctx) {
     int x, y, idx1, idx2;
     uint8_t temp;
     LayerData *layer = &ctx->layers[ctx->active_layer];
+    if (ctx->has_selection) {
+        drawing_transform_selection(ctx, 0, 1, 0);
+        return;
+    }
+    drawing_invalidate_strokes(ctx, ctx->active_layer);
     for (y = 0; y < CANVAS_HEIGHT / 2; y++) {
         for (x = 0; x < CANVAS_WIDTH; x++) {
             idx1 = y * CANVAS_WIDTH + x;
@@ -394,6 +746,11 @@ void drawing_rotate_90(DrawingContext *ctx) {
     int x, y, new_x, new_y;
     LayerData temp;
     LayerData *layer = &ctx->layers[ctx->active_layer];
+    if (ctx->has_selection) {
+        drawing_transform_selection(ctx, 0, 0, 1);
+        return;
+    }
+    drawing_invalidate_strokes(ctx, ctx->active_layer);
     memcpy(&temp, layer, sizeof(LayerData));
     memset(layer, 0, sizeof(LayerData));
 
@@ -411,12 +768,107 @@ void drawing_rotate_90(DrawingContext *ctx) {
 void drawing_invert_colors(DrawingContext *ctx) {
     int i;
     LayerData *layer = &ctx->layers[ctx->active_layer];
+    drawing_invalidate_strokes(ctx, ctx->active_layer);
+    if (ctx->has_selection) {
+        drawing_mask_spans(ctx, span_invert, NULL);
+        return;
+    }
     for (i = 0; i < CANVAS_WIDTH * CANVAS_HEIGHT; i++) {
         if (layer->pixels[i] == 0) layer->pixels[i] = 1;
         else if (layer->pixels[i] == 1) layer->pixels[i] = 0;
     }
 }
 
+static int drawing_layer_is_blank(const LayerData *layer) {
+    uint32_t w;
+    int i;
+    for (i = 0; i < CANVAS_WIDTH * CANVAS_HEIGHT; i += 4) {
+        memcpy(&w, &layer->pixels[i], 4);
+        if (w) return 0;
+    }
+    return 1;
+}
+
+// Chiamato quando i layer vengono sostituiti da pixel senza log
+void drawing_reset_strokes(DrawingContext *ctx) {
+    int i;
+    for (i = 0; i < MAX_LAYERS; i++) {
+        if (drawing_layer_is_blank(&ctx->layers[i])) strokes_clear(&ctx->strokes[i]);
+        else strokes_invalidate(&ctx->strokes[i]);
+    }
+}
+
+// Ridisegna il layer da zero rieseguendo il log: stesse primitive, stessi
+// parametri, quindi stessi pixel
+int drawing_replay_strokes(DrawingContext *ctx, int layer) {
+    StrokeLog *log;
+    const Stroke *st;
+    const StrokePoint *pt;
+    ToolType saved_tool;
+    uint8_t saved_color;
+    int saved_brush, saved_layer, saved_drawing, saved_lx, saved_ly;
+    int i, j;
+
+    if (layer < 0 || layer >= MAX_LAYERS) return 0;
+    log = &ctx->strokes[layer];
+    if (!log->valid) return 0;
+
+    saved_tool = ctx->current_tool;
+    saved_color = ctx->current_color;
+    saved_brush = ctx->brush_size;
+    saved_layer = ctx->active_layer;
+    saved_drawing = ctx->is_drawing;
+    saved_lx = ctx->last_x;
+    saved_ly = ctx->last_y;
+
+    ctx->stroke_replay = 1;
+    ctx->active_layer = layer;
+    memset(&ctx->layers[layer], 0, sizeof(LayerData));
+
+    for (i = 0; i < log->count; i++) {
+        st = &log->strokes[i];
+        pt = &log->points[st->point_start];
+        ctx->current_tool = (ToolType)st->tool;
+        ctx->current_color = st->color;
+        ctx->brush_size = st->brush_size;
+
+        switch (st->kind) {
+            case STROKE_PEN:
+                ctx->is_drawing = 0;
+                for (j = 0; j < st->point_count; j++) {
+                    drawing_pen_stroke(ctx, pt[j].x, pt[j].y);
+                }
+                break;
+            case STROKE_LINE:
+                if (st->point_count >= 2)
+                    drawing_line(ctx, pt[0].x, pt[0].y, pt[1].x, pt[1].y);
+                break;
+            case STROKE_RECT:
+                if (st->point_count >= 2)
+                    drawing_rect(ctx, pt[0].x, pt[0].y, pt[1].x, pt[1].y, st->filled);
+                break;
+            case STROKE_CIRCLE:
+                if (st->point_count >= 2)
+                    drawing_circle(ctx, pt[0].x, pt[0].y, pt[1].x, st->filled);
+                break;
+            case STROKE_FILL:
+                if (st->point_count >= 1)
+                    drawing_bucket_fill(ctx, pt[0].x, pt[0].y);
+                break;
+        }
+    }
+
+    ctx->stroke_replay = 0;
+    ctx->current_tool = saved_tool;
+    ctx->current_color = saved_color;
+    ctx->brush_size = saved_brush;
+    ctx->active_layer = saved_layer;
+    ctx->is_drawing = saved_drawing;
+    ctx->last_x = saved_lx;
+    ctx->last_y = saved_ly;
+    return 1;
+}
+
 void drawing_save_undo(DrawingContext *ctx) {
     int i;
     CanvasState *state;
@@ -430,6 +882,9 @@ void drawing_save_undo(DrawingContext *ctx) {
     for (i = 0; i < MAX_LAYERS; i++) {
         memcpy(&state->layers[i], &ctx->layers[i], sizeof(LayerData));
         state->layer_visible[i] = ctx->layer_visible[i];
+        state->stroke_count[i] = ctx->strokes[i].count;
+        state->stroke_valid[i] = ctx->strokes[i].valid;
+        state->stroke_gen[i] = ctx->strokes[i].generation;
     }
     state->active_layer = ctx->active_layer;
 
@@ -448,6 +903,8 @@ void drawing_undo(DrawingContext *ctx) {
     for (i = 0; i < MAX_LAYERS; i++) {
         memcpy(&ctx->layers[i], &state->layers[i], sizeof(LayerData));
         ctx->layer_visible[i] = state->layer_visible[i];
+        strokes_restore(&ctx->strokes[i], state->stroke_count[i],
+                        state->stroke_valid[i], state->stroke_gen[i]);
     }
     ctx->active_layer = state->active_layer;
 }
@@ -463,6 +920,8 @@ void drawing_redo(DrawingContext *ctx) {
     for (i = 0; i < MAX_LAYERS; i++) {
         memcpy(&ctx->layers[i], &state->layers[i], sizeof(LayerData));
         ctx->layer_visible[i] = state->layer_visible[i];
+        strokes_restore(&ctx->strokes[i], state->stroke_count[i],
+                        state->stroke_valid[i], state->stroke_gen[i]);
     }
     ctx->active_layer = state->active_layer;
 }
@@ -2,6 +2,7 @@
 #define DRAWING_H
 
 #include <stdint.h>
+#include "strokes.h"
 
 #define CANVAS_WIDTH  512
 #define CANVAS_HEIGHT 384
@@ -28,10 +29,36 @@ typedef struct {
     uint8_t pixels[CANVAS_WIDTH * CANVAS_HEIGHT];
 } LayerData;
 
+#define SEL_ROW_WORDS (CANVAS_WIDTH / 32)
+#define SEL_WORDS     (SEL_ROW_WORDS * CANVAS_HEIGHT)
+#define MAX_LASSO_POINTS 512
+#define LASSO_MIN_DIST   2     // Campioni piu' vicini al precedente vengono scartati
+
+// Selezione 1 bit per pixel: bit (x & 31) della parola x >> 5 di ogni riga
+typedef struct {
+    uint32_t bits[SEL_WORDS];
+} SelectionMask;
+
+// Run opaco di una riga dello stamp (pixel != 0 consecutivi)
+typedef struct {
+    uint16_t x;
+    uint16_t len;
+} StampRun;
+
+typedef enum {
+    SEL_REPLACE,
+    SEL_UNION,
+    SEL_SUBTRACT,
+    SEL_INTERSECT
+} SelectionOp;
+
 typedef struct {
     LayerData layers[MAX_LAYERS];
     int layer_visible[MAX_LAYERS];
     int active_layer;
+    int stroke_count[MAX_LAYERS];
+    int stroke_valid[MAX_LAYERS];
+    uint32_t stroke_gen[MAX_LAYERS];
 } CanvasState;
 
 typedef struct {
@@ -58,16 +85,26 @@ typedef struct {
     int pan_x, pan_y;
 
     int has_selection;
-    int sel_x, sel_y, sel_w, sel_h;
+    int sel_x, sel_y, sel_w, sel_h;   // Bounding box della maschera
+    SelectionMask selection_mask;
+    int lasso_x[MAX_LASSO_POINTS];
+    int lasso_y[MAX_LASSO_POINTS];
+    int lasso_count;
     uint8_t selection_buffer[CANVAS_WIDTH * CANVAS_HEIGHT];
 
     int has_stamp;
     uint8_t stamp_buffer[CANVAS_WIDTH * CANVAS_HEIGHT];
     int stamp_w, stamp_h;
+    StampRun *stamp_runs;                     // Allocati da drawing_encode_stamp
+    int stamp_row_start[CANVAS_HEIGHT + 1];   // Primo run di ogni riga
 
     UndoHistory undo;
     LayerData layers[MAX_LAYERS];
 
+    StrokeLog strokes[MAX_LAYERS];
+    int record_strokes;
+    int stroke_replay;
+
     int stabilizer;
     int stab_points_x[8];
     int stab_points_y[8];
@@ -76,6 +113,7 @@ typedef struct {
 
 void drawing_init(DrawingContext *ctx);
 void drawing_reset(DrawingContext *ctx);
+void drawing_free(DrawingContext *ctx);
 
 void drawing_pen_stroke(DrawingContext *ctx, int x, int y);
 void drawing_eraser_stroke(DrawingContext *ctx, int x, int y);
@@ -100,13 +138,23 @@ void drawing_select_area(DrawingContext *ctx, int x, int y, int w, int h);
 void drawing_copy_selection(DrawingContext *ctx);
 void drawing_cut_selection(DrawingContext *ctx);
 void drawing_paste_selection(DrawingContext *ctx, int x, int y);
+void drawing_encode_stamp(DrawingContext *ctx);
+void drawing_stamp_stroke(DrawingContext *ctx, int x, int y);
 void drawing_clear_selection(DrawingContext *ctx);
+void drawing_select_mask(DrawingContext *ctx, const SelectionMask *mask, SelectionOp op);
+void drawing_select_lasso(DrawingContext *ctx, const int *xs, const int *ys, int n, SelectionOp op);
+void drawing_lasso_add_point(DrawingContext *ctx, int x, int y);
+void drawing_select_magic_wand(DrawingContext *ctx, int x, int y, SelectionOp op);
+void drawing_fill_selection(DrawingContext *ctx);
 
 void drawing_flip_horizontal(DrawingContext *ctx);
 void drawing_flip_vertical(DrawingContext *ctx);
 void drawing_rotate_90(DrawingContext *ctx);
 void drawing_invert_colors(DrawingContext *ctx);
 
+void drawing_reset_strokes(DrawingContext *ctx);
+int drawing_replay_strokes(DrawingContext *ctx, int layer);
+
 void drawing_save_undo(DrawingContext *ctx);
 void drawing_undo(DrawingContext *ctx);
 void drawing_redo(DrawingContext *ctx);
@@ -0,0 +1,231 @@
+#include "fileio.h"
+#include <psp2/io/fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool fileio_open_write(FileWriter *w, const char *filename) {
+    memset(w, 0, sizeof(FileWriter));
+    w->buffer = (uint8_t *)malloc(FILEIO_BLOCK_SIZE);
+    if (!w->buffer) {
+        w->fd = -1;
+        w->error = true;
+        return false;
+    }
+
+    w->fd = sceIoOpen(filename, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+    if (w->fd < 0) {
+        free(w->buffer);
+        w->buffer = NULL;
+        w->error = true;
+        return false;
+    }
+    return true;
+}
+
+// Come fileio_open_write, ma il file esistente viene esteso dalla fine
+bool fileio_open_append(FileWriter *w, const char *filename) {
+    SceOff end;
+
+    memset(w, 0, sizeof(FileWriter));
+    w->buffer = (uint8_t *)malloc(FILEIO_BLOCK_SIZE);
+    if (!w->buffer) {
+        w->fd = -1;
+        w->error = true;
+        return false;
+    }
+
+    w->fd = sceIoOpen(filename, SCE_O_WRONLY | SCE_O_CREAT, 0777);
+    end = w->fd >= 0 ? sceIoLseek(w->fd, 0, SCE_SEEK_END) : -1;
+    if (end < 0) {
+        if (w->fd >= 0) sceIoClose(w->fd);
+        free(w->buffer);
+        w->buffer = NULL;
+        w->fd = -1;
+        w->error = true;
+        return false;
+    }
+    w->offset = end;
+    return true;
+}
+
+bool fileio_flush(FileWriter *w) {
+    if (w->error) return false;
+    if (w->used == 0) return true;
+
+    if (sceIoWrite(w->fd, w->buffer, w->used) != (int)w->used) {
+        w->error = true;
+        return false;
+    }
+    w->offset += w->used;
+    w->used = 0;
+    return true;
+}
+
+bool fileio_write(FileWriter *w, const void *data, uint32_t size) {
+    const uint8_t *src = (const uint8_t *)data;
+    uint32_t n;
+
+    if (w->error) return false;
+
+    // Blocchi grandi (clip audio) vanno diretti al file
+    if (size >= FILEIO_BLOCK_SIZE) {
+        if (!fileio_flush(w)) return false;
+        if (sceIoWrite(w->fd, src, size) != (int)size) {
+            w->error = true;
+            return false;
+        }
+        w->offset += size;
+        return true;
+    }
+
+    while (size > 0) {
+        n = FILEIO_BLOCK_SIZE - w->used;
+        if (n > size) n = size;
+        memcpy(w->buffer + w->used, src, n);
+        w->used += n;
+        src += n;
+        size -= n;
+        if (w->used == FILEIO_BLOCK_SIZE && !fileio_flush(w)) return false;
+    }
+    return true;
+}
+
+bool fileio_put(FileWriter *w, uint8_t byte) {
+    if (w->used == FILEIO_BLOCK_SIZE && !fileio_flush(w)) return false;
+    if (w->error) return false;
+    w->buffer[w->used++] = byte;
+    return true;
+}
+
+SceOff fileio_tell_write(const FileWriter *w) {
+    return w->offset + w->used;
+}
+
+// Per riscrivere campi gia' emessi (es. tabella offset)
+bool fileio_seek_write(FileWriter *w, SceOff offset) {
+    if (!fileio_flush(w)) return false;
+    if (sceIoLseek(w->fd, offset, SCE_SEEK_SET) != offset) {
+        w->error = true;
+        return false;
+    }
+    w->offset = offset;
+    return true;
+}
+
+bool fileio_close_write(FileWriter *w) {
+    bool ok = fileio_flush(w);
+
+    if (w->fd >= 0 && sceIoClose(w->fd) < 0) ok = false;
+    free(w->buffer);
+    w->buffer = NULL;
+    w->fd = -1;
+    return ok && !w->error;
+}
+
+bool fileio_open_read(FileReader *r, const char *filename) {
+    memset(r, 0, sizeof(FileReader));
+    r->buffer = (uint8_t *)malloc(FILEIO_BLOCK_SIZE);
+    if (!r->buffer) {
+        r->fd = -1;
+        r->error = true;
+        return false;
+    }
+
+    r->fd = sceIoOpen(filename, SCE_O_RDONLY, 0);
+    if (r->fd < 0) {
+        free(r->buffer);
+        r->buffer = NULL;
+        r->error = true;
+        return false;
+    }
+    return true;
+}
+
+static bool fileio_fill(FileReader *r) {
+    int n;
+
+    r->offset += r->used;
+    r->pos = 0;
+    r->used = 0;
+
+    n = sceIoRead(r->fd, r->buffer, FILEIO_BLOCK_SIZE);
+    if (n <= 0) {
+        r->error = true;
+        return false;
+    }
+    r->used = (uint32_t)n;
+    return true;
+}
+
+bool fileio_read(FileReader *r, void *data, uint32_t size) {
+    uint8_t *dst = (uint8_t *)data;
+    uint32_t n;
+
+    if (r->error) return false;
+
+    while (size > 0) {
+        if (r->pos == r->used) {
+            // Letture grandi direttamente nella destinazione
+            if (size >= FILEIO_BLOCK_SIZE) {
+                r->offset += r->used;
+                r->pos = 0;
+                r->used = 0;
+                if (sceIoRead(r->fd, dst, size) != (int)size) {
+                    r->error = true;
+                    return false;
+                }
+                r->offset += size;
+                return true;
+            }
+            if (!fileio_fill(r)) return false;
+        }
+
+        n = r->used - r->pos;
+        if (n > size) n = size;
+        memcpy(dst, r->buffer + r->pos, n);
+        r->pos += n;
+        dst += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool fileio_get(FileReader *r, uint8_t *byte) {
+    if (r->pos == r->used && (r->error || !fileio_fill(r))) return false;
+    *byte = r->buffer[r->pos++];
+    return true;
+}
+
+SceOff fileio_tell_read(const FileReader *r) {
+    return r->offset + r->pos;
+}
+
+bool fileio_seek_read(FileReader *r, SceOff offset) {
+    if (r->error) return false;
+
+    // Dentro il blocco corrente basta spostare il cursore
+    if (offset >= r->offset && offset <= r->offset + r->used) {
+        r->pos = (uint32_t)(offset - r->offset);
+        return true;
+    }
+
+    if (sceIoLseek(r->fd, offset, SCE_SEEK_SET) != offset) {
+        r->error = true;
+        return false;
+    }
+    r->offset = offset;
+    r->pos = 0;
+    r->used = 0;
+    return true;
+}
+
+bool fileio_skip(FileReader *r, uint32_t size) {
+    return fileio_seek_read(r, fileio_tell_read(r) + size);
+}
+
+void fileio_close_read(FileReader *r) {
+    if (r->fd >= 0) sceIoClose(r->fd);
+    free(r->buffer);
+    r->buffer = NULL;
+    r->fd = -1;
+}
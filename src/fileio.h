@@ -0,0 +1,47 @@
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <psp2/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FILEIO_BLOCK_SIZE (64 * 1024)
+
+// Scrittura bufferizzata: i dati arrivano al file a blocchi da 64KB.
+// Il primo errore resta memorizzato e tutte le chiamate successive
+// falliscono, cosi' basta controllare il risultato di fileio_close_write.
+typedef struct {
+    SceUID fd;
+    uint8_t *buffer;
+    uint32_t used;
+    SceOff offset;          // Posizione nel file del primo byte del buffer
+    bool error;
+} FileWriter;
+
+typedef struct {
+    SceUID fd;
+    uint8_t *buffer;
+    uint32_t pos;           // Cursore di lettura nel buffer
+    uint32_t used;          // Byte validi nel buffer
+    SceOff offset;          // Posizione nel file del primo byte del buffer
+    bool error;
+} FileReader;
+
+bool fileio_open_write(FileWriter *w, const char *filename);
+bool fileio_open_append(FileWriter *w, const char *filename);
+bool fileio_write(FileWriter *w, const void *data, uint32_t size);
+bool fileio_put(FileWriter *w, uint8_t byte);
+bool fileio_flush(FileWriter *w);
+bool fileio_seek_write(FileWriter *w, SceOff offset);
+SceOff fileio_tell_write(const FileWriter *w);
+bool fileio_close_write(FileWriter *w);
+
+bool fileio_open_read(FileReader *r, const char *filename);
+bool fileio_read(FileReader *r, void *data, uint32_t size);
+bool fileio_get(FileReader *r, uint8_t *byte);
+bool fileio_seek_read(FileReader *r, SceOff offset);
+bool fileio_skip(FileReader *r, uint32_t size);
+SceOff fileio_tell_read(const FileReader *r);
+void fileio_close_read(FileReader *r);
+
+#endif
@@ -1,18 +1,51 @@
 #include "filemanager.h"
 #include "colors.h"
+#include "fileio.h"
+#include "apng.h"
+#include "atlas.h"
+#include "avi.h"
+#include "gif.h"
+#include "jpegfile.h"
+#include "pngfile.h"
+#include "soundtrack.h"
+#include "worker.h"
 #include <psp2/io/fcntl.h>
 #include <psp2/io/dirent.h>
 #include <psp2/io/stat.h>
 #include <psp2/rtc.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
-#define AUDIO_MARKER 0xADD100
+#define AUDIO_MARKER    0xADD100
+#define EXPOSURE_MARKER 0xE4905E
+
+// Thread dei salvataggi in background (vedi filemanager_save_async)
+static Worker save_worker;
+static bool save_worker_ready;
+static Worker load_worker;
+static bool load_worker_ready;
+
+// Thread di codifica/decodifica dei frame (save_snapshot, load_v2).
+// Li usa un salvataggio o caricamento alla volta: codec_pool_claim.
+static Worker codec_workers[SAVE_MAX_ENCODERS];
+static int codec_worker_count;
+static int codec_workers_in_use;
+
+#define TILE_DIR SAVE_DIR "tiles/"
 
 void filemanager_init(void) {
     sceIoMkdir(SAVE_DIR, 0777);
+    tilestore_init(TILE_DIR);
+    save_worker_ready = worker_start(&save_worker, "fnv_save", WORKER_PRIORITY_LOW);
+    load_worker_ready = worker_start(&load_worker, "fnv_load", WORKER_PRIORITY_LOW);
+
+    for (codec_worker_count = 0; codec_worker_count < SAVE_MAX_ENCODERS; codec_worker_count++) {
+        if (!worker_start(&codec_workers[codec_worker_count], "fnv_codec", WORKER_PRIORITY_LOW))
+            break;
+    }
 }
 
 void filemanager_generate_filename(char *buffer, int buffer_size) {
@@ -23,401 +56,3243 @@ void filemanager_generate_filename(char *buffer, int buffer_size) {
              time.hour, time.minute, time.second);
 }
 
-bool filemanager_save(AnimationContext *anim, AudioContext *audio, const char *filename) {
-    SceUID fd;
-    FNVHeader header;
-    int f, l, i, total;
-    uint8_t c, val;
-    uint8_t end_marker[2];
-    uint32_t audio_marker;
-    uint8_t trigger;
-    int32_t sample_count;
-    int count;
+#define FRAME_MAX_PAYLOAD (sizeof(FNVFrameInfo) + MAX_LAYERS * sizeof(uint32_t) + CODEC_MAX_SIZE)
 
-    fd = sceIoOpen(filename, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
-    if (fd < 0) return false;
+// Codec usato per i nuovi salvataggi; il caricamento li accetta tutti
+static FrameCodec save_codec = CODEC_DEFLATE2;
+static int save_level = CODEC_DEFAULT_LEVEL;
+static int save_key_interval = FNV_KEY_INTERVAL;
+static bool save_tiles = false;
+static int png_level = PNG_DEFAULT_LEVEL;
 
-    memset(&header, 0, sizeof(header));
-    memcpy(header.magic, "FNVT", 4);
-    header.version = 1;
-    strncpy(header.title, anim->title, 63);
-    strncpy(header.author, anim->author, 63);
-    header.frame_count = anim->frame_count;
-    header.playback_speed = anim->playback_speed;
-    header.loop = anim->loop;
-    header.canvas_width = CANVAS_WIDTH;
-    header.canvas_height = CANVAS_HEIGHT;
-    header.layers_per_frame = MAX_LAYERS;
+void filemanager_set_codec(FrameCodec codec, int level) {
+    if (codec >= 0 && codec < CODEC_COUNT) save_codec = codec;
+    if (level >= 1 && level <= 9) save_level = level;
+}
 
-    sceIoWrite(fd, &header, sizeof(header));
+void filemanager_set_key_interval(int interval) {
+    save_key_interval = interval > 0 ? interval : 0;
+}
 
-    for (f = 0; f < anim->frame_count; f++) {
-        sceIoWrite(fd, &anim->frames[f].frame_speed, sizeof(float));
-        sceIoWrite(fd, &anim->frames[f].is_keyframe, sizeof(int));
+void filemanager_set_tile_store(bool enabled) {
+    save_tiles = enabled;
+}
 
-        for (l = 0; l < MAX_LAYERS; l++) {
-            uint8_t *pixels = anim->frames[f].layers[l].pixels;
-            total = CANVAS_WIDTH * CANVAS_HEIGHT;
-
-            i = 0;
-            while (i < total) {
-                val = pixels[i];
-                count = 1;
-                while (i + count < total && pixels[i + count] == val && count < 255) {
-                    count++;
-                }
-                c = (uint8_t)count;
-                sceIoWrite(fd, &c, 1);
-                sceIoWrite(fd, &val, 1);
-                i += count;
-            }
+bool filemanager_get_tile_store(void) {
+    return save_tiles;
+}
+
+void filemanager_set_png_level(int level) {
+    if (level >= 0 && level <= 9) png_level = level;
+}
+
+static void index_update(const char *filename, bool removed);
+static void journal_checkpoint_done(bool ok);
+typedef struct JournalGroup JournalGroup;
+static bool journal_write_frames(JournalGroup *group, AnimationSnapshot *snap);
+static bool journal_append_done(JournalGroup *group, bool ok);
+
+static bool write_chunk_header(FileWriter *w, const char *type, uint32_t size) {
+    FNVChunk chunk;
+    memcpy(chunk.type, type, 4);
+    chunk.size = size;
+    return fileio_write(w, &chunk, sizeof(chunk));
+}
+
+static void xor_layers(LayerData *dst, const LayerData *a, const LayerData *b) {
+    const uint8_t *pa = a->pixels, *pb = b->pixels;
+    uint8_t *pd = dst->pixels;
+    int i;
+
+    for (i = 0; i < MAX_LAYERS * LAYER_PIXELS; i++) pd[i] = pa[i] ^ pb[i];
+}
+
+static void fill_frame_info(FNVFrameInfo *info, const Frame *frame) {
+    memset(info, 0, sizeof(FNVFrameInfo));
+    info->frame_speed = frame->frame_speed;
+    info->is_keyframe = frame->is_keyframe ? 1 : 0;
+    info->exposure = (uint8_t)(frame->exposure < 1 ? 1 : frame->exposure);
+}
+
+// prev != NULL: codifica lo XOR con il frame precedente (scratch in delta)
+// refs != NULL: layer gia' scritti altrove (vedi FNV_FRAME_REFS)
+static uint32_t encode_frame(CodecContext *codec, const Frame *frame, const Frame *prev,
+                             const uint32_t *refs, uint8_t *out, LayerData *delta)
+{
+    FNVFrameInfo info;
+    const LayerData *layers;
+    uint32_t n, head;
+    int l, stored;
+
+    fill_frame_info(&info, frame);
 
-            end_marker[0] = 0;
-            end_marker[1] = 0xFF;
-            sceIoWrite(fd, end_marker, 2);
+    head = sizeof(info);
+    stored = MAX_LAYERS;
+    for (l = 0; refs && l < MAX_LAYERS; l++) {
+        if (refs[l]) stored--;
+    }
+    if (stored < MAX_LAYERS) {
+        info.flags |= FNV_FRAME_REFS;
+        memcpy(out + head, refs, MAX_LAYERS * sizeof(uint32_t));
+        head += MAX_LAYERS * sizeof(uint32_t);
+    }
+    if (stored == 0) {
+        memcpy(out, &info, sizeof(info));
+        return head;
+    }
+
+    layers = frame->layers;
+    if (prev) {
+        xor_layers(delta, frame->layers, prev->layers);
+        layers = delta;
+        info.flags |= FNV_FRAME_DELTA;
+    }
+    if (stored < MAX_LAYERS) {
+        if (layers != delta) memcpy(delta, frame->layers, sizeof(LayerData) * MAX_LAYERS);
+        for (l = 0; l < MAX_LAYERS; l++) {
+            if (refs[l]) memset(&delta[l], 0, sizeof(LayerData));
         }
+        layers = delta;
     }
 
-    audio_marker = AUDIO_MARKER;
-    sceIoWrite(fd, &audio_marker, sizeof(uint32_t));
+    n = codec_encode(codec, layers, out + head, &info.codec);
+    memcpy(out, &info, sizeof(info));
+    return n ? n + head : 0;
+}
 
-    for (f = 0; f < anim->frame_count && f < 999; f++) {
-        for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
-            trigger = audio->se_triggers[f][i] ? 1 : 0;
-            sceIoWrite(fd, &trigger, 1);
-        }
+// prev: layer del frame precedente gia' ricostruito, richiesto dai delta.
+// refs: riferimenti del frame (i layer riferiti restano a zero).
+// tiles: per i frame FNV_FRAME_TILES (NULL = non accettati); prev deve
+// essere l'ultimo frame letto con lo stesso reader
+static bool decode_frame(CodecContext *codec, TileReader *tiles, const uint8_t *in, uint32_t size,
+                         Frame *frame, const LayerData *prev, uint32_t *refs)
+{
+    FNVFrameInfo info;
+    uint32_t head;
+    int l, stored;
+
+    memset(refs, 0, MAX_LAYERS * sizeof(uint32_t));
+    if (size < sizeof(info)) return false;
+    memcpy(&info, in, sizeof(info));
+    frame->frame_speed = info.frame_speed;
+    frame->is_keyframe = info.is_keyframe != 0;
+    frame->exposure = info.exposure ? info.exposure : 1;
+    if (frame->exposure > MAX_EXPOSURE) frame->exposure = MAX_EXPOSURE;
+    frame->hash_valid = 0;
+
+    head = sizeof(info);
+    if (info.flags & FNV_FRAME_TILES) {
+        return tiles && !(info.flags & FNV_FRAME_REFS) &&
+               tile_reader_frame(tiles, in + head, size - head, frame->layers, prev,
+                                 (info.flags & FNV_FRAME_DELTA) != 0);
     }
+    if (tiles) tiles->last_valid = false;
 
-    for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
-        sample_count = audio->sound_effects[i].sample_count;
-        sceIoWrite(fd, &sample_count, sizeof(int32_t));
-        if (sample_count > 0 && audio->sound_effects[i].data) {
-            sceIoWrite(fd, audio->sound_effects[i].data, sample_count * sizeof(int16_t));
+    stored = MAX_LAYERS;
+    if (info.flags & FNV_FRAME_REFS) {
+        if (size < head + MAX_LAYERS * sizeof(uint32_t)) return false;
+        memcpy(refs, in + head, MAX_LAYERS * sizeof(uint32_t));
+        head += MAX_LAYERS * sizeof(uint32_t);
+        for (l = 0; l < MAX_LAYERS; l++) {
+            if (refs[l]) stored--;
         }
     }
+    if (stored == 0) {
+        memset(frame->layers, 0, sizeof(frame->layers));
+        return size == head;
+    }
 
-    sceIoClose(fd);
+    if (!codec_decode(codec, info.codec, in + head, size - head, frame->layers))
+        return false;
+
+    if (info.flags & FNV_FRAME_DELTA) {
+        if (!prev) return false;
+        xor_layers(frame->layers, frame->layers, prev);
+    }
+    for (l = 0; l < MAX_LAYERS; l++) {
+        if (refs[l]) memset(&frame->layers[l], 0, sizeof(LayerData));
+    }
     return true;
 }
 
-bool filemanager_load(AnimationContext *anim, AudioContext *audio,
-                      DrawingContext *draw, const char *filename)
-{
-    SceUID fd;
-    FNVHeader header;
-    int f, l, pos;
-    uint8_t count_byte, val;
-    uint32_t audio_marker;
-    uint8_t trigger;
+static bool save_audio_chunk(FileWriter *w, int frame_count, AudioContext *audio) {
+    uint32_t size, frames;
+    uint8_t triggers[MAX_SOUND_EFFECTS];
     int32_t sample_count;
-    int i;
+    int f, i;
 
-    fd = sceIoOpen(filename, SCE_O_RDONLY, 0);
-    if (fd < 0) return false;
+    frames = frame_count < 999 ? frame_count : 999;
+    size = sizeof(uint32_t) + frames * MAX_SOUND_EFFECTS;
+    for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
+        size += sizeof(int32_t);
+        if (audio->sound_effects[i].sample_count > 0 && audio->sound_effects[i].data)
+            size += audio->sound_effects[i].sample_count * sizeof(int16_t);
+    }
 
-    sceIoRead(fd, &header, sizeof(header));
+    if (!write_chunk_header(w, "AUDI", size)) return false;
+    if (!fileio_write(w, &frames, sizeof(frames))) return false;
 
-    if (memcmp(header.magic, "FNVT", 4) != 0) {
-        sceIoClose(fd);
-        return false;
+    for (f = 0; f < (int)frames; f++) {
+        for (i = 0; i < MAX_SOUND_EFFECTS; i++)
+            triggers[i] = audio->se_triggers[f][i] ? 1 : 0;
+        if (!fileio_write(w, triggers, MAX_SOUND_EFFECTS)) return false;
+    }
+
+    for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
+        sample_count = audio->sound_effects[i].data ? audio->sound_effects[i].sample_count : 0;
+        if (sample_count < 0) sample_count = 0;
+        if (!fileio_write(w, &sample_count, sizeof(int32_t))) return false;
+        if (sample_count > 0 &&
+            !fileio_write(w, audio->sound_effects[i].data, sample_count * sizeof(int16_t)))
+            return false;
     }
+    return true;
+}
 
-    animation_free(anim);
-    animation_init(anim);
+static bool load_audio_chunk(FileReader *r, AudioContext *audio, int frame_count) {
+    uint32_t frames;
+    uint8_t triggers[MAX_SOUND_EFFECTS];
+    int32_t sample_count;
+    int f, i;
 
-    strncpy(anim->title, header.title, 63);
-    strncpy(anim->author, header.author, 63);
-    anim->playback_speed = header.playback_speed;
-    anim->loop = header.loop;
+    if (!fileio_read(r, &frames, sizeof(frames))) return false;
 
-    anim->frame_count = 0;
-    for (f = 0; f < (int)header.frame_count; f++) {
-        if (f > 0) animation_add_frame(anim);
-        else anim->frame_count = 1;
+    for (f = 0; f < (int)frames; f++) {
+        if (!fileio_read(r, triggers, MAX_SOUND_EFFECTS)) return false;
+        if (f >= frame_count || f >= 999) continue;
+        for (i = 0; i < MAX_SOUND_EFFECTS; i++)
+            audio->se_triggers[f][i] = triggers[i];
+    }
+
+    for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
+        if (!fileio_read(r, &sample_count, sizeof(int32_t))) return false;
+        if (sample_count <= 0) continue;
+        if (sample_count >= MAX_RECORDING_SAMPLES) return false;
+
+        if (audio->sound_effects[i].data) free(audio->sound_effects[i].data);
+        audio->sound_effects[i].data = (int16_t *)malloc(sample_count * sizeof(int16_t));
+        audio->sound_effects[i].sample_count = 0;
+        if (!audio->sound_effects[i].data) return false;
+        if (!fileio_read(r, audio->sound_effects[i].data, sample_count * sizeof(int16_t)))
+            return false;
+        audio->sound_effects[i].sample_count = sample_count;
+        audio->sound_effects[i].sample_rate = AUDIO_SAMPLE_RATE;
+    }
+    return true;
+}
 
-        sceIoRead(fd, &anim->frames[f].frame_speed, sizeof(float));
-        sceIoRead(fd, &anim->frames[f].is_keyframe, sizeof(int));
+static void fill_header(FNVHeader *header, const AnimationSnapshot *snap) {
+    memset(header, 0, sizeof(FNVHeader));
+    memcpy(header->magic, "FNVT", 4);
+    header->version = FNV_VERSION;
+    strncpy(header->title, snap->title, 63);
+    strncpy(header->author, snap->author, 63);
+    header->frame_count = snap->frame_count;
+    header->playback_speed = snap->playback_speed;
+    header->loop = snap->loop;
+    header->canvas_width = CANVAS_WIDTH;
+    header->canvas_height = CANVAS_HEIGHT;
+    header->layers_per_frame = MAX_LAYERS;
+}
 
-        for (l = 0; l < MAX_LAYERS; l++) {
-            uint8_t *pixels = anim->frames[f].layers[l].pixels;
-            pos = 0;
+/* ========== ANTEPRIMA ========== */
+// Costruita durante la codifica: ogni lotto riduce i frame campionati
+// che gli capitano e annota la durata di tutti i suoi frame.
+#define PREVIEW_MIN_INK 4       // Pixel pieni perche' un blocco non sia sfondo
+
+typedef struct {
+    int frame_count;            // Frame dell'animazione
+    int count;                  // Frame dell'anteprima
+    float playback_speed;
+    float *frame_time;          // Secondi a schermo di ogni frame
+    uint8_t *pixels;            // count * PREVIEW_FRAME_SIZE
+} PreviewBuilder;
+
+static bool preview_init(PreviewBuilder *p, const AnimationSnapshot *snap) {
+    memset(p, 0, sizeof(PreviewBuilder));
+    p->frame_count = snap->frame_count;
+    p->count = snap->frame_count < PREVIEW_MAX_FRAMES ? snap->frame_count : PREVIEW_MAX_FRAMES;
+    p->playback_speed = snap->playback_speed >= MIN_SPEED ? snap->playback_speed : DEFAULT_SPEED;
+    p->frame_time = (float *)calloc(snap->frame_count, sizeof(float));
+    p->pixels = (uint8_t *)calloc(p->count, PREVIEW_FRAME_SIZE);
+    return p->count > 0 && p->frame_time && p->pixels;
+}
 
-            while (pos < CANVAS_WIDTH * CANVAS_HEIGHT) {
-                if (sceIoRead(fd, &count_byte, 1) <= 0) break;
-                if (sceIoRead(fd, &val, 1) <= 0) break;
+static void preview_free(PreviewBuilder *p) {
+    free(p->frame_time);
+    free(p->pixels);
+}
 
-                if (count_byte == 0 && val == 0xFF) break;
+// Il frame campionato s e' s * frame_count / count: -1 se f non lo e'
+static int preview_slot(const PreviewBuilder *p, int f) {
+    int s = (f * p->count + p->frame_count - 1) / p->frame_count;
+    if (s < p->count && s * p->frame_count / p->count == f) return s;
+    return -1;
+}
 
-                for (i = 0; i < count_byte && pos < CANVAS_WIDTH * CANVAS_HEIGHT; i++) {
-                    pixels[pos++] = val;
+// In ogni blocco vince il layer piu' in alto con abbastanza inchiostro,
+// col suo colore piu' frequente
+static void preview_reduce(const Frame *frame, uint8_t *out) {
+    int counts[MAX_LAYERS][LAYER_COLORS_COUNT];
+    const uint8_t *row;
+    int bx, by, x, y, l, c, best, total;
+    uint8_t v;
+
+    for (by = 0; by < PREVIEW_HEIGHT; by++) {
+        for (bx = 0; bx < PREVIEW_WIDTH; bx++) {
+            memset(counts, 0, sizeof(counts));
+            for (l = 0; l < MAX_LAYERS; l++) {
+                for (y = 0; y < PREVIEW_SCALE; y++) {
+                    row = frame->layers[l].pixels +
+                          (by * PREVIEW_SCALE + y) * CANVAS_WIDTH + bx * PREVIEW_SCALE;
+                    for (x = 0; x < PREVIEW_SCALE; x++) {
+                        if (row[x] < LAYER_COLORS_COUNT) counts[l][row[x]]++;
+                    }
                 }
             }
+
+            v = 0;
+            for (l = 0; l < MAX_LAYERS && v == 0; l++) {
+                best = 1;
+                total = 0;
+                for (c = 1; c < LAYER_COLORS_COUNT; c++) {
+                    total += counts[l][c];
+                    if (counts[l][c] > counts[l][best]) best = c;
+                }
+                if (total >= PREVIEW_MIN_INK) v = (uint8_t)(1 + l * (LAYER_COLORS_COUNT - 1) + best - 1);
+            }
+
+            if (bx & 1) out[(by * PREVIEW_WIDTH + bx) / 2] |= (uint8_t)(v << 4);
+            else out[(by * PREVIEW_WIDTH + bx) / 2] = v;
         }
     }
+}
 
-    if (sceIoRead(fd, &audio_marker, sizeof(uint32_t)) == sizeof(uint32_t)) {
-        if (audio_marker == AUDIO_MARKER) {
-            for (f = 0; f < (int)header.frame_count && f < 999; f++) {
-                for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
-                    sceIoRead(fd, &trigger, 1);
-                    audio->se_triggers[f][i] = trigger;
-                }
+// Chiamata dai lotti su frame diversi: scrive solo la propria parte
+static void preview_add(PreviewBuilder *p, int f, const Frame *frame) {
+    float speed;
+    int s;
+
+    speed = frame->frame_speed > 0 ? frame->frame_speed : p->playback_speed;
+    p->frame_time[f] = (frame->exposure < 1 ? 1 : frame->exposure) / speed;
+
+    s = preview_slot(p, f);
+    if (s >= 0) preview_reduce(frame, p->pixels + s * PREVIEW_FRAME_SIZE);
+}
+
+static uint32_t preview_chunk_size(const PreviewBuilder *p) {
+    return sizeof(FNVPreviewHeader) + p->count * PREVIEW_FRAME_SIZE;
+}
+
+// Dopo la codifica: la durata totale divisa tra i frame dell'anteprima
+static bool preview_write(FileWriter *w, const PreviewBuilder *p) {
+    FNVPreviewHeader header;
+    float total = 0;
+    int f, ms;
+
+    for (f = 0; f < p->frame_count; f++) total += p->frame_time[f];
+    ms = (int)(total * 1000.0f / p->count + 0.5f);
+    if (ms < 1) ms = 1;
+    if (ms > 0xFFFF) ms = 0xFFFF;
+
+    header.width = PREVIEW_WIDTH;
+    header.height = PREVIEW_HEIGHT;
+    header.frame_count = (uint16_t)p->count;
+    header.interval_ms = (uint16_t)ms;
+    return fileio_write(w, &header, sizeof(header)) &&
+           fileio_write(w, p->pixels, p->count * PREVIEW_FRAME_SIZE);
+}
+
+bool filemanager_read_preview(const char *filename, FNVPreview *preview) {
+    FileReader r;
+    FNVHeader header;
+    FNVChunk chunk;
+    uint32_t size;
+    bool ok = false;
+
+    memset(preview, 0, sizeof(FNVPreview));
+    if (!fileio_open_read(&r, filename)) return false;
+
+    // L'anteprima segue sempre la tabella dei frame
+    if (fileio_read(&r, &header, sizeof(header)) &&
+        memcmp(header.magic, "FNVT", 4) == 0 &&
+        header.version >= 2 && header.version <= FNV_VERSION &&
+        fileio_read(&r, &chunk, sizeof(chunk)) &&
+        memcmp(chunk.type, "FIDX", 4) == 0 &&
+        fileio_skip(&r, chunk.size) &&
+        fileio_read(&r, &chunk, sizeof(chunk)) &&
+        memcmp(chunk.type, "PREV", 4) == 0 &&
+        chunk.size >= sizeof(FNVPreviewHeader) &&
+        fileio_read(&r, &preview->header, sizeof(FNVPreviewHeader)) &&
+        preview->header.width == PREVIEW_WIDTH &&
+        preview->header.height == PREVIEW_HEIGHT &&
+        preview->header.frame_count > 0 &&
+        preview->header.frame_count <= PREVIEW_MAX_FRAMES) {
+        size = preview->header.frame_count * PREVIEW_FRAME_SIZE;
+        if (chunk.size == sizeof(FNVPreviewHeader) + size) {
+            preview->pixels = (uint8_t *)malloc(size);
+            ok = preview->pixels && fileio_read(&r, preview->pixels, size);
+        }
+    }
+
+    fileio_close_read(&r);
+    if (!ok) filemanager_free_preview(preview);
+    return ok;
+}
+
+void filemanager_free_preview(FNVPreview *preview) {
+    free(preview->pixels);
+    memset(preview, 0, sizeof(FNVPreview));
+}
+
+uint8_t filemanager_preview_pixel(const FNVPreview *preview, int frame, int x, int y, int *layer) {
+    uint8_t v;
+
+    v = preview->pixels[frame * PREVIEW_FRAME_SIZE + (y * PREVIEW_WIDTH + x) / 2];
+    v = (x & 1) ? (v >> 4) : (v & 0x0F);
+    if (v == 0) return 0;
+    *layer = (v - 1) / (LAYER_COLORS_COUNT - 1);
+    return (uint8_t)((v - 1) % (LAYER_COLORS_COUNT - 1) + 1);
+}
+
+/* ========== LAYER RIPETUTI ========== */
+// Prima della codifica si cerca per ogni layer il primo layer uguale
+// (stesso hash e stessi pixel): i ripetuti diventano riferimenti.
+static uint32_t *plan_layer_refs(AnimationSnapshot *snap) {
+    uint64_t *hashes;
+    uint32_t *refs;
+    int32_t *table;
+    int n, size, i, slot;
+    bool ok = true;
+
+    n = snap->frame_count * MAX_LAYERS;
+    for (size = 16; size < n * 2; size <<= 1);
+
+    hashes = (uint64_t *)malloc(n * sizeof(uint64_t));
+    refs = (uint32_t *)calloc(n, sizeof(uint32_t));
+    table = (int32_t *)malloc(size * sizeof(int32_t));
+    if (!hashes || !refs || !table) ok = false;
+
+    for (i = 0; ok && i < snap->frame_count; i++)
+        ok = animation_snapshot_layer_hashes(snap, i, hashes + i * MAX_LAYERS);
+
+    if (ok) {
+        memset(table, 0xFF, size * sizeof(int32_t));
+        for (i = 0; i < n; i++) {
+            slot = (int)(hashes[i] & (uint64_t)(size - 1));
+            while (table[slot] >= 0 && hashes[table[slot]] != hashes[i])
+                slot = (slot + 1) & (size - 1);
+            if (table[slot] < 0) {
+                table[slot] = i;
+                continue;
             }
+            // Stesso hash e poi confronto dei pixel: in caso di collisione
+            // il layer resta nel payload
+            if (animation_snapshot_layers_equal(snap, table[slot] / MAX_LAYERS,
+                                                table[slot] % MAX_LAYERS,
+                                                i / MAX_LAYERS, i % MAX_LAYERS))
+                refs[i] = (uint32_t)table[slot] + 1;
+        }
+    }
 
-            for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
-                sceIoRead(fd, &sample_count, sizeof(int32_t));
-                if (sample_count > 0 && sample_count < MAX_RECORDING_SAMPLES) {
-                    if (audio->sound_effects[i].data) {
-                        free(audio->sound_effects[i].data);
-                    }
-                    audio->sound_effects[i].data =
-                        (int16_t *)malloc(sample_count * sizeof(int16_t));
-                    sceIoRead(fd, audio->sound_effects[i].data,
-                              sample_count * sizeof(int16_t));
-                    audio->sound_effects[i].sample_count = sample_count;
-                    audio->sound_effects[i].sample_rate = AUDIO_SAMPLE_RATE;
-                }
+    free(hashes);
+    free(table);
+    if (!ok) {
+        free(refs);
+        return NULL;
+    }
+    return refs;
+}
+
+// Dopo la decodifica: i layer riferiti si copiano dalla sorgente
+static bool resolve_layer_refs(AnimationContext *anim, const uint32_t *refs) {
+    uint32_t src;
+    int i, n;
+
+    n = anim->frame_count * MAX_LAYERS;
+    for (i = 0; i < n; i++) {
+        if (!refs[i]) continue;
+        src = refs[i] - 1;
+        if (src >= (uint32_t)i || refs[src]) return false;
+        memcpy(&anim->frames[i / MAX_LAYERS].layers[i % MAX_LAYERS],
+               &anim->frames[src / MAX_LAYERS].layers[src % MAX_LAYERS], sizeof(LayerData));
+    }
+    return true;
+}
+
+/* ========== ARCHIVIO DEI TILE ========== */
+// Tile usati da un file; i file senza archivio ne usano zero. Basta il
+// primo FRAM per saperlo: un file e' salvato tutto in un modo o nell'altro.
+static bool file_tiles(const char *filename, TileSet *set) {
+    FileReader r;
+    FNVHeader header;
+    FNVChunk chunk;
+    FNVFrameInfo info;
+    TileCoder coder;
+    uint8_t *payload;
+    uint64_t *table, *last;
+    SceOff start;
+    int k;
+    bool ok;
+
+    if (!fileio_open_read(&r, filename)) return false;
+    payload = (uint8_t *)malloc(TILE_TABLE_MAX);
+    table = (uint64_t *)malloc(TILE_TABLE_SIZE);
+    last = (uint64_t *)calloc(TILES_PER_FRAME, sizeof(uint64_t));
+    tile_coder_init(&coder);
+
+    ok = payload && table && last && fileio_read(&r, &header, sizeof(header)) &&
+         memcmp(header.magic, "FNVT", 4) == 0;
+    while (ok && header.version >= 2 && fileio_read(&r, &chunk, sizeof(chunk))) {
+        if (memcmp(chunk.type, "END ", 4) == 0) break;
+        start = fileio_tell_read(&r);
+
+        if (memcmp(chunk.type, "FRAM", 4) == 0) {
+            if (chunk.size < sizeof(info) || chunk.size > sizeof(info) + TILE_TABLE_MAX ||
+                !fileio_read(&r, &info, sizeof(info)) || !(info.flags & FNV_FRAME_TILES))
+                break;
+            ok = fileio_read(&r, payload, chunk.size - sizeof(info)) &&
+                 tile_table_decompress(&coder, payload, chunk.size - sizeof(info), table);
+            for (k = 0; ok && k < TILES_PER_FRAME; k++) {
+                if (info.flags & FNV_FRAME_DELTA) table[k] ^= last[k];
+                last[k] = table[k];
+                ok = tileset_add(set, table[k], 1);
             }
         }
+        ok = ok && fileio_seek_read(&r, start + chunk.size);
     }
 
-    sceIoClose(fd);
+    tile_coder_free(&coder);
+    fileio_close_read(&r);
+    free(payload);
+    free(table);
+    free(last);
+    return ok;
+}
 
-    anim->current_frame = 0;
-    animation_load_current_from_draw(anim, draw);
+/* ========== CODIFICA PARALLELA ========== */
+// I frame vengono codificati a lotti che iniziano sempre con un frame
+// completo, quindi indipendenti tra loro: ogni thread codifica un lotto
+// nel proprio buffer e il thread di salvataggio li scrive in ordine.
+typedef struct {
+    AnimationSnapshot *snap;
+    PreviewBuilder *preview;    // NULL = senza anteprima
+    const uint32_t *refs;       // plan_layer_refs, NULL = tutto nel payload
+    int first;                  // Lotto: frame [first, first + count)
+    int count;
+    int key_interval;
+    CodecContext codec;
+    Frame *cur, *prev;
+    LayerData *delta;
+    uint8_t *out;               // Payload dei frame, uno dopo l'altro
+    uint32_t out_size;
+    uint32_t used;
+    uint32_t *sizes;            // Dimensione di ogni payload
+    // Con l'archivio di tile (FNV_FRAME_TILES) al posto del codec
+    bool tiled;
+    TileCoder tile_coder;
+    uint64_t *table;            // Tabella del frame, poi di quello precedente
+    uint64_t *prev_table;
+    uint8_t *pixels;
+    uint8_t *tiles;             // Tile nuovi: TileRecord + dati, uno dopo l'altro
+    uint32_t tiles_size;
+    uint32_t tiles_used;
+    TileSet used_tiles;         // Tile usati dai frame del lotto
+    uint8_t *strokes;           // Payload del chunk STRK del lotto
+    uint32_t strokes_size;
+    uint32_t strokes_used;
+    bool ok;
+} EncodeBatch;
+
+static int encode_threads = SAVE_DEFAULT_ENCODERS;
+
+// Quanti thread del pool si possono usare (0 = in uso o assente: in serie).
+// Fino a codec_pool_release il chiamante e' l'unico proprietario dei
+// worker (vedi worker.h): deve attenderli tutti prima di rilasciarli.
+// test_and_set/release ordinano anche i dati dei lavori tra i proprietari.
+static int codec_pool_claim(int wanted) {
+    if (codec_worker_count < 2) return 0;
+    if (__sync_lock_test_and_set(&codec_workers_in_use, 1)) return 0;
+    return wanted < codec_worker_count ? wanted : codec_worker_count;
+}
+
+static void codec_pool_release(void) {
+    __sync_lock_release(&codec_workers_in_use);
+}
+
+void filemanager_set_encode_threads(int count) {
+    if (count < 1) count = 1;
+    if (count > SAVE_MAX_ENCODERS) count = SAVE_MAX_ENCODERS;
+    encode_threads = count;
+}
+
+// Tile che l'archivio non ha ancora: compresso qui, scritto in ordine
+// dal thread di salvataggio
+static bool encode_batch_add_tile(EncodeBatch *b, uint64_t hash) {
+    TileRecord rec;
+    uint8_t *grown;
+    uint32_t need;
+
+    need = b->tiles_used + sizeof(rec) + TILE_MAX_DATA;
+    if (need > b->tiles_size) {
+        if (need < b->tiles_size * 2) need = b->tiles_size * 2;
+        grown = (uint8_t *)realloc(b->tiles, need);
+        if (!grown) return false;
+        b->tiles = grown;
+        b->tiles_size = need;
+    }
 
+    memset(&rec, 0, sizeof(rec));
+    memcpy(rec.magic, "TILE", 4);
+    rec.hash = hash;
+    rec.size = tile_compress(&b->tile_coder, b->pixels, b->tiles + b->tiles_used + sizeof(rec),
+                             &rec.format);
+    if (rec.size == 0) return false;
+    memcpy(b->tiles + b->tiles_used, &rec, sizeof(rec));
+    b->tiles_used += sizeof(rec) + rec.size;
     return true;
 }
 
-bool filemanager_delete(const char *filename) {
-    return sceIoRemove(filename) >= 0;
+// Log dei tratti del frame, serializzati finche' il frame e' bloccato:
+// dopo il rilascio la copia dello snapshot viene liberata
+static bool encode_batch_add_strokes(EncodeBatch *b, int f, const Frame *frame) {
+    FNVStrokeEntry entry;
+    uint8_t *grown;
+    uint32_t need;
+    int l;
+
+    for (l = 0; l < MAX_LAYERS; l++) {
+        if (!frame->strokes[l]) continue;
+
+        memset(&entry, 0, sizeof(entry));
+        entry.frame = (uint16_t)f;
+        entry.layer = (uint8_t)l;
+        entry.size = strokes_serialized_size(frame->strokes[l]);
+        need = b->strokes_used + sizeof(entry) + entry.size;
+        if (need > b->strokes_size) {
+            if (need < b->strokes_size * 2) need = b->strokes_size * 2;
+            grown = (uint8_t *)realloc(b->strokes, need);
+            if (!grown) return false;
+            b->strokes = grown;
+            b->strokes_size = need;
+        }
+        memcpy(b->strokes + b->strokes_used, &entry, sizeof(entry));
+        strokes_serialize(frame->strokes[l], b->strokes + b->strokes_used + sizeof(entry));
+        b->strokes_used += sizeof(entry) + entry.size;
+    }
+    return true;
 }
 
-int filemanager_list_saves(SaveSlotInfo *slots, int max_slots) {
-    SceUID dir;
-    int count = 0;
-    SceIoDirent entry;
-    int len;
-    SceUID fd;
-    FNVHeader header;
+// delta: tabella in XOR con quella del frame precedente, quasi tutta a zero
+static uint32_t encode_tiles(EncodeBatch *b, const Frame *frame, bool delta, uint8_t *out) {
+    FNVFrameInfo info;
+    uint64_t *swap;
+    uint64_t hash;
+    uint32_t n;
+    int k;
+
+    for (k = 0; k < TILES_PER_FRAME; k++) {
+        if (!tile_extract(&frame->layers[k / TILES_PER_LAYER], k % TILES_PER_LAYER, b->pixels)) {
+            b->table[k] = TILE_BLANK;
+            continue;
+        }
+        hash = tile_hash(b->pixels);
+        b->table[k] = hash;
 
-    dir = sceIoDopen(SAVE_DIR);
-    if (dir < 0) return 0;
+        // Ogni tile si controlla una volta per lotto
+        if (tileset_get(&b->used_tiles, hash)) continue;
+        if (!tileset_add(&b->used_tiles, hash, 1)) return 0;
+        if (!tilestore_contains(hash) && !encode_batch_add_tile(b, hash)) return 0;
+    }
 
-    memset(&entry, 0, sizeof(SceIoDirent));
+    fill_frame_info(&info, frame);
+    info.flags = FNV_FRAME_TILES;
+    if (delta) {
+        info.flags |= FNV_FRAME_DELTA;
+        for (k = 0; k < TILES_PER_FRAME; k++) b->prev_table[k] ^= b->table[k];
+    }
+    memcpy(out, &info, sizeof(info));
+    n = tile_table_compress(&b->tile_coder, delta ? b->prev_table : b->table, out + sizeof(info));
 
-    while (count < max_slots && sceIoDread(dir, &entry) > 0) {
-        len = (int)strlen(entry.d_name);
-        if (len > 4 && strcmp(&entry.d_name[len - 4], ".fnv") == 0) {
-            snprintf(slots[count].filename, 256, "%s%s", SAVE_DIR, entry.d_name);
-
-            fd = sceIoOpen(slots[count].filename, SCE_O_RDONLY, 0);
-            if (fd >= 0) {
-                sceIoRead(fd, &header, sizeof(header));
-                if (memcmp(header.magic, "FNVT", 4) == 0) {
-                    strncpy(slots[count].title, header.title, 63);
-                    slots[count].title[63] = '\0';
-                    strncpy(slots[count].author, header.author, 63);
-                    slots[count].author[63] = '\0';
-                    slots[count].frame_count = header.frame_count;
-                    slots[count].exists = 1;
-                }
-                sceIoClose(fd);
-            }
-            count++;
+    swap = b->prev_table;
+    b->prev_table = b->table;
+    b->table = swap;
+    return n ? n + sizeof(info) : 0;
+}
+
+// Ogni frame viene copiato sotto lock e codificato fuori, cosi' il
+// thread principale non resta mai in attesa a lungo
+static void encode_batch_run(void *arg) {
+    EncodeBatch *b = (EncodeBatch *)arg;
+    const Frame *src;
+    const uint32_t *refs;
+    Frame *tmp;
+    uint8_t *grown;
+    uint32_t size, need;
+    int i, f, l;
+    bool copied;
+
+    b->used = 0;
+    b->tiles_used = 0;
+    b->strokes_used = 0;
+    tileset_free(&b->used_tiles);
+    b->ok = false;
+    for (i = 0; i < b->count; i++) {
+        f = b->first + i;
+        src = animation_snapshot_acquire(b->snap, f);
+        copied = src && encode_batch_add_strokes(b, f, src);
+        if (copied) memcpy(b->cur, src, sizeof(Frame));
+        animation_snapshot_release(b->snap, f);
+        if (!copied) return;
+        if (b->preview) preview_add(b->preview, f, b->cur);
+
+        need = b->used + FRAME_MAX_PAYLOAD;
+        if (need > b->out_size) {
+            if (need < b->out_size * 2) need = b->out_size * 2;
+            grown = (uint8_t *)realloc(b->out, need);
+            if (!grown) return;
+            b->out = grown;
+            b->out_size = need;
         }
-        memset(&entry, 0, sizeof(SceIoDirent));
+
+        if (b->tiled) {
+            size = encode_tiles(b, b->cur, i > 0 && b->key_interval > 0 && f % b->key_interval != 0,
+                                b->out + b->used);
+            if (size == 0) return;
+            b->sizes[i] = size;
+            b->used += size;
+            continue;
+        }
+
+        // Frame completo ogni key_interval, delta negli altri
+        refs = b->refs ? b->refs + f * MAX_LAYERS : NULL;
+        size = encode_frame(&b->codec, b->cur,
+                            (i > 0 && b->key_interval > 0 && f % b->key_interval != 0) ? b->prev : NULL,
+                            refs, b->out + b->used, b->delta);
+        if (size == 0) return;
+        b->sizes[i] = size;
+        b->used += size;
+
+        // Base del delta successivo come la vedra' il decoder
+        for (l = 0; refs && l < MAX_LAYERS; l++) {
+            if (refs[l]) memset(&b->cur->layers[l], 0, sizeof(LayerData));
+        }
+
+        tmp = b->prev;
+        b->prev = b->cur;
+        b->cur = tmp;
     }
+    b->ok = true;
+}
 
-    sceIoDclose(dir);
-    return count;
+static bool encode_batch_init(EncodeBatch *b, AnimationSnapshot *snap, PreviewBuilder *preview,
+                              const uint32_t *refs, bool tiled, int batch_frames) {
+    memset(b, 0, sizeof(EncodeBatch));
+    b->snap = snap;
+    b->preview = preview;
+    b->refs = refs;
+    b->key_interval = save_key_interval;
+    b->cur = (Frame *)malloc(sizeof(Frame));
+    b->prev = (Frame *)malloc(sizeof(Frame));
+    b->delta = (LayerData *)malloc(sizeof(LayerData) * MAX_LAYERS);
+    b->sizes = (uint32_t *)malloc(batch_frames * sizeof(uint32_t));
+    codec_init(&b->codec, save_codec, save_level);
+    tile_coder_init(&b->tile_coder);
+    tileset_init(&b->used_tiles);
+    b->tiled = tiled;
+    if (tiled) {
+        b->table = (uint64_t *)malloc(TILE_TABLE_SIZE);
+        b->prev_table = (uint64_t *)malloc(TILE_TABLE_SIZE);
+        b->pixels = (uint8_t *)malloc(TILE_PIXELS);
+        if (!b->table || !b->prev_table || !b->pixels) return false;
+    }
+    return b->cur && b->prev && b->delta && b->sizes;
 }
 
-bool filemanager_exists(const char *filename) {
-    SceIoStat stat;
-    return sceIoGetstat(filename, &stat) >= 0;
+static void encode_batch_free(EncodeBatch *b) {
+    codec_free(&b->codec);
+    tile_coder_free(&b->tile_coder);
+    tileset_free(&b->used_tiles);
+    free(b->table);
+    free(b->prev_table);
+    free(b->pixels);
+    free(b->tiles);
+    free(b->strokes);
+    free(b->cur);
+    free(b->prev);
+    free(b->delta);
+    free(b->sizes);
+    free(b->out);
 }
 
-void filemanager_autosave(AnimationContext *anim, AudioContext *audio) {
-    char path[256];
-    snprintf(path, sizeof(path), "%s_autosave.fnv", SAVE_DIR);
-    filemanager_save(anim, audio, path);
+// sceIoRename non sovrascrive: si rimuove prima il vecchio file. Se ci si
+// interrompe tra le due chiamate resta il .tmp completo (vedi file_recover).
+static bool file_replace(const char *tmp, const char *filename) {
+    if (filemanager_exists(filename) && sceIoRemove(filename) < 0) return false;
+    return sceIoRename(tmp, filename) >= 0;
 }
 
-bool filemanager_load_autosave(AnimationContext *anim, AudioContext *audio, DrawingContext *draw) {
-    char path[256];
-    snprintf(path, sizeof(path), "%s_autosave.fnv", SAVE_DIR);
-    return filemanager_load(anim, audio, draw, path);
+// Un .tmp senza il file di destinazione e' un salvataggio gia' completo;
+// accanto al file e' invece una scrittura interrotta
+static void file_recover(const char *filename) {
+    char tmp[256];
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    if (!filemanager_exists(filename) && filemanager_exists(tmp))
+        sceIoRename(tmp, filename);
+    else
+        sceIoRemove(tmp);
 }
 
-bool filemanager_export_gif(AnimationContext *anim, const char *filename) {
-    SceUID fd;
-    int f, delay;
-    uint8_t gif_header[13];
-    uint8_t gct[12];
-    uint8_t ns_ext[19];
-    uint8_t gce[8];
-    uint8_t img_desc[10];
-    uint8_t lzw_min;
-    int total_pixels, written;
-    uint8_t trailer;
-
-    fd = sceIoOpen(filename, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
-    if (fd < 0) return false;
-
-    gif_header[0] = 'G'; gif_header[1] = 'I'; gif_header[2] = 'F';
-    gif_header[3] = '8'; gif_header[4] = '9'; gif_header[5] = 'a';
-    gif_header[6] = (CANVAS_WIDTH & 0xFF);
-    gif_header[7] = (CANVAS_WIDTH >> 8) & 0xFF;
-    gif_header[8] = (CANVAS_HEIGHT & 0xFF);
-    gif_header[9] = (CANVAS_HEIGHT >> 8) & 0xFF;
-    gif_header[10] = 0xF1;
-    gif_header[11] = 0x00;
-    gif_header[12] = 0x00;
-    sceIoWrite(fd, gif_header, 13);
-
-    gct[0] = 255; gct[1] = 255; gct[2] = 255;
-    gct[3] = 0;   gct[4] = 0;   gct[5] = 0;
-    gct[6] = 255; gct[7] = 0;   gct[8] = 0;
-    gct[9] = 0;   gct[10] = 0;  gct[11] = 255;
-    sceIoWrite(fd, gct, 12);
-
-    ns_ext[0] = 0x21; ns_ext[1] = 0xFF; ns_ext[2] = 0x0B;
-    ns_ext[3] = 'N';  ns_ext[4] = 'E';  ns_ext[5] = 'T';
-    ns_ext[6] = 'S';  ns_ext[7] = 'C';  ns_ext[8] = 'A';
-    ns_ext[9] = 'P';  ns_ext[10] = 'E'; ns_ext[11] = '2';
-    ns_ext[12] = '.'; ns_ext[13] = '0';
-    ns_ext[14] = 0x03; ns_ext[15] = 0x01;
-    ns_ext[16] = 0x00; ns_ext[17] = 0x00; ns_ext[18] = 0x00;
-    sceIoWrite(fd, ns_ext, 19);
-
-    delay = (int)(100.0f / anim->playback_speed);
+// Gira anche sul thread di salvataggio: legge solo lo snapshot e la
+// copia dell'audio. Si scrive su <filename>.tmp e si rinomina solo a file
+// completo: un errore o un crash lasciano intatto il vecchio contenuto.
+static bool save_snapshot(AnimationSnapshot *snap, AudioContext *audio, const char *filename) {
+    char tmp[256];
+    FileWriter w;
+    FNVHeader header;
+    FNVIndexEntry *index;
+    EncodeBatch batches[SAVE_MAX_ENCODERS];
+    EncodeBatch *b;
+    PreviewBuilder preview;
+    bool has_preview;
+    uint32_t *refs;
+    TileRecord rec;
+    TileSet file_tiles_set, old_tiles;
+    bool tiled, counted;
+    uint32_t index_size, pos;
+    SceOff index_pos, preview_pos, end_pos;
+    int threads, contexts, batch_frames, batch_count, next, i, f;
+    bool ok;
+
+    threads = encode_threads > 1 ? codec_pool_claim(encode_threads) : 0;
+    contexts = threads > 0 ? threads : 1;
+
+    batch_frames = save_key_interval > 0 ? save_key_interval : SAVE_BATCH_FRAMES;
+    batch_count = (snap->frame_count + batch_frames - 1) / batch_frames;
+
+    // Con l'archivio di tile occupato (altro salvataggio) si usa il codec.
+    // I tile del file sovrascritto si contano prima di perderli.
+    tiled = save_tiles && tilestore_begin();
+    tileset_init(&file_tiles_set);
+    tileset_init(&old_tiles);
+    counted = tiled && tilestore_refs_ready() &&
+              (!filemanager_exists(filename) || file_tiles(filename, &old_tiles));
+
+    // Senza memoria per anteprima o riferimenti il file si salva lo stesso
+    has_preview = preview_init(&preview, snap);
+    refs = tiled ? NULL : plan_layer_refs(snap);
+
+    ok = true;
+    for (i = 0; i < contexts; i++) {
+        if (!encode_batch_init(&batches[i], snap, has_preview ? &preview : NULL, refs, tiled,
+                               batch_frames))
+            ok = false;
+    }
 
-    for (f = 0; f < anim->frame_count; f++) {
-        gce[0] = 0x21; gce[1] = 0xF9; gce[2] = 0x04;
-        gce[3] = 0x04;
-        gce[4] = (uint8_t)(delay & 0xFF);
-        gce[5] = (uint8_t)((delay >> 8) & 0xFF);
-        gce[6] = 0x00; gce[7] = 0x00;
-        sceIoWrite(fd, gce, 8);
-
-        img_desc[0] = 0x2C;
-        img_desc[1] = 0x00; img_desc[2] = 0x00;
-        img_desc[3] = 0x00; img_desc[4] = 0x00;
-        img_desc[5] = (CANVAS_WIDTH & 0xFF);
-        img_desc[6] = (CANVAS_WIDTH >> 8) & 0xFF;
-        img_desc[7] = (CANVAS_HEIGHT & 0xFF);
-        img_desc[8] = (CANVAS_HEIGHT >> 8) & 0xFF;
-        img_desc[9] = 0x00;
-        sceIoWrite(fd, img_desc, 10);
-
-        lzw_min = 2;
-        sceIoWrite(fd, &lzw_min, 1);
-
-        total_pixels = CANVAS_WIDTH * CANVAS_HEIGHT;
-        written = 0;
-
-        while (written < total_pixels) {
-            int block_size = total_pixels - written;
-            uint8_t bs, clear_code, color;
-            int pi;
-
-            if (block_size > 254) block_size = 254;
-
-            bs = (uint8_t)(block_size + 1);
-            sceIoWrite(fd, &bs, 1);
-
-            if (written == 0) {
-                clear_code = 4;
-                sceIoWrite(fd, &clear_code, 1);
-            }
+    index_size = snap->frame_count * sizeof(FNVIndexEntry);
+    index = (FNVIndexEntry *)calloc(snap->frame_count, sizeof(FNVIndexEntry));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    if (!ok || !index || !fileio_open_write(&w, tmp)) {
+        for (i = 0; i < contexts; i++) encode_batch_free(&batches[i]);
+        if (threads > 0) codec_pool_release();
+        if (tiled) tilestore_end(false);
+        tileset_free(&old_tiles);
+        preview_free(&preview);
+        free(refs);
+        free(index);
+        return false;
+    }
 
-            for (pi = 0; pi < block_size; pi++) {
-                int px = written + pi;
-                color = anim->frames[f].layers[0].pixels[px];
-                if (color >= 4) color = 0;
-                sceIoWrite(fd, &color, 1);
-            }
+    fill_header(&header, snap);
+    fileio_write(&w, &header, sizeof(header));
+
+    // La tabella viene scritta vuota e completata alla fine
+    write_chunk_header(&w, "FIDX", index_size);
+    index_pos = fileio_tell_write(&w);
+    fileio_write(&w, index, index_size);
+
+    // Anche l'anteprima si completa alla fine, a codifica finita
+    preview_pos = 0;
+    if (has_preview) {
+        write_chunk_header(&w, "PREV", preview_chunk_size(&preview));
+        preview_pos = fileio_tell_write(&w);
+        preview_write(&w, &preview);
+    }
+
+    // Il lotto n va al contesto n % contexts: si scrivono in ordine
+    // e ogni contesto liberato riparte subito col lotto successivo
+    for (next = 0; next < batch_count + contexts; next++) {
+        b = &batches[next % contexts];
 
-            written += block_size;
+        if (next >= contexts) {
+            if (threads > 0) worker_wait(&codec_workers[next % contexts]);
+            if (!b->ok) w.error = true;
+
+            // I tile nuovi vanno nell'archivio prima dei frame che li usano
+            for (pos = 0; !w.error && pos < b->tiles_used; pos += sizeof(rec) + rec.size) {
+                memcpy(&rec, b->tiles + pos, sizeof(rec));
+                if (!tilestore_put(rec.hash, b->tiles + pos + sizeof(rec), rec.size, rec.format))
+                    w.error = true;
+            }
+            if (tiled && !w.error && !tileset_merge(&file_tiles_set, &b->used_tiles))
+                w.error = true;
+
+            for (i = 0, pos = 0; !w.error && i < b->count; i++) {
+                f = b->first + i;
+                index[f].offset = (uint32_t)fileio_tell_write(&w);
+                index[f].size = b->sizes[i];
+                write_chunk_header(&w, "FRAM", b->sizes[i]);
+                fileio_write(&w, b->out + pos, b->sizes[i]);
+                pos += b->sizes[i];
+            }
+            if (!w.error && b->strokes_used > 0) {
+                write_chunk_header(&w, "STRK", b->strokes_used);
+                fileio_write(&w, b->strokes, b->strokes_used);
+            }
         }
 
-        {
-            uint8_t term = 0x00;
-            sceIoWrite(fd, &term, 1);
+        if (next < batch_count && !w.error) {
+            b->first = next * batch_frames;
+            b->count = snap->frame_count - b->first;
+            if (b->count > batch_frames) b->count = batch_frames;
+            if (threads == 0 || !worker_submit(&codec_workers[next % contexts], encode_batch_run, b))
+                encode_batch_run(b);
         }
     }
 
-    trailer = 0x3B;
-    sceIoWrite(fd, &trailer, 1);
+    // Dopo un errore qualche lotto puo' essere ancora in corso
+    for (i = 0; i < threads; i++) worker_wait(&codec_workers[i]);
+    for (i = 0; i < contexts; i++) encode_batch_free(&batches[i]);
+    if (threads > 0) codec_pool_release();
 
-    sceIoClose(fd);
-    return true;
+    save_audio_chunk(&w, snap->frame_count, audio);
+    write_chunk_header(&w, "END ", 0);
+
+    end_pos = fileio_tell_write(&w);
+    fileio_seek_write(&w, index_pos);
+    fileio_write(&w, index, index_size);
+    if (has_preview) {
+        fileio_seek_write(&w, preview_pos);
+        preview_write(&w, &preview);
+    }
+    fileio_seek_write(&w, end_pos);
+
+    // Il file diventa leggibile solo con i tile gia' nell'indice
+    ok = !w.error && !snap->broken;
+    if (tiled) ok = tilestore_end(ok) && ok;
+    ok = fileio_close_write(&w) && ok;
+    ok = ok && file_replace(tmp, filename);
+    if (!ok) sceIoRemove(tmp);
+
+    // Se il salvataggio fallisce il vecchio file resta com'era
+    if (counted && ok) {
+        tilestore_add_refs(&file_tiles_set, 1);
+        tilestore_add_refs(&old_tiles, -1);
+    }
+    tileset_free(&file_tiles_set);
+    tileset_free(&old_tiles);
+    preview_free(&preview);
+    free(refs);
+    free(index);
+    return ok;
 }
 
-bool filemanager_export_png_sequence(AnimationContext *anim, const char *dirname) {
-    int f;
-    char path[256];
+bool filemanager_save(AnimationContext *anim, AudioContext *audio, const char *filename) {
+    AnimationSnapshot *snap;
+    bool ok;
 
-    sceIoMkdir(dirname, 0777);
+    snap = animation_snapshot_begin(anim);
+    if (!snap) return false;
+    ok = save_snapshot(snap, audio, filename);
+    animation_snapshot_end(anim, snap);
 
-    for (f = 0; f < anim->frame_count; f++) {
-        snprintf(path, sizeof(path), "%s/frame_%04d.bmp", dirname, f);
-        filemanager_export_frame_png(anim, f, path);
+    if (ok) index_update(filename, false);
+    return ok;
+}
+
+/* ========== SALVATAGGIO IN BACKGROUND ========== */
+typedef struct {
+    AnimationContext *anim;     // Solo per il thread principale
+    AnimationSnapshot *snap;
+    AudioContext *audio;        // Copia privata
+    char filename[256];
+    JournalGroup *group;        // Non NULL: JFRM di un gruppo del journal
+    bool autosave;
+    bool pending;               // Inviato e non ancora raccolto da poll
+    bool ok;
+} SaveJob;
+
+static SaveJob save_job;
+
+// Le clip possono essere riregistrate durante il salvataggio: si copiano
+static AudioContext *audio_snapshot(const AudioContext *audio) {
+    AudioContext *copy;
+    int i, n;
+
+    copy = (AudioContext *)malloc(sizeof(AudioContext));
+    if (!copy) return NULL;
+    memcpy(copy, audio, sizeof(AudioContext));
+    copy->record_buffer = NULL;
+    copy->bgm.data = NULL;
+
+    for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
+        n = audio->sound_effects[i].data ? audio->sound_effects[i].sample_count : 0;
+        copy->sound_effects[i].data = NULL;
+        copy->sound_effects[i].sample_count = 0;
+        if (n <= 0) continue;
+
+        copy->sound_effects[i].data = (int16_t *)malloc(n * sizeof(int16_t));
+        if (!copy->sound_effects[i].data) {
+            while (--i >= 0) free(copy->sound_effects[i].data);
+            free(copy);
+            return NULL;
+        }
+        memcpy(copy->sound_effects[i].data, audio->sound_effects[i].data, n * sizeof(int16_t));
+        copy->sound_effects[i].sample_count = n;
+    }
+    return copy;
+}
+
+static void audio_snapshot_free(AudioContext *copy) {
+    int i;
+    if (!copy) return;
+    for (i = 0; i < MAX_SOUND_EFFECTS; i++) free(copy->sound_effects[i].data);
+    free(copy);
+}
+
+static void save_job_run(void *arg) {
+    SaveJob *job = (SaveJob *)arg;
+    if (job->group)
+        job->ok = journal_write_frames(job->group, job->snap);
+    else
+        job->ok = save_snapshot(job->snap, job->audio, job->filename);
+}
+
+bool filemanager_save_async(AnimationContext *anim, AudioContext *audio,
+                            const char *filename, bool autosave)
+{
+    if (save_job.pending) return false;
+
+    save_job.snap = animation_snapshot_begin(anim);
+    save_job.audio = audio_snapshot(audio);
+    if (!save_job.snap || !save_job.audio) {
+        animation_snapshot_end(anim, save_job.snap);
+        audio_snapshot_free(save_job.audio);
+        return false;
     }
+
+    save_job.anim = anim;
+    save_job.group = NULL;
+    strncpy(save_job.filename, filename, sizeof(save_job.filename) - 1);
+    save_job.filename[sizeof(save_job.filename) - 1] = '\0';
+    save_job.autosave = autosave;
+    save_job.ok = false;
+    save_job.pending = true;
+
+    // Senza thread si salva subito; il risultato arriva comunque da poll
+    if (!save_worker_ready || !worker_submit(&save_worker, save_job_run, &save_job))
+        save_job_run(&save_job);
     return true;
 }
 
-bool filemanager_export_frame_png(AnimationContext *anim, int frame, const char *filename) {
-    SceUID fd;
-    uint32_t file_size;
-    uint8_t bmp_header[54];
-    int x, y, l, padding;
-    unsigned int final_color;
-    uint8_t rgb[3];
-    uint8_t pad_bytes[3] = {0, 0, 0};
-    uint8_t pix;
+SaveStatus filemanager_poll_save(bool *autosave) {
+    if (!save_job.pending) return SAVE_IDLE;
+    if (save_worker_ready && worker_busy(&save_worker)) return SAVE_RUNNING;
+
+    animation_snapshot_end(save_job.anim, save_job.snap);
+    audio_snapshot_free(save_job.audio);
+    save_job.snap = NULL;
+    save_job.audio = NULL;
+    save_job.pending = false;
+
+    if (save_job.group) {
+        save_job.ok = journal_append_done(save_job.group, save_job.ok);
+        save_job.group = NULL;
+    } else {
+        if (save_job.ok) index_update(save_job.filename, false);
+        if (save_job.autosave) journal_checkpoint_done(save_job.ok);
+    }
+    if (autosave) *autosave = save_job.autosave;
+    return save_job.ok ? SAVE_DONE : SAVE_FAILED;
+}
 
-    if (frame < 0 || frame >= anim->frame_count) return false;
+bool filemanager_save_busy(void) {
+    return save_job.pending;
+}
+
+void filemanager_wait_save(void) {
+    if (save_worker_ready) worker_wait(&save_worker);
+}
+
+
+static bool load_v1(FileReader *r, const FNVHeader *header, AnimationContext *anim,
+                    AudioContext *audio, LoadProgressFunc progress, void *user)
+{
+    int f, l, pos;
+    uint8_t count_byte, val;
+    uint32_t audio_marker, exposure_marker;
+    uint8_t trigger, exposure;
+    int32_t sample_count;
+    int32_t keyframe;
+    int i;
 
-    fd = sceIoOpen(filename, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
-    if (fd < 0) return false;
+    anim->frame_count = 0;
+    for (f = 0; f < (int)header->frame_count; f++) {
+        if (f > 0) animation_add_frame(anim);
+        else anim->frame_count = 1;
 
-    padding = (4 - (CANVAS_WIDTH * 3) % 4) % 4;
-    file_size = 54 + (CANVAS_WIDTH * 3 + padding) * CANVAS_HEIGHT;
+        // is_keyframe era scritto come int dal campo bool
+        if (!fileio_read(r, &anim->frames[f].frame_speed, sizeof(float)) ||
+            !fileio_read(r, &keyframe, sizeof(int32_t)))
+            return false;
+        anim->frames[f].is_keyframe = (keyframe & 0xFF) != 0;
 
-    memset(bmp_header, 0, 54);
-    bmp_header[0] = 'B'; bmp_header[1] = 'M';
-    *(uint32_t *)&bmp_header[2] = file_size;
-    *(uint32_t *)&bmp_header[10] = 54;
-    *(uint32_t *)&bmp_header[14] = 40;
-    *(int32_t *)&bmp_header[18] = CANVAS_WIDTH;
-    *(int32_t *)&bmp_header[22] = -(int32_t)CANVAS_HEIGHT;
-    *(uint16_t *)&bmp_header[26] = 1;
-    *(uint16_t *)&bmp_header[28] = 24;
+        for (l = 0; l < MAX_LAYERS; l++) {
+            uint8_t *pixels = anim->frames[f].layers[l].pixels;
+            pos = 0;
 
-    sceIoWrite(fd, bmp_header, 54);
+            // Il terminatore segue sempre l'ultimo run, anche a layer pieno
+            for (;;) {
+                if (!fileio_get(r, &count_byte) || !fileio_get(r, &val)) return false;
 
-    for (y = 0; y < CANVAS_HEIGHT; y++) {
-        for (x = 0; x < CANVAS_WIDTH; x++) {
-            final_color = COLOR_WHITE;
+                if (count_byte == 0 && val == 0xFF) break;
 
-            for (l = MAX_LAYERS - 1; l >= 0; l--) {
-                pix = anim->frames[frame].layers[l].pixels[y * CANVAS_WIDTH + x];
-                if (pix != 0) {
-                    final_color = drawing_get_rgba_color(pix, l);
+                for (i = 0; i < count_byte && pos < CANVAS_WIDTH * CANVAS_HEIGHT; i++) {
+                    pixels[pos++] = val;
                 }
             }
+        }
 
-            rgb[0] = (final_color >> 16) & 0xFF;
-            rgb[1] = (final_color >> 8) & 0xFF;
-            rgb[2] = final_color & 0xFF;
-            sceIoWrite(fd, rgb, 3);
+        if (progress && !progress(f + 1, (int)header->frame_count, user)) return false;
+    }
+
+    // Sezioni opzionali: i file senza audio finiscono qui
+    if (!fileio_read(r, &audio_marker, sizeof(uint32_t)) || audio_marker != AUDIO_MARKER)
+        return true;
+
+    for (f = 0; f < (int)header->frame_count && f < 999; f++) {
+        for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
+            if (!fileio_get(r, &trigger)) return false;
+            audio->se_triggers[f][i] = trigger;
         }
-        if (padding > 0)
-            sceIoWrite(fd, pad_bytes, padding);
     }
 
+    for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
+        if (!fileio_read(r, &sample_count, sizeof(int32_t))) return false;
+        if (sample_count > 0 && sample_count < MAX_RECORDING_SAMPLES) {
+            if (audio->sound_effects[i].data) {
+                free(audio->sound_effects[i].data);
+            }
+            audio->sound_effects[i].sample_count = 0;
+            audio->sound_effects[i].data =
+                (int16_t *)malloc(sample_count * sizeof(int16_t));
+            if (!audio->sound_effects[i].data ||
+                !fileio_read(r, audio->sound_effects[i].data, sample_count * sizeof(int16_t)))
+                return false;
+            audio->sound_effects[i].sample_count = sample_count;
+            audio->sound_effects[i].sample_rate = AUDIO_SAMPLE_RATE;
+        }
+    }
+
+    if (fileio_read(r, &exposure_marker, sizeof(uint32_t)) &&
+        exposure_marker == EXPOSURE_MARKER) {
+        for (f = 0; f < anim->frame_count; f++) {
+            if (!fileio_get(r, &exposure)) break;
+            animation_set_exposure(anim, f, exposure);
+        }
+    }
+    return true;
+}
+
+/* ========== DECODIFICA PARALLELA ========== */
+// Il thread che carica legge i chunk FRAM e li raggruppa in lotti che
+// iniziano con un frame completo; i thread del pool decodificano ogni
+// lotto direttamente nei frame finali. Le catene di delta non escono
+// mai dal lotto, quindi i lotti non dipendono l'uno dall'altro.
+typedef struct {
+    AnimationContext *anim;
+    int first;                  // Lotto: frame [first, first + count)
+    int count;
+    uint8_t *in;                // Payload dei frame, uno dopo l'altro
+    uint32_t in_size;
+    uint32_t used;
+    uint32_t *sizes;
+    uint32_t *refs;             // Riferimenti di tutti i frame, vedi resolve_layer_refs
+    CodecContext codec;
+    TileReader *tiles;
+    bool ok;
+} DecodeBatch;
+
+// Audio letto con un secondo FileReader mentre i frame si decodificano
+typedef struct {
+    const char *filename;
+    SceOff offset;              // Primo chunk dopo l'ultimo FRAM
+    AudioContext *audio;
+    int frame_count;
+    bool ok;
+} AudioLoadJob;
+
+static void decode_batch_run(void *arg) {
+    DecodeBatch *b = (DecodeBatch *)arg;
+    uint32_t pos;
+    int i, f;
+
+    b->ok = true;
+    for (i = 0, pos = 0; b->ok && i < b->count; i++) {
+        f = b->first + i;
+        // Il primo frame del lotto e' completo: non si legge il lotto vicino
+        b->ok = decode_frame(&b->codec, b->tiles, b->in + pos, b->sizes[i], &b->anim->frames[f],
+                             i > 0 ? b->anim->frames[f - 1].layers : NULL,
+                             b->refs + f * MAX_LAYERS);
+        pos += b->sizes[i];
+    }
+}
+
+static void audio_load_run(void *arg) {
+    AudioLoadJob *job = (AudioLoadJob *)arg;
+    FileReader r;
+    FNVChunk chunk;
+    SceOff start;
+
+    job->ok = false;
+    if (!fileio_open_read(&r, job->filename)) return;
+
+    job->ok = fileio_seek_read(&r, job->offset);
+    while (job->ok && fileio_read(&r, &chunk, sizeof(chunk))) {
+        if (memcmp(chunk.type, "END ", 4) == 0) break;
+        start = fileio_tell_read(&r);
+        if (memcmp(chunk.type, "AUDI", 4) == 0) {
+            job->ok = load_audio_chunk(&r, job->audio, job->frame_count);
+            break;
+        }
+        job->ok = fileio_seek_read(&r, start + chunk.size);
+    }
+    fileio_close_read(&r);
+}
+
+// Spazio per altri size byte in coda al lotto
+static bool decode_batch_reserve(DecodeBatch *b, uint32_t size) {
+    uint8_t *grown;
+    uint32_t need = b->used + size;
+
+    if (need <= b->in_size) return true;
+    if (need < b->in_size * 2) need = b->in_size * 2;
+    grown = (uint8_t *)realloc(b->in, need);
+    if (!grown) return false;
+    b->in = grown;
+    b->in_size = need;
+    return true;
+}
+
+// I pixel restano quelli dei FRAM: un log illeggibile lascia il layer
+// solo raster, solo un errore di lettura fa fallire il caricamento
+static bool load_strokes_chunk(FileReader *r, uint32_t size, AnimationContext *anim) {
+    FNVStrokeEntry entry;
+    StrokeLog *log;
+    uint8_t *data;
+    uint32_t pos;
+
+    data = (uint8_t *)malloc(size);
+    if (!data) return fileio_skip(r, size);
+    if (!fileio_read(r, data, size)) {
+        free(data);
+        return false;
+    }
+
+    for (pos = 0; size - pos >= sizeof(entry); pos += sizeof(entry) + entry.size) {
+        memcpy(&entry, data + pos, sizeof(entry));
+        if (entry.size > size - pos - sizeof(entry)) break;
+        if (entry.frame >= anim->frame_count || entry.layer >= MAX_LAYERS) continue;
+
+        log = strokes_deserialize(data + pos + sizeof(entry), entry.size);
+        if (!log) continue;
+        strokes_destroy(anim->frames[entry.frame].strokes[entry.layer]);
+        anim->frames[entry.frame].strokes[entry.layer] = log;
+    }
+    free(data);
+    return true;
+}
+
+static bool load_v2(FileReader *r, const FNVHeader *header, AnimationContext *anim,
+                    AudioContext *audio, const char *filename,
+                    LoadProgressFunc progress, void *user)
+{
+    DecodeBatch batches[SAVE_MAX_ENCODERS];
+    DecodeBatch *b, *nb;
+    AudioLoadJob audio_job;
+    FNVIndexEntry *index;
+    FNVFrameInfo info;
+    FNVChunk chunk;
+    SceOff start;
+    uint32_t *refs;
+    int threads, contexts, current, loaded, f, i;
+    bool ok = true, audio_async = false;
+
+    for (f = 1; f < (int)header->frame_count; f++) animation_add_frame(anim);
+
+    refs = (uint32_t *)calloc(anim->frame_count * MAX_LAYERS, sizeof(uint32_t));
+    if (!refs) ok = false;
+
+    threads = codec_pool_claim(codec_worker_count);
+    contexts = threads > 0 ? threads : 1;
+    for (i = 0; i < contexts; i++) {
+        memset(&batches[i], 0, sizeof(DecodeBatch));
+        batches[i].anim = anim;
+        batches[i].sizes = (uint32_t *)malloc(header->frame_count * sizeof(uint32_t));
+        batches[i].refs = refs;
+        batches[i].tiles = (TileReader *)malloc(sizeof(TileReader));
+        batches[i].ok = true;
+        codec_init(&batches[i].codec, CODEC_RLE, CODEC_DEFAULT_LEVEL);
+        if (batches[i].tiles) tile_reader_init(batches[i].tiles);
+        if (!batches[i].sizes || !batches[i].tiles) ok = false;
+    }
+
+    // Il lotto corrente si riempie finche' non arriva un frame completo;
+    // allora parte e il successivo usa il contesto dopo (round robin)
+    current = 0;
+    b = &batches[0];
+    loaded = 0;
+    while (ok && fileio_read(r, &chunk, sizeof(chunk))) {
+        if (memcmp(chunk.type, "END ", 4) == 0) break;
+        start = fileio_tell_read(r);
+
+        if (memcmp(chunk.type, "FIDX", 4) == 0 && threads > 0 &&
+            chunk.size == header->frame_count * sizeof(FNVIndexEntry)) {
+            // Dall'indice si sa dove inizia l'audio: parte subito sul pool
+            index = (FNVIndexEntry *)malloc(chunk.size);
+            if (index && fileio_read(r, index, chunk.size)) {
+                f = header->frame_count - 1;
+                audio_job.filename = filename;
+                audio_job.offset = (SceOff)index[f].offset + sizeof(FNVChunk) + index[f].size;
+                audio_job.audio = audio;
+                audio_job.frame_count = anim->frame_count;
+                audio_job.ok = false;
+                // Finche' il thread 0 legge l'audio, i lotti assegnati a lui
+                // si decodificano qui
+                audio_async = worker_submit(&codec_workers[0], audio_load_run, &audio_job);
+            }
+            free(index);
+        } else if (memcmp(chunk.type, "FRAM", 4) == 0) {
+            if (loaded >= anim->frame_count || chunk.size < sizeof(info) ||
+                chunk.size > FRAME_MAX_PAYLOAD || !decode_batch_reserve(b, chunk.size) ||
+                !fileio_read(r, b->in + b->used, chunk.size)) {
+                ok = false;
+            } else {
+                memcpy(&info, b->in + b->used, sizeof(info));
+                if (!(info.flags & FNV_FRAME_DELTA) && b->count >= LOAD_BATCH_FRAMES) {
+                    // Frame completo: il lotto pieno parte, questo apre il prossimo
+                    if (threads == 0 || !worker_submit(&codec_workers[current], decode_batch_run, b))
+                        decode_batch_run(b);
+
+                    current = (current + 1) % contexts;
+                    nb = &batches[current];
+                    if (threads > 0) worker_wait(&codec_workers[current]);
+                    if (!nb->ok || !decode_batch_reserve(nb, chunk.size)) {
+                        ok = false;
+                    } else {
+                        // In serie nb == b: le due zone possono sovrapporsi
+                        memmove(nb->in, b->in + b->used, chunk.size);
+                        nb->used = 0;
+                        nb->first = loaded;
+                        nb->count = 0;
+                        b = nb;
+                    }
+                }
+                if (ok) {
+                    if (b->count == 0) b->first = loaded;
+                    b->sizes[b->count++] = chunk.size;
+                    b->used += chunk.size;
+                    loaded++;
+                    // Avanza con la lettura: la decodifica segue sul pool
+                    if (progress && !progress(loaded, anim->frame_count, user)) ok = false;
+                }
+            }
+        } else if (memcmp(chunk.type, "AUDI", 4) == 0) {
+            if (!audio_async) ok = load_audio_chunk(r, audio, anim->frame_count);
+        } else if (memcmp(chunk.type, "STRK", 4) == 0) {
+            ok = load_strokes_chunk(r, chunk.size, anim);
+        }
+
+        // Chunk sconosciuti o letti solo in parte: si riparte dalla fine
+        ok = ok && fileio_seek_read(r, start + chunk.size);
+    }
+
+    if (ok && b->count > 0) {
+        if (threads == 0 || !worker_submit(&codec_workers[current], decode_batch_run, b))
+            decode_batch_run(b);
+    }
+
+    for (i = 0; i < threads; i++) worker_wait(&codec_workers[i]);
+    for (i = 0; i < contexts; i++) {
+        if (!batches[i].ok) ok = false;
+        codec_free(&batches[i].codec);
+        if (batches[i].tiles) tile_reader_close(batches[i].tiles);
+        free(batches[i].tiles);
+        free(batches[i].in);
+        free(batches[i].sizes);
+    }
+    if (threads > 0) codec_pool_release();
+    if (audio_async && !audio_job.ok) ok = false;
+
+    ok = ok && loaded == anim->frame_count && resolve_layer_refs(anim, refs);
+    free(refs);
+    return ok;
+}
+
+// Legge il file in anim (appena inizializzata) e audio
+static bool load_file(AnimationContext *anim, AudioContext *audio, const char *filename,
+                      LoadProgressFunc progress, void *user)
+{
+    FileReader r;
+    FNVHeader header;
+    bool ok;
+
+    if (!fileio_open_read(&r, filename)) return false;
+
+    if (!fileio_read(&r, &header, sizeof(header)) ||
+        memcmp(header.magic, "FNVT", 4) != 0 ||
+        header.version == 0 || header.version > FNV_VERSION ||
+        header.frame_count == 0 || header.frame_count > MAX_FRAMES) {
+        fileio_close_read(&r);
+        return false;
+    }
+
+    strncpy(anim->title, header.title, 63);
+    strncpy(anim->author, header.author, 63);
+    anim->playback_speed = header.playback_speed;
+    anim->loop = header.loop;
+
+    if (header.version == 1)
+        ok = load_v1(&r, &header, anim, audio, progress, user);
+    else
+        ok = load_v2(&r, &header, anim, audio, filename, progress, user);
+
+    fileio_close_read(&r);
+    return ok;
+}
+
+// Sostituisce animazione e audio con quelli caricati (svuotandoli)
+static void load_commit(AnimationContext *anim, AudioContext *audio, DrawingContext *draw,
+                        AnimationContext *loaded, AudioContext *loaded_audio)
+{
+    int i;
+
+    animation_replace(anim, loaded);
+    anim->current_frame = 0;
+    animation_load_current_from_draw(anim, draw);
+
+    memcpy(audio->se_triggers, loaded_audio->se_triggers, sizeof(audio->se_triggers));
+    for (i = 0; i < MAX_SOUND_EFFECTS; i++) {
+        free(audio->sound_effects[i].data);
+        audio->sound_effects[i] = loaded_audio->sound_effects[i];
+        loaded_audio->sound_effects[i].data = NULL;
+        loaded_audio->sound_effects[i].sample_count = 0;
+    }
+}
+
+bool filemanager_load_ex(AnimationContext *anim, AudioContext *audio, DrawingContext *draw,
+                         const char *filename, LoadProgressFunc progress, void *user)
+{
+    AnimationContext *loaded;
+    AudioContext *loaded_audio;
+    bool ok = false;
+
+    // Le clip attuali fanno da base, come nel caricamento sul posto
+    loaded = (AnimationContext *)malloc(sizeof(AnimationContext));
+    loaded_audio = audio_snapshot(audio);
+    if (loaded && loaded_audio) {
+        animation_init(loaded);
+        ok = load_file(loaded, loaded_audio, filename, progress, user);
+        if (ok) load_commit(anim, audio, draw, loaded, loaded_audio);
+        animation_free(loaded);
+    }
+
+    free(loaded);
+    audio_snapshot_free(loaded_audio);
+    return ok;
+}
+
+bool filemanager_load(AnimationContext *anim, AudioContext *audio,
+                      DrawingContext *draw, const char *filename)
+{
+    return filemanager_load_ex(anim, audio, draw, filename, NULL, NULL);
+}
+
+/* ========== CARICAMENTO IN BACKGROUND ========== */
+typedef struct {
+    char filename[256];
+    AnimationContext *anim;     // Destinazione privata, scambiata da poll
+    AudioContext *audio;
+    int done;                   // Avanzamento, letto dal thread principale
+    int total;
+    int cancel;
+    bool ok;
+    bool pending;
+} LoadJob;
+
+static LoadJob load_job;
+
+static bool load_job_progress(int done, int total, void *user) {
+    LoadJob *job = (LoadJob *)user;
+    __atomic_store_n(&job->total, total, __ATOMIC_RELAXED);
+    __atomic_store_n(&job->done, done, __ATOMIC_RELAXED);
+    return !__atomic_load_n(&job->cancel, __ATOMIC_RELAXED);
+}
+
+static void load_job_run(void *arg) {
+    LoadJob *job = (LoadJob *)arg;
+    job->ok = load_file(job->anim, job->audio, job->filename, load_job_progress, job);
+}
+
+static void load_job_free(void) {
+    if (load_job.anim) animation_free(load_job.anim);
+    free(load_job.anim);
+    audio_snapshot_free(load_job.audio);
+    load_job.anim = NULL;
+    load_job.audio = NULL;
+}
+
+bool filemanager_load_async(AudioContext *audio, const char *filename) {
+    if (load_job.pending) return false;
+
+    load_job.anim = (AnimationContext *)malloc(sizeof(AnimationContext));
+    load_job.audio = audio_snapshot(audio);
+    if (!load_job.anim || !load_job.audio) {
+        free(load_job.anim);
+        audio_snapshot_free(load_job.audio);
+        load_job.anim = NULL;
+        load_job.audio = NULL;
+        return false;
+    }
+    animation_init(load_job.anim);
+
+    strncpy(load_job.filename, filename, sizeof(load_job.filename) - 1);
+    load_job.filename[sizeof(load_job.filename) - 1] = '\0';
+    load_job.done = 0;
+    load_job.total = 0;
+    load_job.cancel = 0;
+    load_job.ok = false;
+    load_job.pending = true;
+
+    if (!load_worker_ready || !worker_submit(&load_worker, load_job_run, &load_job))
+        load_job_run(&load_job);
+    return true;
+}
+
+LoadStatus filemanager_poll_load(AnimationContext *anim, AudioContext *audio, DrawingContext *draw) {
+    LoadStatus status;
+
+    if (!load_job.pending) return LOAD_IDLE;
+    if (load_worker_ready && worker_busy(&load_worker)) return LOAD_RUNNING;
+
+    if (load_job.cancel) {
+        status = LOAD_CANCELLED;
+    } else if (load_job.ok) {
+        load_commit(anim, audio, draw, load_job.anim, load_job.audio);
+        status = LOAD_DONE;
+    } else {
+        status = LOAD_FAILED;
+    }
+
+    load_job_free();
+    load_job.pending = false;
+    return status;
+}
+
+bool filemanager_load_busy(void) {
+    return load_job.pending;
+}
+
+void filemanager_load_progress(int *done, int *total) {
+    *done = __atomic_load_n(&load_job.done, __ATOMIC_RELAXED);
+    *total = __atomic_load_n(&load_job.total, __ATOMIC_RELAXED);
+}
+
+void filemanager_cancel_load(void) {
+    if (load_job.pending) __atomic_store_n(&load_job.cancel, 1, __ATOMIC_RELAXED);
+}
+
+void filemanager_wait_load(void) {
+    if (load_job.pending && load_worker_ready) worker_wait(&load_worker);
+}
+
+bool filemanager_reader_open(FNVReader *reader, const char *filename) {
+    FNVChunk chunk;
+    uint32_t count;
+
+    memset(reader, 0, sizeof(FNVReader));
+    codec_init(&reader->codec, CODEC_RLE, CODEC_DEFAULT_LEVEL);
+    if (!fileio_open_read(&reader->file, filename)) return false;
+
+    count = 0;
+    if (fileio_read(&reader->file, &reader->header, sizeof(FNVHeader)) &&
+        memcmp(reader->header.magic, "FNVT", 4) == 0 &&
+        reader->header.version >= 2 && reader->header.version <= FNV_VERSION &&
+        fileio_read(&reader->file, &chunk, sizeof(chunk)) &&
+        memcmp(chunk.type, "FIDX", 4) == 0) {
+        count = chunk.size / sizeof(FNVIndexEntry);
+    }
+
+    if (count > 0 && count == reader->header.frame_count && count <= MAX_FRAMES) {
+        reader->index = (FNVIndexEntry *)malloc(chunk.size);
+        if (reader->index && fileio_read(&reader->file, reader->index, chunk.size))
+            return true;
+    }
+
+    filemanager_reader_close(reader);
+    return false;
+}
+
+static bool reader_read_info(FNVReader *reader, int frame, FNVFrameInfo *info) {
+    FNVIndexEntry *e = &reader->index[frame];
+
+    if (e->size < sizeof(FNVFrameInfo)) return false;
+    return fileio_seek_read(&reader->file, e->offset + sizeof(FNVChunk)) &&
+           fileio_read(&reader->file, info, sizeof(FNVFrameInfo));
+}
+
+static bool reader_decode(FNVReader *reader, int frame, Frame *out, const LayerData *prev,
+                          uint32_t *refs) {
+    FNVIndexEntry *e = &reader->index[frame];
+    FNVChunk chunk;
+
+    if (e->size > FRAME_MAX_PAYLOAD) return false;
+
+    if (e->size > reader->buffer_size) {
+        uint8_t *nb = (uint8_t *)realloc(reader->buffer, e->size);
+        if (!nb) return false;
+        reader->buffer = nb;
+        reader->buffer_size = e->size;
+    }
+
+    if (!fileio_seek_read(&reader->file, e->offset)) return false;
+    if (!fileio_read(&reader->file, &chunk, sizeof(chunk))) return false;
+    if (memcmp(chunk.type, "FRAM", 4) != 0 || chunk.size != e->size) return false;
+    if (!fileio_read(&reader->file, reader->buffer, e->size)) return false;
+
+    if (!reader->tiles && e->size >= sizeof(FNVFrameInfo) &&
+        (((FNVFrameInfo *)reader->buffer)->flags & FNV_FRAME_TILES)) {
+        reader->tiles = (TileReader *)malloc(sizeof(TileReader));
+        if (!reader->tiles) return false;
+        tile_reader_init(reader->tiles);
+    }
+    return decode_frame(&reader->codec, reader->tiles, reader->buffer, e->size, out, prev, refs);
+}
+
+// I frame delta si ricostruiscono dal keyframe piu' vicino, oppure
+// dall'ultimo frame letto se e' tra i due (lettura sequenziale).
+// I layer riferiti (refs) restano a zero.
+static bool reader_read_chain(FNVReader *reader, int frame, Frame *out, uint32_t *refs) {
+    FNVFrameInfo info;
+    int start, f;
+
+    if (!reader->last) {
+        reader->last = (LayerData *)malloc(sizeof(LayerData) * MAX_LAYERS);
+        if (!reader->last) return false;
+        reader->last_frame = -1;
+    }
+
+    for (start = frame; start > 0; start--) {
+        if (start == reader->last_frame + 1) break;
+        if (!reader_read_info(reader, start, &info)) return false;
+        if (!(info.flags & FNV_FRAME_DELTA)) break;
+    }
+
+    for (f = start; f <= frame; f++) {
+        if (!reader_decode(reader, f, out, f > 0 ? reader->last : NULL, refs)) {
+            reader->last_frame = -1;
+            return false;
+        }
+        memcpy(reader->last, out->layers, sizeof(LayerData) * MAX_LAYERS);
+        reader->last_frame = f;
+    }
+    return true;
+}
+
+// I riferimenti puntano sempre a layer scritti: del frame sorgente basta
+// la catena, senza risolvere i suoi riferimenti
+static bool reader_resolve_refs(FNVReader *reader, int frame, Frame *out, const uint32_t *refs) {
+    uint32_t src_refs[MAX_LAYERS], src;
+    int l, src_frame, loaded = -1;
+
+    for (l = 0; l < MAX_LAYERS; l++) {
+        if (!refs[l]) continue;
+        src = refs[l] - 1;
+        src_frame = (int)(src / MAX_LAYERS);
+        if (src >= (uint32_t)(frame * MAX_LAYERS + l)) return false;
+
+        if (src_frame == frame) {
+            if (refs[src % MAX_LAYERS]) return false;
+            memcpy(&out->layers[l], &out->layers[src % MAX_LAYERS], sizeof(LayerData));
+            continue;
+        }
+
+        if (!reader->source) {
+            reader->source = (Frame *)malloc(sizeof(Frame));
+            if (!reader->source) return false;
+        }
+        if (src_frame != loaded) {
+            if (!reader_read_chain(reader, src_frame, reader->source, src_refs)) return false;
+            loaded = src_frame;
+        }
+        if (src_refs[src % MAX_LAYERS]) return false;
+        memcpy(&out->layers[l], &reader->source->layers[src % MAX_LAYERS], sizeof(LayerData));
+    }
+
+    // La catena ora e' sul sorgente: riparte dal frame letto, come lo
+    // vede il delta successivo (riferimenti a zero)
+    if (loaded >= 0) {
+        memcpy(reader->last, out->layers, sizeof(LayerData) * MAX_LAYERS);
+        for (l = 0; l < MAX_LAYERS; l++) {
+            if (refs[l]) memset(&reader->last[l], 0, sizeof(LayerData));
+        }
+        reader->last_frame = frame;
+    }
+    return true;
+}
+
+bool filemanager_reader_read_frame(FNVReader *reader, int frame, Frame *out) {
+    uint32_t refs[MAX_LAYERS];
+
+    if (!reader->index || frame < 0 || frame >= (int)reader->header.frame_count)
+        return false;
+
+    // Un errore di lettura non deve bloccare i frame successivi
+    reader->file.error = false;
+
+    return reader_read_chain(reader, frame, out, refs) &&
+           reader_resolve_refs(reader, frame, out, refs);
+}
+
+void filemanager_reader_close(FNVReader *reader) {
+    fileio_close_read(&reader->file);
+    codec_free(&reader->codec);
+    if (reader->tiles) tile_reader_close(reader->tiles);
+    free(reader->tiles);
+    free(reader->last);
+    free(reader->source);
+    free(reader->index);
+    free(reader->buffer);
+    memset(reader, 0, sizeof(FNVReader));
+    reader->file.fd = -1;
+}
+
+/* ========== INDICE SALVATAGGI ========== */
+// Cache su disco della lista file: il browser legge solo la memoria e la
+// cartella viene riscandita solo quando cambia la sua data di modifica.
+// Sta in una sottocartella, cosi' riscriverla non cambia SAVE_DIR.
+#define SAVE_CACHE_DIR  SAVE_DIR "cache/"
+#define SAVE_INDEX_PATH SAVE_CACHE_DIR "saves.idx"
+#define SAVE_INDEX_VERSION 1
+
+typedef struct {
+    char magic[4];          // "FNVI"
+    uint32_t version;
+    uint32_t count;
+    SceDateTime dir_mtime;
+    // Seguito da count SaveSlotInfo
+} SaveIndexHeader;
+
+static SaveSlotInfo *save_index;
+static int save_index_count;
+static int save_index_capacity;
+static SceDateTime save_index_mtime;
+static bool save_index_loaded;
+static bool save_index_scanned;
+
+static bool same_time(const SceDateTime *a, const SceDateTime *b) {
+    return a->year == b->year && a->month == b->month && a->day == b->day &&
+           a->hour == b->hour && a->minute == b->minute && a->second == b->second &&
+           a->microsecond == b->microsecond;
+}
+
+static bool index_reserve(int needed) {
+    SaveSlotInfo *ns;
+    int cap;
+
+    if (needed <= save_index_capacity) return true;
+    cap = save_index_capacity ? save_index_capacity * 2 : 64;
+    while (cap < needed) cap *= 2;
+    ns = (SaveSlotInfo *)realloc(save_index, cap * sizeof(SaveSlotInfo));
+    if (!ns) return false;
+    save_index = ns;
+    save_index_capacity = cap;
+    return true;
+}
+
+static int index_find(const char *filename) {
+    int i;
+    for (i = 0; i < save_index_count; i++) {
+        if (strcmp(save_index[i].filename, filename) == 0) return i;
+    }
+    return -1;
+}
+
+// Solo i .fnv direttamente in SAVE_DIR fanno parte dell'indice
+static bool index_covers(const char *filename) {
+    size_t dl = strlen(SAVE_DIR), len = strlen(filename);
+    return len > dl + 4 && strncmp(filename, SAVE_DIR, dl) == 0 &&
+           strchr(filename + dl, '/') == NULL &&
+           strcmp(filename + len - 4, ".fnv") == 0;
+}
+
+static void index_read_slot(SaveSlotInfo *slot, const char *filename, const SceIoStat *st) {
+    SceUID fd;
+    FNVHeader header;
+
+    memset(slot, 0, sizeof(SaveSlotInfo));
+    strncpy(slot->filename, filename, sizeof(slot->filename) - 1);
+    slot->size = st->st_size;
+    slot->mtime = st->st_mtime;
+
+    fd = sceIoOpen(filename, SCE_O_RDONLY, 0);
+    if (fd < 0) return;
+    // Un solo header: la lettura diretta basta, niente buffer
+    if (sceIoRead(fd, &header, sizeof(header)) == sizeof(header) &&
+        memcmp(header.magic, "FNVT", 4) == 0) {
+        strncpy(slot->title, header.title, 63);
+        strncpy(slot->author, header.author, 63);
+        slot->frame_count = header.frame_count;
+        slot->exists = 1;
+    }
     sceIoClose(fd);
+}
+
+static void index_load_file(void) {
+    SaveIndexHeader h;
+    FileReader r;
+
+    save_index_count = 0;
+    if (!fileio_open_read(&r, SAVE_INDEX_PATH)) return;
+
+    if (fileio_read(&r, &h, sizeof(h)) && memcmp(h.magic, "FNVI", 4) == 0 &&
+        h.version == SAVE_INDEX_VERSION && index_reserve(h.count) &&
+        fileio_read(&r, save_index, h.count * sizeof(SaveSlotInfo))) {
+        save_index_count = h.count;
+        save_index_mtime = h.dir_mtime;
+        save_index_scanned = true;
+    }
+    fileio_close_read(&r);
+}
+
+static void index_store_file(void) {
+    SaveIndexHeader h;
+    FileWriter w;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "FNVI", 4);
+    h.version = SAVE_INDEX_VERSION;
+    h.count = save_index_count;
+    h.dir_mtime = save_index_mtime;
+
+    sceIoMkdir(SAVE_CACHE_DIR, 0777);
+    if (!fileio_open_write(&w, SAVE_INDEX_PATH)) return;
+    fileio_write(&w, &h, sizeof(h));
+    fileio_write(&w, save_index, save_index_count * sizeof(SaveSlotInfo));
+    // Se la scrittura fallisce la cache viene ricostruita al prossimo avvio
+    if (!fileio_close_write(&w)) sceIoRemove(SAVE_INDEX_PATH);
+}
+
+// Riscansione incrementale: i file con stessa dimensione e data
+// riusano la voce esistente, gli altri rileggono l'header
+static void index_rescan(const SceDateTime *dir_mtime) {
+    SaveSlotInfo *old;
+    int old_count, count, idx, len;
+    SceIoDirent entry;
+    SceUID dir;
+    char path[256];
+
+    old = save_index;
+    old_count = save_index_count;
+    save_index = NULL;
+    save_index_count = 0;
+    save_index_capacity = 0;
+
+    dir = sceIoDopen(SAVE_DIR);
+    count = 0;
+    if (dir >= 0) {
+        memset(&entry, 0, sizeof(SceIoDirent));
+        while (sceIoDread(dir, &entry) > 0) {
+            len = (int)strlen(entry.d_name);
+            if (len > 4 && strcmp(&entry.d_name[len - 4], ".fnv") == 0 &&
+                index_reserve(count + 1)) {
+                snprintf(path, sizeof(path), "%s%s", SAVE_DIR, entry.d_name);
+
+                for (idx = 0; idx < old_count; idx++) {
+                    if (strcmp(old[idx].filename, path) == 0) break;
+                }
+                if (idx < old_count && old[idx].size == entry.d_stat.st_size &&
+                    same_time(&old[idx].mtime, &entry.d_stat.st_mtime))
+                    save_index[count] = old[idx];
+                else
+                    index_read_slot(&save_index[count], path, &entry.d_stat);
+                count++;
+            }
+            memset(&entry, 0, sizeof(SceIoDirent));
+        }
+        sceIoDclose(dir);
+    }
+
+    free(old);
+    save_index_count = count;
+    save_index_mtime = *dir_mtime;
+    save_index_scanned = true;
+    index_store_file();
+}
+
+void filemanager_refresh_saves(void) {
+    SceIoStat st;
+
+    if (!save_index_loaded) {
+        index_load_file();
+        save_index_loaded = true;
+    }
+
+    if (sceIoGetstat(SAVE_DIR, &st) < 0) {
+        save_index_count = 0;
+        return;
+    }
+    if (save_index_scanned && same_time(&st.st_mtime, &save_index_mtime)) return;
+    index_rescan(&st.st_mtime);
+}
+
+const SaveSlotInfo *filemanager_get_saves(int *count) {
+    if (!save_index_loaded) filemanager_refresh_saves();
+    *count = save_index_count;
+    return save_index;
+}
+
+// Dopo save/delete fatti da noi: aggiorna la voce senza riscandire
+static void index_update(const char *filename, bool removed) {
+    SceIoStat st;
+    int idx;
+
+    if (!save_index_loaded || !index_covers(filename)) return;
+
+    idx = index_find(filename);
+    if (removed || sceIoGetstat(filename, &st) < 0) {
+        if (idx >= 0) {
+            memmove(&save_index[idx], &save_index[idx + 1],
+                    (save_index_count - idx - 1) * sizeof(SaveSlotInfo));
+            save_index_count--;
+        }
+    } else {
+        if (idx < 0) {
+            if (!index_reserve(save_index_count + 1)) {
+                save_index_scanned = false;
+                return;
+            }
+            idx = save_index_count++;
+        }
+        index_read_slot(&save_index[idx], filename, &st);
+    }
+
+    if (sceIoGetstat(SAVE_DIR, &st) >= 0) save_index_mtime = st.st_mtime;
+    index_store_file();
+}
+
+bool filemanager_delete(const char *filename) {
+    TileSet tiles;
+    bool counted;
+
+    tileset_init(&tiles);
+    counted = tilestore_refs_ready() && file_tiles(filename, &tiles);
+    if (sceIoRemove(filename) < 0) {
+        tileset_free(&tiles);
+        return false;
+    }
+    index_update(filename, true);
+
+    if (counted) tilestore_add_refs(&tiles, -1);
+    tileset_free(&tiles);
+    filemanager_collect_tiles(false);
+    return true;
+}
+
+// Mark: tutti i .fnv della cartella, autosave compreso
+static bool count_live_tiles(TileSet *live) {
+    SceUID dir;
+    SceIoDirent entry;
+    TileSet file;
+    char path[512];
+    int len;
+    bool ok = true;
+
+    dir = sceIoDopen(SAVE_DIR);
+    if (dir < 0) return false;
+
+    memset(&entry, 0, sizeof(SceIoDirent));
+    while (ok && sceIoDread(dir, &entry) > 0) {
+        len = (int)strlen(entry.d_name);
+        if (len > 4 && strcmp(&entry.d_name[len - 4], ".fnv") == 0) {
+            snprintf(path, sizeof(path), "%s%s", SAVE_DIR, entry.d_name);
+            tileset_init(&file);
+            ok = file_tiles(path, &file) && tileset_merge(live, &file);
+            tileset_free(&file);
+        }
+        memset(&entry, 0, sizeof(SceIoDirent));
+    }
+    sceIoDclose(dir);
+    return ok;
+}
+
+// I riferimenti si contano dai file la prima volta che servono; poi li
+// aggiornano salvataggi ed eliminazioni
+bool filemanager_collect_tiles(bool force) {
+    TileSet live;
+    bool ok;
+
+    // Mentre si salva o si carica i file e l'archivio sono in uso
+    if (filemanager_save_busy() || filemanager_load_busy()) return false;
+    if (tilestore_count() == 0) return false;
+    if (!force && tilestore_refs_ready() && tilestore_garbage() < TILE_GC_THRESHOLD) return false;
+
+    tileset_init(&live);
+    ok = count_live_tiles(&live);
+    if (ok) {
+        tilestore_set_refs(&live);
+        ok = (force || tilestore_garbage() >= TILE_GC_THRESHOLD) && tilestore_collect(&live);
+    }
+    tileset_free(&live);
+    return ok;
+}
+
+int filemanager_list_saves(SaveSlotInfo *slots, int max_slots) {
+    const SaveSlotInfo *all;
+    int count;
+
+    filemanager_refresh_saves();
+    all = filemanager_get_saves(&count);
+    if (count > max_slots) count = max_slots;
+    if (count > 0) memcpy(slots, all, count * sizeof(SaveSlotInfo));
+    return count;
+}
+
+bool filemanager_exists(const char *filename) {
+    SceIoStat stat;
+    return sceIoGetstat(filename, &stat) >= 0;
+}
+
+/* ========== AUTOSAVE E JOURNAL ========== */
+#define AUTOSAVE_PATH SAVE_DIR "_autosave.fnv"
+#define JOURNAL_PATH  SAVE_DIR "_autosave.fnj"
+
+// Stato di un frame com'e' su disco (checkpoint + journal)
+typedef struct {
+    uint64_t hash;
+    float frame_speed;
+    uint8_t is_keyframe;
+    uint8_t exposure;
+    uint8_t dirty;          // Frame modificato dalla cattura precedente
+} JournalFrame;
+
+typedef struct {
+    JournalFrame *frames;
+    int frame_count;
+    uint64_t audio_hash;
+    SceOff size;            // Byte del journal
+    SceOff base_size;       // Byte del checkpoint
+    bool valid;             // false = il prossimo autosave e' un checkpoint
+
+    // Stato del checkpoint in corso, adottato quando termina
+    JournalFrame *pending;
+    int pending_count;
+    uint64_t pending_audio;
+    uint64_t pending_hash;
+} AutosaveJournal;
+
+static AutosaveJournal journal;
+
+// Gli hash dei layer sono in cache: costa solo rileggere i frame modificati.
+// La cattura diventa lo stato su disco, quindi azzera Frame.dirty
+static JournalFrame *journal_capture(AnimationContext *anim) {
+    JournalFrame *frames;
+    int f;
+
+    frames = (JournalFrame *)malloc(anim->frame_count * sizeof(JournalFrame));
+    if (!frames) return NULL;
+    for (f = 0; f < anim->frame_count; f++) {
+        frames[f].hash = animation_get_frame_hash(anim, f);
+        frames[f].frame_speed = anim->frames[f].frame_speed;
+        frames[f].is_keyframe = anim->frames[f].is_keyframe ? 1 : 0;
+        frames[f].exposure = (uint8_t)animation_get_exposure(anim, f);
+        frames[f].dirty = anim->frames[f].dirty ? 1 : 0;
+        anim->frames[f].dirty = false;
+    }
+    return frames;
+}
+
+// Un hash uguale non basta: un frame modificato con lo stesso hash (ritorno
+// allo stato su disco o collisione) si riscrive comunque. I frame non
+// modificati sono quelli su disco, senza confronti.
+static bool journal_frame_changed(const JournalFrame *now, const JournalFrame *disk) {
+    return now->dirty || now->hash != disk->hash || now->frame_speed != disk->frame_speed ||
+           now->is_keyframe != disk->is_keyframe || now->exposure != disk->exposure;
+}
+
+static void journal_begin_checkpoint(AnimationContext *anim, AudioContext *audio) {
+    free(journal.pending);
+    journal.pending = journal_capture(anim);
+    journal.pending_count = anim->frame_count;
+    journal.pending_audio = audio_get_hash(audio);
+    journal.pending_hash = animation_get_hash(anim);
+}
+
+// Checkpoint terminato: il journal riparte vuoto sulla nuova base.
+// ok arriva da save_snapshot, quindi il nuovo checkpoint ha gia'
+// sostituito il vecchio. Se l'header non viene riscritto, quello
+// vecchio non corrisponde piu' al checkpoint e il journal verra'
+// ignorato al caricamento.
+static void journal_checkpoint_done(bool ok) {
+    FileWriter w;
+    FNVJournalHeader header;
+    SceIoStat st;
+
+    journal.valid = false;
+    if (ok && journal.pending) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "FNVJ", 4);
+        header.version = FNV_JOURNAL_VERSION;
+        header.base_hash = journal.pending_hash;
+        if (fileio_open_write(&w, JOURNAL_PATH)) {
+            fileio_write(&w, &header, sizeof(header));
+            journal.valid = fileio_close_write(&w);
+        }
+    }
+
+    if (journal.valid) {
+        free(journal.frames);
+        journal.frames = journal.pending;
+        journal.frame_count = journal.pending_count;
+        journal.audio_hash = journal.pending_audio;
+        journal.size = sizeof(header);
+        journal.base_size = sceIoGetstat(AUTOSAVE_PATH, &st) >= 0 ? st.st_size : 0;
+    } else {
+        free(journal.pending);
+    }
+    journal.pending = NULL;
+}
+
+// Un gruppo: JFRM per ogni frame diverso da quello su disco, poi JCMT.
+// I JFRM si codificano sul thread di salvataggio da uno snapshot; il
+// JCMT, piccolo, lo accoda poll sul thread principale. Un crash prima
+// del JCMT lascia un gruppo aperto, che al caricamento si ignora.
+struct JournalGroup {
+    int *frames;            // Indici dei frame da riscrivere
+    int count;
+    JournalFrame *now;      // Stato su disco quando il gruppo e' chiuso
+    int frame_count;
+    FNVJournalCommit commit;
+};
+
+static void journal_group_free(JournalGroup *group) {
+    if (!group) return;
+    free(group->frames);
+    free(group->now);
+    free(group);
+}
+
+// Thread di salvataggio
+static bool journal_write_frames(JournalGroup *group, AnimationSnapshot *snap) {
+    FileWriter w;
+    CodecContext codec;
+    const Frame *frame;
+    uint8_t *payload;
+    uint32_t size, idx;
+    int i;
+    bool ok;
+
+    payload = (uint8_t *)malloc(FRAME_MAX_PAYLOAD);
+    if (!payload) return false;
+    if (!fileio_open_append(&w, JOURNAL_PATH)) {
+        free(payload);
+        return false;
+    }
+
+    codec_init(&codec, save_codec, save_level);
+    for (i = 0; !w.error && i < group->count; i++) {
+        idx = (uint32_t)group->frames[i];
+        frame = animation_snapshot_acquire(snap, idx);
+        size = frame ? encode_frame(&codec, frame, NULL, NULL, payload, NULL) : 0;
+        animation_snapshot_release(snap, idx);
+        if (size == 0) {
+            w.error = true;
+            break;
+        }
+        write_chunk_header(&w, "JFRM", sizeof(idx) + size);
+        fileio_write(&w, &idx, sizeof(idx));
+        fileio_write(&w, payload, size);
+    }
+    codec_free(&codec);
+
+    ok = fileio_close_write(&w) && !snap->broken;
+    free(payload);
+    return ok;
+}
+
+// Thread principale, da poll: chiude il gruppo e ne adotta lo stato
+static bool journal_append_done(JournalGroup *group, bool ok) {
+    FileWriter w;
+
+    if (ok && fileio_open_append(&w, JOURNAL_PATH)) {
+        write_chunk_header(&w, "JCMT", sizeof(group->commit));
+        fileio_write(&w, &group->commit, sizeof(group->commit));
+        journal.size = fileio_tell_write(&w);
+        ok = fileio_close_write(&w);
+    } else {
+        ok = false;
+    }
+
+    if (ok) {
+        free(journal.frames);
+        journal.frames = group->now;
+        journal.frame_count = group->frame_count;
+        group->now = NULL;
+    } else {
+        journal.valid = false;
+    }
+    journal_group_free(group);
+    return ok;
+}
+
+// Prepara il gruppo e lo passa al thread di salvataggio con uno snapshot
+static bool journal_append_async(AnimationContext *anim, JournalFrame *now) {
+    JournalGroup *group;
+    int f;
+
+    group = (JournalGroup *)calloc(1, sizeof(JournalGroup));
+    if (!group) return false;
+    group->frames = (int *)malloc(anim->frame_count * sizeof(int));
+    save_job.snap = group->frames ? animation_snapshot_begin(anim) : NULL;
+    if (!save_job.snap) {
+        journal_group_free(group);
+        return false;
+    }
+
+    for (f = 0; f < anim->frame_count; f++) {
+        if (f >= journal.frame_count || journal_frame_changed(&now[f], &journal.frames[f]))
+            group->frames[group->count++] = f;
+    }
+    group->now = now;
+    group->frame_count = anim->frame_count;
+    group->commit.frame_count = anim->frame_count;
+    group->commit.playback_speed = anim->playback_speed;
+    group->commit.loop = anim->loop ? 1 : 0;
+    strncpy(group->commit.title, anim->title, 63);
+    strncpy(group->commit.author, anim->author, 63);
+
+    save_job.anim = anim;
+    save_job.audio = NULL;
+    save_job.group = group;
+    strcpy(save_job.filename, JOURNAL_PATH);
+    save_job.autosave = true;
+    save_job.ok = false;
+    save_job.pending = true;
+
+    if (!save_worker_ready || !worker_submit(&save_worker, save_job_run, &save_job))
+        save_job_run(&save_job);
     return true;
 }
+
+// Frame di un gruppo in attesa del suo JCMT
+typedef struct {
+    uint32_t idx;
+    uint32_t offset;        // Nel buffer del gruppo
+    uint32_t size;
+} JournalStaged;
+
+// Il gruppo e' gia' stato decodificato per intero nel frame di prova:
+// la stessa decodifica sui frame dell'animazione non puo' fallire
+static void journal_apply_group(AnimationContext *anim, CodecContext *codec, const uint8_t *group,
+                                const JournalStaged *staged, int count,
+                                const FNVJournalCommit *commit)
+{
+    uint32_t refs[MAX_LAYERS];
+    int i;
+
+    while (anim->frame_count > (int)commit->frame_count)
+        animation_delete_frame(anim, anim->frame_count - 1);
+    while (anim->frame_count < (int)commit->frame_count)
+        animation_add_frame(anim);
+    // Il journal porta solo i pixel: i frame riscritti restano solo raster
+    for (i = 0; i < count; i++) {
+        animation_frame_free_strokes(&anim->frames[staged[i].idx]);
+        decode_frame(codec, NULL, group + staged[i].offset, staged[i].size,
+                     &anim->frames[staged[i].idx], NULL, refs);
+    }
+
+    anim->playback_speed = commit->playback_speed;
+    anim->loop = commit->loop != 0;
+    memcpy(anim->title, commit->title, 63);
+    memcpy(anim->author, commit->author, 63);
+    anim->title[63] = '\0';
+    anim->author[63] = '\0';
+}
+
+// Riapplica al checkpoint appena caricato i gruppi chiusi da un JCMT.
+// I payload di un gruppo restano in memoria fino al JCMT e si applicano
+// solo se si decodificano tutti: l'animazione passa sempre da un gruppo
+// completo all'altro. Una coda senza JCMT (crash durante la scrittura)
+// viene scartata; un gruppo chiuso ma illeggibile ferma il replay e
+// restituisce false. In *end la fine dell'ultimo gruppo applicato,
+// 0 se il journal manca o appartiene a un altro checkpoint.
+static bool journal_replay(AnimationContext *anim, SceOff *end) {
+    FileReader r;
+    FNVJournalHeader header;
+    FNVJournalCommit commit;
+    FNVChunk chunk;
+    CodecContext codec;
+    JournalStaged *staged;
+    Frame *scratch;
+    uint8_t *group, *grown;
+    uint32_t idx, size, used, capacity, refs[MAX_LAYERS];
+    int count, i;
+    bool bad, ok = true;
+
+    *end = 0;
+    if (!fileio_open_read(&r, JOURNAL_PATH)) return true;
+    if (!fileio_read(&r, &header, sizeof(header)) ||
+        memcmp(header.magic, "FNVJ", 4) != 0 ||
+        header.version != FNV_JOURNAL_VERSION ||
+        header.base_hash != animation_get_hash(anim)) {
+        fileio_close_read(&r);
+        return true;
+    }
+    *end = fileio_tell_read(&r);
+
+    staged = (JournalStaged *)malloc(MAX_FRAMES * sizeof(JournalStaged));
+    scratch = (Frame *)malloc(sizeof(Frame));
+    capacity = FRAME_MAX_PAYLOAD;
+    group = (uint8_t *)malloc(capacity);
+    if (!staged || !scratch || !group) {
+        fileio_close_read(&r);
+        free(staged);
+        free(scratch);
+        free(group);
+        return false;
+    }
+    codec_init(&codec, CODEC_RLE, CODEC_DEFAULT_LEVEL);
+
+    count = 0;
+    used = 0;
+    bad = false;
+    while (ok && fileio_read(&r, &chunk, sizeof(chunk))) {
+        if (memcmp(chunk.type, "JFRM", 4) == 0) {
+            size = chunk.size - sizeof(idx);
+            if (chunk.size < sizeof(idx) + sizeof(FNVFrameInfo) || size > FRAME_MAX_PAYLOAD ||
+                count >= MAX_FRAMES) {
+                bad = true;
+                if (!fileio_skip(&r, chunk.size)) break;
+                continue;
+            }
+            if (used + size > capacity) {
+                capacity = used + size > capacity * 2 ? used + size : capacity * 2;
+                grown = (uint8_t *)realloc(group, capacity);
+                if (!grown) {
+                    ok = false;
+                    break;
+                }
+                group = grown;
+            }
+            if (!fileio_read(&r, &idx, sizeof(idx)) || !fileio_read(&r, group + used, size)) break;
+            staged[count].idx = idx;
+            staged[count].offset = used;
+            staged[count].size = size;
+            used += size;
+            count++;
+        } else if (memcmp(chunk.type, "JCMT", 4) == 0) {
+            if (chunk.size != sizeof(commit) || !fileio_read(&r, &commit, sizeof(commit))) break;
+
+            // Prova di decodifica di tutto il gruppo prima di toccare l'animazione
+            ok = !bad && commit.frame_count >= 1 && commit.frame_count <= MAX_FRAMES;
+            for (i = 0; ok && i < count; i++) {
+                ok = staged[i].idx < commit.frame_count &&
+                     !(((FNVFrameInfo *)(group + staged[i].offset))->flags & FNV_FRAME_REFS) &&
+                     decode_frame(&codec, NULL, group + staged[i].offset, staged[i].size,
+                                  scratch, NULL, refs);
+            }
+            if (ok) {
+                journal_apply_group(anim, &codec, group, staged, count, &commit);
+                *end = fileio_tell_read(&r);
+            }
+            count = 0;
+            used = 0;
+        } else if (!fileio_skip(&r, chunk.size)) {
+            break;
+        }
+    }
+
+    codec_free(&codec);
+    free(staged);
+    free(scratch);
+    free(group);
+    fileio_close_read(&r);
+    return ok;
+}
+
+void filemanager_autosave(AnimationContext *anim, AudioContext *audio) {
+    journal_begin_checkpoint(anim, audio);
+    journal_checkpoint_done(filemanager_save(anim, audio, AUTOSAVE_PATH));
+}
+
+bool filemanager_autosave_async(AnimationContext *anim, AudioContext *audio) {
+    journal_begin_checkpoint(anim, audio);
+    if (filemanager_save_async(anim, audio, AUTOSAVE_PATH, true)) return true;
+
+    // La cattura ha gia' azzerato Frame.dirty: il prossimo e' un checkpoint
+    free(journal.pending);
+    journal.pending = NULL;
+    journal.valid = false;
+    return false;
+}
+
+bool filemanager_autosave_journal(AnimationContext *anim, AudioContext *audio) {
+    JournalFrame *now;
+    int f, changed = 0;
+
+    if (save_job.pending) return false;
+
+    now = journal.valid ? journal_capture(anim) : NULL;
+    if (now) {
+        for (f = 0; f < anim->frame_count; f++) {
+            if (f >= journal.frame_count || journal_frame_changed(&now[f], &journal.frames[f]))
+                changed++;
+        }
+    }
+
+    // Compattazione: si riscrive tutto se il journal supera il checkpoint
+    // o se il gruppo toccherebbe piu' di meta' dei frame
+    if (!now || audio_get_hash(audio) != journal.audio_hash ||
+        journal.size > journal.base_size || changed * 2 > anim->frame_count) {
+        free(now);
+        return filemanager_autosave_async(anim, audio);
+    }
+
+    // now passa al gruppo: diventa lo stato su disco quando poll lo chiude
+    if (!journal_append_async(anim, now)) {
+        journal.valid = false;
+        free(now);
+        return false;
+    }
+    return true;
+}
+
+bool filemanager_load_autosave(AnimationContext *anim, AudioContext *audio, DrawingContext *draw) {
+    SceIoStat st;
+    SceOff end;
+    bool replayed;
+
+    journal.valid = false;
+    file_recover(AUTOSAVE_PATH);
+    if (!filemanager_load(anim, audio, draw, AUTOSAVE_PATH)) return false;
+
+    // Si continua ad accodare solo a un journal integro, altrimenti il
+    // prossimo autosave e' un checkpoint
+    replayed = journal_replay(anim, &end);
+    if (replayed && sceIoGetstat(JOURNAL_PATH, &st) >= 0 && st.st_size == end) {
+        free(journal.frames);
+        journal.frames = journal_capture(anim);
+        journal.frame_count = anim->frame_count;
+        journal.audio_hash = audio_get_hash(audio);
+        journal.size = st.st_size;
+        journal.base_size = sceIoGetstat(AUTOSAVE_PATH, &st) >= 0 ? st.st_size : 0;
+        journal.valid = journal.frames != NULL;
+    }
+
+    anim->current_frame = 0;
+    animation_load_current_from_draw(anim, draw);
+    return replayed;
+}
+
+/* ========== EXPORT ========== */
+// Tela composta con gli indici dell'anteprima: 0 = sfondo, altrimenti
+// 1 + layer * 3 + colore - 1 del layer piu' in alto (il layer 0)
+#define EXPORT_COLORS (1 + MAX_LAYERS * (LAYER_COLORS_COUNT - 1))
+
+static void export_palette(unsigned int *palette) {
+    int l, c;
+
+    palette[0] = drawing_get_rgba_color(0, 0);
+    for (l = 0; l < MAX_LAYERS; l++) {
+        for (c = 1; c < LAYER_COLORS_COUNT; c++)
+            palette[1 + l * (LAYER_COLORS_COUNT - 1) + c - 1] = drawing_get_rgba_color(c, l);
+    }
+}
+
+static void export_compose(const Frame *frame, uint8_t *out) {
+    uint8_t c;
+    int i, l;
+
+    for (i = 0; i < LAYER_PIXELS; i++) {
+        out[i] = 0;
+        for (l = 0; l < MAX_LAYERS; l++) {
+            c = frame->layers[l].pixels[i];
+            if (c == 0) continue;
+            if (c >= LAYER_COLORS_COUNT) c = 1;     // Come drawing_get_rgba_color
+            out[i] = (uint8_t)(1 + l * (LAYER_COLORS_COUNT - 1) + c - 1);
+            break;
+        }
+    }
+}
+
+// Secondi sullo schermo, con le regole di animation_update
+static float export_frame_time(AnimationContext *anim, int f) {
+    float speed = anim->frames[f].frame_speed > 0 ? anim->frames[f].frame_speed
+                                                  : anim->playback_speed;
+    if (speed < MIN_SPEED) speed = DEFAULT_SPEED;
+    return animation_get_exposure(anim, f) / speed;
+}
+
+// Primo frame dopo f con layer diversi (frame_count se nessuno)
+static int export_next_change(AnimationContext *anim, int f) {
+    int next;
+
+    // Hash diversi bastano a separare i frame (in cache dopo ogni
+    // autosave); hash uguali si confermano pixel per pixel
+    for (next = f + 1; next < anim->frame_count; next++) {
+        if (!animation_frames_equal(anim, f, next) ||
+            memcmp(anim->frames[next].layers, anim->frames[f].layers,
+                   sizeof(anim->frames[f].layers)) != 0)
+            break;
+    }
+    return next;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    uint64_t t;
+
+    while (b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Rettangolo dei pixel cambiati; false = nessuno
+static bool export_diff_rect(const uint8_t *a, const uint8_t *b,
+                             int *x0, int *y0, int *x1, int *y1)
+{
+    int x, y;
+
+    *x0 = CANVAS_WIDTH;
+    *y0 = CANVAS_HEIGHT;
+    *x1 = -1;
+    *y1 = -1;
+    for (y = 0; y < CANVAS_HEIGHT; y++) {
+        const uint8_t *ra = a + y * CANVAS_WIDTH, *rb = b + y * CANVAS_WIDTH;
+        if (memcmp(ra, rb, CANVAS_WIDTH) == 0) continue;
+        if (*y0 == CANVAS_HEIGHT) *y0 = y;
+        *y1 = y;
+        for (x = 0; x < *x0 && ra[x] == rb[x]; x++);
+        if (x < *x0) *x0 = x;
+        for (x = CANVAS_WIDTH - 1; x > *x1 && ra[x] == rb[x]; x--);
+        if (x > *x1) *x1 = x;
+    }
+    return *x1 >= 0;
+}
+
+// Il primo frame e' intero; gli altri solo il rettangolo cambiato, con i
+// pixel invariati trasparenti. I frame consecutivi uguali diventano uno
+// solo col ritardo sommato; i ritardi si arrotondano sul tempo totale,
+// cosi' l'errore dei centesimi non si accumula.
+bool filemanager_export_gif(AnimationContext *anim, const char *filename) {
+    FileWriter w;
+    GifEncoder *enc;
+    unsigned int palette[EXPORT_COLORS + 1];
+    uint8_t *prev, *cur, *swap;
+    float elapsed;
+    int f, next, i, x, y, x0, y0, x1, y1, delay, shown;
+    bool ok;
+
+    enc = (GifEncoder *)malloc(sizeof(GifEncoder));
+    prev = (uint8_t *)malloc(LAYER_PIXELS);
+    cur = (uint8_t *)malloc(LAYER_PIXELS);
+    ok = enc && prev && cur && fileio_open_write(&w, filename);
+    if (!ok) {
+        free(enc);
+        free(prev);
+        free(cur);
+        return false;
+    }
+
+    export_palette(palette);
+    palette[EXPORT_COLORS] = 0;             // Trasparente
+    ok = gif_begin(&w, enc, CANVAS_WIDTH, CANVAS_HEIGHT, palette, EXPORT_COLORS + 1, anim->loop);
+
+    elapsed = 0;
+    shown = 0;
+    for (f = 0; ok && f < anim->frame_count; f = next) {
+        next = export_next_change(anim, f);
+        for (i = f; i < next; i++) elapsed += export_frame_time(anim, i);
+        delay = (int)(elapsed * 100.0f + 0.5f) - shown;
+        shown += delay;
+
+        export_compose(&anim->frames[f], cur);
+        if (f == 0) {
+            ok = gif_add_image(&w, enc, cur, CANVAS_WIDTH, 0, 0, CANVAS_WIDTH, CANVAS_HEIGHT,
+                               delay, GIF_NO_TRANSPARENCY);
+        } else {
+            // Layer diversi ma stessa immagine: un pixel trasparente
+            if (!export_diff_rect(prev, cur, &x0, &y0, &x1, &y1)) x0 = y0 = x1 = y1 = 0;
+
+            // prev non serve piu': diventa il rettangolo da scrivere
+            for (y = y0; y <= y1; y++) {
+                for (x = x0; x <= x1; x++) {
+                    i = y * CANVAS_WIDTH + x;
+                    prev[i] = prev[i] == cur[i] ? EXPORT_COLORS : cur[i];
+                }
+            }
+            ok = gif_add_image(&w, enc, prev, CANVAS_WIDTH, x0, y0, x1 - x0 + 1, y1 - y0 + 1,
+                               delay, EXPORT_COLORS);
+        }
+
+        swap = prev;
+        prev = cur;
+        cur = swap;
+    }
+
+    ok = gif_end(&w) && ok;
+    ok = fileio_close_write(&w) && ok;
+    free(enc);
+    free(prev);
+    free(cur);
+    return ok;
+}
+
+// I layer condividono i colori: nel PNG restano solo le voci diverse
+// (2 bit con la tavolozza standard); remap porta gli indici di
+// export_compose nelle voci rimaste
+static int export_png_palette(unsigned int *palette, uint8_t *remap) {
+    unsigned int all[EXPORT_COLORS];
+    int i, j, colors;
+
+    export_palette(all);
+    colors = 0;
+    for (i = 0; i < EXPORT_COLORS; i++) {
+        for (j = 0; j < colors && palette[j] != all[i]; j++);
+        if (j == colors) palette[colors++] = all[i];
+        remap[i] = (uint8_t)j;
+    }
+    return colors;
+}
+
+static bool export_png_encode(AnimationContext *anim, int frame, PngBuffer *png, uint8_t *pixels) {
+    unsigned int palette[EXPORT_COLORS];
+    uint8_t remap[EXPORT_COLORS];
+    int i, colors;
+
+    colors = export_png_palette(palette, remap);
+    export_compose(&anim->frames[frame], pixels);
+    for (i = 0; i < LAYER_PIXELS; i++) pixels[i] = remap[pixels[i]];
+    return pngfile_encode(png, pixels, CANVAS_WIDTH, CANVAS_HEIGHT, CANVAS_WIDTH,
+                          palette, colors, png_level);
+}
+
+// Un lavoro per thread: prende il prossimo frame libero, lo codifica una
+// volta e ne scrive una copia per ogni tick di esposizione
+typedef struct {
+    AnimationContext *anim;
+    const char *dirname;
+    const int *first_tick;      // Primo tick di ogni frame
+    int *next_frame;            // Condiviso tra i lavori
+    bool ok;
+} PngExportJob;
+
+static void png_export_run(void *arg) {
+    PngExportJob *job = (PngExportJob *)arg;
+    PngBuffer png;
+    uint8_t *pixels;
+    char path[256];
+    int f, t, ticks;
+
+    pngfile_buffer_init(&png);
+    pixels = (uint8_t *)malloc(LAYER_PIXELS);
+    job->ok = pixels != NULL;
+
+    while (job->ok) {
+        f = __sync_fetch_and_add(job->next_frame, 1);
+        if (f >= job->anim->frame_count) break;
+
+        job->ok = export_png_encode(job->anim, f, &png, pixels);
+        ticks = animation_get_exposure(job->anim, f);
+        for (t = 0; job->ok && t < ticks; t++) {
+            snprintf(path, sizeof(path), "%s/frame_%04d.png", job->dirname, job->first_tick[f] + t);
+            job->ok = pngfile_save(&png, path);
+        }
+    }
+
+    // Dopo un errore gli altri lavori si fermano al prossimo frame
+    if (!job->ok) __sync_lock_test_and_set(job->next_frame, job->anim->frame_count);
+    free(pixels);
+    pngfile_buffer_free(&png);
+}
+
+// Una immagine per tick: i frame tenuti vengono ripetuti. I frame si
+// dividono tra il pool di codifica e il thread chiamante.
+bool filemanager_export_png_sequence(AnimationContext *anim, const char *dirname) {
+    PngExportJob jobs[SAVE_MAX_ENCODERS + 1];
+    int *first_tick;
+    int f, i, tick, next_frame, threads;
+    bool ok;
+
+    sceIoMkdir(dirname, 0777);
+
+    first_tick = (int *)malloc((anim->frame_count + 1) * sizeof(int));
+    if (!first_tick) return false;
+    tick = 0;
+    for (f = 0; f < anim->frame_count; f++) {
+        first_tick[f] = tick;
+        tick += animation_get_exposure(anim, f);
+    }
+
+    threads = codec_pool_claim(codec_worker_count);
+    next_frame = 0;
+    for (i = 0; i <= threads; i++) {
+        jobs[i].anim = anim;
+        jobs[i].dirname = dirname;
+        jobs[i].first_tick = first_tick;
+        jobs[i].next_frame = &next_frame;
+        jobs[i].ok = true;      // Se non parte, i frame li fanno gli altri
+    }
+    for (i = 0; i < threads; i++) worker_submit(&codec_workers[i], png_export_run, &jobs[i]);
+    png_export_run(&jobs[threads]);
+    for (i = 0; i < threads; i++) worker_wait(&codec_workers[i]);
+    if (threads > 0) codec_pool_release();
+
+    ok = true;
+    for (i = 0; i <= threads; i++) ok = ok && jobs[i].ok;
+    free(first_tick);
+    return ok;
+}
+
+bool filemanager_export_frame_png(AnimationContext *anim, int frame, const char *filename) {
+    PngBuffer png;
+    uint8_t *pixels;
+    bool ok;
+
+    if (frame < 0 || frame >= anim->frame_count) return false;
+
+    pixels = (uint8_t *)malloc(LAYER_PIXELS);
+    if (!pixels) return false;
+    pngfile_buffer_init(&png);
+    ok = export_png_encode(anim, frame, &png, pixels) && pngfile_save(&png, filename);
+    pngfile_buffer_free(&png);
+    free(pixels);
+    return ok;
+}
+
+// Video a frequenza fissa rate / scale, mai sotto la velocita' piu' alta
+// dell'animazione: ogni frame dura almeno un tick video. I frame
+// partono al tick piu' vicino al loro istante, e l'audio segue i tick:
+// i suoni cadono esattamente sul frame che si vede.
+#define AVI_SLOTS 3
+#define AVI_MAX_FPS 30
+
+typedef struct {
+    AnimationContext *anim;
+    AudioContext *audio;
+    FileWriter w;
+    AviWriter avi;
+    uint32_t rate, scale;
+    uint32_t *first_tick;       // frame_count + 1 voci, l'ultima = totale
+    uint32_t *first_sample;     // Primo campione di ogni frame
+    int16_t *samples;           // Campioni di un tick
+    bool ok;
+} AviExport;
+
+// Un frame in lavorazione: composto, poi codificato, poi scritto
+typedef struct {
+    AviExport *ex;
+    int frame;
+    uint8_t *indices;
+    uint8_t *rgb;
+    JpegBuffer jpeg;
+    bool ok;
+} AviSlot;
+
+static uint32_t avi_tick_sample(const AviExport *ex, uint32_t tick) {
+    return (uint32_t)((uint64_t)tick * AUDIO_SAMPLE_RATE * ex->scale / ex->rate);
+}
+
+static void avi_compose(AviSlot *slot, const unsigned int *palette) {
+    unsigned int color;
+    uint8_t *rgb = slot->rgb;
+    int i;
+
+    export_compose(&slot->ex->anim->frames[slot->frame], slot->indices);
+    for (i = 0; i < LAYER_PIXELS; i++) {
+        color = palette[slot->indices[i]];
+        rgb[0] = color & 0xFF;
+        rgb[1] = (color >> 8) & 0xFF;
+        rgb[2] = (color >> 16) & 0xFF;
+        rgb += 3;
+    }
+}
+
+static void avi_encode_run(void *arg) {
+    AviSlot *slot = (AviSlot *)arg;
+
+    slot->ok = jpegfile_encode(&slot->jpeg, slot->rgb, CANVAS_WIDTH, CANVAS_HEIGHT,
+                               JPEG_DEFAULT_QUALITY);
+}
+
+// Lo stesso JPEG per ogni tick del frame, ciascuno seguito dal suo audio
+static void avi_write_run(void *arg) {
+    AviSlot *slot = (AviSlot *)arg;
+    AviExport *ex = slot->ex;
+    uint32_t tick, from, to;
+
+    if (!ex->ok || !slot->ok) {
+        ex->ok = false;
+        return;
+    }
+    for (tick = ex->first_tick[slot->frame]; ex->ok && tick < ex->first_tick[slot->frame + 1]; tick++) {
+        from = avi_tick_sample(ex, tick);
+        to = avi_tick_sample(ex, tick + 1);
+        soundtrack_render(ex->audio, ex->first_sample, ex->anim->frame_count, from,
+                          ex->samples, to - from);
+        ex->ok = avi_add_video(&ex->w, &ex->avi, slot->jpeg.data, slot->jpeg.size) &&
+                 avi_add_audio(&ex->w, &ex->avi, ex->samples, to - from);
+    }
+}
+
+static bool avi_timing(AviExport *ex) {
+    AnimationContext *anim = ex->anim;
+    uint32_t speed, fastest, common, g;
+    double elapsed;
+    int f;
+
+    // Velocita' in millesimi di fps. Se il loro mcm non supera
+    // AVI_MAX_FPS ogni frame dura un numero intero di tick.
+    fastest = MIN_SPEED * 1000;
+    common = 1;
+    for (f = 0; f < anim->frame_count; f++) {
+        speed = (uint32_t)(animation_get_exposure(anim, f) / export_frame_time(anim, f) * 1000.0f + 0.5f);
+        if (speed > fastest) fastest = speed;
+        if (common <= AVI_MAX_FPS * 1000) common = common / gcd(common, speed) * speed;
+    }
+    ex->rate = common <= AVI_MAX_FPS * 1000 ? common : fastest;
+    g = gcd(ex->rate, 1000);
+    ex->rate /= g;
+    ex->scale = 1000 / g;
+
+    ex->first_tick = (uint32_t *)malloc((anim->frame_count + 1) * sizeof(uint32_t));
+    ex->first_sample = (uint32_t *)malloc(anim->frame_count * sizeof(uint32_t));
+    // Un tick dura al massimo 1 / MIN_SPEED secondi
+    ex->samples = (int16_t *)malloc((AUDIO_SAMPLE_RATE / MIN_SPEED + 1) * sizeof(int16_t));
+    if (!ex->first_tick || !ex->first_sample || !ex->samples) return false;
+
+    elapsed = 0;
+    for (f = 0; f <= anim->frame_count; f++) {
+        ex->first_tick[f] = (uint32_t)(elapsed * ex->rate / ex->scale + 0.5);
+        if (f == anim->frame_count) break;
+        ex->first_sample[f] = avi_tick_sample(ex, ex->first_tick[f]);
+        elapsed += export_frame_time(anim, f);
+    }
+    return true;
+}
+
+// Tre stadi sovrapposti: mentre il thread chiamante compone il frame n,
+// un worker codifica il JPEG di n - 1 e un altro scrive n - 2. Senza
+// pool gli stessi passi girano in serie.
+bool filemanager_export_avi(AnimationContext *anim, AudioContext *audio, const char *filename) {
+    AviExport ex;
+    AviSlot slots[AVI_SLOTS];
+    AviSlot *slot;
+    unsigned int palette[EXPORT_COLORS];
+    int i, step, threads;
+    bool ok;
+
+    memset(&ex, 0, sizeof(ex));
+    memset(slots, 0, sizeof(slots));
+    ex.anim = anim;
+    ex.audio = audio;
+    ok = avi_timing(&ex);
+    for (i = 0; i < AVI_SLOTS; i++) {
+        slots[i].ex = &ex;
+        slots[i].indices = (uint8_t *)malloc(LAYER_PIXELS);
+        slots[i].rgb = (uint8_t *)malloc(LAYER_PIXELS * 3);
+        jpegfile_buffer_init(&slots[i].jpeg);
+        ok = ok && slots[i].indices && slots[i].rgb;
+    }
+    ok = ok && fileio_open_write(&ex.w, filename);
+
+    if (ok) {
+        export_palette(palette);
+        ex.ok = avi_begin(&ex.w, &ex.avi, CANVAS_WIDTH, CANVAS_HEIGHT, ex.rate, ex.scale,
+                          AUDIO_SAMPLE_RATE);
+
+        threads = codec_pool_claim(2);
+        for (step = 0; ex.ok && step < anim->frame_count + 2; step++) {
+            if (step >= 2) {
+                slot = &slots[(step - 2) % AVI_SLOTS];
+                if (threads < 2 || !worker_submit(&codec_workers[1], avi_write_run, slot))
+                    avi_write_run(slot);
+            }
+            if (step >= 1 && step <= anim->frame_count) {
+                slot = &slots[(step - 1) % AVI_SLOTS];
+                if (threads < 2 || !worker_submit(&codec_workers[0], avi_encode_run, slot))
+                    avi_encode_run(slot);
+            }
+            if (step < anim->frame_count) {
+                slot = &slots[step % AVI_SLOTS];
+                slot->frame = step;
+                avi_compose(slot, palette);
+            }
+            if (threads >= 2) {
+                worker_wait(&codec_workers[0]);
+                worker_wait(&codec_workers[1]);
+            }
+        }
+        if (threads > 0) codec_pool_release();
+
+        ok = avi_end(&ex.w, &ex.avi) && ex.ok;
+        ok = fileio_close_write(&ex.w) && ok;
+    }
+
+    for (i = 0; i < AVI_SLOTS; i++) {
+        free(slots[i].indices);
+        free(slots[i].rgb);
+        jpegfile_buffer_free(&slots[i].jpeg);
+    }
+    free(ex.first_tick);
+    free(ex.first_sample);
+    free(ex.samples);
+    return ok;
+}
+
+// Durata esatta del frame in secondi: num / den
+static void export_frame_fraction(AnimationContext *anim, int f, uint64_t *num, uint64_t *den) {
+    float speed = anim->frames[f].frame_speed > 0 ? anim->frames[f].frame_speed
+                                                  : anim->playback_speed;
+    if (speed < MIN_SPEED) speed = DEFAULT_SPEED;
+    *num = (uint64_t)animation_get_exposure(anim, f) * 1000;
+    *den = (uint64_t)(speed * 1000.0f + 0.5f);
+}
+
+// Somma a num / den la durata del frame f, riducendo la frazione
+static void export_add_frame_time(AnimationContext *anim, int f, uint64_t *num, uint64_t *den) {
+    uint64_t frame_num, frame_den, g;
+
+    export_frame_fraction(anim, f, &frame_num, &frame_den);
+    *num = *num * frame_den + frame_num * *den;
+    *den *= frame_den;
+    g = gcd(*num, *den);
+    *num /= g;
+    *den /= g;
+}
+
+// fcTL ha numeratore e denominatore a 16 bit: se la frazione ridotta non
+// ci sta si arrotonda al millesimo (o al centesimo, ...) di secondo
+static void apng_delay(uint64_t num, uint64_t den, uint16_t *delay_num, uint16_t *delay_den) {
+    uint64_t g = gcd(num, den);
+    uint32_t unit;
+
+    num /= g;
+    den /= g;
+    if (num <= 0xFFFF && den <= 0xFFFF) {
+        *delay_num = (uint16_t)num;
+        *delay_den = (uint16_t)den;
+        return;
+    }
+    for (unit = 1000; unit > 1 && (num * unit + den / 2) / den > 0xFFFF; unit /= 10);
+    num = (num * unit + den / 2) / den;
+    *delay_num = (uint16_t)(num < 0xFFFF ? num : 0xFFFF);
+    *delay_den = (uint16_t)unit;
+}
+
+// Come la GIF: il primo frame intero, poi solo il rettangolo cambiato
+// con i pixel invariati trasparenti (blend OVER), e i frame consecutivi
+// uguali uniti. La tavolozza e' quella dei PNG piu' la voce trasparente.
+bool filemanager_export_apng(AnimationContext *anim, const char *filename) {
+    FileWriter w;
+    ApngWriter apng;
+    unsigned int palette[EXPORT_COLORS + 1];
+    uint8_t remap[EXPORT_COLORS];
+    uint8_t *prev, *cur, *swap;
+    uint64_t num, den;
+    uint16_t delay_num, delay_den;
+    uint32_t groups;
+    int f, next, i, x, y, x0, y0, x1, y1, colors, transparent;
+    bool ok;
+
+    colors = export_png_palette(palette, remap);
+    transparent = colors;
+    palette[colors++] = 0;
+
+    groups = 0;
+    for (f = 0; f < anim->frame_count; f = export_next_change(anim, f)) groups++;
+
+    prev = (uint8_t *)malloc(LAYER_PIXELS);
+    cur = (uint8_t *)malloc(LAYER_PIXELS);
+    ok = prev && cur && apng_begin(&apng, CANVAS_WIDTH, CANVAS_HEIGHT, palette, colors,
+                                   png_level, groups, anim->loop ? 0 : 1);
+    ok = ok && fileio_open_write(&w, filename);
+    if (!ok) {
+        free(prev);
+        free(cur);
+        return false;
+    }
+
+    for (f = 0; ok && f < anim->frame_count; f = next) {
+        next = export_next_change(anim, f);
+        num = 0;
+        den = 1;
+        for (i = f; i < next; i++) export_add_frame_time(anim, i, &num, &den);
+        apng_delay(num, den, &delay_num, &delay_den);
+
+        export_compose(&anim->frames[f], cur);
+        for (i = 0; i < LAYER_PIXELS; i++) cur[i] = remap[cur[i]];
+
+        if (f == 0) {
+            ok = apng_add_frame(&w, &apng, cur, CANVAS_WIDTH, 0, 0, CANVAS_WIDTH, CANVAS_HEIGHT,
+                                delay_num, delay_den, APNG_BLEND_SOURCE);
+        } else {
+            if (!export_diff_rect(prev, cur, &x0, &y0, &x1, &y1)) x0 = y0 = x1 = y1 = 0;
+
+            for (y = y0; y <= y1; y++) {
+                for (x = x0; x <= x1; x++) {
+                    i = y * CANVAS_WIDTH + x;
+                    prev[i] = prev[i] == cur[i] ? transparent : cur[i];
+                }
+            }
+            ok = apng_add_frame(&w, &apng, prev + y0 * CANVAS_WIDTH + x0, CANVAS_WIDTH,
+                                x0, y0, x1 - x0 + 1, y1 - y0 + 1,
+                                delay_num, delay_den, APNG_BLEND_OVER);
+        }
+
+        swap = prev;
+        prev = cur;
+        cur = swap;
+    }
+
+    ok = apng_end(&w, &apng) && ok;
+    ok = fileio_close_write(&w) && ok;
+    free(prev);
+    free(cur);
+    return ok;
+}
+
+// Traccia dei suoni in WAV (PCM 16 bit mono). I frame partono al
+// campione piu' vicino al loro istante esatto, come li mostra il player.
+bool filemanager_export_wav(AnimationContext *anim, AudioContext *audio, const char *filename) {
+    FileWriter w;
+    uint8_t header[SOUNDTRACK_WAV_HEADER];
+    uint32_t *first_sample;
+    int16_t *samples;
+    uint64_t num, den;
+    uint32_t total, pos, count;
+    int f;
+    bool ok;
+
+    first_sample = (uint32_t *)malloc(anim->frame_count * sizeof(uint32_t));
+    samples = (int16_t *)malloc(FILEIO_BLOCK_SIZE);
+    ok = first_sample && samples && fileio_open_write(&w, filename);
+    if (!ok) {
+        free(first_sample);
+        free(samples);
+        return false;
+    }
+
+    num = 0;
+    den = 1;
+    for (f = 0; f < anim->frame_count; f++) {
+        first_sample[f] = (uint32_t)((num * AUDIO_SAMPLE_RATE + den / 2) / den);
+        export_add_frame_time(anim, f, &num, &den);
+    }
+    total = (uint32_t)((num * AUDIO_SAMPLE_RATE + den / 2) / den);
+
+    soundtrack_wav_header(header, total);
+    fileio_write(&w, header, sizeof(header));
+    for (pos = 0; ok && pos < total; pos += count) {
+        count = total - pos;
+        if (count > FILEIO_BLOCK_SIZE / sizeof(int16_t)) count = FILEIO_BLOCK_SIZE / sizeof(int16_t);
+        soundtrack_render(audio, first_sample, anim->frame_count, pos, samples, count);
+        ok = fileio_write(&w, samples, count * sizeof(int16_t));
+    }
+
+    ok = fileio_close_write(&w) && ok;
+    free(first_sample);
+    free(samples);
+    return ok;
+}
+
+/* ========== SPRITE SHEET ========== */
+#define SHEET_PAGE_SIZE 2048
+#define SHEET_PADDING   1
+
+// Un'immagine distinta: i frame uguali puntano alla stessa
+typedef struct {
+    uint64_t hash;              // Della tela composta
+    int frame;                  // Primo frame con questa immagine
+    int x, y;                   // Angolo del ritaglio sulla tela
+} SheetCell;
+
+// Rettangolo dei pixel non di sfondo; false = frame vuoto
+static bool export_ink_rect(const uint8_t *pixels, int *x0, int *y0, int *x1, int *y1) {
+    int x, y;
+
+    *x0 = CANVAS_WIDTH;
+    *y0 = CANVAS_HEIGHT;
+    *x1 = -1;
+    *y1 = -1;
+    for (y = 0; y < CANVAS_HEIGHT; y++) {
+        const uint8_t *row = pixels + y * CANVAS_WIDTH;
+        for (x = 0; x < CANVAS_WIDTH && row[x] == 0; x++);
+        if (x == CANVAS_WIDTH) continue;
+        if (*y0 == CANVAS_HEIGHT) *y0 = y;
+        *y1 = y;
+        if (x < *x0) *x0 = x;
+        for (x = CANVAS_WIDTH - 1; x > *x1 && row[x] == 0; x--);
+        if (x > *x1) *x1 = x;
+    }
+    return *x1 >= 0;
+}
+
+static bool write_text(FileWriter *w, const char *format, ...) {
+    char line[256];
+    va_list args;
+    int n;
+
+    va_start(args, format);
+    n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n < 0 || n >= (int)sizeof(line)) return false;
+    return fileio_write(w, line, n);
+}
+
+static bool sheet_write_json(AnimationContext *anim, const char *dirname, int pages,
+                             const SheetCell *cells, const AtlasRect *rects, int count,
+                             const int *cell_of)
+{
+    FileWriter w;
+    char path[256];
+    uint64_t num, den;
+    int i;
+
+    snprintf(path, sizeof(path), "%s/sheet.json", dirname);
+    if (!fileio_open_write(&w, path)) return false;
+
+    write_text(&w, "{\n  \"canvas\": { \"w\": %d, \"h\": %d },\n", CANVAS_WIDTH, CANVAS_HEIGHT);
+    write_text(&w, "  \"loop\": %s,\n  \"atlases\": [", anim->loop ? "true" : "false");
+    for (i = 0; i < pages; i++) write_text(&w, "%s\"atlas_%d.png\"", i ? ", " : "", i);
+
+    // Le celle vuote non hanno atlante (-1)
+    write_text(&w, "],\n  \"cells\": [\n");
+    for (i = 0; i < count; i++) {
+        write_text(&w, "    { \"atlas\": %d, \"x\": %d, \"y\": %d, \"w\": %d, \"h\": %d, "
+                       "\"offset_x\": %d, \"offset_y\": %d }%s\n",
+                   rects[i].w > 0 ? rects[i].page : -1, rects[i].x, rects[i].y,
+                   rects[i].w, rects[i].h, cells[i].x, cells[i].y, i + 1 < count ? "," : "");
+    }
+
+    write_text(&w, "  ],\n  \"frames\": [\n");
+    for (i = 0; i < anim->frame_count; i++) {
+        export_frame_fraction(anim, i, &num, &den);
+        write_text(&w, "    { \"cell\": %d, \"duration_ms\": %.3f }%s\n",
+                   cell_of[i], (double)num * 1000.0 / (double)den,
+                   i + 1 < anim->frame_count ? "," : "");
+    }
+    write_text(&w, "  ]\n}\n");
+    return fileio_close_write(&w);
+}
+
+// Ogni immagine distinta, ritagliata sull'inchiostro, finisce in una
+// cella di un atlante PNG (sfondo trasparente) grande al massimo
+// SHEET_PAGE_SIZE; sheet.json da' celle, frame e durate esatte.
+bool filemanager_export_sprite_sheet(AnimationContext *anim, const char *dirname) {
+    unsigned int palette[EXPORT_COLORS + 1];
+    uint8_t remap[EXPORT_COLORS];
+    uint8_t *cur, *other, *page;
+    SheetCell *cells;
+    AtlasRect *rects;
+    int *cell_of;
+    PngBuffer png;
+    char path[256];
+    uint64_t hash;
+    int f, c, p, x, y, x0, y0, x1, y1, count, pages, page_w, page_h, colors, transparent;
+    bool ok;
+
+    sceIoMkdir(dirname, 0777);
+
+    colors = export_png_palette(palette, remap);
+    transparent = colors;
+    palette[colors++] = 0;
+
+    cur = (uint8_t *)malloc(LAYER_PIXELS);
+    other = (uint8_t *)malloc(LAYER_PIXELS);
+    page = (uint8_t *)malloc(SHEET_PAGE_SIZE * SHEET_PAGE_SIZE);
+    cells = (SheetCell *)malloc(anim->frame_count * sizeof(SheetCell));
+    rects = (AtlasRect *)malloc(anim->frame_count * sizeof(AtlasRect));
+    cell_of = (int *)malloc(anim->frame_count * sizeof(int));
+    pngfile_buffer_init(&png);
+    ok = cur && other && page && cells && rects && cell_of;
+
+    // Immagini distinte: stesso hash e poi confronto pixel per pixel
+    count = 0;
+    for (f = 0; ok && f < anim->frame_count; f++) {
+        export_compose(&anim->frames[f], cur);
+        hash = animation_hash_data(cur, LAYER_PIXELS);
+        for (c = 0; c < count; c++) {
+            if (cells[c].hash != hash) continue;
+            export_compose(&anim->frames[cells[c].frame], other);
+            if (memcmp(cur, other, LAYER_PIXELS) == 0) break;
+        }
+        if (c == count) {
+            cells[c].hash = hash;
+            cells[c].frame = f;
+            if (export_ink_rect(cur, &x0, &y0, &x1, &y1)) {
+                cells[c].x = x0;
+                cells[c].y = y0;
+                rects[c].w = x1 - x0 + 1;
+                rects[c].h = y1 - y0 + 1;
+            } else {
+                cells[c].x = cells[c].y = 0;
+                rects[c].w = rects[c].h = 0;
+            }
+            count++;
+        }
+        cell_of[f] = c;
+    }
+
+    pages = ok ? atlas_pack(rects, count, SHEET_PAGE_SIZE, SHEET_PAGE_SIZE, SHEET_PADDING) : -1;
+    ok = pages >= 0;
+
+    for (p = 0; ok && p < pages; p++) {
+        // La pagina si stringe sulle celle che contiene
+        page_w = page_h = 1;
+        for (c = 0; c < count; c++) {
+            if (rects[c].w == 0 || rects[c].page != p) continue;
+            if (rects[c].x + rects[c].w > page_w) page_w = rects[c].x + rects[c].w;
+            if (rects[c].y + rects[c].h > page_h) page_h = rects[c].y + rects[c].h;
+        }
+        memset(page, transparent, page_w * page_h);
+
+        for (c = 0; c < count; c++) {
+            if (rects[c].w == 0 || rects[c].page != p) continue;
+            export_compose(&anim->frames[cells[c].frame], cur);
+            for (y = 0; y < rects[c].h; y++) {
+                const uint8_t *src = cur + (cells[c].y + y) * CANVAS_WIDTH + cells[c].x;
+                uint8_t *dst = page + (rects[c].y + y) * page_w + rects[c].x;
+                for (x = 0; x < rects[c].w; x++) dst[x] = src[x] ? remap[src[x]] : transparent;
+            }
+        }
+
+        snprintf(path, sizeof(path), "%s/atlas_%d.png", dirname, p);
+        ok = pngfile_encode(&png, page, page_w, page_h, page_w, palette, colors, png_level) &&
+             pngfile_save(&png, path);
+    }
+
+    ok = ok && sheet_write_json(anim, dirname, pages, cells, rects, count, cell_of);
+
+    pngfile_buffer_free(&png);
+    free(cur);
+    free(other);
+    free(page);
+    free(cells);
+    free(rects);
+    free(cell_of);
+    return ok;
+}
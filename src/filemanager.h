@@ -3,6 +3,9 @@
 
 #include "animation.h"
 #include "audio.h"
+#include "fileio.h"
+#include "codec.h"
+#include "tilestore.h"
 #include <stdbool.h>
 
 #define SAVE_DIR "ux0:data/FlipnoteVita/"
@@ -14,12 +17,22 @@ typedef struct {
     char author[64];
     int frame_count;
     bool exists;
+    SceOff size;            // Per validare l'indice su disco
+    SceDateTime mtime;
 } SaveSlotInfo;
 
+#define FNV_VERSION 2
+#define FNV_KEY_INTERVAL 12     // Frame completo ogni N frame (0 = nessun delta)
+
+#define SAVE_MAX_ENCODERS     4     // Thread di codifica al salvataggio
+#define SAVE_DEFAULT_ENCODERS 3     // I core applicativi della Vita
+#define SAVE_BATCH_FRAMES     8     // Frame per lotto senza delta
+#define LOAD_BATCH_FRAMES     8     // Frame minimi per lotto di decodifica
+
 // Formato file .fnv (Flipnote Vita)
 typedef struct {
     char magic[4];          // "FNVT"
-    uint32_t version;       // 1
+    uint32_t version;       // 1 = stream RLE, 2 = chunk
     char title[64];
     char author[64];
     uint32_t frame_count;
@@ -28,28 +41,221 @@ typedef struct {
     uint32_t canvas_width;
     uint32_t canvas_height;
     uint32_t layers_per_frame;
-    // Seguito da frame data
+    // v1: seguito da frame data; v2: seguito da chunk
 } FNVHeader;
 
+// v2: dopo l'header una sequenza di chunk {tipo, dimensione, payload}.
+// I tipi sconosciuti vengono saltati, quindi si possono aggiungere
+// sezioni nuove senza rompere i loader esistenti.
+//   "FIDX"  tabella offset dei frame (FNVIndexEntry x frame_count)
+//   "PREV"  anteprima ridotta (FNVPreviewHeader + frame), subito dopo FIDX
+//   "FRAM"  un frame: FNVFrameInfo + 3 layer nel codec indicato
+//   "STRK"  log dei tratti dei layer che ne hanno uno (FNVStrokeEntry +
+//           strokes_serialize), dopo i FRAM di ogni lotto
+//   "AUDI"  trigger SE per frame + clip registrate
+//   "END "  fine file
+typedef struct {
+    char type[4];
+    uint32_t size;          // Byte di payload, header del chunk escluso
+} FNVChunk;
+
+typedef struct {
+    uint32_t offset;        // Posizione assoluta del chunk FRAM
+    uint32_t size;          // Dimensione del payload
+} FNVIndexEntry;
+
+typedef struct {
+    float frame_speed;
+    uint8_t is_keyframe;
+    uint8_t exposure;
+    uint8_t codec;          // FrameCodec
+    uint8_t flags;
+} FNVFrameInfo;
+
+typedef struct {
+    uint16_t frame;
+    uint8_t layer;
+    uint8_t reserved;
+    uint32_t size;          // Byte del log serializzato che segue
+} FNVStrokeEntry;
+
+#define FNV_FRAME_DELTA 0x01    // Layer in XOR con il frame precedente
+#define FNV_FRAME_REFS  0x02    // Dopo FNVFrameInfo: uint32 ref[MAX_LAYERS]
+#define FNV_FRAME_TILES 0x04    // Dopo FNVFrameInfo: tabella di hash dei tile
+
+// Layer ripetuti (duplicati, frame vuoti) vengono scritti una volta sola:
+// ref[l] = 1 + frame * MAX_LAYERS + layer del primo layer uguale, sempre
+// precedente e mai a sua volta un riferimento (0 = layer nel payload).
+// Nel payload i layer riferiti valgono zero, anche come base del delta
+// del frame successivo; se tutti i layer sono riferiti non c'e' payload.
+
+// Frame nell'archivio di tile (vedi tilestore.h): il payload e' la
+// tabella uint64 hash[MAX_LAYERS][TILES_PER_LAYER] compressa con deflate,
+// TILE_BLANK per i tile vuoti. Con FNV_FRAME_DELTA la tabella e' in XOR
+// con quella del frame precedente. Mai riferimenti: i tile uguali sono
+// gia' condivisi, anche tra file diversi.
+
+// Anteprima: i layer composti e ridotti di PREVIEW_SCALE, un nibble per
+// pixel (0 = sfondo, altrimenti 1 + layer * 3 + colore - 1), due pixel
+// per byte con quello a sinistra nei bit bassi. Fino a PREVIEW_MAX_FRAMES
+// frame presi a intervalli regolari; il primo fa da miniatura.
+#define PREVIEW_SCALE      8
+#define PREVIEW_WIDTH      (CANVAS_WIDTH / PREVIEW_SCALE)
+#define PREVIEW_HEIGHT     (CANVAS_HEIGHT / PREVIEW_SCALE)
+#define PREVIEW_FRAME_SIZE (PREVIEW_WIDTH * PREVIEW_HEIGHT / 2)
+#define PREVIEW_MAX_FRAMES 16
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint16_t frame_count;
+    uint16_t interval_ms;   // Durata di ogni frame dell'anteprima
+} FNVPreviewHeader;
+
+typedef struct {
+    FNVPreviewHeader header;
+    uint8_t *pixels;        // frame_count * PREVIEW_FRAME_SIZE
+} FNVPreview;
+
+// Journal dell'autosave (_autosave.fnj): modifiche accodate all'ultimo
+// checkpoint (_autosave.fnv). Stessi chunk del .fnv:
+//   "JFRM"  uint32 indice + payload come FRAM (mai delta, riferimenti o tile)
+//   "JCMT"  FNVJournalCommit, chiude un gruppo di JFRM
+// Al caricamento si applicano solo i gruppi chiusi da un JCMT, ognuno
+// per intero o per niente.
+#define FNV_JOURNAL_VERSION 1
+
+typedef struct {
+    char magic[4];          // "FNVJ"
+    uint32_t version;
+    uint64_t base_hash;     // animation_get_hash del checkpoint
+} FNVJournalHeader;
+
+typedef struct {
+    uint32_t frame_count;
+    float playback_speed;
+    uint8_t loop;
+    uint8_t reserved[3];
+    char title[64];
+    char author[64];
+} FNVJournalCommit;
+
+// Lettura di singoli frame senza caricare l'intera animazione (solo v2)
+typedef struct {
+    FileReader file;
+    FNVHeader header;
+    FNVIndexEntry *index;
+    uint8_t *buffer;        // Payload dell'ultimo frame letto
+    uint32_t buffer_size;
+    CodecContext codec;
+    LayerData *last;        // Ultimo frame ricostruito (base per i delta)
+    int last_frame;
+    Frame *source;          // Sorgente dei layer riferiti
+    TileReader *tiles;      // Creato al primo frame FNV_FRAME_TILES
+} FNVReader;
+
+typedef enum {
+    SAVE_IDLE,
+    SAVE_RUNNING,
+    SAVE_DONE,
+    SAVE_FAILED
+} SaveStatus;
+
+typedef enum {
+    LOAD_IDLE,
+    LOAD_RUNNING,
+    LOAD_DONE,
+    LOAD_FAILED,
+    LOAD_CANCELLED
+} LoadStatus;
+
+// Avanzamento del caricamento (frame letti su totale), chiamata dal
+// thread che carica: false annulla
+typedef bool (*LoadProgressFunc)(int done, int total, void *user);
+
 void filemanager_init(void);
 
 // Salvataggio/Caricamento
 bool filemanager_save(AnimationContext *anim, AudioContext *audio, const char *filename);
+// Il file viene letto a parte: anim e audio cambiano solo se va a buon fine
 bool filemanager_load(AnimationContext *anim, AudioContext *audio, DrawingContext *draw, const char *filename);
+bool filemanager_load_ex(AnimationContext *anim, AudioContext *audio, DrawingContext *draw,
+                         const char *filename, LoadProgressFunc progress, void *user);
 bool filemanager_delete(const char *filename);
+void filemanager_set_codec(FrameCodec codec, int level);
+void filemanager_set_key_interval(int interval);
+void filemanager_set_encode_threads(int count);     // 1 = in serie
+
+// Archivio di tile condiviso (SAVE_DIR "tiles/"): i nuovi salvataggi
+// scrivono solo i tile che l'archivio non ha. Eliminare un file libera
+// i suoi tile; il collector riscrive l'archivio quando lo spazio libero
+// supera TILE_GC_THRESHOLD.
+#define TILE_GC_THRESHOLD (512 * 1024)
+void filemanager_set_tile_store(bool enabled);
+bool filemanager_get_tile_store(void);
+bool filemanager_collect_tiles(bool force);     // false = saltato o fallito
+
+// Salvataggio su thread separato da uno snapshot copy-on-write.
+// Un salvataggio alla volta: poll (dal thread principale) ritorna
+// DONE/FAILED una sola volta, poi IDLE.
+bool filemanager_save_async(AnimationContext *anim, AudioContext *audio,
+                            const char *filename, bool autosave);
+SaveStatus filemanager_poll_save(bool *autosave);
+bool filemanager_save_busy(void);
+void filemanager_wait_save(void);
+
+// Caricamento su thread separato, un file alla volta. poll (dal thread
+// principale) sostituisce anim e audio quando e' terminato con successo
+// e ritorna DONE/FAILED/CANCELLED una sola volta, poi IDLE.
+bool filemanager_load_async(AudioContext *audio, const char *filename);
+LoadStatus filemanager_poll_load(AnimationContext *anim, AudioContext *audio, DrawingContext *draw);
+bool filemanager_load_busy(void);
+void filemanager_load_progress(int *done, int *total);
+void filemanager_cancel_load(void);
+void filemanager_wait_load(void);
+
+// Accesso casuale ai frame di un file v2
+bool filemanager_reader_open(FNVReader *reader, const char *filename);
+bool filemanager_reader_read_frame(FNVReader *reader, int frame, Frame *out);
+void filemanager_reader_close(FNVReader *reader);
+
+// Legge solo il chunk PREV (false per file v1 o senza anteprima)
+bool filemanager_read_preview(const char *filename, FNVPreview *preview);
+void filemanager_free_preview(FNVPreview *preview);
+// Colore (0 = sfondo) e layer di un pixel dell'anteprima
+uint8_t filemanager_preview_pixel(const FNVPreview *preview, int frame, int x, int y, int *layer);
 
-// Lista file
+// Lista file (indice in memoria, vedi filemanager_refresh_saves)
+void filemanager_refresh_saves(void);
+const SaveSlotInfo *filemanager_get_saves(int *count);
 int filemanager_list_saves(SaveSlotInfo *slots, int max_slots);
 bool filemanager_exists(const char *filename);
 
 // Auto-save
 void filemanager_autosave(AnimationContext *anim, AudioContext *audio);
+bool filemanager_autosave_async(AnimationContext *anim, AudioContext *audio);
+// Accoda al journal i frame cambiati; passa a un checkpoint completo
+// se il journal e' troppo grande o e' cambiato l'audio. In entrambi i
+// casi i frame si codificano in background e l'esito arriva da
+// filemanager_poll_save (autosave = true).
+// false = nulla avviato (salvataggio in corso o errore)
+bool filemanager_autosave_journal(AnimationContext *anim, AudioContext *audio);
+// false anche con un gruppo del journal illeggibile: l'animazione resta
+// caricata, ferma all'ultimo gruppo applicato per intero
 bool filemanager_load_autosave(AnimationContext *anim, AudioContext *audio, DrawingContext *draw);
 
-// Export
+// Export. I PNG sono a tavolozza con livello zlib png_level (0..9,
+// default PNG_DEFAULT_LEVEL); la sequenza usa i thread di codifica.
+void filemanager_set_png_level(int level);
 bool filemanager_export_gif(AnimationContext *anim, const char *filename);
+bool filemanager_export_apng(AnimationContext *anim, const char *filename);
 bool filemanager_export_png_sequence(AnimationContext *anim, const char *dirname);
 bool filemanager_export_frame_png(AnimationContext *anim, int frame, const char *filename);
+// Video MJPEG con la traccia dei suoni (vedi soundtrack.h)
+bool filemanager_export_avi(AnimationContext *anim, AudioContext *audio, const char *filename);
+bool filemanager_export_wav(AnimationContext *anim, AudioContext *audio, const char *filename);
+// Atlanti PNG dei frame ritagliati (atlas_N.png) e sheet.json in dirname
+bool filemanager_export_sprite_sheet(AnimationContext *anim, const char *dirname);
 
 // Genera nome file
 void filemanager_generate_filename(char *buffer, int buffer_size);
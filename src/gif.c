@@ -0,0 +1,171 @@
+#include "gif.h"
+#include <string.h>
+
+#define GIF_MAX_CODE 4096
+
+static void put_u16(uint8_t *p, int v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)((v >> 8) & 0xFF);
+}
+
+bool gif_begin(FileWriter *w, GifEncoder *enc, int width, int height,
+               const unsigned int *palette, int colors, bool loop)
+{
+    static const uint8_t netscape[19] = {
+        0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+        0x03, 0x01, 0x00, 0x00, 0x00
+    };
+    uint8_t screen[13];
+    uint8_t rgb[GIF_MAX_COLORS * 3];
+    int bits, i;
+
+    // La tavolozza ha 2^bits voci, almeno 4 (codici LZW da 2 bit)
+    for (bits = 2; (1 << bits) < colors && bits < 8; bits++);
+    memset(enc, 0, sizeof(GifEncoder));
+    enc->min_code_size = bits;
+
+    memcpy(screen, "GIF89a", 6);
+    put_u16(screen + 6, width);
+    put_u16(screen + 8, height);
+    screen[10] = (uint8_t)(0x80 | ((bits - 1) << 4) | (bits - 1));
+    screen[11] = 0;             // Sfondo
+    screen[12] = 0;
+    fileio_write(w, screen, sizeof(screen));
+
+    memset(rgb, 0, sizeof(rgb));
+    for (i = 0; i < colors && i < (1 << bits); i++) {
+        rgb[i * 3 + 0] = palette[i] & 0xFF;
+        rgb[i * 3 + 1] = (palette[i] >> 8) & 0xFF;
+        rgb[i * 3 + 2] = (palette[i] >> 16) & 0xFF;
+    }
+    fileio_write(w, rgb, (1 << bits) * 3);
+
+    // Senza NETSCAPE2.0 l'animazione si ferma all'ultimo frame
+    if (loop) fileio_write(w, netscape, sizeof(netscape));
+    return !w->error;
+}
+
+/* ========== LZW ========== */
+static void lzw_flush_block(FileWriter *w, GifEncoder *enc) {
+    if (enc->block_used == 0) return;
+    fileio_put(w, (uint8_t)enc->block_used);
+    fileio_write(w, enc->block, enc->block_used);
+    enc->block_used = 0;
+}
+
+// Codici LSB-first, impacchettati in sotto-blocchi da 255 byte
+static void lzw_put(FileWriter *w, GifEncoder *enc, int code, int size) {
+    enc->bits |= (uint32_t)code << enc->bit_count;
+    enc->bit_count += size;
+    while (enc->bit_count >= 8) {
+        enc->block[enc->block_used++] = (uint8_t)(enc->bits & 0xFF);
+        enc->bits >>= 8;
+        enc->bit_count -= 8;
+        if (enc->block_used == 255) lzw_flush_block(w, enc);
+    }
+}
+
+// Il dizionario riparte da capo (dopo ogni codice di clear)
+static void lzw_reset(GifEncoder *enc) {
+    memset(enc->keys, 0, sizeof(enc->keys));
+}
+
+// Stringa prefisso + indice: codice del dizionario o -1, *slot = posizione
+static int lzw_find(const GifEncoder *enc, int prefix, uint8_t index, int *slot) {
+    int32_t key = ((prefix << 8) | index) + 1;
+    int h = ((index << 12) ^ prefix) % GIF_LZW_HASH;
+
+    while (enc->keys[h] != 0) {
+        if (enc->keys[h] == key) return enc->codes[h];
+        h = h + 1 < GIF_LZW_HASH ? h + 1 : 0;
+    }
+    *slot = h;
+    return -1;
+}
+
+static void lzw_encode(FileWriter *w, GifEncoder *enc, const uint8_t *pixels, int stride,
+                       int width, int height)
+{
+    int clear, eoi, next, size, prefix, code, slot, x, y;
+    uint8_t index;
+
+    clear = 1 << enc->min_code_size;
+    eoi = clear + 1;
+    next = clear + 2;
+    size = enc->min_code_size + 1;
+    enc->bits = 0;
+    enc->bit_count = 0;
+    enc->block_used = 0;
+
+    lzw_reset(enc);
+    lzw_put(w, enc, clear, size);
+
+    prefix = pixels[0];
+    for (y = 0; y < height; y++) {
+        for (x = (y == 0) ? 1 : 0; x < width; x++) {
+            index = pixels[y * stride + x];
+            code = lzw_find(enc, prefix, index, &slot);
+            if (code >= 0) {
+                prefix = code;
+                continue;
+            }
+
+            lzw_put(w, enc, prefix, size);
+            if (next < GIF_MAX_CODE) {
+                enc->keys[slot] = ((prefix << 8) | index) + 1;
+                enc->codes[slot] = (uint16_t)next++;
+                // Il decoder aggiunge la stessa voce un codice dopo:
+                // si allarga quando lui arriva a 2^size
+                if (next > (1 << size) && size < 12) size++;
+            } else {
+                lzw_put(w, enc, clear, size);
+                lzw_reset(enc);
+                next = clear + 2;
+                size = enc->min_code_size + 1;
+            }
+            prefix = index;
+        }
+    }
+
+    lzw_put(w, enc, prefix, size);
+    lzw_put(w, enc, eoi, size);
+    if (enc->bit_count > 0) lzw_put(w, enc, 0, 8 - enc->bit_count);
+    lzw_flush_block(w, enc);
+    fileio_put(w, 0);           // Fine dei sotto-blocchi
+}
+
+bool gif_add_image(FileWriter *w, GifEncoder *enc, const uint8_t *pixels, int stride,
+                   int x, int y, int width, int height, int delay, int transparent)
+{
+    uint8_t gce[8];
+    uint8_t desc[10];
+
+    if (width <= 0 || height <= 0) return false;
+    if (delay > 0xFFFF) delay = 0xFFFF;
+
+    // Disposal 1: l'immagine resta e la successiva si disegna sopra
+    gce[0] = 0x21;
+    gce[1] = 0xF9;
+    gce[2] = 4;
+    gce[3] = (uint8_t)((1 << 2) | (transparent >= 0 ? 1 : 0));
+    put_u16(gce + 4, delay);
+    gce[6] = (uint8_t)(transparent >= 0 ? transparent : 0);
+    gce[7] = 0;
+    fileio_write(w, gce, sizeof(gce));
+
+    desc[0] = 0x2C;
+    put_u16(desc + 1, x);
+    put_u16(desc + 3, y);
+    put_u16(desc + 5, width);
+    put_u16(desc + 7, height);
+    desc[9] = 0;
+    fileio_write(w, desc, sizeof(desc));
+
+    fileio_put(w, (uint8_t)enc->min_code_size);
+    lzw_encode(w, enc, pixels + y * stride + x, stride, width, height);
+    return !w->error;
+}
+
+bool gif_end(FileWriter *w) {
+    return fileio_put(w, 0x3B);
+}
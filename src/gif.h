@@ -0,0 +1,38 @@
+#ifndef GIF_H
+#define GIF_H
+
+#include "fileio.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Scrittura di GIF89a animate con tavolozza globale fissa. Le immagini
+// sono rettangoli della tela (x, y, larghezza, altezza) letti da un
+// buffer di indici con passo stride; i dati passano da LZW a larghezza
+// variabile (3..12 bit) e vengono scritti in sotto-blocchi da 255 byte.
+#define GIF_MAX_COLORS 256
+#define GIF_NO_TRANSPARENCY -1
+#define GIF_LZW_HASH 5003           // Primo, > 4096 codici
+
+typedef struct {
+    int min_code_size;              // Bit per indice (2..8)
+    int32_t keys[GIF_LZW_HASH];     // (prefisso << 8 | indice) + 1, 0 = libero
+    uint16_t codes[GIF_LZW_HASH];
+    uint8_t block[256];             // Sotto-blocco in costruzione
+    int block_used;
+    uint32_t bits;                  // Accumulatore LSB-first
+    int bit_count;
+} GifEncoder;
+
+// colors: numero di voci della tavolozza, arrotondato alla potenza di 2
+// successiva; palette in formato RGBA8 (il canale alfa e' ignorato)
+bool gif_begin(FileWriter *w, GifEncoder *enc, int width, int height,
+               const unsigned int *palette, int colors, bool loop);
+
+// Immagine che resta sulla tela per delay centesimi di secondo; i pixel
+// di valore transparent lasciano vedere quelle precedenti
+bool gif_add_image(FileWriter *w, GifEncoder *enc, const uint8_t *pixels, int stride,
+                   int x, int y, int width, int height, int delay, int transparent);
+
+bool gif_end(FileWriter *w);
+
+#endif
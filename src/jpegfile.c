@@ -0,0 +1,125 @@
+#include "jpegfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+
+#define JPEG_CHUNK (16 * 1024)
+
+typedef struct {
+    struct jpeg_destination_mgr pub;
+    JpegBuffer *buffer;
+} JpegDest;
+
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} JpegError;
+
+void jpegfile_buffer_init(JpegBuffer *b) {
+    memset(b, 0, sizeof(JpegBuffer));
+}
+
+void jpegfile_buffer_free(JpegBuffer *b) {
+    free(b->data);
+    memset(b, 0, sizeof(JpegBuffer));
+}
+
+// libjpeg scrive direttamente nel buffer; quando e' pieno lo si allarga
+static bool buffer_grow(JpegBuffer *b, uint32_t need) {
+    uint8_t *grown;
+
+    if (need <= b->capacity) return true;
+    if (need < b->capacity * 2) need = b->capacity * 2;
+    if (need < JPEG_CHUNK) need = JPEG_CHUNK;
+    grown = (uint8_t *)realloc(b->data, need);
+    if (!grown) return false;
+    b->data = grown;
+    b->capacity = need;
+    return true;
+}
+
+static void dest_init(j_compress_ptr cinfo) {
+    JpegDest *dest = (JpegDest *)cinfo->dest;
+
+    dest->pub.next_output_byte = dest->buffer->data;
+    dest->pub.free_in_buffer = dest->buffer->capacity;
+}
+
+// Chiamata a buffer pieno: tutto il contenuto e' valido
+static boolean dest_empty(j_compress_ptr cinfo) {
+    JpegDest *dest = (JpegDest *)cinfo->dest;
+    JpegBuffer *b = dest->buffer;
+    uint32_t used = b->capacity;
+
+    if (!buffer_grow(b, used + 1)) {
+        b->error = true;
+        cinfo->err->error_exit((j_common_ptr)cinfo);
+    }
+    dest->pub.next_output_byte = b->data + used;
+    dest->pub.free_in_buffer = b->capacity - used;
+    return TRUE;
+}
+
+static void dest_term(j_compress_ptr cinfo) {
+    JpegDest *dest = (JpegDest *)cinfo->dest;
+
+    dest->buffer->size = dest->buffer->capacity - (uint32_t)dest->pub.free_in_buffer;
+}
+
+// Al posto di exit(): si torna in jpegfile_encode
+static void error_exit(j_common_ptr cinfo) {
+    JpegError *err = (JpegError *)cinfo->err;
+    longjmp(err->jump, 1);
+}
+
+static void output_message(j_common_ptr cinfo) {
+    (void)cinfo;
+}
+
+bool jpegfile_encode(JpegBuffer *out, const uint8_t *rgb, int width, int height, int quality) {
+    struct jpeg_compress_struct cinfo;
+    JpegError err;
+    JpegDest dest;
+    JSAMPROW row;
+
+    out->size = 0;
+    out->error = false;
+    if (!buffer_grow(out, JPEG_CHUNK)) return false;
+
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = error_exit;
+    err.pub.output_message = output_message;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        out->size = 0;
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+
+    memset(&dest, 0, sizeof(dest));
+    dest.pub.init_destination = dest_init;
+    dest.pub.empty_output_buffer = dest_empty;
+    dest.pub.term_destination = dest_term;
+    dest.buffer = out;
+    cinfo.dest = &dest.pub;
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.comp_info[0].h_samp_factor = 1;
+    cinfo.comp_info[0].v_samp_factor = 1;
+
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        row = (JSAMPROW)(rgb + cinfo.next_scanline * width * 3);
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return !out->error;
+}
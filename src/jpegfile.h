@@ -0,0 +1,25 @@
+#ifndef JPEGFILE_H
+#define JPEGFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// JPEG RGB a 24 bit scritti con libjpeg in memoria. Crominanza piena
+// (4:4:4): con il 4:2:0 le linee sottili colorate sbavano.
+#define JPEG_DEFAULT_QUALITY 90
+
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t capacity;
+    bool error;
+} JpegBuffer;
+
+void jpegfile_buffer_init(JpegBuffer *b);
+void jpegfile_buffer_free(JpegBuffer *b);
+
+// rgb: 3 byte per pixel, righe consecutive. Il buffer viene svuotato e
+// riempito con il file completo.
+bool jpegfile_encode(JpegBuffer *out, const uint8_t *rgb, int width, int height, int quality);
+
+#endif
@@ -29,6 +29,65 @@ static UIContext g_ui;
 static SceUInt64 prev_time;
 static float delta_time;
 
+// Fingerprint dell'ultimo autosave
+static uint64_t last_autosave_hash;
+static int has_autosave_hash;
+
+static uint64_t app_content_hash(void) {
+    return animation_get_hash(&g_anim) ^ audio_get_hash(&g_audio);
+}
+
+static void app_autosave(void) {
+    uint64_t h;
+
+    animation_save_current_to_draw(&g_anim, &g_draw);
+    h = app_content_hash();
+    if (has_autosave_hash && h == last_autosave_hash) return; // Nulla di nuovo
+
+    // Journal incrementale o checkpoint in background; se fallisce si
+    // riprova al giro dopo
+    if (!filemanager_autosave_journal(&g_anim, &g_audio)) return;
+    last_autosave_hash = h;
+    has_autosave_hash = 1;
+}
+
+// Raccoglie l'esito del salvataggio in background, se terminato
+static void app_poll_save(void) {
+    bool autosave = false;
+
+    switch (filemanager_poll_save(&autosave)) {
+        case SAVE_DONE:
+            if (!autosave) ui_show_toast(&g_ui, "Salvato con successo!", 2.0f);
+            break;
+        case SAVE_FAILED:
+            if (autosave) has_autosave_hash = 0;
+            ui_show_toast(&g_ui, autosave ? "Errore nell'autosalvataggio!"
+                                          : "Errore nel salvataggio!", 2.0f);
+            break;
+        default:
+            break;
+    }
+}
+
+// Il caricamento in background sostituisce l'animazione solo se riuscito
+static void app_poll_load(void) {
+    switch (filemanager_poll_load(&g_anim, &g_audio, &g_draw)) {
+        case LOAD_DONE:
+            g_ui.timeline_scroll = 0;
+            ui_goto_screen(&g_ui, SCREEN_EDITOR);
+            ui_show_toast(&g_ui, "Flipnote caricato", 2.0f);
+            break;
+        case LOAD_FAILED:
+            ui_show_toast(&g_ui, "Errore nel caricamento!", 2.0f);
+            break;
+        case LOAD_CANCELLED:
+            ui_show_toast(&g_ui, "Caricamento annullato", 2.0f);
+            break;
+        default:
+            break;
+    }
+}
+
 static void app_init(void) {
     // Abilita max CPU/GPU
     scePowerSetArmClockFrequency(444);
@@ -91,6 +150,10 @@ static void app_render(void) {
             ui_render_playback(&g_ui, &g_draw, &g_anim, &g_audio, &g_input);
             break;
             
+        case SCREEN_STREAM_PLAYER:
+            ui_render_stream_player(&g_ui, &g_input);
+            break;
+            
         case SCREEN_FILE_BROWSER:
             ui_render_file_browser(&g_ui, &g_input);
             break;
@@ -160,26 +223,39 @@ static void app_update(void) {
     
     // Aggiorna logica UI
     ui_update(&g_ui, &g_draw, &g_anim, &g_audio, &g_input, delta_time);
+    app_poll_save();
+    app_poll_load();
     
-    // Autosave periodico (ogni 5 minuti circa)
+    // Autosave periodico: il journal scrive solo i frame modificati
     static float autosave_timer = 0;
     autosave_timer += delta_time;
-    if (autosave_timer > 300.0f) { // 5 minuti
+    if (autosave_timer > 10.0f) { // 10 secondi
         autosave_timer = 0;
         if (g_ui.current_screen == SCREEN_EDITOR) {
-            animation_save_current_to_draw(&g_anim, &g_draw);
-            filemanager_autosave(&g_anim, &g_audio);
+            app_autosave();
         }
     }
 }
 
 static void app_cleanup(void) {
-    // Autosave finale
-    animation_save_current_to_draw(&g_anim, &g_draw);
-    filemanager_autosave(&g_anim, &g_audio);
+    // Un caricamento in corso si scarta
+    filemanager_cancel_load();
+    filemanager_wait_load();
+    app_poll_load();
+
+    // Autosave finale: si attende un salvataggio in corso e quello nuovo
+    filemanager_wait_save();
+    app_poll_save();
+    app_autosave();
+    filemanager_wait_save();
+    app_poll_save();
+    
+    if (g_ui.current_screen == SCREEN_STREAM_PLAYER)
+        player_close(&g_ui.player);
     
     audio_free(&g_audio);
     animation_free(&g_anim);
+    drawing_free(&g_draw);
     vita2d_fini();
 }
 
@@ -0,0 +1,145 @@
+#include "player.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Gira sul thread del player: tocca solo il reader e lo slot indicato
+static void player_decode_job(void *arg) {
+    StreamPlayer *p = (StreamPlayer *)arg;
+    p->job_ok = filemanager_reader_read_frame(&p->reader, p->job_seq % p->frame_count,
+                                              &p->slots[p->job_seq % PLAYER_WINDOW]);
+}
+
+// Raccoglie il frame decodificato, se il lavoro e' terminato
+static void player_collect(StreamPlayer *p) {
+    if (!p->job_pending) return;
+    if (p->worker_ready && worker_busy(&p->worker)) return;
+
+    p->job_pending = false;
+    if (p->job_ok) {
+        p->decoded++;
+    } else {
+        p->failed = true;
+        p->is_playing = false;
+    }
+}
+
+// Chiede il frame successivo finche' la finestra non e' piena
+static void player_fill(StreamPlayer *p) {
+    if (p->job_pending || p->failed) return;
+    if (p->decoded - p->shown >= PLAYER_WINDOW) return;
+    if (!p->loop && p->decoded >= p->frame_count) return;
+
+    p->job_seq = p->decoded;
+    p->job_pending = true;
+    if (!p->worker_ready || !worker_submit(&p->worker, player_decode_job, p))
+        player_decode_job(p);
+}
+
+bool player_open(StreamPlayer *p, const char *filename) {
+    memset(p, 0, sizeof(StreamPlayer));
+
+    if (!filemanager_reader_open(&p->reader, filename)) return false;
+
+    p->slots = (Frame *)malloc(sizeof(Frame) * PLAYER_WINDOW);
+    if (!p->slots) {
+        filemanager_reader_close(&p->reader);
+        return false;
+    }
+
+    p->frame_count = (int)p->reader.header.frame_count;
+    p->playback_speed = p->reader.header.playback_speed;
+    if (p->playback_speed < MIN_SPEED) p->playback_speed = DEFAULT_SPEED;
+    p->loop = p->reader.header.loop;
+    p->is_playing = true;
+
+    // Senza thread si decodifica in player_update
+    p->worker_ready = worker_start(&p->worker, "fnv_player", WORKER_PRIORITY_LOW);
+    player_fill(p);
+    return true;
+}
+
+void player_close(StreamPlayer *p) {
+    if (p->worker_ready) worker_stop(&p->worker);
+    filemanager_reader_close(&p->reader);
+    free(p->slots);
+    p->slots = NULL;
+    p->worker_ready = false;
+    p->job_pending = false;
+}
+
+void player_update(StreamPlayer *p, float delta_time) {
+    const Frame *cur;
+    float speed, frame_duration;
+    int exposure;
+
+    player_collect(p);
+
+    if (p->is_playing && p->decoded > p->shown) {
+        cur = &p->slots[p->shown % PLAYER_WINDOW];
+        speed = cur->frame_speed > 0 ? cur->frame_speed : p->playback_speed;
+        exposure = cur->exposure < 1 ? 1 : cur->exposure;
+        frame_duration = 1.0f / speed;
+        p->frame_timer += delta_time;
+
+        // Stesse regole di animation_update: un tick per frame_duration,
+        // exposure tick sullo stesso frame
+        if (p->frame_timer >= frame_duration) {
+            p->frame_timer -= frame_duration;
+            p->hold_ticks++;
+            if (p->hold_ticks >= exposure) {
+                if (!p->loop && p->shown + 1 >= p->frame_count) {
+                    p->is_playing = false;
+                    p->hold_ticks = 0;
+                } else if (p->decoded > p->shown + 1) {
+                    p->shown++;
+                    p->hold_ticks = 0;
+                } else {
+                    // Frame successivo non ancora pronto: si riprova al
+                    // prossimo update, senza accumulare ritardo
+                    p->hold_ticks--;
+                    p->frame_timer = frame_duration;
+                }
+            }
+        }
+    }
+
+    player_fill(p);
+}
+
+const Frame *player_get_frame(const StreamPlayer *p) {
+    if (!p->slots || p->decoded <= p->shown) return NULL;
+    return &p->slots[p->shown % PLAYER_WINDOW];
+}
+
+int player_get_frame_index(const StreamPlayer *p) {
+    return p->frame_count > 0 ? p->shown % p->frame_count : 0;
+}
+
+bool player_is_buffering(const StreamPlayer *p) {
+    return !p->failed && p->decoded <= p->shown;
+}
+
+void player_toggle_play(StreamPlayer *p) {
+    if (p->failed) return;
+    // A fine animazione senza loop si riparte dall'inizio
+    if (!p->is_playing && !p->loop && p->shown + 1 >= p->frame_count) {
+        player_restart(p);
+        return;
+    }
+    p->is_playing = !p->is_playing;
+}
+
+void player_restart(StreamPlayer *p) {
+    if (p->failed) return;
+
+    // La finestra va scartata: si attende il lavoro in corso
+    if (p->worker_ready) worker_wait(&p->worker);
+    p->job_pending = false;
+
+    p->shown = 0;
+    p->decoded = 0;
+    p->frame_timer = 0;
+    p->hold_ticks = 0;
+    p->is_playing = true;
+    player_fill(p);
+}
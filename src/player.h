@@ -0,0 +1,48 @@
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include "filemanager.h"
+#include "worker.h"
+#include <stdbool.h>
+
+#define PLAYER_WINDOW 4     // Frame in memoria, compreso quello mostrato
+
+// Riproduzione in streaming di un .fnv v2 senza caricare l'animazione:
+// un thread legge e decodifica i frame successivi in un anello di
+// PLAYER_WINDOW frame, il thread principale mostra solo quelli pronti.
+typedef struct {
+    FNVReader reader;
+    Frame *slots;           // Anello: il frame di sequenza s sta in s % PLAYER_WINDOW
+    Worker worker;
+    bool worker_ready;
+
+    // Sequenze progressive (col loop continuano a crescere):
+    // frame = sequenza % frame_count, pronti = [shown, decoded)
+    int shown;
+    int decoded;
+    int job_seq;
+    bool job_pending;
+    bool job_ok;
+    bool failed;            // Errore di lettura: la riproduzione si ferma
+
+    int frame_count;
+    float playback_speed;
+    bool loop;
+    bool is_playing;
+    float frame_timer;
+    int hold_ticks;
+} StreamPlayer;
+
+bool player_open(StreamPlayer *p, const char *filename);
+void player_close(StreamPlayer *p);
+void player_update(StreamPlayer *p, float delta_time);
+
+// NULL finche' il primo frame non e' pronto
+const Frame *player_get_frame(const StreamPlayer *p);
+int player_get_frame_index(const StreamPlayer *p);
+bool player_is_buffering(const StreamPlayer *p);
+
+void player_toggle_play(StreamPlayer *p);
+void player_restart(StreamPlayer *p);
+
+#endif
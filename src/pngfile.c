@@ -0,0 +1,127 @@
+#include "pngfile.h"
+#include "fileio.h"
+#include <png.h>
+#include <stdlib.h>
+#include <string.h>
+
+void pngfile_buffer_init(PngBuffer *b) {
+    memset(b, 0, sizeof(PngBuffer));
+}
+
+void pngfile_buffer_free(PngBuffer *b) {
+    free(b->data);
+    memset(b, 0, sizeof(PngBuffer));
+}
+
+static void buffer_write(png_structp png, png_bytep data, png_size_t size) {
+    PngBuffer *b = (PngBuffer *)png_get_io_ptr(png);
+    uint8_t *grown;
+    uint32_t need;
+
+    if (b->error) return;
+    need = b->size + (uint32_t)size;
+    if (need > b->capacity) {
+        if (need < b->capacity * 2) need = b->capacity * 2;
+        if (need < 16 * 1024) need = 16 * 1024;
+        grown = (uint8_t *)realloc(b->data, need);
+        if (!grown) {
+            b->error = true;
+            return;
+        }
+        b->data = grown;
+        b->capacity = need;
+    }
+    memcpy(b->data + b->size, data, size);
+    b->size += (uint32_t)size;
+}
+
+static void buffer_flush(png_structp png) {
+    (void)png;
+}
+
+// Riga di indici impacchettata a bits per pixel, il primo nei bit alti
+static void pack_row(const uint8_t *in, uint8_t *out, int width, int bits) {
+    int x, per_byte, shift;
+
+    if (bits == 8) {
+        memcpy(out, in, width);
+        return;
+    }
+    per_byte = 8 / bits;
+    memset(out, 0, (width + per_byte - 1) / per_byte);
+    for (x = 0; x < width; x++) {
+        shift = 8 - bits * (x % per_byte + 1);
+        out[x / per_byte] |= (uint8_t)(in[x] << shift);
+    }
+}
+
+bool pngfile_encode(PngBuffer *out, const uint8_t *pixels, int width, int height, int stride,
+                    const unsigned int *palette, int colors, int level)
+{
+    png_structp png;
+    png_infop info;
+    png_color pal[256];
+    png_byte alpha[256];
+    uint8_t *volatile row = NULL;
+    int bits, i, y, transparent;
+
+    if (colors < 1 || colors > 256) return false;
+    for (bits = 1; (1 << bits) < colors; bits *= 2);
+
+    png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png) return false;
+    info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_write_struct(&png, NULL);
+        return false;
+    }
+
+    // Gli errori di libpng tornano qui con longjmp
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        free(row);
+        return false;
+    }
+
+    out->size = 0;
+    out->error = false;
+    png_set_write_fn(png, out, buffer_write, buffer_flush);
+    png_set_compression_level(png, level);
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);    // Consigliato per le tavolozze
+
+    png_set_IHDR(png, info, width, height, bits, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+
+    transparent = 0;
+    for (i = 0; i < colors; i++) {
+        pal[i].red = palette[i] & 0xFF;
+        pal[i].green = (palette[i] >> 8) & 0xFF;
+        pal[i].blue = (palette[i] >> 16) & 0xFF;
+        alpha[i] = (palette[i] >> 24) & 0xFF;
+        if (alpha[i] != 0xFF) transparent = i + 1;
+    }
+    png_set_PLTE(png, info, pal, colors);
+    if (transparent > 0) png_set_tRNS(png, info, alpha, transparent, NULL);
+
+    row = (uint8_t *)malloc(width);
+    if (!row) png_error(png, "memoria");
+
+    png_write_info(png, info);
+    for (y = 0; y < height; y++) {
+        pack_row(pixels + y * stride, row, width, bits);
+        png_write_row(png, row);
+    }
+    png_write_end(png, info);
+
+    png_destroy_write_struct(&png, &info);
+    free(row);
+    return !out->error;
+}
+
+bool pngfile_save(const PngBuffer *b, const char *filename) {
+    FileWriter w;
+
+    if (!fileio_open_write(&w, filename)) return false;
+    fileio_write(&w, b->data, b->size);
+    return fileio_close_write(&w);
+}
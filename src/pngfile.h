@@ -0,0 +1,29 @@
+#ifndef PNGFILE_H
+#define PNGFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// PNG a tavolozza scritti con libpng in memoria. La profondita' (1, 2,
+// 4 o 8 bit) e' la minima che contiene i colori; le voci con alfa < 255
+// finiscono nel chunk tRNS.
+#define PNG_DEFAULT_LEVEL 6
+
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t capacity;
+    bool error;
+} PngBuffer;
+
+void pngfile_buffer_init(PngBuffer *b);
+void pngfile_buffer_free(PngBuffer *b);
+
+// pixels: un indice per byte, passo stride; palette in formato RGBA8.
+// Il buffer viene svuotato e riempito con il file completo.
+bool pngfile_encode(PngBuffer *out, const uint8_t *pixels, int width, int height, int stride,
+                    const unsigned int *palette, int colors, int level);
+
+bool pngfile_save(const PngBuffer *b, const char *filename);
+
+#endif
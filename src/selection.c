@@ -0,0 +1,211 @@
+#include "selection.h"
+#include <stdlib.h>
+#include <string.h>
+
+void selection_clear(SelectionMask *m) {
+    memset(m->bits, 0, sizeof(m->bits));
+}
+
+void selection_copy(SelectionMask *dst, const SelectionMask *src) {
+    memcpy(dst->bits, src->bits, sizeof(dst->bits));
+}
+
+void selection_combine(SelectionMask *dst, const SelectionMask *src, SelectionOp op) {
+    int i;
+    switch (op) {
+        case SEL_REPLACE:
+            selection_copy(dst, src);
+            break;
+        case SEL_UNION:
+            for (i = 0; i < SEL_WORDS; i++) dst->bits[i] |= src->bits[i];
+            break;
+        case SEL_SUBTRACT:
+            for (i = 0; i < SEL_WORDS; i++) dst->bits[i] &= ~src->bits[i];
+            break;
+        case SEL_INTERSECT:
+            for (i = 0; i < SEL_WORDS; i++) dst->bits[i] &= src->bits[i];
+            break;
+    }
+}
+
+// Imposta i bit [x0, x1] della riga y, a parole intere dove possibile
+void selection_set_span(SelectionMask *m, int y, int x0, int x1) {
+    uint32_t *row;
+    int w0, w1, w;
+
+    if (y < 0 || y >= CANVAS_HEIGHT) return;
+    if (x0 < 0) x0 = 0;
+    if (x1 >= CANVAS_WIDTH) x1 = CANVAS_WIDTH - 1;
+    if (x0 > x1) return;
+
+    row = &m->bits[y * SEL_ROW_WORDS];
+    w0 = x0 >> 5;
+    w1 = x1 >> 5;
+
+    if (w0 == w1) {
+        row[w0] |= (0xFFFFFFFFu >> (31 - (x1 - x0))) << (x0 & 31);
+        return;
+    }
+
+    row[w0] |= 0xFFFFFFFFu << (x0 & 31);
+    for (w = w0 + 1; w < w1; w++) row[w] = 0xFFFFFFFFu;
+    row[w1] |= 0xFFFFFFFFu >> (31 - (x1 & 31));
+}
+
+int selection_test(const SelectionMask *m, int x, int y) {
+    if (x < 0 || x >= CANVAS_WIDTH || y < 0 || y >= CANVAS_HEIGHT) return 0;
+    return (m->bits[y * SEL_ROW_WORDS + (x >> 5)] >> (x & 31)) & 1;
+}
+
+int selection_is_empty(const SelectionMask *m) {
+    int i;
+    for (i = 0; i < SEL_WORDS; i++) {
+        if (m->bits[i]) return 0;
+    }
+    return 1;
+}
+
+int selection_bounds(const SelectionMask *m, int *x, int *y, int *w, int *h) {
+    int min_x = CANVAS_WIDTH, max_x = -1, min_y = -1, max_y = -1;
+    int row, i, bx;
+    uint32_t word;
+
+    for (row = 0; row < CANVAS_HEIGHT; row++) {
+        const uint32_t *r = &m->bits[row * SEL_ROW_WORDS];
+        for (i = 0; i < SEL_ROW_WORDS; i++) {
+            word = r[i];
+            if (!word) continue;
+            if (min_y < 0) min_y = row;
+            max_y = row;
+            bx = i * 32 + __builtin_ctz(word);
+            if (bx < min_x) min_x = bx;
+            bx = i * 32 + 31 - __builtin_clz(word);
+            if (bx > max_x) max_x = bx;
+        }
+    }
+
+    if (min_y < 0) {
+        *x = *y = *w = *h = 0;
+        return 0;
+    }
+    *x = min_x;
+    *y = min_y;
+    *w = max_x - min_x + 1;
+    *h = max_y - min_y + 1;
+    return 1;
+}
+
+void selection_rect(SelectionMask *m, int x, int y, int w, int h) {
+    int row;
+    selection_clear(m);
+    for (row = y; row < y + h; row++) {
+        selection_set_span(m, row, x, x + w - 1);
+    }
+}
+
+static int cmp_float(const void *a, const void *b) {
+    float fa = *(const float *)a, fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// Riempimento scanline pari/dispari, campionato al centro dei pixel
+void selection_lasso(SelectionMask *m, const int *xs, const int *ys, int n) {
+    float *cross;
+    int i, j, k, row, min_y, max_y, x0, x1;
+    float yc;
+
+    selection_clear(m);
+    if (n < 3) return;
+
+    cross = (float *)malloc(n * sizeof(float));
+    if (!cross) return;
+
+    min_y = max_y = ys[0];
+    for (i = 1; i < n; i++) {
+        if (ys[i] < min_y) min_y = ys[i];
+        if (ys[i] > max_y) max_y = ys[i];
+    }
+    if (min_y < 0) min_y = 0;
+    if (max_y >= CANVAS_HEIGHT) max_y = CANVAS_HEIGHT - 1;
+
+    for (row = min_y; row <= max_y; row++) {
+        yc = (float)row + 0.5f;
+        k = 0;
+        for (i = 0, j = n - 1; i < n; j = i++) {
+            if (((float)ys[i] <= yc) != ((float)ys[j] <= yc)) {
+                cross[k++] = (float)xs[i] + (yc - (float)ys[i]) *
+                             (float)(xs[j] - xs[i]) / (float)(ys[j] - ys[i]);
+            }
+        }
+        qsort(cross, k, sizeof(float), cmp_float);
+
+        for (i = 0; i + 1 < k; i += 2) {
+            x0 = (int)(cross[i] + 0.5f);
+            x1 = (int)(cross[i + 1] - 0.5f);
+            selection_set_span(m, row, x0, x1);
+        }
+    }
+
+    free(cross);
+}
+
+typedef struct {
+    int16_t x, y;
+} WandSeed;
+
+// Regione 4-connessa dello stesso colore, riempita per span orizzontali
+void selection_magic_wand(SelectionMask *m, const LayerData *layer, int x, int y) {
+    WandSeed *stack;
+    int top, max_stack, sx, sy, l, r, i, ny, d;
+    uint8_t target;
+    const uint8_t *row;
+
+    selection_clear(m);
+    if (x < 0 || x >= CANVAS_WIDTH || y < 0 || y >= CANVAS_HEIGHT) return;
+
+    target = layer->pixels[y * CANVAS_WIDTH + x];
+    max_stack = CANVAS_WIDTH * CANVAS_HEIGHT / 2;
+    stack = (WandSeed *)malloc(max_stack * sizeof(WandSeed));
+    if (!stack) return;
+
+    top = 0;
+    stack[top].x = (int16_t)x;
+    stack[top].y = (int16_t)y;
+    top++;
+
+    while (top > 0) {
+        top--;
+        sx = stack[top].x;
+        sy = stack[top].y;
+        if (selection_test(m, sx, sy)) continue;
+
+        row = &layer->pixels[sy * CANVAS_WIDTH];
+        l = sx;
+        r = sx;
+        while (l > 0 && row[l - 1] == target && !selection_test(m, l - 1, sy)) l--;
+        while (r < CANVAS_WIDTH - 1 && row[r + 1] == target && !selection_test(m, r + 1, sy)) r++;
+        selection_set_span(m, sy, l, r);
+
+        // Un seme per ogni run del colore target sopra e sotto lo span
+        for (d = -1; d <= 1; d += 2) {
+            ny = sy + d;
+            if (ny < 0 || ny >= CANVAS_HEIGHT) continue;
+            row = &layer->pixels[ny * CANVAS_WIDTH];
+            i = l;
+            while (i <= r) {
+                if (row[i] == target && !selection_test(m, i, ny)) {
+                    if (top < max_stack) {
+                        stack[top].x = (int16_t)i;
+                        stack[top].y = (int16_t)ny;
+                        top++;
+                    }
+                    while (i <= r && row[i] == target) i++;
+                } else {
+                    i++;
+                }
+            }
+        }
+    }
+
+    free(stack);
+}
@@ -0,0 +1,20 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "drawing.h"
+
+void selection_clear(SelectionMask *m);
+void selection_copy(SelectionMask *dst, const SelectionMask *src);
+void selection_combine(SelectionMask *dst, const SelectionMask *src, SelectionOp op);
+
+void selection_set_span(SelectionMask *m, int y, int x0, int x1);
+int selection_test(const SelectionMask *m, int x, int y);
+int selection_is_empty(const SelectionMask *m);
+int selection_bounds(const SelectionMask *m, int *x, int *y, int *w, int *h);
+
+// Generatori
+void selection_rect(SelectionMask *m, int x, int y, int w, int h);
+void selection_lasso(SelectionMask *m, const int *xs, const int *ys, int n);
+void selection_magic_wand(SelectionMask *m, const LayerData *layer, int x, int y);
+
+#endif
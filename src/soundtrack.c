@@ -0,0 +1,114 @@
+#include "soundtrack.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define SOUNDTRACK_BLOCK 1024
+#define VOLUME_SHIFT     12         // Volumi in 1/4096
+
+// Durata della clip in campioni dell'uscita
+static uint32_t clip_length(const SoundClip *clip) {
+    if (!clip->data || clip->sample_count <= 0) return 0;
+    if (clip->sample_rate <= 0 || clip->sample_rate == AUDIO_SAMPLE_RATE) return clip->sample_count;
+    return (uint32_t)((uint64_t)clip->sample_count * AUDIO_SAMPLE_RATE / clip->sample_rate);
+}
+
+// Somma in acc la parte della clip (partita a start) che cade nel blocco
+static void mix_clip(int32_t *acc, uint32_t block, uint32_t count,
+                     const SoundClip *clip, uint32_t start)
+{
+    uint32_t length, from, to, i, src;
+
+    length = clip_length(clip);
+    from = start > block ? start : block;
+    to = start + length < block + count ? start + length : block + count;
+
+    for (i = from; i < to; i++) {
+        src = i - start;
+        // Clip registrate a un'altra frequenza: campione piu' vicino
+        if (clip->sample_rate > 0 && clip->sample_rate != AUDIO_SAMPLE_RATE)
+            src = (uint32_t)((uint64_t)src * clip->sample_rate / AUDIO_SAMPLE_RATE);
+        acc[i - block] += clip->data[src];
+    }
+}
+
+static int32_t volume_fixed(float volume) {
+    if (volume < 0.0f) volume = 0.0f;
+    if (volume > 1.0f) volume = 1.0f;
+    return (int32_t)(volume * (1 << VOLUME_SHIFT) + 0.5f);
+}
+
+// Il SE s suona all'inizio del frame f (trigger o metronomo)
+static bool se_starts(const AudioContext *audio, int f, int s) {
+    if (!audio->se_enabled[s]) return false;
+    if (f < 999 && audio->se_triggers[f][s]) return true;
+    return s == 0 && audio->metronome_enabled && audio->metronome_interval > 0 &&
+           f % audio->metronome_interval == 0;
+}
+
+void soundtrack_render(const AudioContext *audio, const uint32_t *frame_start, int frame_count,
+                       uint32_t first, int16_t *out, uint32_t count)
+{
+    int32_t se[SOUNDTRACK_BLOCK], bgm[SOUNDTRACK_BLOCK];
+    int32_t se_volume, bgm_volume;
+    int64_t sample;
+    uint32_t block, n, i, longest;
+    int f, s;
+
+    se_volume = volume_fixed(audio->se_volume);
+    bgm_volume = audio->bgm_enabled ? volume_fixed(audio->bgm_volume) : 0;
+
+    // Nessuna clip dura piu' di longest: i frame piu' vecchi non suonano
+    longest = 0;
+    for (s = 0; s < MAX_SOUND_EFFECTS; s++) {
+        n = clip_length(&audio->sound_effects[s]);
+        if (n > longest) longest = n;
+    }
+
+    for (block = first; block < first + count; block += n) {
+        n = first + count - block;
+        if (n > SOUNDTRACK_BLOCK) n = SOUNDTRACK_BLOCK;
+        memset(se, 0, n * sizeof(int32_t));
+        memset(bgm, 0, n * sizeof(int32_t));
+
+        for (f = 0; f < frame_count && frame_start[f] < block + n; f++) {
+            if (frame_start[f] + longest <= block) continue;
+            for (s = 0; s < MAX_SOUND_EFFECTS; s++) {
+                if (se_starts(audio, f, s))
+                    mix_clip(se, block, n, &audio->sound_effects[s], frame_start[f]);
+            }
+        }
+        if (bgm_volume > 0) mix_clip(bgm, block, n, &audio->bgm, 0);
+
+        for (i = 0; i < n; i++) {
+            sample = ((int64_t)se[i] * se_volume + (int64_t)bgm[i] * bgm_volume) >> VOLUME_SHIFT;
+            if (sample > 32767) sample = 32767;
+            if (sample < -32768) sample = -32768;
+            out[block - first + i] = (int16_t)sample;
+        }
+    }
+}
+
+static void put_u16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)((v >> 8) & 0xFF);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+void soundtrack_wav_header(uint8_t *header, uint32_t samples) {
+    memcpy(header, "RIFF", 4);
+    put_u32(header + 4, 36 + samples * 2);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_u32(header + 16, 16);
+    put_u16(header + 20, 1);                    // PCM
+    put_u16(header + 22, 1);                    // Mono
+    put_u32(header + 24, AUDIO_SAMPLE_RATE);
+    put_u32(header + 28, AUDIO_SAMPLE_RATE * 2);
+    put_u16(header + 32, 2);
+    put_u16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    put_u32(header + 40, samples * 2);
+}
@@ -0,0 +1,24 @@
+#ifndef SOUNDTRACK_H
+#define SOUNDTRACK_H
+
+#include "audio.h"
+#include <stdint.h>
+
+// Traccia audio dell'animazione calcolata fuori linea, mono a
+// AUDIO_SAMPLE_RATE. Al primo campione di ogni frame partono le clip dei
+// trigger attivi di se_triggers e, se attivo, il click del metronomo
+// (SE 0 ogni metronome_interval frame, come audio_play_frame_sounds);
+// la BGM parte dall'inizio. Le clip sovrapposte si sommano; i volumi
+// sono in virgola fissa, cosi' il risultato e' identico campione per
+// campione su ogni piattaforma. Non usa ne' il device audio ne' l'SDK.
+#define SOUNDTRACK_WAV_HEADER 44
+
+// frame_start[f]: primo campione del frame f, crescente.
+// Riempie out con i campioni [first, first + count).
+void soundtrack_render(const AudioContext *audio, const uint32_t *frame_start, int frame_count,
+                       uint32_t first, int16_t *out, uint32_t count);
+
+// Header RIFF/WAVE di un PCM 16 bit mono di samples campioni
+void soundtrack_wav_header(uint8_t *header, uint32_t samples);
+
+#endif
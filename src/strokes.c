@@ -0,0 +1,273 @@
+#include "strokes.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STROKES_INITIAL 64
+#define POINTS_INITIAL  1024
+
+// Generazioni uniche tra tutti i log, cosi' uno stato di undo non puo'
+// combaciare con il log di un altro layer
+static uint32_t next_generation = 1;
+
+void strokes_init(StrokeLog *log) {
+    memset(log, 0, sizeof(StrokeLog));
+    log->valid = 1;
+    log->generation = next_generation++;
+}
+
+void strokes_free(StrokeLog *log) {
+    if (log->strokes) free(log->strokes);
+    if (log->points) free(log->points);
+    strokes_init(log);
+}
+
+void strokes_clear(StrokeLog *log) {
+    log->count = 0;
+    log->high = 0;
+    log->open = 0;
+    log->valid = 1;
+    log->generation = next_generation++;
+}
+
+void strokes_invalidate(StrokeLog *log) {
+    log->count = 0;
+    log->high = 0;
+    log->open = 0;
+    log->valid = 0;
+    log->generation = next_generation++;
+}
+
+void strokes_retag(StrokeLog *log) {
+    log->high = log->count;
+    log->generation = next_generation++;
+}
+
+int strokes_point_count(const StrokeLog *log) {
+    const Stroke *last;
+    if (log->count <= 0) return 0;
+    last = &log->strokes[log->count - 1];
+    return last->point_start + last->point_count;
+}
+
+uint32_t strokes_byte_size(const StrokeLog *log) {
+    return (uint32_t)(log->count * sizeof(Stroke) +
+                      strokes_point_count(log) * sizeof(StrokePoint));
+}
+
+static int strokes_reserve_points(StrokeLog *log, int needed) {
+    int new_cap;
+    StrokePoint *np;
+
+    if (needed <= log->point_capacity) return 1;
+
+    new_cap = log->point_capacity ? log->point_capacity * 2 : POINTS_INITIAL;
+    while (new_cap < needed) new_cap *= 2;
+
+    np = (StrokePoint *)realloc(log->points, new_cap * sizeof(StrokePoint));
+    if (!np) return 0;
+    log->points = np;
+    log->point_capacity = new_cap;
+    return 1;
+}
+
+Stroke *strokes_begin(StrokeLog *log, StrokeKind kind, int tool, int color,
+                      int brush_size, int filled)
+{
+    Stroke *s;
+
+    log->open = 0;
+    if (!log->valid) return NULL;
+
+    if (log->count >= log->capacity) {
+        int new_cap = log->capacity ? log->capacity * 2 : STROKES_INITIAL;
+        Stroke *ns = (Stroke *)realloc(log->strokes, new_cap * sizeof(Stroke));
+        if (!ns) {
+            strokes_invalidate(log);
+            return NULL;
+        }
+        log->strokes = ns;
+        log->capacity = new_cap;
+    }
+
+    // Un nuovo tratto scarta la coda di redo
+    s = &log->strokes[log->count];
+    s->kind = (uint8_t)kind;
+    s->tool = (uint8_t)tool;
+    s->color = (uint8_t)color;
+    s->brush_size = (uint8_t)brush_size;
+    s->filled = (uint8_t)filled;
+    s->point_start = strokes_point_count(log);
+    s->point_count = 0;
+
+    log->count++;
+    log->high = log->count;
+    log->open = (kind == STROKE_PEN);
+    return s;
+}
+
+void strokes_add_point(StrokeLog *log, int x, int y) {
+    Stroke *s;
+    int idx;
+
+    if (!log->valid || log->count <= 0) return;
+    s = &log->strokes[log->count - 1];
+
+    idx = s->point_start + s->point_count;
+    if (!strokes_reserve_points(log, idx + 1)) {
+        strokes_invalidate(log);
+        return;
+    }
+    log->points[idx].x = (int16_t)x;
+    log->points[idx].y = (int16_t)y;
+    s->point_count++;
+}
+
+// Usato da undo/redo: count/valid/generation sono quelli salvati insieme
+// allo stato raster. Dopo un nuovo tratto gli stati di redo non sono piu'
+// raggiungibili, quindi i primi count tratti della stessa generazione
+// corrispondono ancora ai pixel ripristinati.
+void strokes_restore(StrokeLog *log, int count, int valid, uint32_t generation) {
+    if (valid && count == 0) {
+        strokes_clear(log);
+    } else if (!valid || generation != log->generation || count > log->high) {
+        strokes_invalidate(log);
+    } else {
+        log->count = count;
+        log->open = 0;
+    }
+}
+
+int strokes_copy(StrokeLog *dst, const StrokeLog *src) {
+    int points = strokes_point_count(src);
+
+    strokes_clear(dst);
+    if (!src->valid) {
+        strokes_invalidate(dst);
+        return 1;
+    }
+    if (src->count > dst->capacity) {
+        Stroke *ns = (Stroke *)realloc(dst->strokes, src->count * sizeof(Stroke));
+        if (!ns) {
+            strokes_invalidate(dst);
+            return 0;
+        }
+        dst->strokes = ns;
+        dst->capacity = src->count;
+    }
+    if (!strokes_reserve_points(dst, points)) {
+        strokes_invalidate(dst);
+        return 0;
+    }
+
+    if (src->count > 0) memcpy(dst->strokes, src->strokes, src->count * sizeof(Stroke));
+    if (points > 0) memcpy(dst->points, src->points, points * sizeof(StrokePoint));
+    dst->count = src->count;
+    dst->high = src->count;
+    return 1;
+}
+
+StrokeLog *strokes_clone(const StrokeLog *src) {
+    StrokeLog *log;
+
+    if (!src->valid || src->count <= 0) return NULL;
+    log = (StrokeLog *)malloc(sizeof(StrokeLog));
+    if (!log) return NULL;
+    strokes_init(log);
+    if (!strokes_copy(log, src)) {
+        strokes_destroy(log);
+        return NULL;
+    }
+    return log;
+}
+
+void strokes_destroy(StrokeLog *log) {
+    if (!log) return;
+    free(log->strokes);
+    free(log->points);
+    free(log);
+}
+
+uint32_t strokes_serialized_size(const StrokeLog *log) {
+    return (uint32_t)(2 * sizeof(uint32_t) + log->count * sizeof(StrokeRecord) +
+                      strokes_point_count(log) * sizeof(StrokePoint));
+}
+
+void strokes_serialize(const StrokeLog *log, uint8_t *out) {
+    StrokeRecord rec;
+    uint32_t head[2];
+    int i;
+
+    head[0] = (uint32_t)log->count;
+    head[1] = (uint32_t)strokes_point_count(log);
+    memcpy(out, head, sizeof(head));
+    out += sizeof(head);
+
+    memset(&rec, 0, sizeof(rec));
+    for (i = 0; i < log->count; i++) {
+        rec.kind = log->strokes[i].kind;
+        rec.tool = log->strokes[i].tool;
+        rec.color = log->strokes[i].color;
+        rec.brush_size = log->strokes[i].brush_size;
+        rec.filled = log->strokes[i].filled;
+        rec.point_count = (uint32_t)log->strokes[i].point_count;
+        memcpy(out, &rec, sizeof(rec));
+        out += sizeof(rec);
+    }
+    if (head[1] > 0) memcpy(out, log->points, head[1] * sizeof(StrokePoint));
+}
+
+StrokeLog *strokes_deserialize(const uint8_t *in, uint32_t size) {
+    StrokeLog *log;
+    StrokeRecord rec;
+    uint32_t head[2], total;
+    int i;
+
+    if (size < sizeof(head)) return NULL;
+    memcpy(head, in, sizeof(head));
+    if (head[0] == 0 || head[0] > size / sizeof(StrokeRecord) ||
+        head[1] > size / sizeof(StrokePoint) ||
+        size != sizeof(head) + head[0] * sizeof(StrokeRecord) + head[1] * sizeof(StrokePoint))
+        return NULL;
+
+    // Puo' girare sul thread di caricamento: niente generazione, che
+    // serve solo ai log del DrawingContext
+    log = (StrokeLog *)calloc(1, sizeof(StrokeLog));
+    if (!log) return NULL;
+    log->valid = 1;
+    log->strokes = (Stroke *)malloc(head[0] * sizeof(Stroke));
+    log->points = (StrokePoint *)malloc((head[1] > 0 ? head[1] : 1) * sizeof(StrokePoint));
+    if (!log->strokes || !log->points) {
+        strokes_destroy(log);
+        return NULL;
+    }
+    log->capacity = (int)head[0];
+    log->point_capacity = (int)(head[1] > 0 ? head[1] : 1);
+
+    // I punti dei tratti devono coprire esattamente la tabella dei punti
+    total = 0;
+    in += sizeof(head);
+    for (i = 0; i < (int)head[0]; i++) {
+        memcpy(&rec, in, sizeof(rec));
+        in += sizeof(rec);
+        if (rec.kind > STROKE_FILL || rec.point_count > head[1] - total) {
+            strokes_destroy(log);
+            return NULL;
+        }
+        log->strokes[i].kind = rec.kind;
+        log->strokes[i].tool = rec.tool;
+        log->strokes[i].color = rec.color;
+        log->strokes[i].brush_size = rec.brush_size;
+        log->strokes[i].filled = rec.filled;
+        log->strokes[i].point_start = (int)total;
+        log->strokes[i].point_count = (int)rec.point_count;
+        total += rec.point_count;
+    }
+    if (total != head[1]) {
+        strokes_destroy(log);
+        return NULL;
+    }
+    if (head[1] > 0) memcpy(log->points, in, head[1] * sizeof(StrokePoint));
+    log->count = (int)head[0];
+    log->high = log->count;
+    return log;
+}
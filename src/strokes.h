@@ -0,0 +1,83 @@
+#ifndef STROKES_H
+#define STROKES_H
+
+#include <stdint.h>
+
+typedef enum {
+    STROKE_PEN,       // Mano libera: punti collegati col pennello
+    STROKE_LINE,      // 2 punti
+    STROKE_RECT,      // 2 angoli
+    STROKE_CIRCLE,    // Centro + (raggio, 0)
+    STROKE_FILL       // Punto di partenza del secchiello
+} StrokeKind;
+
+typedef struct {
+    int16_t x, y;
+} StrokePoint;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t tool;         // ToolType al momento del tratto
+    uint8_t color;
+    uint8_t brush_size;
+    uint8_t filled;
+    int point_start;      // Indice in StrokeLog.points
+    int point_count;
+} Stroke;
+
+// Log dei tratti di un layer. Finche' valid e' 1, rieseguire i tratti
+// in ordine su un layer vuoto riproduce esattamente i pixel.
+// Nel DrawingContext il log segue le modifiche (undo, redo, invalidazioni);
+// nei Frame ne resta una copia compatta, sempre valida, di proprieta' del
+// frame (NULL = layer solo raster).
+typedef struct {
+    Stroke *strokes;
+    int count;            // Tratti attivi
+    int high;             // Tratti registrati (count..high-1 ripristinabili con redo)
+    int capacity;
+    StrokePoint *points;
+    int point_capacity;
+    int open;             // L'ultimo tratto PEN accetta altri punti
+    int valid;            // 0 = layer modificato da operazioni non vettoriali
+    uint32_t generation;  // Cambia a ogni clear/invalidate (per undo)
+} StrokeLog;
+
+void strokes_init(StrokeLog *log);
+void strokes_free(StrokeLog *log);
+void strokes_clear(StrokeLog *log);
+void strokes_invalidate(StrokeLog *log);
+void strokes_retag(StrokeLog *log);
+
+Stroke *strokes_begin(StrokeLog *log, StrokeKind kind, int tool, int color,
+                      int brush_size, int filled);
+void strokes_add_point(StrokeLog *log, int x, int y);
+void strokes_restore(StrokeLog *log, int count, int valid, uint32_t generation);
+
+// Copia dei tratti attivi di src in dst (gia' inizializzato), con una
+// nuova generazione. 0 = memoria esaurita, dst invalidato.
+int strokes_copy(StrokeLog *dst, const StrokeLog *src);
+// Copia compatta su heap (NULL se src non e' valido o e' vuoto)
+StrokeLog *strokes_clone(const StrokeLog *src);
+void strokes_destroy(StrokeLog *log);
+
+int strokes_point_count(const StrokeLog *log);
+uint32_t strokes_byte_size(const StrokeLog *log);
+
+// Forma serializzata (chunk "STRK" del .fnv): uint32 tratti, uint32
+// punti, poi StrokeRecord per tratto e StrokePoint per punto
+typedef struct {
+    uint8_t kind;
+    uint8_t tool;
+    uint8_t color;
+    uint8_t brush_size;
+    uint8_t filled;
+    uint8_t reserved[3];
+    uint32_t point_count;
+} StrokeRecord;
+
+uint32_t strokes_serialized_size(const StrokeLog *log);
+void strokes_serialize(const StrokeLog *log, uint8_t *out);
+// NULL se i dati sono incoerenti o vuoti
+StrokeLog *strokes_deserialize(const uint8_t *in, uint32_t size);
+
+#endif
@@ -0,0 +1,717 @@
+#include "tilestore.h"
+#include "animation.h"
+#include <psp2/io/fcntl.h>
+#include <psp2/io/stat.h>
+#include <psp2/kernel/threadmgr.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ========== TILE ========== */
+static const uint8_t *tile_origin(const LayerData *layer, int tile) {
+    return layer->pixels + (tile / TILES_X) * TILE_SIZE * CANVAS_WIDTH +
+           (tile % TILES_X) * TILE_SIZE;
+}
+
+bool tile_extract(const LayerData *layer, int tile, uint8_t *pixels) {
+    const uint8_t *src = tile_origin(layer, tile);
+    uint8_t any = 0;
+    int y, x;
+
+    for (y = 0; y < TILE_SIZE; y++) {
+        memcpy(pixels + y * TILE_SIZE, src + y * CANVAS_WIDTH, TILE_SIZE);
+        for (x = 0; x < TILE_SIZE; x++) any |= pixels[y * TILE_SIZE + x];
+    }
+    return any != 0;
+}
+
+void tile_insert(LayerData *layer, int tile, const uint8_t *pixels) {
+    uint8_t *dst = (uint8_t *)tile_origin(layer, tile);
+    int y;
+
+    for (y = 0; y < TILE_SIZE; y++)
+        memcpy(dst + y * CANVAS_WIDTH, pixels + y * TILE_SIZE, TILE_SIZE);
+}
+
+void tile_clear(LayerData *layer, int tile) {
+    uint8_t *dst = (uint8_t *)tile_origin(layer, tile);
+    int y;
+
+    for (y = 0; y < TILE_SIZE; y++) memset(dst + y * CANVAS_WIDTH, 0, TILE_SIZE);
+}
+
+void tile_copy(LayerData *dst, const LayerData *src, int tile) {
+    uint8_t *d = (uint8_t *)tile_origin(dst, tile);
+    const uint8_t *s = tile_origin(src, tile);
+    int y;
+
+    for (y = 0; y < TILE_SIZE; y++)
+        memcpy(d + y * CANVAS_WIDTH, s + y * CANVAS_WIDTH, TILE_SIZE);
+}
+
+uint64_t tile_hash(const uint8_t *pixels) {
+    uint64_t h = animation_hash_data(pixels, TILE_PIXELS);
+    return h == TILE_BLANK ? 1 : h;
+}
+
+/* ========== COMPRESSIONE ========== */
+void tile_coder_init(TileCoder *c) {
+    memset(c, 0, sizeof(TileCoder));
+}
+
+void tile_coder_free(TileCoder *c) {
+    if (c->deflate_ready) deflateEnd(&c->deflater);
+    if (c->inflate_ready) inflateEnd(&c->inflater);
+    c->deflate_ready = false;
+    c->inflate_ready = false;
+}
+
+static uint32_t coder_deflate(TileCoder *c, const uint8_t *in, uint32_t size,
+                              uint8_t *out, uint32_t out_size)
+{
+    z_stream *zs = &c->deflater;
+
+    if (!c->deflate_ready) {
+        memset(zs, 0, sizeof(z_stream));
+        if (deflateInit(zs, Z_DEFAULT_COMPRESSION) != Z_OK) return 0;
+        c->deflate_ready = true;
+    } else if (deflateReset(zs) != Z_OK) {
+        return 0;
+    }
+
+    zs->next_in = (Bytef *)in;
+    zs->avail_in = size;
+    zs->next_out = out;
+    zs->avail_out = out_size;
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END) return 0;
+    return out_size - zs->avail_out;
+}
+
+static bool coder_inflate(TileCoder *c, const uint8_t *in, uint32_t size,
+                          uint8_t *out, uint32_t out_size)
+{
+    z_stream *zs = &c->inflater;
+
+    if (!c->inflate_ready) {
+        memset(zs, 0, sizeof(z_stream));
+        if (inflateInit(zs) != Z_OK) return false;
+        c->inflate_ready = true;
+    } else if (inflateReset(zs) != Z_OK) {
+        return false;
+    }
+
+    zs->next_in = (Bytef *)in;
+    zs->avail_in = size;
+    zs->next_out = out;
+    zs->avail_out = out_size;
+    return inflate(zs, Z_FINISH) == Z_STREAM_END && zs->avail_out == 0;
+}
+
+// Indici 0..3 a 2 bit; altrimenti un byte per pixel
+uint32_t tile_compress(TileCoder *c, const uint8_t *pixels, uint8_t *out, uint8_t *format) {
+    int i;
+
+    memset(c->packed, 0, sizeof(c->packed));
+    for (i = 0; i < TILE_PIXELS; i++) {
+        if (pixels[i] > 3) {
+            *format = TILE_FORMAT_RAW8;
+            return coder_deflate(c, pixels, TILE_PIXELS, out, TILE_MAX_DATA);
+        }
+        c->packed[i >> 2] |= (uint8_t)(pixels[i] << ((i & 3) * 2));
+    }
+    *format = TILE_FORMAT_PACKED2;
+    return coder_deflate(c, c->packed, sizeof(c->packed), out, TILE_MAX_DATA);
+}
+
+static bool tile_decompress(TileCoder *c, const uint8_t *in, uint32_t size, uint8_t format,
+                            uint8_t *pixels)
+{
+    int i;
+
+    if (format == TILE_FORMAT_RAW8)
+        return coder_inflate(c, in, size, pixels, TILE_PIXELS);
+    if (format != TILE_FORMAT_PACKED2 ||
+        !coder_inflate(c, in, size, c->packed, sizeof(c->packed)))
+        return false;
+
+    for (i = 0; i < TILE_PIXELS; i++)
+        pixels[i] = (c->packed[i >> 2] >> ((i & 3) * 2)) & 3;
+    return true;
+}
+
+uint32_t tile_table_compress(TileCoder *c, const uint64_t *table, uint8_t *out) {
+    return coder_deflate(c, (const uint8_t *)table, TILE_TABLE_SIZE, out, TILE_TABLE_MAX);
+}
+
+bool tile_table_decompress(TileCoder *c, const uint8_t *in, uint32_t size, uint64_t *table) {
+    return coder_inflate(c, in, size, (uint8_t *)table, TILE_TABLE_SIZE);
+}
+
+/* ========== INSIEMI DI HASH ========== */
+void tileset_init(TileSet *s) {
+    memset(s, 0, sizeof(TileSet));
+}
+
+void tileset_free(TileSet *s) {
+    free(s->hashes);
+    free(s->counts);
+    memset(s, 0, sizeof(TileSet));
+}
+
+static int tileset_slot(const TileSet *s, uint64_t hash) {
+    int slot = (int)(hash & (uint64_t)(s->capacity - 1));
+    while (s->hashes[slot] != TILE_BLANK && s->hashes[slot] != hash)
+        slot = (slot + 1) & (s->capacity - 1);
+    return slot;
+}
+
+static bool tileset_grow(TileSet *s) {
+    TileSet bigger;
+    int i, slot;
+
+    bigger.capacity = s->capacity ? s->capacity * 2 : 256;
+    bigger.count = s->count;
+    bigger.hashes = (uint64_t *)calloc(bigger.capacity, sizeof(uint64_t));
+    bigger.counts = (uint32_t *)calloc(bigger.capacity, sizeof(uint32_t));
+    if (!bigger.hashes || !bigger.counts) {
+        free(bigger.hashes);
+        free(bigger.counts);
+        return false;
+    }
+
+    for (i = 0; i < s->capacity; i++) {
+        if (s->hashes[i] == TILE_BLANK) continue;
+        slot = tileset_slot(&bigger, s->hashes[i]);
+        bigger.hashes[slot] = s->hashes[i];
+        bigger.counts[slot] = s->counts[i];
+    }
+    tileset_free(s);
+    *s = bigger;
+    return true;
+}
+
+bool tileset_add(TileSet *s, uint64_t hash, uint32_t count) {
+    int slot;
+
+    if (hash == TILE_BLANK) return true;
+    if ((s->count + 1) * 2 > s->capacity && !tileset_grow(s)) return false;
+
+    slot = tileset_slot(s, hash);
+    if (s->hashes[slot] == TILE_BLANK) {
+        s->hashes[slot] = hash;
+        s->count++;
+    }
+    s->counts[slot] += count;
+    return true;
+}
+
+uint32_t tileset_get(const TileSet *s, uint64_t hash) {
+    int slot;
+
+    if (s->capacity == 0 || hash == TILE_BLANK) return 0;
+    slot = tileset_slot(s, hash);
+    return s->hashes[slot] == hash ? s->counts[slot] : 0;
+}
+
+bool tileset_merge(TileSet *dst, const TileSet *src) {
+    int i;
+
+    for (i = 0; i < src->capacity; i++) {
+        if (src->hashes[i] != TILE_BLANK && !tileset_add(dst, src->hashes[i], 1)) return false;
+    }
+    return true;
+}
+
+/* ========== ARCHIVIO ========== */
+typedef struct {
+    char pack_path[128];
+    char index_path[128];
+    char new_path[128];
+    TileEntry *entries;
+    uint32_t *refs;             // File che usano ogni tile (se refs_ready)
+    int count;                  // Voci, comprese quelle in scrittura
+    int committed;              // Voci visibili ai lettori
+    int capacity;
+    int32_t *table;             // Hash -> voce (indirizzamento aperto)
+    int table_size;
+    uint64_t pack_id;
+    FileWriter writer;
+    bool writing;
+    int readers;                // TileReader con il pack aperto
+    bool loaded;
+    bool refs_ready;
+    SceUID lock;
+} TileStore;
+
+static TileStore store;
+
+static int store_find(uint64_t hash) {
+    int slot;
+
+    if (store.table_size == 0) return -1;
+    slot = (int)(hash & (uint64_t)(store.table_size - 1));
+    while (store.table[slot] >= 0) {
+        if (store.entries[store.table[slot]].hash == hash) return store.table[slot];
+        slot = (slot + 1) & (store.table_size - 1);
+    }
+    return -1;
+}
+
+static void store_link(int i) {
+    int slot = (int)(store.entries[i].hash & (uint64_t)(store.table_size - 1));
+    while (store.table[slot] >= 0) slot = (slot + 1) & (store.table_size - 1);
+    store.table[slot] = i;
+}
+
+static bool store_rehash(int table_size) {
+    int32_t *table;
+    int i;
+
+    table = (int32_t *)malloc(table_size * sizeof(int32_t));
+    if (!table) return false;
+    free(store.table);
+    store.table = table;
+    store.table_size = table_size;
+    memset(store.table, 0xFF, table_size * sizeof(int32_t));
+    for (i = 0; i < store.count; i++) store_link(i);
+    return true;
+}
+
+static bool store_insert(uint64_t hash, uint32_t offset, uint32_t size) {
+    TileEntry *entries;
+    uint32_t *refs;
+    int capacity;
+
+    if (store.count >= store.capacity) {
+        capacity = store.capacity ? store.capacity * 2 : 1024;
+        entries = (TileEntry *)realloc(store.entries, capacity * sizeof(TileEntry));
+        if (!entries) return false;
+        store.entries = entries;
+        refs = (uint32_t *)realloc(store.refs, capacity * sizeof(uint32_t));
+        if (!refs) return false;
+        store.refs = refs;
+        store.capacity = capacity;
+    }
+    if ((store.count + 1) * 2 > store.table_size &&
+        !store_rehash(store.table_size ? store.table_size * 2 : 2048))
+        return false;
+
+    store.entries[store.count].hash = hash;
+    store.entries[store.count].offset = offset;
+    store.entries[store.count].size = size;
+    store.refs[store.count] = 0;
+    store_link(store.count);
+    store.count++;
+    return true;
+}
+
+static void store_reset(void) {
+    free(store.entries);
+    free(store.refs);
+    free(store.table);
+    store.entries = NULL;
+    store.refs = NULL;
+    store.table = NULL;
+    store.count = 0;
+    store.committed = 0;
+    store.capacity = 0;
+    store.table_size = 0;
+    store.refs_ready = false;
+}
+
+// Voci [from, store.count) in coda all'indice (rewrite: indice da capo)
+static bool index_write(int from, bool rewrite) {
+    FileWriter w;
+    TileIndexHeader header;
+
+    if (rewrite) {
+        if (!fileio_open_write(&w, store.index_path)) return false;
+        memcpy(header.magic, "FNVI", 4);
+        header.version = TILESTORE_VERSION;
+        header.pack_id = store.pack_id;
+        fileio_write(&w, &header, sizeof(header));
+        from = 0;
+    } else if (!fileio_open_append(&w, store.index_path)) {
+        return false;
+    }
+
+    if (store.count > from)
+        fileio_write(&w, &store.entries[from], (store.count - from) * sizeof(TileEntry));
+    return fileio_close_write(&w);
+}
+
+static bool pack_create(const char *path, uint64_t id) {
+    FileWriter w;
+    TilePackHeader header;
+
+    if (!fileio_open_write(&w, path)) return false;
+    memcpy(header.magic, "FNVP", 4);
+    header.version = TILESTORE_VERSION;
+    header.id = id;
+    fileio_write(&w, &header, sizeof(header));
+    return fileio_close_write(&w);
+}
+
+// Record del pack da offset in poi, finche' sono integri
+static void pack_scan(FileReader *r, SceOff offset, SceOff pack_size) {
+    TileRecord rec;
+
+    while (offset + (SceOff)sizeof(rec) <= pack_size &&
+           fileio_seek_read(r, offset) && fileio_read(r, &rec, sizeof(rec)) &&
+           memcmp(rec.magic, "TILE", 4) == 0 && rec.size <= TILE_MAX_DATA &&
+           offset + (SceOff)sizeof(rec) + rec.size <= pack_size) {
+        if (store_find(rec.hash) < 0 && !store_insert(rec.hash, (uint32_t)offset, rec.size)) break;
+        offset += sizeof(rec) + rec.size;
+    }
+}
+
+static bool store_load(void) {
+    FileReader r;
+    TilePackHeader pack;
+    TileIndexHeader index;
+    TileEntry e;
+    SceIoStat st;
+    SceOff pack_size, end, scanned;
+    bool index_ok;
+
+    if (store.loaded) return true;
+    store_reset();
+
+    // Compattazione interrotta dopo aver rimosso il vecchio pack
+    if (sceIoGetstat(store.pack_path, &st) < 0 && sceIoGetstat(store.new_path, &st) >= 0)
+        sceIoRename(store.new_path, store.pack_path);
+    else
+        sceIoRemove(store.new_path);
+
+    if (sceIoGetstat(store.pack_path, &st) < 0) {
+        store.pack_id = 1;
+        if (!pack_create(store.pack_path, store.pack_id) || !index_write(0, true)) return false;
+        store.loaded = true;
+        return true;
+    }
+    pack_size = st.st_size;
+
+    if (!fileio_open_read(&r, store.pack_path)) return false;
+    if (!fileio_read(&r, &pack, sizeof(pack)) || memcmp(pack.magic, "FNVP", 4) != 0 ||
+        pack.version != TILESTORE_VERSION) {
+        fileio_close_read(&r);
+        return false;
+    }
+    store.pack_id = pack.id;
+
+    // Indice: si usa solo se intero e tutto dentro il pack (una scrittura
+    // interrotta lascia una voce a meta'), altrimenti si rilegge il pack
+    end = sizeof(pack);
+    index_ok = sceIoGetstat(store.index_path, &st) >= 0 && st.st_size >= (SceOff)sizeof(index) &&
+               (st.st_size - sizeof(index)) % sizeof(TileEntry) == 0;
+    if (index_ok) {
+        FileReader ir;
+        index_ok = fileio_open_read(&ir, store.index_path);
+        if (index_ok) {
+            index_ok = fileio_read(&ir, &index, sizeof(index)) &&
+                       memcmp(index.magic, "FNVI", 4) == 0 &&
+                       index.version == TILESTORE_VERSION && index.pack_id == pack.id;
+            while (index_ok && fileio_read(&ir, &e, sizeof(e))) {
+                index_ok = (SceOff)e.offset >= (SceOff)sizeof(pack) &&
+                           (SceOff)e.offset + sizeof(TileRecord) + e.size <= pack_size &&
+                           (store_find(e.hash) >= 0 || store_insert(e.hash, e.offset, e.size));
+                if ((SceOff)e.offset + sizeof(TileRecord) + e.size > end)
+                    end = e.offset + sizeof(TileRecord) + e.size;
+            }
+            fileio_close_read(&ir);
+        }
+    }
+    if (!index_ok) {
+        store_reset();
+        end = sizeof(pack);
+    }
+
+    // Record scritti dopo l'ultimo aggiornamento dell'indice
+    scanned = store.count;
+    pack_scan(&r, end, pack_size);
+    fileio_close_read(&r);
+
+    if (!index_ok || scanned < store.count) index_write((int)scanned, !index_ok);
+    store.committed = store.count;
+    store.loaded = true;
+    return true;
+}
+
+void tilestore_init(const char *dir) {
+    sceIoMkdir(dir, 0777);
+    snprintf(store.pack_path, sizeof(store.pack_path), "%stiles.pak", dir);
+    snprintf(store.index_path, sizeof(store.index_path), "%stiles.idx", dir);
+    snprintf(store.new_path, sizeof(store.new_path), "%stiles.new", dir);
+    store.lock = sceKernelCreateMutex("tile_store", 0, 0, NULL);
+}
+
+bool tilestore_contains(uint64_t hash) {
+    bool found;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    found = store_load() && store_find(hash) >= 0;
+    sceKernelUnlockMutex(store.lock, 1);
+    return found;
+}
+
+int tilestore_count(void) {
+    int count;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    count = store_load() ? store.committed : 0;
+    sceKernelUnlockMutex(store.lock, 1);
+    return count;
+}
+
+bool tilestore_begin(void) {
+    bool ok = false;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    if (!store.writing && store_load() && fileio_open_append(&store.writer, store.pack_path)) {
+        store.writing = true;
+        ok = true;
+    }
+    sceKernelUnlockMutex(store.lock, 1);
+    return ok;
+}
+
+bool tilestore_put(uint64_t hash, const uint8_t *data, uint32_t size, uint8_t format) {
+    TileRecord rec;
+    SceOff offset;
+    bool ok = true;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    if (store_find(hash) < 0) {
+        memcpy(rec.magic, "TILE", 4);
+        rec.size = size;
+        rec.hash = hash;
+        rec.format = format;
+        memset(rec.reserved, 0, sizeof(rec.reserved));
+
+        offset = fileio_tell_write(&store.writer);
+        ok = offset <= 0xFFFFFFFFu - sizeof(rec) - size &&
+             fileio_write(&store.writer, &rec, sizeof(rec)) &&
+             fileio_write(&store.writer, data, size) &&
+             store_insert(hash, (uint32_t)offset, size);
+    }
+    sceKernelUnlockMutex(store.lock, 1);
+    return ok;
+}
+
+bool tilestore_end(bool ok) {
+    sceKernelLockMutex(store.lock, 1, NULL);
+    if (store.writing) {
+        ok = fileio_close_write(&store.writer) && ok;
+        store.writing = false;
+
+        // I record di un salvataggio fallito restano nel pack senza voce:
+        // li recupera la prossima scansione, li elimina il collector
+        if (ok) ok = index_write(store.committed, false);
+        if (ok) {
+            store.committed = store.count;
+        } else {
+            store.count = store.committed;
+            store_rehash(store.table_size);
+        }
+    }
+    sceKernelUnlockMutex(store.lock, 1);
+    return ok;
+}
+
+/* ========== LETTURA ========== */
+void tile_reader_init(TileReader *r) {
+    memset(r, 0, sizeof(TileReader));
+    r->pack.fd = -1;
+    tile_coder_init(&r->coder);
+}
+
+bool tile_reader_load(TileReader *r, uint64_t hash, LayerData *layer, int tile) {
+    TileRecord rec;
+    TileEntry e;
+    int i;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    i = store_load() ? store_find(hash) : -1;
+    if (i >= 0 && i < store.committed) e = store.entries[i];
+    sceKernelUnlockMutex(store.lock, 1);
+    if (i < 0 || i >= store.committed) return false;
+
+    if (!r->open) {
+        if (!fileio_open_read(&r->pack, store.pack_path)) return false;
+        r->open = true;
+        __sync_fetch_and_add(&store.readers, 1);
+    }
+
+    if (!fileio_seek_read(&r->pack, e.offset) || !fileio_read(&r->pack, &rec, sizeof(rec)) ||
+        memcmp(rec.magic, "TILE", 4) != 0 || rec.hash != hash || rec.size != e.size ||
+        !fileio_read(&r->pack, r->data, rec.size) ||
+        !tile_decompress(&r->coder, r->data, rec.size, rec.format, r->pixels)) {
+        // Il prossimo tile riapre il pack da capo
+        fileio_close_read(&r->pack);
+        __sync_fetch_and_sub(&store.readers, 1);
+        r->open = false;
+        return false;
+    }
+
+    tile_insert(layer, tile, r->pixels);
+    return true;
+}
+
+bool tile_reader_frame(TileReader *r, const uint8_t *in, uint32_t size,
+                       LayerData *layers, const LayerData *prev, bool delta)
+{
+    int k, l, t;
+    bool ok;
+
+    ok = tile_table_decompress(&r->coder, in, size, r->table);
+    if (!prev) r->last_valid = false;
+    if (delta) {
+        ok = ok && r->last_valid;
+        for (k = 0; ok && k < TILES_PER_FRAME; k++) r->table[k] ^= r->last[k];
+    }
+
+    for (k = 0; ok && k < TILES_PER_FRAME; k++) {
+        l = k / TILES_PER_LAYER;
+        t = k % TILES_PER_LAYER;
+        if (r->table[k] == TILE_BLANK)
+            tile_clear(&layers[l], t);
+        else if (r->last_valid && r->last[k] == r->table[k])
+            tile_copy(&layers[l], &prev[l], t);
+        else
+            ok = tile_reader_load(r, r->table[k], &layers[l], t);
+    }
+
+    // La tabella letta diventa la base del frame successivo
+    r->last_valid = ok;
+    if (ok) memcpy(r->last, r->table, TILE_TABLE_SIZE);
+    return ok;
+}
+
+void tile_reader_close(TileReader *r) {
+    if (r->open) {
+        fileio_close_read(&r->pack);
+        __sync_fetch_and_sub(&store.readers, 1);
+    }
+    r->open = false;
+    r->pack.fd = -1;
+    r->last_valid = false;
+    tile_coder_free(&r->coder);
+}
+
+/* ========== RIFERIMENTI E COLLECTOR ========== */
+bool tilestore_refs_ready(void) {
+    return store.refs_ready;
+}
+
+void tilestore_set_refs(const TileSet *live) {
+    int i;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    if (store_load()) {
+        for (i = 0; i < store.count; i++) store.refs[i] = tileset_get(live, store.entries[i].hash);
+        store.refs_ready = true;
+    }
+    sceKernelUnlockMutex(store.lock, 1);
+}
+
+void tilestore_add_refs(const TileSet *file, int delta) {
+    int i, e;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    for (i = 0; store.refs_ready && i < file->capacity; i++) {
+        if (file->hashes[i] == TILE_BLANK) continue;
+        e = store_find(file->hashes[i]);
+        if (e < 0) continue;
+        if (delta < 0 && store.refs[e] < (uint32_t)-delta) store.refs[e] = 0;
+        else store.refs[e] += delta;
+    }
+    sceKernelUnlockMutex(store.lock, 1);
+}
+
+uint32_t tilestore_garbage(void) {
+    uint32_t bytes = 0;
+    int i;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    for (i = 0; store.refs_ready && i < store.committed; i++) {
+        if (store.refs[i] == 0) bytes += sizeof(TileRecord) + store.entries[i].size;
+    }
+    sceKernelUnlockMutex(store.lock, 1);
+    return bytes;
+}
+
+// Nuovo pack accanto al vecchio, poi scambio: un'interruzione lascia
+// sempre un pack completo (vedi store_load)
+bool tilestore_collect(const TileSet *live) {
+    FileReader r;
+    FileWriter w;
+    TilePackHeader header;
+    TileRecord rec;
+    TileEntry *old;
+    uint8_t *data;
+    int old_count, i;
+    bool ok;
+
+    sceKernelLockMutex(store.lock, 1, NULL);
+    if (store.writing || store.readers > 0 || !store_load()) {
+        sceKernelUnlockMutex(store.lock, 1);
+        return false;
+    }
+
+    data = (uint8_t *)malloc(TILE_MAX_DATA);
+    old = (TileEntry *)malloc((store.count + 1) * sizeof(TileEntry));
+    ok = data && old && fileio_open_read(&r, store.pack_path);
+    if (!ok) {
+        free(data);
+        free(old);
+        sceKernelUnlockMutex(store.lock, 1);
+        return false;
+    }
+
+    if (!fileio_open_write(&w, store.new_path)) {
+        fileio_close_read(&r);
+        free(data);
+        free(old);
+        sceKernelUnlockMutex(store.lock, 1);
+        return false;
+    }
+
+    old_count = store.count;
+    memcpy(old, store.entries, old_count * sizeof(TileEntry));
+    store_reset();
+    store.pack_id++;
+
+    memcpy(header.magic, "FNVP", 4);
+    header.version = TILESTORE_VERSION;
+    header.id = store.pack_id;
+    fileio_write(&w, &header, sizeof(header));
+
+    for (i = 0; ok && i < old_count; i++) {
+        if (tileset_get(live, old[i].hash) == 0) continue;
+        ok = fileio_seek_read(&r, old[i].offset) && fileio_read(&r, &rec, sizeof(rec)) &&
+             rec.hash == old[i].hash && rec.size == old[i].size &&
+             fileio_read(&r, data, rec.size) &&
+             store_insert(rec.hash, (uint32_t)fileio_tell_write(&w), rec.size) &&
+             fileio_write(&w, &rec, sizeof(rec)) && fileio_write(&w, data, rec.size);
+    }
+    fileio_close_read(&r);
+    ok = fileio_close_write(&w) && ok;
+
+    if (ok) ok = sceIoRemove(store.pack_path) >= 0 && sceIoRename(store.new_path, store.pack_path) >= 0;
+    if (ok) {
+        index_write(0, true);
+        store.committed = store.count;
+        for (i = 0; i < store.count; i++) store.refs[i] = tileset_get(live, store.entries[i].hash);
+        store.refs_ready = true;
+    } else {
+        // Si ricarica quello che c'e' su disco
+        sceIoRemove(store.new_path);
+        store.loaded = false;
+        store_load();
+    }
+
+    free(data);
+    free(old);
+    sceKernelUnlockMutex(store.lock, 1);
+    return ok;
+}
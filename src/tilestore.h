@@ -0,0 +1,137 @@
+#ifndef TILESTORE_H
+#define TILESTORE_H
+
+#include "drawing.h"
+#include "fileio.h"
+#include <zlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Archivio di tile condiviso tra i salvataggi. Ogni tile 64x64 di un
+// layer e' identificato dall'hash del contenuto e scritto una volta sola;
+// i .fnv salvati con l'archivio contengono solo le tabelle di hash.
+//   tiles.pak  TilePackHeader + record {TileRecord, dati deflate}, in coda
+//   tiles.idx  TileIndexHeader + TileEntry per record, in coda
+// L'indice e' una cache: se non corrisponde al pack si ricostruisce
+// leggendo i record. I riferimenti per tile (quanti file lo usano) stanno
+// solo in memoria e si ricontano dai file quando servono.
+#define TILE_SIZE         64
+#define TILES_X           (CANVAS_WIDTH / TILE_SIZE)
+#define TILES_Y           (CANVAS_HEIGHT / TILE_SIZE)
+#define TILES_PER_LAYER   (TILES_X * TILES_Y)
+#define TILES_PER_FRAME   (MAX_LAYERS * TILES_PER_LAYER)
+#define TILE_PIXELS       (TILE_SIZE * TILE_SIZE)
+#define TILE_MAX_DATA     (TILE_PIXELS + 64)        // Limite di deflate
+#define TILE_TABLE_SIZE   (TILES_PER_FRAME * sizeof(uint64_t))
+#define TILE_TABLE_MAX    (TILE_TABLE_SIZE + 64)
+#define TILE_BLANK        0ULL                      // Tile vuoto: mai scritto
+
+#define TILE_FORMAT_PACKED2 0   // 4 pixel per byte
+#define TILE_FORMAT_RAW8    1   // Indici > 3, un byte per pixel
+
+#define TILESTORE_VERSION 1
+
+typedef struct {
+    char magic[4];          // "FNVP"
+    uint32_t version;
+    uint64_t id;            // Cambia a ogni compattazione
+} TilePackHeader;
+
+typedef struct {
+    char magic[4];          // "TILE"
+    uint32_t size;          // Byte compressi che seguono
+    uint64_t hash;
+    uint8_t format;         // TILE_FORMAT_*
+    uint8_t reserved[7];
+} TileRecord;
+
+typedef struct {
+    char magic[4];          // "FNVI"
+    uint32_t version;
+    uint64_t pack_id;       // Pack a cui si riferiscono gli offset
+} TileIndexHeader;
+
+typedef struct {
+    uint64_t hash;
+    uint32_t offset;        // Posizione del TileRecord nel pack
+    uint32_t size;
+} TileEntry;
+
+// Insieme di hash con contatore (indirizzamento aperto, TILE_BLANK = vuoto)
+typedef struct {
+    uint64_t *hashes;
+    uint32_t *counts;
+    int count;
+    int capacity;
+} TileSet;
+
+// Stato zlib riutilizzabile, uno per thread
+typedef struct {
+    z_stream deflater;
+    z_stream inflater;
+    bool deflate_ready;
+    bool inflate_ready;
+    uint8_t packed[TILE_PIXELS / 4];
+} TileCoder;
+
+// Lettura dei tile dal pack, una per thread
+typedef struct {
+    FileReader pack;
+    bool open;
+    TileCoder coder;
+    uint8_t data[TILE_MAX_DATA];
+    uint8_t pixels[TILE_PIXELS];
+    uint64_t table[TILES_PER_FRAME];
+    uint64_t last[TILES_PER_FRAME];     // Tabella dell'ultimo frame letto
+    bool last_valid;
+} TileReader;
+
+// Tile di un layer (indice t = riga * TILES_X + colonna)
+bool tile_extract(const LayerData *layer, int tile, uint8_t *pixels);   // false = vuoto
+void tile_insert(LayerData *layer, int tile, const uint8_t *pixels);
+void tile_clear(LayerData *layer, int tile);
+void tile_copy(LayerData *dst, const LayerData *src, int tile);
+uint64_t tile_hash(const uint8_t *pixels);                               // Mai TILE_BLANK
+
+void tile_coder_init(TileCoder *c);
+void tile_coder_free(TileCoder *c);
+uint32_t tile_compress(TileCoder *c, const uint8_t *pixels, uint8_t *out, uint8_t *format);
+uint32_t tile_table_compress(TileCoder *c, const uint64_t *table, uint8_t *out);
+bool tile_table_decompress(TileCoder *c, const uint8_t *in, uint32_t size, uint64_t *table);
+
+void tileset_init(TileSet *s);
+void tileset_free(TileSet *s);
+bool tileset_add(TileSet *s, uint64_t hash, uint32_t count);
+uint32_t tileset_get(const TileSet *s, uint64_t hash);
+bool tileset_merge(TileSet *dst, const TileSet *src);   // +1 per ogni hash di src
+
+void tilestore_init(const char *dir);
+bool tilestore_contains(uint64_t hash);
+int tilestore_count(void);              // Tile nell'archivio
+
+// Scrittura, un salvataggio alla volta: i tile aggiunti diventano
+// visibili ai lettori solo con tilestore_end(true)
+bool tilestore_begin(void);
+bool tilestore_put(uint64_t hash, const uint8_t *data, uint32_t size, uint8_t format);
+bool tilestore_end(bool ok);
+
+void tile_reader_init(TileReader *r);
+bool tile_reader_load(TileReader *r, uint64_t hash, LayerData *layer, int tile);
+// Layer di un frame dalla tabella compressa. prev: layer letti per ultimi
+// con questo reader (o NULL), da cui si copiano i tile invariati; delta:
+// tabella in XOR con quella di prev
+bool tile_reader_frame(TileReader *r, const uint8_t *in, uint32_t size,
+                       LayerData *layers, const LayerData *prev, bool delta);
+void tile_reader_close(TileReader *r);
+
+// Riferimenti: validi dopo tilestore_set_refs (conteggio completo dai file)
+bool tilestore_refs_ready(void);
+void tilestore_set_refs(const TileSet *live);
+void tilestore_add_refs(const TileSet *file, int delta);
+uint32_t tilestore_garbage(void);       // Byte di tile senza riferimenti
+
+// Riscrive il pack con i soli tile di live. Fallisce se c'e' un
+// salvataggio o un reader aperto.
+bool tilestore_collect(const TileSet *live);
+
+#endif
@@ -15,6 +15,10 @@ static const char *tool_names[TOOL_COUNT] = {
     "Timbro", "Contagocce"
 };
 
+static const char *select_op_names[] = {
+    "Nuova", "Aggiungi", "Sottrai", "Interseca"
+};
+
 static const char *tool_icons[TOOL_COUNT] = {
     "P", "E", "B", "L", "R", "C", "M", "S", "T", "D"
 };
@@ -78,6 +82,10 @@ void ui_init(UIContext *ui) {
 void ui_goto_screen(UIContext *ui, ScreenState screen) {
     ui->prev_screen = ui->current_screen;
     ui->current_screen = screen;
+
+    // La lista viene validata solo all'ingresso, non a ogni frame
+    if (screen == SCREEN_FILE_BROWSER)
+        filemanager_refresh_saves();
 }
 
 void ui_go_back(UIContext *ui) {
@@ -351,6 +359,12 @@ void ui_render_timeline(UIContext *ui, AnimationContext *anim, DrawingContext *d
 
         snprintf(num, sizeof(num), "%d", frame_idx + 1);
         draw_text(fx + 2, fy + thumb_h + 12, COLOR_UI_LIGHT, num);
+
+        if (animation_get_exposure(anim, frame_idx) > 1) {
+            snprintf(num, sizeof(num), "x%d", animation_get_exposure(anim, frame_idx));
+            vita2d_draw_rectangle(fx + thumb_w - 18, fy, 18, 12, RGBA8(0, 0, 0, 160));
+            draw_text_scaled(fx + thumb_w - 17, fy + 10, COLOR_UI_SELECTED, 0.7f, num);
+        }
     }
 
     if (anim->frame_count > visible && visible > 0) {
@@ -373,6 +387,8 @@ void ui_render_status_bar(UIContext *ui, DrawingContext *draw, AnimationContext
 
     vita2d_draw_rectangle(0, 0, 960, CANVAS_Y - 2, theme);
     draw_text(10, 14, COLOR_WHITE, tool_names[draw->current_tool]);
+    if (draw->current_tool == TOOL_SELECT)
+        draw_text(100, 14, COLOR_WHITE, select_op_names[ui->select_op]);
 
     snprintf(buf, sizeof(buf), "Frame: %d/%d", anim->current_frame + 1, anim->frame_count);
     draw_text(200, 14, COLOR_WHITE, buf);
@@ -499,13 +515,32 @@ void ui_render_editor(UIContext *ui, DrawingContext *draw, AnimationContext *ani
 }
 
 /* ========== PLAYBACK ========== */
+// Layer dal basso verso l'alto; visible NULL = tutti
+static void render_layers(const LayerData *layers, const int *visible, int x, int y) {
+    int l, yy, xx;
+    uint8_t p;
+    unsigned int c;
+
+    for (l = MAX_LAYERS - 1; l >= 0; l--) {
+        if (visible && !visible[l]) continue;
+        for (yy = 0; yy < CANVAS_HEIGHT; yy++) {
+            for (xx = 0; xx < CANVAS_WIDTH; xx++) {
+                p = layers[l].pixels[yy * CANVAS_WIDTH + xx];
+                if (p != 0) {
+                    c = drawing_get_rgba_color(p, l);
+                    if (c != COLOR_TRANSPARENT)
+                        vita2d_draw_pixel(x + xx, y + yy, c);
+                }
+            }
+        }
+    }
+}
+
 void ui_render_playback(UIContext *ui, DrawingContext *draw, AnimationContext *anim,
                         AudioContext *audio, InputState *input)
 {
     unsigned int theme;
-    int px_off, py_off, l, yy, xx;
-    uint8_t p;
-    unsigned int c;
+    int px_off, py_off;
     int cy_off, cx_off;
     char fc[32];
     (void)audio;
@@ -517,20 +552,7 @@ void ui_render_playback(UIContext *ui, DrawingContext *draw, AnimationContext *a
     py_off = (544 - CANVAS_HEIGHT) / 2 - 20;
 
     vita2d_draw_rectangle(px_off, py_off, CANVAS_WIDTH, CANVAS_HEIGHT, COLOR_WHITE);
-
-    for (l = MAX_LAYERS - 1; l >= 0; l--) {
-        if (!draw->layer_visible[l]) continue;
-        for (yy = 0; yy < CANVAS_HEIGHT; yy++) {
-            for (xx = 0; xx < CANVAS_WIDTH; xx++) {
-                p = draw->layers[l].pixels[yy * CANVAS_WIDTH + xx];
-                if (p != 0) {
-                    c = drawing_get_rgba_color(p, l);
-                    if (c != COLOR_TRANSPARENT)
-                        vita2d_draw_pixel(px_off + xx, py_off + yy, c);
-                }
-            }
-        }
-    }
+    render_layers(draw->layers, draw->layer_visible, px_off, py_off);
 
     cy_off = py_off + CANVAS_HEIGHT + 15;
     cx_off = (960 - 300) / 2;
@@ -620,7 +642,7 @@ void ui_render_layer_menu(UIContext *ui, DrawingContext *draw, InputState *input
     theme = get_theme_color(ui);
     vita2d_draw_rectangle(0, 0, 960, 544, RGBA8(0, 0, 0, 180));
 
-    wx = 250; wy = 80; ww = 460; wh = 400;
+    wx = 250; wy = 70; ww = 460; wh = 420;
     vita2d_draw_rectangle(wx, wy, ww, wh, RGBA8(50, 50, 50, 255));
     vita2d_draw_rectangle(wx, wy, ww, 30, theme);
     draw_text(wx + 10, wy + 22, COLOR_WHITE, "Gestione Layer");
@@ -667,6 +689,26 @@ void ui_render_layer_menu(UIContext *ui, DrawingContext *draw, InputState *input
     if (ui_button(wx+300, ly, 130, 35, "Inverti", COLOR_UI_BUTTON, input)) {
         drawing_save_undo(draw); drawing_invert_colors(draw);
     }
+    ly += 45;
+
+    if (ui_button(wx+20,  ly, 95, 35, "Copia", draw->has_selection ? theme : COLOR_UI_GRAY, input)) {
+        if (draw->has_selection) {
+            drawing_copy_selection(draw); ui_show_toast(ui, "Selezione copiata", 1.0f);
+        }
+    }
+    if (ui_button(wx+125, ly, 95, 35, "Taglia", draw->has_selection ? theme : COLOR_UI_GRAY, input)) {
+        if (draw->has_selection) {
+            drawing_save_undo(draw); drawing_cut_selection(draw);
+            ui_show_toast(ui, "Selezione tagliata", 1.0f);
+        }
+    }
+    if (ui_button(wx+230, ly, 95, 35, "Riempi", draw->has_selection ? theme : COLOR_UI_GRAY, input)) {
+        if (draw->has_selection) {
+            drawing_save_undo(draw); drawing_fill_selection(draw);
+        }
+    }
+    if (ui_button(wx+335, ly, 95, 35, "Desel.", COLOR_UI_BUTTON, input))
+        drawing_clear_selection(draw);
 
     if (ui_button(wx + ww - 100, wy + wh - 50, 80, 35, "Chiudi", RGBA8(200,50,50,255), input))
         ui_go_back(ui);
@@ -677,13 +719,13 @@ void ui_render_frame_menu(UIContext *ui, AnimationContext *anim,
                           DrawingContext *draw, InputState *input)
 {
     unsigned int theme;
-    int wx, wy, ww, wh, sy, btn_w, btn_h, gap_v, half, n, d;
+    int wx, wy, ww, wh, sy, btn_w, btn_h, gap_v, half, n, d, e;
     char info[64];
 
     theme = get_theme_color(ui);
     vita2d_draw_rectangle(0, 0, 960, 544, RGBA8(0, 0, 0, 180));
 
-    wx = 250; wy = 60; ww = 460; wh = 430;
+    wx = 250; wy = 40; ww = 460; wh = 470;
     vita2d_draw_rectangle(wx, wy, ww, wh, RGBA8(50, 50, 50, 255));
     vita2d_draw_rectangle(wx, wy, ww, 30, theme);
     draw_text(wx + 10, wy + 22, COLOR_WHITE, "Menu Frame");
@@ -767,6 +809,15 @@ void ui_render_frame_menu(UIContext *ui, AnimationContext *anim,
             animation_load_current_from_draw(anim, draw);
         }
     }
+    sy += btn_h + gap_v;
+
+    e = animation_get_exposure(anim, anim->current_frame);
+    snprintf(info, sizeof(info), "Esposizione: x%d", e);
+    draw_text(wx + 20, sy + 24, COLOR_WHITE, info);
+    if (ui_button(wx+200, sy, 50, btn_h, "-", COLOR_UI_BUTTON, input))
+        animation_set_exposure(anim, anim->current_frame, e - 1);
+    if (ui_button(wx+260, sy, 50, btn_h, "+", COLOR_UI_BUTTON, input))
+        animation_set_exposure(anim, anim->current_frame, e + 1);
 
     if (ui_button(wx + ww - 100, wy + wh - 50, 80, 35, "Chiudi", RGBA8(200,50,50,255), input))
         ui_go_back(ui);
@@ -915,11 +966,146 @@ void ui_render_sound_editor(UIContext *ui, AudioContext *audio,
         ui_go_back(ui);
 }
 
+/* ========== STREAM PLAYER ========== */
+// I frame arrivano dal file man mano (vedi player.c)
+void ui_render_stream_player(UIContext *ui, InputState *input) {
+    unsigned int theme;
+    int px_off, py_off, cy_off, cx_off;
+    const Frame *frame;
+    StreamPlayer *p = &ui->player;
+    char fc[32];
+
+    theme = get_theme_color(ui);
+    vita2d_draw_rectangle(0, 0, 960, 544, COLOR_BLACK);
+
+    px_off = (960 - CANVAS_WIDTH) / 2;
+    py_off = (544 - CANVAS_HEIGHT) / 2 - 20;
+
+    vita2d_draw_rectangle(px_off, py_off, CANVAS_WIDTH, CANVAS_HEIGHT, COLOR_WHITE);
+    frame = player_get_frame(p);
+    if (frame)
+        render_layers(frame->layers, NULL, px_off, py_off);
+    if (p->failed)
+        draw_text(px_off + 10, py_off + 24, COLOR_RED, "Errore di lettura");
+    else if (player_is_buffering(p))
+        draw_text(px_off + 10, py_off + 24, COLOR_UI_DARK, "Caricamento...");
+
+    cy_off = py_off + CANVAS_HEIGHT + 15;
+    cx_off = (960 - 300) / 2;
+
+    if (ui_button(cx_off + 30, cy_off, 60, 35, "<<", get_theme_dark(ui), input))
+        player_restart(p);
+    if (ui_button(cx_off + 100, cy_off, 60, 35, p->is_playing ? "||" : ">", theme, input))
+        player_toggle_play(p);
+    if (ui_button(cx_off + 170, cy_off, 130, 35, "Indietro", COLOR_UI_BUTTON, input)) {
+        player_close(p);
+        ui_go_back(ui);
+    }
+
+    snprintf(fc, sizeof(fc), "%d / %d", player_get_frame_index(p) + 1, p->frame_count);
+    draw_text(cx_off + 110, cy_off + 55, COLOR_WHITE, fc);
+    draw_text(cx_off, cy_off + 55,
+              p->loop ? COLOR_GREEN : COLOR_RED,
+              p->loop ? "Loop: ON" : "Loop: OFF");
+}
+
 /* ========== FILE BROWSER ========== */
+static void ui_open_stream_player(UIContext *ui, const SaveSlotInfo *slots, int count) {
+    if (ui->file_browser_selection < 0 || ui->file_browser_selection >= count) return;
+
+    if (player_open(&ui->player, slots[ui->file_browser_selection].filename))
+        ui_goto_screen(ui, SCREEN_STREAM_PLAYER);
+    else
+        ui_show_toast(ui, "Impossibile riprodurre il file", 2.0f);
+}
+
+static bool same_file(const BrowserPreview *bp, const SaveSlotInfo *slot) {
+    return bp->loaded && strcmp(bp->filename, slot->filename) == 0 &&
+           bp->size == slot->size && memcmp(&bp->mtime, &slot->mtime, sizeof(SceDateTime)) == 0;
+}
+
+// Anteprima dalla cache; al massimo una lettura da disco per frame
+// (*budget), le altre righe restano vuote fino al frame successivo
+static const FNVPreview *ui_get_preview(UIContext *ui, const SaveSlotInfo *slot, int *budget) {
+    BrowserPreview *bp, *oldest;
+    int i;
+
+    oldest = &ui->previews[0];
+    for (i = 0; i < BROWSER_PREVIEWS; i++) {
+        bp = &ui->previews[i];
+        if (same_file(bp, slot)) {
+            bp->last_used = ++ui->preview_clock;
+            return bp->preview.pixels ? &bp->preview : NULL;
+        }
+        if (!bp->loaded || (oldest->loaded && bp->last_used < oldest->last_used))
+            oldest = bp;
+    }
+
+    if (*budget <= 0) return NULL;
+    (*budget)--;
+
+    bp = oldest;
+    filemanager_free_preview(&bp->preview);
+    strncpy(bp->filename, slot->filename, sizeof(bp->filename) - 1);
+    bp->filename[sizeof(bp->filename) - 1] = '\0';
+    bp->size = slot->size;
+    bp->mtime = slot->mtime;
+    bp->loaded = true;
+    bp->last_used = ++ui->preview_clock;
+    filemanager_read_preview(slot->filename, &bp->preview);
+    return bp->preview.pixels ? &bp->preview : NULL;
+}
+
+// Righe di pixel uguali disegnate come un solo rettangolo
+static void render_preview(const FNVPreview *preview, int frame, int x, int y) {
+    int xx, yy, start, layer;
+    uint8_t c, run_c;
+    int run_layer;
+
+    vita2d_draw_rectangle(x, y, PREVIEW_WIDTH, PREVIEW_HEIGHT, COLOR_WHITE);
+    for (yy = 0; yy < PREVIEW_HEIGHT; yy++) {
+        start = 0;
+        run_c = 0;
+        run_layer = 0;
+        for (xx = 0; xx <= PREVIEW_WIDTH; xx++) {
+            layer = 0;
+            c = xx < PREVIEW_WIDTH ? filemanager_preview_pixel(preview, frame, xx, yy, &layer) : 0;
+            if (xx < PREVIEW_WIDTH && c == run_c && layer == run_layer) continue;
+            if (run_c != 0)
+                vita2d_draw_rectangle(x + start, y + yy, xx - start, 1,
+                                      drawing_get_rgba_color(run_c, run_layer));
+            start = xx;
+            run_c = c;
+            run_layer = layer;
+        }
+    }
+}
+
+// Sopra la lista mentre il file si carica: solo l'annullamento e' attivo
+static void ui_render_load_progress(UIContext *ui, InputState *input) {
+    int done, total, bar_w;
+    char buf[64];
+
+    filemanager_load_progress(&done, &total);
+    bar_w = total > 0 ? 360 * done / total : 0;
+
+    vita2d_draw_rectangle(0, 0, 960, 544, RGBA8(0, 0, 0, 180));
+    vita2d_draw_rectangle(280, 190, 400, 150, RGBA8(60, 60, 60, 255));
+    draw_text(300, 220, COLOR_WHITE, "Caricamento...");
+    vita2d_draw_rectangle(300, 240, 360, 20, COLOR_UI_DARK);
+    vita2d_draw_rectangle(300, 240, bar_w, 20, get_theme_color(ui));
+    snprintf(buf, sizeof(buf), "%d / %d frame", done, total);
+    draw_text(300, 285, COLOR_UI_LIGHT, buf);
+
+    if (ui_button(540, 295, 120, 35, "Annulla", RGBA8(200,50,50,255), input))
+        filemanager_cancel_load();
+}
+
 void ui_render_file_browser(UIContext *ui, InputState *input) {
     unsigned int theme;
-    int count, list_y, item_h, start, visible, i, idx, iy;
-    SaveSlotInfo slots[MAX_SAVE_SLOTS];
+    int count, list_y, item_h, start, visible, i, idx, iy, budget, frame;
+    const SaveSlotInfo *slots;
+    const FNVPreview *preview;
     char info_buf[64];
 
     theme = get_theme_color(ui);
@@ -927,7 +1113,7 @@ void ui_render_file_browser(UIContext *ui, InputState *input) {
     vita2d_draw_rectangle(0, 0, 960, 30, theme);
     draw_text(10, 22, COLOR_WHITE, "Flipnote salvati");
 
-    count = filemanager_list_saves(slots, MAX_SAVE_SLOTS);
+    slots = filemanager_get_saves(&count);
     ui->file_browser_count = count;
 
     if (count == 0) {
@@ -936,6 +1122,7 @@ void ui_render_file_browser(UIContext *ui, InputState *input) {
         list_y = 40; item_h = 60;
         start = ui->file_browser_scroll;
         visible = (544 - 80) / item_h;
+        budget = 1;
 
         for (i = 0; i < visible && (start + i) < count; i++) {
             unsigned int bg_c;
@@ -944,20 +1131,39 @@ void ui_render_file_browser(UIContext *ui, InputState *input) {
             bg_c = (idx == ui->file_browser_selection)
                    ? RGBA8(80,80,80,255) : RGBA8(60,60,60,255);
             vita2d_draw_rectangle(10, iy, 940, item_h - 5, bg_c);
-            draw_text(20, iy + 25, COLOR_WHITE, slots[idx].title);
+
+            preview = ui_get_preview(ui, &slots[idx], &budget);
+            if (preview) {
+                frame = (int)(ui->preview_time * 1000.0f / preview->header.interval_ms);
+                render_preview(preview, frame % preview->header.frame_count, 16, iy + 3);
+            } else {
+                vita2d_draw_rectangle(16, iy + 3, PREVIEW_WIDTH, PREVIEW_HEIGHT, RGBA8(90,90,90,255));
+            }
+
+            draw_text(92, iy + 25, COLOR_WHITE, slots[idx].title);
             snprintf(info_buf, sizeof(info_buf), "di %s - %d frame",
                      slots[idx].author, slots[idx].frame_count);
-            draw_text(20, iy + 45, COLOR_UI_LIGHT, info_buf);
+            draw_text(92, iy + 45, COLOR_UI_LIGHT, info_buf);
             if (input->touch_just_pressed &&
                 point_in_rect(input->touch_x, input->touch_y, 10, iy, 940, item_h-5))
                 ui->file_browser_selection = idx;
         }
     }
 
-    if (ui_button(10, 500, 120, 35, "Carica", theme, input)) {
-        /* caricamento gestito in ui_update */
+    if (filemanager_load_busy()) {
+        ui_render_load_progress(ui, input);
+        return;
     }
-    if (ui_button(140, 500, 120, 35, "Elimina", RGBA8(200,50,50,255), input)) {
+
+    if (ui_button(10, 500, 120, 35, "Carica", theme, input))
+        ui->load_requested = 1;     // caricamento gestito in ui_update
+    if (ui_button(140, 500, 120, 35, "Guarda", theme, input))
+        ui_open_stream_player(ui, slots, count);
+    if (count > (544 - 80) / 60) {
+        snprintf(info_buf, sizeof(info_buf), "%d/%d", ui->file_browser_selection + 1, count);
+        draw_text(410, 524, COLOR_UI_LIGHT, info_buf);
+    }
+    if (ui_button(270, 500, 120, 35, "Elimina", RGBA8(200,50,50,255), input)) {
         if (ui->file_browser_selection >= 0 && ui->file_browser_selection < count)
             filemanager_delete(slots[ui->file_browser_selection].filename);
     }
@@ -991,6 +1197,13 @@ void ui_render_settings(UIContext *ui, InputState *input) {
                   ui->show_frame_counter ? "Contatore Frame: ON" : "Contatore Frame: OFF",
                   ui->show_frame_counter ? theme : COLOR_UI_GRAY, input))
         ui->show_frame_counter = !ui->show_frame_counter;
+    sy += 50;
+
+    // Vale per i salvataggi successivi; i file gia' scritti restano come sono
+    if (ui_button(30, sy, 300, 35,
+                  filemanager_get_tile_store() ? "Archivio Tile: ON" : "Archivio Tile: OFF",
+                  filemanager_get_tile_store() ? theme : COLOR_UI_GRAY, input))
+        filemanager_set_tile_store(!filemanager_get_tile_store());
     sy += 80;
 
     draw_text(30, sy, COLOR_UI_LIGHT, "Flipnote Studio per PS Vita");   sy += 25;
@@ -1021,7 +1234,7 @@ void ui_render_export_menu(UIContext *ui, AnimationContext *anim,
     theme = get_theme_color(ui);
     vita2d_draw_rectangle(0, 0, 960, 544, RGBA8(0, 0, 0, 180));
 
-    wx = 250; wy = 100; ww = 460; wh = 300;
+    wx = 250; wy = 39; ww = 460; wh = 465;
     vita2d_draw_rectangle(wx, wy, ww, wh, RGBA8(50, 50, 50, 255));
     vita2d_draw_rectangle(wx, wy, ww, 30, theme);
     draw_text(wx + 10, wy + 22, COLOR_WHITE, "Esporta");
@@ -1030,12 +1243,15 @@ void ui_render_export_menu(UIContext *ui, AnimationContext *anim,
 
     if (ui_button(wx+20, sy, btn_w, 40, "Salva Flipnote (.fnv)", theme, input)) {
         filemanager_generate_filename(fn, sizeof(fn));
-        if (filemanager_save(anim, audio, fn))
-            ui_show_toast(ui, "Salvato con successo!", 2.0f);
+        // L'esito arriva con filemanager_poll_save (main.c)
+        if (filemanager_save_async(anim, audio, fn, false))
+            ui_show_toast(ui, "Salvataggio in corso...", 2.0f);
+        else if (filemanager_save_busy())
+            ui_show_toast(ui, "Salvataggio gia' in corso", 2.0f);
         else
             ui_show_toast(ui, "Errore nel salvataggio!", 2.0f);
     }
-    sy += 50;
+    sy += 45;
 
     if (ui_button(wx+20, sy, btn_w, 40, "Esporta GIF Animata", theme, input)) {
         snprintf(fn, sizeof(fn), "%sexport.gif", SAVE_DIR);
@@ -1044,7 +1260,34 @@ void ui_render_export_menu(UIContext *ui, AnimationContext *anim,
         else
             ui_show_toast(ui, "Errore nell'esportazione!", 2.0f);
     }
-    sy += 50;
+    sy += 45;
+
+    if (ui_button(wx+20, sy, btn_w, 40, "Esporta PNG Animato", theme, input)) {
+        snprintf(fn, sizeof(fn), "%sexport.png", SAVE_DIR);
+        if (filemanager_export_apng(anim, fn))
+            ui_show_toast(ui, "PNG animato esportato!", 2.0f);
+        else
+            ui_show_toast(ui, "Errore nell'esportazione!", 2.0f);
+    }
+    sy += 45;
+
+    if (ui_button(wx+20, sy, btn_w, 40, "Esporta Video AVI", theme, input)) {
+        snprintf(fn, sizeof(fn), "%sexport.avi", SAVE_DIR);
+        if (filemanager_export_avi(anim, audio, fn))
+            ui_show_toast(ui, "Video esportato!", 2.0f);
+        else
+            ui_show_toast(ui, "Errore nell'esportazione!", 2.0f);
+    }
+    sy += 45;
+
+    if (ui_button(wx+20, sy, btn_w, 40, "Esporta Audio WAV", theme, input)) {
+        snprintf(fn, sizeof(fn), "%sexport.wav", SAVE_DIR);
+        if (filemanager_export_wav(anim, audio, fn))
+            ui_show_toast(ui, "Audio esportato!", 2.0f);
+        else
+            ui_show_toast(ui, "Errore nell'esportazione!", 2.0f);
+    }
+    sy += 45;
 
     if (ui_button(wx+20, sy, btn_w, 40, "Esporta Sequenza Immagini", theme, input)) {
         snprintf(fn, sizeof(fn), "%sframes/", SAVE_DIR);
@@ -1053,10 +1296,19 @@ void ui_render_export_menu(UIContext *ui, AnimationContext *anim,
         else
             ui_show_toast(ui, "Errore nell'esportazione!", 2.0f);
     }
-    sy += 50;
+    sy += 45;
+
+    if (ui_button(wx+20, sy, btn_w, 40, "Esporta Sprite Sheet", theme, input)) {
+        snprintf(fn, sizeof(fn), "%ssheet/", SAVE_DIR);
+        if (filemanager_export_sprite_sheet(anim, fn))
+            ui_show_toast(ui, "Sprite sheet esportato!", 2.0f);
+        else
+            ui_show_toast(ui, "Errore nell'esportazione!", 2.0f);
+    }
+    sy += 45;
 
     if (ui_button(wx+20, sy, btn_w, 40, "Esporta Frame Corrente", theme, input)) {
-        snprintf(fn, sizeof(fn), "%sframe_%d.bmp", SAVE_DIR, anim->current_frame);
+        snprintf(fn, sizeof(fn), "%sframe_%d.png", SAVE_DIR, anim->current_frame);
         if (filemanager_export_frame_png(anim, anim->current_frame, fn))
             ui_show_toast(ui, "Frame esportato!", 2.0f);
         else
@@ -1092,7 +1344,8 @@ void ui_render_help(UIContext *ui, InputState *input) {
     draw_text(30, sy, COLOR_WHITE, "R - Rettangolo");                    sy += lh;
     draw_text(30, sy, COLOR_WHITE, "C - Cerchio");                       sy += lh;
     draw_text(30, sy, COLOR_WHITE, "M - Sposta: muovi il contenuto");    sy += lh;
-    draw_text(30, sy, COLOR_WHITE, "S - Seleziona: seleziona un'area");  sy += lh;
+    draw_text(30, sy, COLOR_WHITE, "S - Seleziona: lazo, tocco = bacchetta magica");  sy += lh;
+    draw_text(30, sy, COLOR_WHITE, "    tieni R = aggiungi, L = sottrai, L+R = interseca"); sy += lh;
     draw_text(30, sy, COLOR_WHITE, "T - Timbro: incolla selezione");     sy += lh;
     draw_text(30, sy, COLOR_WHITE, "D - Contagocce: preleva colore");    sy += lh + 10;
     draw_text(30, sy, COLOR_UI_SELECTED, "Max 999 frame per animazione"); sy += lh;
@@ -1108,11 +1361,19 @@ void ui_update(UIContext *ui, DrawingContext *draw, AnimationContext *anim,
                AudioContext *audio, InputState *input, float delta_time)
 {
     if (ui->current_screen == SCREEN_EDITOR) {
-        /* L / R */
-        if (input_button_pressed(input, SCE_CTRL_LTRIGGER))
-            animation_prev_frame(anim, draw);
-        if (input_button_pressed(input, SCE_CTRL_RTRIGGER))
-            animation_next_frame(anim, draw);
+        /* L / R: frame; con la selezione tenuti scelgono come combinare
+           la nuova area (R = aggiungi, L = sottrai, L+R = interseca) */
+        if (draw->current_tool == TOOL_SELECT) {
+            int l = input_button_held(input, SCE_CTRL_LTRIGGER);
+            int r = input_button_held(input, SCE_CTRL_RTRIGGER);
+            ui->select_op = (l && r) ? SEL_INTERSECT : r ? SEL_UNION :
+                            l ? SEL_SUBTRACT : SEL_REPLACE;
+        } else {
+            if (input_button_pressed(input, SCE_CTRL_LTRIGGER))
+                animation_prev_frame(anim, draw);
+            if (input_button_pressed(input, SCE_CTRL_RTRIGGER))
+                animation_next_frame(anim, draw);
+        }
 
         /* Triangle */
         if (input_button_pressed(input, SCE_CTRL_TRIANGLE)) {
@@ -1206,6 +1467,17 @@ void ui_update(UIContext *ui, DrawingContext *draw, AnimationContext *anim,
                     case TOOL_RECT:
                     case TOOL_CIRCLE:
                         break;
+                    case TOOL_STAMP:
+                        if (draw->has_stamp)
+                            drawing_stamp_stroke(draw, cx, cy);
+                        else if (input->touch_just_pressed)
+                            ui_show_toast(ui, "Copia prima una selezione", 1.0f);
+                        break;
+                    case TOOL_SELECT:
+                        if (input->touch_just_pressed)
+                            draw->lasso_count = 0;
+                        drawing_lasso_add_point(draw, cx, cy);
+                        break;
                     default:
                         drawing_pen_stroke(draw, cx, cy);
                         break;
@@ -1226,6 +1498,20 @@ void ui_update(UIContext *ui, DrawingContext *draw, AnimationContext *anim,
                     int ddy = ey - draw->start_y;
                     int r = (int)sqrtf((float)(ddx*ddx + ddy*ddy));
                     drawing_circle(draw, draw->start_x, draw->start_y, r, 0);
+                } else if (draw->current_tool == TOOL_SELECT && draw->lasso_count > 0) {
+                    /* Trascinamento = lazo, tocco singolo = bacchetta magica */
+                    int li, lw = 0, lh = 0;
+                    for (li = 1; li < draw->lasso_count; li++) {
+                        if (abs(draw->lasso_x[li] - draw->lasso_x[0]) > lw) lw = abs(draw->lasso_x[li] - draw->lasso_x[0]);
+                        if (abs(draw->lasso_y[li] - draw->lasso_y[0]) > lh) lh = abs(draw->lasso_y[li] - draw->lasso_y[0]);
+                    }
+                    if (draw->lasso_count >= 3 && (lw > 2 || lh > 2))
+                        drawing_select_lasso(draw, draw->lasso_x, draw->lasso_y,
+                                             draw->lasso_count, ui->select_op);
+                    else
+                        drawing_select_magic_wand(draw, draw->lasso_x[0], draw->lasso_y[0], ui->select_op);
+                    draw->lasso_count = 0;
+                    ui_show_toast(ui, draw->has_selection ? "Selezione" : "Nessuna selezione", 0.8f);
                 }
                 draw->is_drawing = 0;
             }
@@ -1329,6 +1615,63 @@ void ui_update(UIContext *ui, DrawingContext *draw, AnimationContext *anim,
             ui_goto_screen(ui, SCREEN_EDITOR);
         }
     }
+    else if (ui->current_screen == SCREEN_FILE_BROWSER) {
+        int visible = (544 - 80) / 60;
+        int sel = ui->file_browser_selection;
+
+        // Durante il caricamento il browser resta fermo; l'esito arriva
+        // con filemanager_poll_load (main.c)
+        if (filemanager_load_busy()) {
+            ui->load_requested = 0;
+            if (input_button_pressed(input, SCE_CTRL_CIRCLE))
+                filemanager_cancel_load();
+            return;
+        }
+        if (input_button_pressed(input, SCE_CTRL_CROSS)) ui->load_requested = 1;
+        if (ui->load_requested) {
+            const SaveSlotInfo *slots;
+            int count;
+            ui->load_requested = 0;
+            slots = filemanager_get_saves(&count);
+            if (sel >= 0 && sel < count && !filemanager_load_async(audio, slots[sel].filename))
+                ui_show_toast(ui, "Impossibile caricare il file", 2.0f);
+        }
+
+        // Riparte ogni ora per non perdere precisione
+        ui->preview_time += delta_time;
+        if (ui->preview_time >= 3600.0f) ui->preview_time -= 3600.0f;
+
+        if (input_button_pressed(input, SCE_CTRL_UP)) sel--;
+        if (input_button_pressed(input, SCE_CTRL_DOWN)) sel++;
+        if (input_button_pressed(input, SCE_CTRL_LEFT)) sel -= visible;
+        if (input_button_pressed(input, SCE_CTRL_RIGHT)) sel += visible;
+        if (sel >= ui->file_browser_count) sel = ui->file_browser_count - 1;
+        if (sel < 0) sel = 0;
+        ui->file_browser_selection = sel;
+
+        if (sel < ui->file_browser_scroll)
+            ui->file_browser_scroll = sel;
+        if (sel >= ui->file_browser_scroll + visible)
+            ui->file_browser_scroll = sel - visible + 1;
+
+        if (input_button_pressed(input, SCE_CTRL_SQUARE)) {
+            const SaveSlotInfo *slots;
+            int count;
+            slots = filemanager_get_saves(&count);
+            ui_open_stream_player(ui, slots, count);
+        }
+        if (input_button_pressed(input, SCE_CTRL_CIRCLE))
+            ui_go_back(ui);
+    }
+    else if (ui->current_screen == SCREEN_STREAM_PLAYER) {
+        player_update(&ui->player, delta_time);
+        if (input_button_pressed(input, SCE_CTRL_CROSS))
+            player_toggle_play(&ui->player);
+        if (input_button_pressed(input, SCE_CTRL_CIRCLE)) {
+            player_close(&ui->player);
+            ui_go_back(ui);
+        }
+    }
     else if (ui->current_screen == SCREEN_TITLE) {
         if (input_button_pressed(input, SCE_CTRL_START) ||
             input_button_pressed(input, SCE_CTRL_CROSS))
@@ -5,11 +5,13 @@
 #include "animation.h"
 #include "audio.h"
 #include "input.h"
+#include "player.h"
 
 typedef enum {
     SCREEN_TITLE,
     SCREEN_EDITOR,
     SCREEN_PLAYBACK,
+    SCREEN_STREAM_PLAYER,
     SCREEN_FILE_BROWSER,
     SCREEN_SETTINGS,
     SCREEN_TOOL_OPTIONS,
@@ -32,6 +34,17 @@ typedef enum {
     MENU_ANIMATION
 } MenuType;
 
+#define BROWSER_PREVIEWS 8      // Anteprime in memoria, almeno le righe visibili
+
+typedef struct {
+    char filename[256];
+    SceOff size;                // Un file riscritto va riletto
+    SceDateTime mtime;
+    FNVPreview preview;         // pixels NULL = file senza anteprima
+    bool loaded;
+    int last_used;
+} BrowserPreview;
+
 typedef struct {
     ScreenState current_screen;
     ScreenState prev_screen;
@@ -55,8 +68,15 @@ typedef struct {
     int file_browser_selection;
     int file_browser_scroll;
     int file_browser_count;
+    int load_requested;         // Avviato in ui_update, che ha animazione e audio
+    BrowserPreview previews[BROWSER_PREVIEWS];
+    int preview_clock;          // Per scartare l'anteprima meno recente
+    float preview_time;
+
+    StreamPlayer player;        // Visione di un file senza caricarlo
 
     int layer_menu_selection;
+    SelectionOp select_op;      // Da L/R tenuti mentre si seleziona
 
     char toast_message[128];
     float toast_timer;
@@ -76,6 +96,7 @@ void ui_render_editor(UIContext *ui, DrawingContext *draw, AnimationContext *ani
                       AudioContext *audio, InputState *input);
 void ui_render_playback(UIContext *ui, DrawingContext *draw, AnimationContext *anim,
                         AudioContext *audio, InputState *input);
+void ui_render_stream_player(UIContext *ui, InputState *input);
 void ui_render_file_browser(UIContext *ui, InputState *input);
 void ui_render_settings(UIContext *ui, InputState *input);
 void ui_render_color_picker(UIContext *ui, DrawingContext *draw, InputState *input);
@@ -0,0 +1,80 @@
+#include "worker.h"
+#include <psp2/kernel/threadmgr.h>
+#include <string.h>
+
+static int worker_thread(SceSize args, void *argp) {
+    Worker *w = *(Worker **)argp;
+    (void)args;
+
+    for (;;) {
+        sceKernelWaitSema(w->job_sema, 1, NULL);
+        if (__atomic_load_n(&w->quit, __ATOMIC_ACQUIRE)) break;
+
+        w->func(w->arg);
+        // I risultati del lavoro devono essere visibili prima di busy = 0
+        __atomic_store_n(&w->busy, 0, __ATOMIC_RELEASE);
+        sceKernelSignalSema(w->done_sema, 1);
+    }
+
+    return 0;
+}
+
+bool worker_start(Worker *w, const char *name, int priority) {
+    Worker *self = w;
+
+    memset(w, 0, sizeof(Worker));
+    w->job_sema = sceKernelCreateSema(name, 0, 0, 1, NULL);
+    w->done_sema = sceKernelCreateSema(name, 0, 0, 1, NULL);
+    w->thread = -1;
+    if (w->job_sema >= 0 && w->done_sema >= 0) {
+        w->thread = sceKernelCreateThread(name, worker_thread, priority,
+                                          WORKER_STACK_SIZE, 0, 0, NULL);
+    }
+    if (w->thread < 0) {
+        if (w->job_sema >= 0) sceKernelDeleteSema(w->job_sema);
+        if (w->done_sema >= 0) sceKernelDeleteSema(w->done_sema);
+        w->job_sema = -1;
+        w->done_sema = -1;
+        return false;
+    }
+
+    // L'argomento viene copiato nello stack del thread: si passa il puntatore
+    sceKernelStartThread(w->thread, sizeof(Worker *), &self);
+    return true;
+}
+
+void worker_stop(Worker *w) {
+    if (w->thread < 0 || w->job_sema < 0) return;
+
+    worker_wait(w);
+    __atomic_store_n(&w->quit, 1, __ATOMIC_RELEASE);
+    sceKernelSignalSema(w->job_sema, 1);
+    sceKernelWaitThreadEnd(w->thread, NULL, NULL);
+    sceKernelDeleteThread(w->thread);
+    sceKernelDeleteSema(w->job_sema);
+    sceKernelDeleteSema(w->done_sema);
+    w->thread = -1;
+    w->job_sema = -1;
+    w->done_sema = -1;
+}
+
+bool worker_submit(Worker *w, WorkerFunc func, void *arg) {
+    if (worker_busy(w)) return false;
+
+    w->func = func;
+    w->arg = arg;
+    __atomic_store_n(&w->busy, 1, __ATOMIC_RELEASE);
+    sceKernelSignalSema(w->job_sema, 1);
+    return true;
+}
+
+// acquire: se busy e' 0 i risultati del lavoro sono gia' visibili
+bool worker_busy(const Worker *w) {
+    return __atomic_load_n(&w->busy, __ATOMIC_ACQUIRE) != 0;
+}
+
+// done_sema arriva al massimo a 1: un segnale lasciato da un lavoro
+// gia' raccolto con worker_busy sveglia a vuoto e si riattende
+void worker_wait(const Worker *w) {
+    while (worker_busy(w)) sceKernelWaitSema(w->done_sema, 1, NULL);
+}
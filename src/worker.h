@@ -0,0 +1,40 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <psp2/types.h>
+#include <stdbool.h>
+
+// Priorita' sotto il thread principale: il disegno resta fluido
+#define WORKER_PRIORITY_LOW 160
+
+// I lavori chiamano zlib, libpng e libjpeg: il picco misurato da
+// tests/bench_workers.c e' sotto i 16 KB, un quarto di questo
+#define WORKER_STACK_SIZE (64 * 1024)
+
+typedef void (*WorkerFunc)(void *arg);
+
+// Thread di servizio che esegue un lavoro alla volta.
+// submit, busy e wait vanno chiamati da un solo thread alla volta (il
+// proprietario). Un worker condiviso tra piu' thread, come il pool di
+// codifica di filemanager, passa di mano solo a worker fermo: chi lo
+// prende (codec_pool_claim) attende i propri lavori con worker_wait
+// prima di restituirlo (codec_pool_release).
+typedef struct {
+    SceUID thread;
+    SceUID job_sema;        // Segnalato a ogni lavoro (o alla chiusura)
+    SceUID done_sema;       // Segnalato alla fine di ogni lavoro
+    WorkerFunc func;
+    void *arg;
+    int busy;               // Accessi atomici (acquire/release)
+    int quit;
+} Worker;
+
+bool worker_start(Worker *w, const char *name, int priority);
+void worker_stop(Worker *w);
+
+// false se il worker sta gia' eseguendo un lavoro
+bool worker_submit(Worker *w, WorkerFunc func, void *arg);
+bool worker_busy(const Worker *w);
+void worker_wait(const Worker *w);
+
+#endif
@@ -0,0 +1,136 @@
+// Rapporto di compressione e velocita' dei codec di frame su un corpus
+// sintetico: tratti (fixture), disegni fatti con gli strumenti veri di
+// drawing.c, frame quasi vuoti e retino casuale. RLE e' il codec del
+// formato originale; ogni frame viene anche decodificato e confrontato.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "codec.h"
+#include "fixture.h"
+#include "test.h"
+
+#define RAW_FRAME (MAX_LAYERS * LAYER_PIXELS)
+
+typedef struct {
+    const char *name;
+    AnimationContext anim;
+} Corpus;
+
+// Disegno con penna, gomma, forme e secchiello su tutti e tre i layer
+static void corpus_drawn(AnimationContext *anim, int count) {
+    DrawingContext *draw = malloc(sizeof(DrawingContext));
+    int f, k, j;
+
+    animation_init(anim);
+    drawing_init(draw);
+    while (anim->frame_count < count) animation_add_frame(anim);
+
+    for (f = 0; f < count; f++) {
+        drawing_reset(draw);
+        fixture_seed = 1000 + f / 3;    // Disegni tenuti per tre frame
+
+        draw->active_layer = 0;
+        draw->current_tool = TOOL_PEN;
+        for (k = 0; k < 6; k++) {
+            draw->brush_size = 1 + (int)(fixture_rand() % 4);
+            draw->current_color = 1 + (uint8_t)(fixture_rand() % 3);
+            draw->is_drawing = 0;
+            for (j = 0; j < 40; j++)
+                drawing_pen_stroke(draw, (int)(fixture_rand() % CANVAS_WIDTH),
+                                   (int)(fixture_rand() % CANVAS_HEIGHT));
+        }
+
+        draw->active_layer = 1;
+        draw->current_color = 2;
+        drawing_rect(draw, 50 + f, 60, 200 + f, 160, 1);
+        drawing_circle(draw, 300, 200 + f % 20, 40, 0);
+        draw->current_color = 3;
+        drawing_bucket_fill(draw, 300, 200 + f % 20);
+
+        draw->active_layer = 2;
+        draw->brush_size = 8;
+        draw->current_color = 1;
+        drawing_line(draw, 0, 370, CANVAS_WIDTH - 1, 300 + f % 30);
+        draw->current_tool = TOOL_ERASER;
+        draw->is_drawing = 0;
+        drawing_eraser_stroke(draw, 100, 330);
+        drawing_eraser_stroke(draw, 160, 330);
+
+        memcpy(anim->frames[f].layers, draw->layers, sizeof(draw->layers));
+    }
+    free(draw);
+}
+
+// Pochi tratti su layer per lo piu' vuoti (storyboard, frame iniziali)
+static void corpus_sparse(AnimationContext *anim, int count) {
+    int f;
+    animation_init(anim);
+    while (anim->frame_count < count) animation_add_frame(anim);
+    for (f = 0; f < count; f++) {
+        fixture_line(&anim->frames[f].layers[0], 100, 100 + f, 400, 120, 1, 1);
+        fixture_disc(&anim->frames[f].layers[0], 256, 192, 3 + f % 5, 2);
+    }
+}
+
+static void bench(Corpus *c, FrameCodec codec, int level) {
+    CodecContext ctx;
+    uint8_t *out = malloc(CODEC_MAX_SIZE);
+    LayerData *back = malloc(sizeof(LayerData) * MAX_LAYERS);
+    uint64_t raw = 0, packed = 0;
+    double enc = 0, dec = 0, t0;
+    int f, bad = 0;
+    uint32_t n;
+    uint8_t used;
+    char label[32];
+
+    codec_init(&ctx, codec, level);
+    for (f = 0; f < c->anim.frame_count; f++) {
+        t0 = test_now_ms();
+        n = codec_encode(&ctx, c->anim.frames[f].layers, out, &used);
+        enc += test_now_ms() - t0;
+        CHECK(n > 0);
+
+        t0 = test_now_ms();
+        if (!codec_decode(&ctx, used, out, n, back)) bad++;
+        dec += test_now_ms() - t0;
+        if (memcmp(back, c->anim.frames[f].layers, sizeof(LayerData) * MAX_LAYERS) != 0) bad++;
+
+        raw += RAW_FRAME;
+        packed += n;
+    }
+    codec_free(&ctx);
+    CHECK(bad == 0);
+
+    if (codec == CODEC_RLE) snprintf(label, sizeof(label), "RLE");
+    else snprintf(label, sizeof(label), "%s %d", codec_name(codec), level);
+    printf("  %-8s %-10s %9.1f KB/frame %7.1fx %8.0f MB/s enc %8.0f MB/s dec\n",
+           c->name, label, (double)packed / c->anim.frame_count / 1024.0,
+           (double)raw / packed, raw / (enc / 1000.0) / 1e6, raw / (dec / 1000.0) / 1e6);
+
+    free(out);
+    free(back);
+}
+
+int main(void) {
+    static Corpus corpus[4];
+    int i;
+
+    corpus[0].name = "tratti";
+    fixture_animation(&corpus[0].anim, 60, FIXTURE_LINEART);
+    corpus[1].name = "disegno";
+    corpus_drawn(&corpus[1].anim, 30);
+    corpus[2].name = "vuoti";
+    corpus_sparse(&corpus[2].anim, 60);
+    corpus[3].name = "retino";
+    fixture_animation(&corpus[3].anim, 6, FIXTURE_DENSE);
+
+    printf("bench_codec (frame da %d KB, dimensione media dopo la codifica)\n", RAW_FRAME / 1024);
+    for (i = 0; i < 4; i++) {
+        bench(&corpus[i], CODEC_RLE, 0);
+        bench(&corpus[i], CODEC_DEFLATE2, 1);
+        bench(&corpus[i], CODEC_DEFLATE2, CODEC_DEFAULT_LEVEL);
+        bench(&corpus[i], CODEC_DEFLATE2, 9);
+        animation_free(&corpus[i].anim);
+    }
+    return test_exit("bench_codec");
+}
@@ -0,0 +1,185 @@
+// Chiamate di sistema e throughput dell'I/O dei file. Prima parte: lo
+// stesso stream RLE (coppie conteggio/valore, come il vecchio formato v1)
+// scritto e letto con una sceIoWrite/sceIoRead per byte, come faceva
+// filemanager prima di fileio, e attraverso FileWriter/FileReader.
+// Seconda parte: i percorsi reali di salvataggio, caricamento ed export.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES       60
+#define DENSE_FRAMES 6     // Il percorso a 1 byte per chiamata e' lentissimo
+
+static long ops_opens, ops_reads, ops_writes, ops_seeks;
+
+static void ops_begin(void) {
+    ops_opens = sce_host_opens;
+    ops_reads = sce_host_reads;
+    ops_writes = sce_host_writes;
+    ops_seeks = sce_host_seeks;
+}
+
+static long ops_total(void) {
+    return (sce_host_opens - ops_opens) + (sce_host_reads - ops_reads) +
+           (sce_host_writes - ops_writes) + (sce_host_seeks - ops_seeks);
+}
+
+static void report(const char *name, double ms, long syscalls, SceOff bytes) {
+    printf("  %-34s %9ld syscall %9.1f ms %8.1f MB/s\n", name, syscalls, ms,
+           ms > 0 ? (double)bytes / (ms / 1000.0) / 1e6 : 0.0);
+}
+
+// Stream RLE di tutti i layer: run da 1..255 byte uguali
+static uint8_t *rle_stream(AnimationContext *anim, uint32_t *size) {
+    uint32_t cap = 1 << 20, n = 0;
+    uint8_t *out = malloc(cap);
+    int f, l, i, run;
+
+    for (f = 0; f < anim->frame_count; f++) {
+        for (l = 0; l < MAX_LAYERS; l++) {
+            const uint8_t *p = anim->frames[f].layers[l].pixels;
+            for (i = 0; i < CANVAS_WIDTH * CANVAS_HEIGHT; i += run) {
+                run = 1;
+                while (i + run < CANVAS_WIDTH * CANVAS_HEIGHT && run < 255 && p[i + run] == p[i]) run++;
+                if (n + 2 > cap) out = realloc(out, cap *= 2);
+                out[n++] = (uint8_t)run;
+                out[n++] = p[i];
+            }
+        }
+    }
+    *size = n;
+    return out;
+}
+
+static void bench_stream(const char *label, AnimationContext *anim, const char *path) {
+    uint32_t size, i;
+    uint8_t *stream = rle_stream(anim, &size);
+    uint8_t *back = malloc(size);
+    FileWriter w;
+    FileReader r;
+    SceUID fd;
+    double t0;
+
+    printf("%s: stream RLE di %u byte (%u run)\n", label, size, size / 2);
+
+    ops_begin();
+    t0 = test_now_ms();
+    fd = sceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+    for (i = 0; i < size; i += 2) {
+        sceIoWrite(fd, &stream[i], 1);
+        sceIoWrite(fd, &stream[i + 1], 1);
+    }
+    sceIoClose(fd);
+    report("scrittura, 1 byte per chiamata", test_now_ms() - t0, ops_total(), size);
+
+    ops_begin();
+    t0 = test_now_ms();
+    fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+    for (i = 0; i < size; i += 2) {
+        sceIoRead(fd, &back[i], 1);
+        sceIoRead(fd, &back[i + 1], 1);
+    }
+    sceIoClose(fd);
+    report("lettura, 1 byte per chiamata", test_now_ms() - t0, ops_total(), size);
+    CHECK(memcmp(back, stream, size) == 0);
+
+    memset(back, 0, size);
+    ops_begin();
+    t0 = test_now_ms();
+    CHECK(fileio_open_write(&w, path));
+    for (i = 0; i < size; i += 2) {
+        fileio_put(&w, stream[i]);
+        fileio_put(&w, stream[i + 1]);
+    }
+    CHECK(fileio_close_write(&w));
+    report("scrittura, FileWriter", test_now_ms() - t0, ops_total(), size);
+
+    ops_begin();
+    t0 = test_now_ms();
+    CHECK(fileio_open_read(&r, path));
+    for (i = 0; i < size; i += 2) {
+        fileio_get(&r, &back[i]);
+        fileio_get(&r, &back[i + 1]);
+    }
+    CHECK(!r.error);
+    fileio_close_read(&r);
+    report("lettura, FileReader", test_now_ms() - t0, ops_total(), size);
+    CHECK(memcmp(back, stream, size) == 0);
+
+    free(stream);
+    free(back);
+}
+
+static SceOff file_size(const char *path) {
+    SceIoStat st;
+    return sceIoGetstat(path, &st) == 0 ? st.st_size : 0;
+}
+
+static void bench_paths(const char *label, AnimationContext *anim, AudioContext *audio,
+                        DrawingContext *draw)
+{
+    static AnimationContext loaded;
+    const char *fnv = SAVE_DIR "bench_fileio.fnv";
+    const char *gif = SAVE_DIR "bench_fileio.gif";
+    double t0;
+    bool ok;
+
+    printf("%s: percorsi di filemanager\n", label);
+
+    ops_begin();
+    t0 = test_now_ms();
+    ok = filemanager_save(anim, audio, fnv);
+    report("filemanager_save", test_now_ms() - t0, ops_total(), file_size(fnv));
+    CHECK(ok);
+
+    animation_init(&loaded);
+    ops_begin();
+    t0 = test_now_ms();
+    ok = filemanager_load(&loaded, audio, draw, fnv);
+    report("filemanager_load", test_now_ms() - t0, ops_total(), file_size(fnv));
+    CHECK(ok);
+    CHECK(loaded.frame_count == anim->frame_count);
+    CHECK(ok && animation_get_hash(&loaded) == animation_get_hash(anim));
+    animation_free(&loaded);
+
+    ops_begin();
+    t0 = test_now_ms();
+    ok = filemanager_export_gif(anim, gif);
+    report("filemanager_export_gif", test_now_ms() - t0, ops_total(), file_size(gif));
+    CHECK(ok);
+
+    sceIoRemove(fnv);
+    sceIoRemove(gif);
+}
+
+int main(int argc, char **argv) {
+    static AnimationContext anim;
+    static AudioContext audio;
+    DrawingContext *draw = malloc(sizeof(DrawingContext));
+    const char *stream_path = SAVE_DIR "bench_fileio.bin";
+
+    if (argc > 1) sce_host_set_root(argv[1]);
+    filemanager_init();
+    filemanager_set_tile_store(false);
+    drawing_init(draw);
+
+    printf("bench_fileio (%d frame a tratti, %d a retino)\n", FRAMES, DENSE_FRAMES);
+    fixture_audio(&audio, FRAMES);
+
+    fixture_animation(&anim, FRAMES, FIXTURE_LINEART);
+    bench_stream("tratti", &anim, stream_path);
+    bench_paths("tratti", &anim, &audio, draw);
+    animation_free(&anim);
+
+    fixture_animation(&anim, DENSE_FRAMES, FIXTURE_DENSE);
+    bench_stream("retino", &anim, stream_path);
+    bench_paths("retino", &anim, &audio, draw);
+    animation_free(&anim);
+
+    sceIoRemove(stream_path);
+    free(draw);
+    return test_exit("bench_fileio");
+}
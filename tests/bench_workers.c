@@ -0,0 +1,144 @@
+// Worker: latenza di worker_wait, scalabilita' del salvataggio con 1..4
+// thread di codifica e stack usato davvero dai lavori (zlib, libpng,
+// libjpeg) rispetto a WORKER_STACK_SIZE.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "filemanager.h"
+#include "worker.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES      120
+#define DENSE_FRAMES 24
+#define ROUND_TRIPS 2000
+#define RUNS        3
+
+static volatile int job_counter;
+
+static void tiny_job(void *arg) {
+    (void)arg;
+    job_counter++;
+}
+
+// Lavoro vuoto: il tempo e' tutto submit + risveglio + worker_wait
+static void bench_round_trip(void) {
+    Worker w;
+    double t0, ms;
+    int i;
+
+    CHECK(worker_start(&w, "bench_rt", WORKER_PRIORITY_LOW));
+    t0 = test_now_ms();
+    for (i = 0; i < ROUND_TRIPS; i++) {
+        CHECK(worker_submit(&w, tiny_job, NULL));
+        worker_wait(&w);
+    }
+    ms = test_now_ms() - t0;
+    worker_stop(&w);
+
+    CHECK(job_counter == ROUND_TRIPS);
+    printf("  worker_wait: %d lavori vuoti, %.1f us a lavoro (prima: attesa a passi di 1 ms)\n",
+           ROUND_TRIPS, ms * 1000.0 / ROUND_TRIPS);
+}
+
+static double best_save(AnimationContext *anim, AudioContext *audio, const char *path) {
+    double t0, ms, best = 0;
+    int run;
+
+    for (run = 0; run < RUNS; run++) {
+        t0 = test_now_ms();
+        CHECK(filemanager_save(anim, audio, path));
+        ms = test_now_ms() - t0;
+        if (run == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+static void bench_scaling(const char *label, AnimationContext *anim, AudioContext *audio) {
+    const char *path = SAVE_DIR "bench_workers.fnv";
+    double ms, base = 0;
+    int threads;
+
+    for (threads = 1; threads <= SAVE_MAX_ENCODERS; threads++) {
+        filemanager_set_encode_threads(threads);
+        ms = best_save(anim, audio, path);
+        if (threads == 1) base = ms;
+        printf("  salvataggio %-7s %d thread: %8.1f ms  x%.2f\n", label, threads, ms, base / ms);
+    }
+    filemanager_set_encode_threads(SAVE_DEFAULT_ENCODERS);
+    sceIoRemove(path);
+}
+
+// Tutti i lavori dei thread del filemanager, poi il massimo dello stack
+static void bench_stack(AnimationContext *anim, AudioContext *audio, DrawingContext *draw) {
+    static AnimationContext loaded;
+    static const char *names[] = {"fnv_codec", "fnv_save", "fnv_load"};
+    const char *fnv = SAVE_DIR "bench_workers.fnv";
+    const char *avi = SAVE_DIR "bench_workers.avi";
+    const char *png_dir = SAVE_DIR "bench_workers_png";
+    char path[256];
+    bool autosave;
+    long peak;
+    int i, f;
+
+    CHECK(filemanager_save(anim, audio, fnv));
+    CHECK(filemanager_save_async(anim, audio, fnv, false));
+    filemanager_wait_save();
+    CHECK(filemanager_poll_save(&autosave) == SAVE_DONE);
+
+    animation_init(&loaded);
+    CHECK(filemanager_load(&loaded, audio, draw, fnv));
+    CHECK(filemanager_load_async(audio, fnv));
+    filemanager_wait_load();
+    CHECK(filemanager_poll_load(&loaded, audio, draw) == LOAD_DONE);
+    animation_free(&loaded);
+
+    CHECK(filemanager_export_png_sequence(anim, png_dir));
+    CHECK(filemanager_export_avi(anim, audio, avi));
+
+    printf("  stack (WORKER_STACK_SIZE %d KB; misurato su x86-64, i frame ARM sono simili):\n",
+           WORKER_STACK_SIZE / 1024);
+    for (i = 0; i < 3; i++) {
+        peak = sce_host_stack_peak(names[i]);
+        printf("    %-10s %6.1f KB  %4.0f%%\n", names[i], peak / 1024.0,
+               peak * 100.0 / WORKER_STACK_SIZE);
+        // Margine per il compilatore ARM e per le versioni delle librerie
+        CHECK(peak > 0 && peak <= WORKER_STACK_SIZE / 2);
+    }
+
+    for (f = 0; f < anim->frame_count * 4; f++) {
+        snprintf(path, sizeof(path), "%s/frame_%04d.png", png_dir, f);
+        sceIoRemove(path);
+    }
+    sceIoRemove(fnv);
+    sceIoRemove(avi);
+}
+
+int main(int argc, char **argv) {
+    static AnimationContext anim;
+    static AudioContext audio;
+    DrawingContext *draw = malloc(sizeof(DrawingContext));
+
+    if (argc > 1) sce_host_set_root(argv[1]);
+    filemanager_init();
+    filemanager_set_tile_store(false);
+    drawing_init(draw);
+
+    printf("bench_workers (%ld core, DEFLATE2 livello %d)\n", sysconf(_SC_NPROCESSORS_ONLN),
+           CODEC_DEFAULT_LEVEL);
+    bench_round_trip();
+
+    fixture_audio(&audio, FRAMES);
+    fixture_animation(&anim, FRAMES, FIXTURE_LINEART);
+    bench_scaling("tratti", &anim, &audio);
+    bench_stack(&anim, &audio, draw);
+    animation_free(&anim);
+
+    fixture_animation(&anim, DENSE_FRAMES, FIXTURE_DENSE);
+    bench_scaling("retino", &anim, &audio);
+    animation_free(&anim);
+
+    free(draw);
+    return test_exit("bench_workers");
+}
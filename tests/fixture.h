@@ -0,0 +1,117 @@
+#ifndef FIXTURE_H
+#define FIXTURE_H
+
+// Animazioni sintetiche per test e benchmark. FIXTURE_LINEART somiglia a
+// un flipnote disegnato a mano (tratti, una palla che rimbalza, pochi
+// riempimenti); FIXTURE_DENSE e' un retino casuale che nessun codec riduce.
+#include <stdlib.h>
+#include <string.h>
+#include "animation.h"
+#include "audio.h"
+#include "colors.h"
+
+typedef enum {
+    FIXTURE_LINEART,
+    FIXTURE_DENSE
+} FixtureStyle;
+
+static uint32_t fixture_seed = 1;
+
+static inline uint32_t fixture_rand(void) {
+    fixture_seed ^= fixture_seed << 13;
+    fixture_seed ^= fixture_seed >> 17;
+    fixture_seed ^= fixture_seed << 5;
+    return fixture_seed;
+}
+
+static inline void fixture_disc(LayerData *l, int cx, int cy, int r, uint8_t color) {
+    int x, y;
+    for (y = cy - r; y <= cy + r; y++) {
+        if (y < 0 || y >= CANVAS_HEIGHT) continue;
+        for (x = cx - r; x <= cx + r; x++) {
+            if (x < 0 || x >= CANVAS_WIDTH) continue;
+            if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r)
+                l->pixels[y * CANVAS_WIDTH + x] = color;
+        }
+    }
+}
+
+// Linea col pennello rotondo di raggio r, come drawing_line
+static inline void fixture_line(LayerData *l, int x0, int y0, int x1, int y1, int r, uint8_t color) {
+    int dx = abs(x1 - x0), dy = abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+    int err = dx - dy, e2;
+    for (;;) {
+        fixture_disc(l, x0, y0, r, color);
+        if (x0 == x1 && y0 == y1) break;
+        e2 = 2 * err;
+        if (e2 > -dy) { err -= dy; x0 += sx; }
+        if (e2 < dx)  { err += dx; y0 += sy; }
+    }
+}
+
+static inline void fixture_frame(Frame *f, int i, FixtureStyle style) {
+    int l, k, x, y, px, py;
+
+    memset(f->layers, 0, sizeof(f->layers));
+    if (style == FIXTURE_DENSE) {
+        for (l = 0; l < MAX_LAYERS; l++)
+            for (k = 0; k < CANVAS_WIDTH * CANVAS_HEIGHT; k++)
+                f->layers[l].pixels[k] = (uint8_t)(fixture_rand() % LAYER_COLORS_COUNT);
+        return;
+    }
+
+    // Layer 0: terreno e palla che rimbalza
+    fixture_line(&f->layers[0], 0, 340, CANVAS_WIDTH - 1, 340, 1, 1);
+    x = 40 + (i * 7) % (CANVAS_WIDTH - 80);
+    y = 300 - abs((i * 23) % 240 - 120) * 2;
+    fixture_disc(&f->layers[0], x, y, 24, 2);
+    fixture_disc(&f->layers[0], x - 6, y - 6, 6, 0);
+
+    // Layer 1: scarabocchio che cresce di qualche tratto per frame
+    fixture_seed = 0x9E3779B9u;
+    px = 256; py = 192;
+    for (k = 0; k < 8 + i % 40; k++) {
+        int nx = px + (int)(fixture_rand() % 61) - 30;
+        int ny = py + (int)(fixture_rand() % 61) - 30;
+        if (nx < 10) nx = 10;
+        if (nx > CANVAS_WIDTH - 10) nx = CANVAS_WIDTH - 10;
+        if (ny < 10) ny = 10;
+        if (ny > 330) ny = 330;
+        fixture_line(&f->layers[1], px, py, nx, ny, 1, 1);
+        px = nx; py = ny;
+    }
+
+    // Layer 2: ogni tanto un cartello pieno
+    if ((i / 8) % 2 == 0) {
+        for (y = 20; y < 80; y++)
+            for (x = 380; x < 490; x++)
+                f->layers[2].pixels[y * CANVAS_WIDTH + x] = 3;
+    }
+}
+
+// count frame generati; ritorna false se l'animazione non li contiene
+static inline bool fixture_animation(AnimationContext *anim, int count, FixtureStyle style) {
+    int i;
+    animation_init(anim);
+    while (anim->frame_count < count) {
+        if (animation_add_frame(anim) < 0) return false;
+    }
+    for (i = 0; i < count; i++) {
+        fixture_frame(&anim->frames[i], i, style);
+        animation_invalidate_frame_hash(anim, i);
+    }
+    return true;
+}
+
+// audio_init genera gia' i quattro effetti; qui si aggiungono i trigger
+static inline void fixture_audio(AudioContext *audio, int frames) {
+    int i;
+    audio_init(audio);
+    for (i = 0; i < frames; i++) {
+        if (i % 6 == 0) audio_set_se_trigger(audio, i, 0, 1);
+        if (i % 10 == 3) audio_set_se_trigger(audio, i, 2, 1);
+    }
+}
+
+#endif
@@ -0,0 +1 @@
+#include "../../sce_host.h"
@@ -0,0 +1,386 @@
+// Implementazione host (POSIX + pthread) delle chiamate Vita usate dai
+// moduli sotto test. I descrittori di file sono quelli del sistema; thread,
+// semafori e mutex vivono in tabelle fisse indicizzate dallo SceUID.
+#include "sce_host.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+long sce_host_opens, sce_host_reads, sce_host_writes, sce_host_seeks;
+
+static char host_root[256] = "out/";
+
+void sce_host_set_root(const char *dir) {
+    snprintf(host_root, sizeof(host_root), "%s", dir);
+}
+
+// "ux0:data/x" -> "<root>ux0/data/x"; gli altri percorsi restano invariati
+static const char *host_path(const char *path, char *buf, size_t size) {
+    if (strncmp(path, "ux0:", 4) != 0) return path;
+    snprintf(buf, size, "%sux0/%s", host_root, path + 4);
+    return buf;
+}
+
+// Crea anche le cartelle intermedie (su Vita "ux0:data" esiste già)
+static int mkdir_parents(const char *path, mode_t mode) {
+    char tmp[512];
+    char *p;
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (p = tmp + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(tmp, mode);
+        *p = '/';
+    }
+    return mkdir(tmp, mode);
+}
+
+static void time_to_date(time_t t, SceDateTime *d) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    d->year = tm.tm_year + 1900;
+    d->month = tm.tm_mon + 1;
+    d->day = tm.tm_mday;
+    d->hour = tm.tm_hour;
+    d->minute = tm.tm_min;
+    d->second = tm.tm_sec;
+    d->microsecond = 0;
+}
+
+/* ========== IO ========== */
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode) {
+    char buf[512];
+    int fl;
+    if ((flags & 3) == SCE_O_RDONLY) fl = O_RDONLY;
+    else if ((flags & 3) == SCE_O_WRONLY) fl = O_WRONLY;
+    else fl = O_RDWR;
+    if (flags & SCE_O_CREAT) fl |= O_CREAT;
+    if (flags & SCE_O_TRUNC) fl |= O_TRUNC;
+    if (flags & SCE_O_APPEND) fl |= O_APPEND;
+    __atomic_fetch_add(&sce_host_opens, 1, __ATOMIC_RELAXED);
+    return open(host_path(file, buf, sizeof(buf)), fl, mode ? mode : 0644);
+}
+
+int sceIoClose(SceUID fd) {
+    return close(fd);
+}
+
+int sceIoRead(SceUID fd, void *data, SceSize size) {
+    __atomic_fetch_add(&sce_host_reads, 1, __ATOMIC_RELAXED);
+    return (int)read(fd, data, size);
+}
+
+int sceIoWrite(SceUID fd, const void *data, SceSize size) {
+    __atomic_fetch_add(&sce_host_writes, 1, __ATOMIC_RELAXED);
+    return (int)write(fd, data, size);
+}
+
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence) {
+    __atomic_fetch_add(&sce_host_seeks, 1, __ATOMIC_RELAXED);
+    return lseek(fd, offset, whence);
+}
+
+int sceIoMkdir(const char *dir, SceMode mode) {
+    char buf[512];
+    return mkdir_parents(host_path(dir, buf, sizeof(buf)), mode ? mode : 0755);
+}
+
+int sceIoRemove(const char *file) {
+    char buf[512];
+    return unlink(host_path(file, buf, sizeof(buf)));
+}
+
+// Come sulla console la destinazione non viene sovrascritta
+int sceIoRename(const char *from, const char *to) {
+    char a[512], b[512];
+    struct stat st;
+    if (stat(host_path(to, b, sizeof(b)), &st) == 0) return -1;
+    return rename(host_path(from, a, sizeof(a)), b);
+}
+
+int sceIoGetstat(const char *file, SceIoStat *stat_out) {
+    char buf[512];
+    struct stat st;
+    if (stat(host_path(file, buf, sizeof(buf)), &st) != 0) return -1;
+    memset(stat_out, 0, sizeof(*stat_out));
+    stat_out->st_size = st.st_size;
+    stat_out->st_mode = S_ISDIR(st.st_mode) ? 0x1000 : 0x2000;
+    time_to_date(st.st_mtim.tv_sec, &stat_out->st_mtime);
+    return 0;
+}
+
+#define HOST_MAX_DIRS 16
+static DIR *dirs[HOST_MAX_DIRS];
+static char dir_paths[HOST_MAX_DIRS][512];
+
+SceUID sceIoDopen(const char *dir) {
+    char buf[512];
+    const char *path = host_path(dir, buf, sizeof(buf));
+    DIR *d = opendir(path);
+    int i;
+    if (!d) return -1;
+    for (i = 1; i < HOST_MAX_DIRS; i++) {
+        if (dirs[i]) continue;
+        dirs[i] = d;
+        snprintf(dir_paths[i], sizeof(dir_paths[i]), "%s", path);
+        return i;
+    }
+    closedir(d);
+    return -1;
+}
+
+int sceIoDread(SceUID fd, SceIoDirent *entry) {
+    struct dirent *de;
+    struct stat st;
+    char path[800];
+    while ((de = readdir(dirs[fd])) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        memset(entry, 0, sizeof(*entry));
+        snprintf(entry->d_name, sizeof(entry->d_name), "%s", de->d_name);
+        snprintf(path, sizeof(path), "%s/%s", dir_paths[fd], de->d_name);
+        if (stat(path, &st) == 0) {
+            entry->d_stat.st_size = st.st_size;
+            entry->d_stat.st_mode = S_ISDIR(st.st_mode) ? 0x1000 : 0x2000;
+            time_to_date(st.st_mtim.tv_sec, &entry->d_stat.st_mtime);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+int sceIoDclose(SceUID fd) {
+    closedir(dirs[fd]);
+    dirs[fd] = NULL;
+    return 0;
+}
+
+int sceRtcGetCurrentClockLocalTime(SceDateTime *t) {
+    time_to_date(time(NULL), t);
+    return 0;
+}
+
+/* ========== THREAD ========== */
+
+#define HOST_MAX_THREADS 32
+#define HOST_MAX_SEMAS   64
+#define HOST_MAX_MUTEXES 1024
+
+// Lo stack ha la dimensione chiesta (almeno PTHREAD_STACK_MIN) ed e'
+// riempito con STACK_PAINT: sce_host_stack_peak misura quanto e' stato usato
+#define STACK_PAINT 0xA5
+
+typedef struct {
+    pthread_t handle;
+    SceKernelThreadEntry entry;
+    char name[32];
+    uint8_t *stack;
+    size_t stack_size;
+    char args[256];
+    SceSize args_size;
+} HostThread;
+
+static HostThread threads[HOST_MAX_THREADS];
+static int thread_count;
+static sem_t semas[HOST_MAX_SEMAS];
+static int sema_max[HOST_MAX_SEMAS];
+static int sema_count;
+static pthread_mutex_t mutexes[HOST_MAX_MUTEXES];
+static int mutex_count;
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int table_alloc(int *count, int max) {
+    int id = -1;
+    pthread_mutex_lock(&table_lock);
+    if (*count < max) id = (*count)++;
+    pthread_mutex_unlock(&table_lock);
+    return id;
+}
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int priority,
+                             int stack_size, SceUInt attr, int cpu_mask, const void *option) {
+    int id = table_alloc(&thread_count, HOST_MAX_THREADS);
+    HostThread *t;
+    (void)priority; (void)attr; (void)cpu_mask; (void)option;
+    if (id < 0) return -1;
+    t = &threads[id];
+    t->entry = entry;
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->stack_size = stack_size < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : (size_t)stack_size;
+    t->stack = aligned_alloc(4096, t->stack_size);
+    if (!t->stack) return -1;
+    memset(t->stack, STACK_PAINT, t->stack_size);
+    return id;
+}
+
+static void *thread_main(void *arg) {
+    HostThread *t = arg;
+    t->entry(t->args_size, t->args_size ? t->args : NULL);
+    return NULL;
+}
+
+int sceKernelStartThread(SceUID thid, SceSize args, const void *argp) {
+    HostThread *t = &threads[thid];
+    pthread_attr_t attr;
+    int ret;
+
+    // Come su Vita, gli argomenti vengono copiati nel nuovo thread
+    if (args > sizeof(t->args)) return -1;
+    if (args) memcpy(t->args, argp, args);
+    t->args_size = args;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, t->stack, t->stack_size);
+    ret = pthread_create(&t->handle, &attr, thread_main, t);
+    pthread_attr_destroy(&attr);
+    return ret == 0 ? 0 : -1;
+}
+
+// Lo stack cresce verso il basso: il primo byte cambiato dal fondo
+long sce_host_stack_peak(const char *name) {
+    long peak = 0;
+    size_t i;
+    int id;
+
+    for (id = 0; id < thread_count; id++) {
+        if (!threads[id].stack || strcmp(threads[id].name, name) != 0) continue;
+        for (i = 0; i < threads[id].stack_size && threads[id].stack[i] == STACK_PAINT; i++);
+        if ((long)(threads[id].stack_size - i) > peak) peak = (long)(threads[id].stack_size - i);
+    }
+    return peak;
+}
+
+int sceKernelWaitThreadEnd(SceUID thid, int *status, SceUInt *timeout) {
+    (void)timeout;
+    if (status) *status = 0;
+    return pthread_join(threads[thid].handle, NULL) == 0 ? 0 : -1;
+}
+
+// Lo stack resta allocato: sce_host_stack_peak puo' ancora leggerlo
+int sceKernelDeleteThread(SceUID thid) {
+    (void)thid;
+    return 0;
+}
+
+SceUID sceKernelCreateSema(const char *name, SceUInt attr, int init, int max, void *option) {
+    int id = table_alloc(&sema_count, HOST_MAX_SEMAS);
+    (void)name; (void)attr; (void)option;
+    if (id < 0) return -1;
+    sem_init(&semas[id], 0, init);
+    sema_max[id] = max;
+    return id;
+}
+
+int sceKernelDeleteSema(SceUID semaid) {
+    return sem_destroy(&semas[semaid]);
+}
+
+// Come su Vita, oltre il massimo il segnale fallisce e il contatore
+// resta com'era
+int sceKernelSignalSema(SceUID semaid, int count) {
+    int value;
+    pthread_mutex_lock(&table_lock);
+    sem_getvalue(&semas[semaid], &value);
+    if (value + count > sema_max[semaid]) {
+        pthread_mutex_unlock(&table_lock);
+        return -1;
+    }
+    while (count-- > 0) sem_post(&semas[semaid]);
+    pthread_mutex_unlock(&table_lock);
+    return 0;
+}
+
+int sceKernelWaitSema(SceUID semaid, int count, SceUInt *timeout) {
+    (void)timeout;
+    while (count-- > 0) {
+        while (sem_wait(&semas[semaid]) != 0 && errno == EINTR) {}
+    }
+    return 0;
+}
+
+SceUID sceKernelCreateMutex(const char *name, SceUInt attr, int init, void *option) {
+    int id = table_alloc(&mutex_count, HOST_MAX_MUTEXES);
+    (void)name; (void)attr; (void)init; (void)option;
+    if (id < 0) return -1;
+    pthread_mutex_init(&mutexes[id], NULL);
+    return id;
+}
+
+int sceKernelDeleteMutex(SceUID mutexid) {
+    return pthread_mutex_destroy(&mutexes[mutexid]);
+}
+
+int sceKernelLockMutex(SceUID mutexid, int count, SceUInt *timeout) {
+    (void)count; (void)timeout;
+    return pthread_mutex_lock(&mutexes[mutexid]);
+}
+
+int sceKernelUnlockMutex(SceUID mutexid, int count) {
+    (void)count;
+    return pthread_mutex_unlock(&mutexes[mutexid]);
+}
+
+int sceKernelDelayThread(SceUInt usec) {
+    return usleep(usec);
+}
+
+/* ========== AUDIO ========== */
+// Nessun dispositivo audio: le porte si aprono e non suonano
+
+int sceAudioOutOpenPort(int type, int len, int freq, int mode) {
+    (void)type; (void)len; (void)freq; (void)mode;
+    return 1;
+}
+
+int sceAudioOutSetVolume(int port, int flag, int *vol) {
+    (void)port; (void)flag; (void)vol;
+    return 0;
+}
+
+int sceAudioOutReleasePort(int port) {
+    (void)port;
+    return 0;
+}
+
+int sceAudioOutOutput(int port, const void *buffer) {
+    (void)port; (void)buffer;
+    return 0;
+}
+
+int sceAudioInOpenPort(int type, int len, int freq, int param) {
+    (void)type; (void)len; (void)freq; (void)param;
+    return 1;
+}
+
+int sceAudioInReleasePort(int port) {
+    (void)port;
+    return 0;
+}
+
+int sceAudioInInput(int port, void *buffer) {
+    (void)port; (void)buffer;
+    return 0;
+}
+
+/* ========== VITA2D ========== */
+
+void vita2d_draw_rectangle(float x, float y, float w, float h, unsigned int color) {
+    (void)x; (void)y; (void)w; (void)h; (void)color;
+}
+
+void vita2d_draw_line(float x0, float y0, float x1, float y1, unsigned int color) {
+    (void)x0; (void)y0; (void)x1; (void)y1; (void)color;
+}
+
+void vita2d_draw_pixel(float x, float y, unsigned int color) {
+    (void)x; (void)y; (void)color;
+}
@@ -0,0 +1,117 @@
+#ifndef SCE_HOST_H
+#define SCE_HOST_H
+
+// Sottoinsieme dell'SDK Vita usato dai moduli senza grafica, per i test
+// su host. Le funzioni sono in sce_host.c (POSIX + pthread).
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+// sys/stat.h definisce st_mtime & co. come macro: SceIoStat usa gli
+// stessi nomi, il codice host usa st_mtim
+#undef st_ctime
+#undef st_atime
+#undef st_mtime
+
+typedef int SceUID;
+typedef unsigned int SceUInt;
+typedef int SceInt32;
+typedef unsigned int SceUInt32;
+typedef int64_t SceOff;
+typedef uint64_t SceUInt64;
+typedef unsigned int SceSize;
+typedef int SceMode;
+typedef uint8_t SceUInt8;
+
+/* ========== IO ========== */
+#define SCE_O_RDONLY 0x0001
+#define SCE_O_WRONLY 0x0002
+#define SCE_O_RDWR   0x0003
+#define SCE_O_APPEND 0x0100
+#define SCE_O_CREAT  0x0200
+#define SCE_O_TRUNC  0x0400
+#define SCE_SEEK_SET 0
+#define SCE_SEEK_CUR 1
+#define SCE_SEEK_END 2
+
+typedef struct {
+    unsigned short year, month, day, hour, minute, second;
+    unsigned int microsecond;
+} SceDateTime;
+
+typedef struct {
+    SceMode st_mode;
+    unsigned int st_attr;
+    SceOff st_size;
+    SceDateTime st_ctime, st_atime, st_mtime;
+    unsigned int st_private[6];
+} SceIoStat;
+
+typedef struct {
+    SceIoStat d_stat;
+    char d_name[256];
+    void *d_private;
+    int dummy;
+} SceIoDirent;
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode);
+int sceIoClose(SceUID fd);
+int sceIoRead(SceUID fd, void *data, SceSize size);
+int sceIoWrite(SceUID fd, const void *data, SceSize size);
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence);
+int sceIoMkdir(const char *dir, SceMode mode);
+int sceIoRemove(const char *file);
+int sceIoRename(const char *from, const char *to);
+int sceIoGetstat(const char *file, SceIoStat *stat);
+SceUID sceIoDopen(const char *dir);
+int sceIoDread(SceUID fd, SceIoDirent *entry);
+int sceIoDclose(SceUID fd);
+
+int sceRtcGetCurrentClockLocalTime(SceDateTime *time);
+
+/* ========== THREAD ========== */
+typedef int (*SceKernelThreadEntry)(SceSize args, void *argp);
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int priority,
+                             int stack_size, SceUInt attr, int cpu_mask, const void *option);
+int sceKernelStartThread(SceUID thid, SceSize args, const void *argp);
+int sceKernelWaitThreadEnd(SceUID thid, int *status, SceUInt *timeout);
+int sceKernelDeleteThread(SceUID thid);
+SceUID sceKernelCreateSema(const char *name, SceUInt attr, int init, int max, void *option);
+int sceKernelDeleteSema(SceUID semaid);
+int sceKernelSignalSema(SceUID semaid, int count);
+int sceKernelWaitSema(SceUID semaid, int count, SceUInt *timeout);
+SceUID sceKernelCreateMutex(const char *name, SceUInt attr, int init, void *option);
+int sceKernelDeleteMutex(SceUID mutexid);
+int sceKernelLockMutex(SceUID mutexid, int count, SceUInt *timeout);
+int sceKernelUnlockMutex(SceUID mutexid, int count);
+int sceKernelDelayThread(SceUInt usec);
+
+/* ========== AUDIO ========== */
+#define SCE_AUDIO_OUT_PORT_TYPE_MAIN        0
+#define SCE_AUDIO_OUT_MODE_MONO             0
+#define SCE_AUDIO_OUT_MAX_VOL               32768
+#define SCE_AUDIO_VOLUME_FLAG_L_CH          1
+#define SCE_AUDIO_VOLUME_FLAG_R_CH          2
+#define SCE_AUDIO_IN_PORT_TYPE_VOICE        0
+#define SCE_AUDIO_IN_PARAM_FORMAT_S16_MONO  0
+
+int sceAudioOutOpenPort(int type, int len, int freq, int mode);
+int sceAudioOutSetVolume(int port, int flag, int *vol);
+int sceAudioOutReleasePort(int port);
+int sceAudioOutOutput(int port, const void *buffer);
+int sceAudioInOpenPort(int type, int len, int freq, int param);
+int sceAudioInReleasePort(int port);
+int sceAudioInInput(int port, void *buffer);
+
+/* ========== CONTATORI ========== */
+// Chiamate di sistema fatte finora (per i benchmark di fileio)
+extern long sce_host_opens, sce_host_reads, sce_host_writes, sce_host_seeks;
+
+// Byte di stack usati al massimo dai thread con questo nome
+long sce_host_stack_peak(const char *name);
+
+// I percorsi "ux0:" finiscono sotto questa cartella (default "out/")
+void sce_host_set_root(const char *dir);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef VITA2D_H
+#define VITA2D_H
+
+// Solo quanto serve a drawing.c sull'host: il disegno a schermo non fa nulla
+#include "sce_host.h"
+
+#define RGBA8(r, g, b, a) ((((a) & 0xFF) << 24) | (((b) & 0xFF) << 16) | \
+                           (((g) & 0xFF) << 8) | (((r) & 0xFF) << 0))
+
+void vita2d_draw_rectangle(float x, float y, float w, float h, unsigned int color);
+void vita2d_draw_line(float x0, float y0, float x1, float y1, unsigned int color);
+void vita2d_draw_pixel(float x, float y, unsigned int color);
+
+#endif
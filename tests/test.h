@@ -0,0 +1,33 @@
+#ifndef TEST_H
+#define TEST_H
+
+// Mini framework per i test su host: CHECK conta i fallimenti senza
+// interrompere, test_exit() decide il codice di uscita.
+#include <stdio.h>
+#include <time.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: CHECK(%s) fallito\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+static inline double test_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static inline int test_exit(const char *name) {
+    if (test_failures) {
+        fprintf(stderr, "%s: %d fallimenti\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,267 @@
+// Export APNG riletto chunk per chunk: acTL dichiara quanti fcTL
+// seguono (un frame per gruppo di frame uguali), i numeri di sequenza di
+// fcTL e fdAT sono consecutivi, ogni rettangolo e' il riquadro dei pixel
+// cambiati rispetto al gruppo prima, la durata e' quella esatta del
+// gruppo, e i dati decompressi e sovrapposti danno il frame composto.
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES 40
+#define GROUPS (FRAMES - 2)
+
+static const char *root = "out/";
+
+typedef struct {
+    uint32_t width, height, x, y;
+    uint16_t delay_num, delay_den;
+    uint8_t dispose, blend;
+} FrameControl;
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static unsigned int expected_rgba(const Frame *f, int p) {
+    int l;
+    for (l = 0; l < MAX_LAYERS; l++) {
+        if (f->layers[l].pixels[p]) return drawing_get_rgba_color(f->layers[l].pixels[p], l);
+    }
+    return drawing_get_rgba_color(0, 0);
+}
+
+static bool same_layers(AnimationContext *anim, int a, int b) {
+    return memcmp(anim->frames[a].layers, anim->frames[b].layers, sizeof(anim->frames[a].layers)) == 0;
+}
+
+// Come in test_gif: un gruppo di tre frame uguali, due frame con layer
+// diversi e la stessa immagine, velocita' ed esposizioni diverse
+static void make_animation(AnimationContext *anim) {
+    int f, p;
+
+    CHECK(fixture_animation(anim, FRAMES, FIXTURE_LINEART));
+    anim->playback_speed = 8;
+    anim->loop = true;
+    anim->frames[7].frame_speed = 3;
+    anim->frames[12].exposure = 3;
+
+    for (f = 25; f <= 26; f++) memcpy(anim->frames[f].layers, anim->frames[24].layers, sizeof(anim->frames[f].layers));
+    memcpy(anim->frames[30].layers, anim->frames[29].layers, sizeof(anim->frames[30].layers));
+    for (p = 0; p < LAYER_PIXELS && !anim->frames[30].layers[0].pixels[p]; p++);
+    anim->frames[30].layers[2].pixels[p] = anim->frames[30].layers[2].pixels[p] == 1 ? 2 : 1;
+
+    for (f = 0; f < FRAMES; f++) animation_invalidate_frame_hash(anim, f);
+}
+
+// Riquadro atteso: pixel composti diversi tra due frame, 1x1 in (0, 0)
+// se non ne cambia nessuno
+static void changed_rect(const Frame *a, const Frame *b, FrameControl *r) {
+    int x, y, x0 = CANVAS_WIDTH, y0 = CANVAS_HEIGHT, x1 = -1, y1 = -1;
+
+    for (y = 0; y < CANVAS_HEIGHT; y++) {
+        for (x = 0; x < CANVAS_WIDTH; x++) {
+            if (expected_rgba(a, y * CANVAS_WIDTH + x) == expected_rgba(b, y * CANVAS_WIDTH + x)) continue;
+            if (x < x0) x0 = x;
+            if (x > x1) x1 = x;
+            if (y < y0) y0 = y;
+            if (y > y1) y1 = y;
+        }
+    }
+    if (x1 < 0) x0 = y0 = x1 = y1 = 0;
+    r->x = x0;
+    r->y = y0;
+    r->width = x1 - x0 + 1;
+    r->height = y1 - y0 + 1;
+}
+
+// Dati zlib di un frame sulla tela: righe con filtro 0, indici a bits bit
+static bool apply_frame(const uint8_t *z, uLong z_size, const FrameControl *fc, int bits,
+                        const unsigned int *palette, unsigned int *canvas) {
+    uLongf size;
+    uint8_t *raw;
+    uint32_t row = (fc->width * bits + 7) / 8, x, y;
+    unsigned int color;
+    int index;
+    bool ok;
+
+    size = (uLongf)fc->height * (row + 1);
+    raw = malloc(size);
+    ok = raw && fc->x + fc->width <= CANVAS_WIDTH && fc->y + fc->height <= CANVAS_HEIGHT &&
+         uncompress(raw, &size, z, z_size) == Z_OK && size == fc->height * (row + 1);
+    for (y = 0; ok && y < fc->height; y++) {
+        const uint8_t *r = raw + y * (row + 1);
+        ok = r[0] == 0;
+        for (x = 0; ok && x < fc->width; x++) {
+            index = (r[1 + x * bits / 8] >> (8 - bits - (x * bits) % 8)) & ((1 << bits) - 1);
+            color = palette[index];
+            if (fc->blend == 1 && (color >> 24) == 0) continue;
+            canvas[(fc->y + y) * CANVAS_WIDTH + fc->x + x] = color;
+        }
+    }
+    free(raw);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    static AnimationContext anim;
+    const char *path = SAVE_DIR "test_apng.apng";
+    static FrameControl expected[GROUPS];
+    static uint8_t z[LAYER_PIXELS * 2];
+    FrameControl fc;
+    unsigned int palette[256], *canvas;
+    uint32_t size, seq, next_seq = 0, frames = 0, plays = 0, z_size = 0;
+    uint64_t num, den;
+    uint8_t *data;
+    char host[512];
+    FILE *fp;
+    long file_size, pos, rect_pixels = 0;
+    int first[GROUPS + 1], f, i, p, g, n, bits = 0, fctl = 0, actl = 0, idat = 0, fdat = 0;
+    int wrong_rects = 0, wrong_delays = 0, wrong_pixels = 0, wrong_seq = 0, bad_data = 0;
+    bool in_frame = false;
+
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+    make_animation(&anim);
+    CHECK(filemanager_export_apng(&anim, path));
+
+    // Gruppi di frame uguali e riquadri attesi
+    n = 0;
+    for (f = 0; f < FRAMES && n < GROUPS; f++) {
+        if (f > 0 && same_layers(&anim, f - 1, f)) continue;
+        first[n] = f;
+        if (n == 0) {
+            expected[n].x = expected[n].y = 0;
+            expected[n].width = CANVAS_WIDTH;
+            expected[n].height = CANVAS_HEIGHT;
+        } else {
+            changed_rect(&anim.frames[first[n - 1]], &anim.frames[f], &expected[n]);
+        }
+        n++;
+    }
+    CHECK(n == GROUPS && f == FRAMES);
+    first[GROUPS] = FRAMES;
+
+    snprintf(host, sizeof(host), "%sux0/%s", root, path + 4);
+    fp = fopen(host, "rb");
+    CHECK(fp != NULL);
+    if (!fp) return test_exit("test_apng");
+    fseek(fp, 0, SEEK_END);
+    file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = malloc(file_size);
+    CHECK(fread(data, 1, file_size, fp) == (size_t)file_size);
+    fclose(fp);
+    CHECK(memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0);
+
+    canvas = calloc(LAYER_PIXELS, sizeof(unsigned int));
+    memset(&fc, 0, sizeof(fc));
+    memset(palette, 0, sizeof(palette));
+    g = -1;
+    for (pos = 8; pos + 12 <= file_size; pos += 12 + size) {
+        const uint8_t *c = data + pos;
+        size = get_u32(c);
+        if ((long)size > file_size - pos - 12) break;
+        c += 4;
+
+        // I dati del frame finiscono al chunk che non li continua
+        if (in_frame && memcmp(c, "IDAT", 4) && memcmp(c, "fdAT", 4)) {
+            if (!apply_frame(z, z_size, &fc, bits, palette, canvas)) bad_data++;
+            for (p = 0; g >= 0 && g < GROUPS && p < LAYER_PIXELS; p++)
+                wrong_pixels += canvas[p] != expected_rgba(&anim.frames[first[g]], p);
+            in_frame = false;
+            z_size = 0;
+        }
+
+        if (memcmp(c, "IHDR", 4) == 0) {
+            CHECK(get_u32(c + 4) == CANVAS_WIDTH && get_u32(c + 8) == CANVAS_HEIGHT);
+            bits = c[12];
+            CHECK(c[13] == 3);
+        } else if (memcmp(c, "PLTE", 4) == 0) {
+            for (i = 0; i < (int)size / 3; i++)
+                palette[i] = c[4 + i * 3] | c[5 + i * 3] << 8 | c[6 + i * 3] << 16 | 0xFF000000u;
+        } else if (memcmp(c, "tRNS", 4) == 0) {
+            for (i = 0; i < (int)size; i++)
+                palette[i] = (palette[i] & 0xFFFFFF) | (unsigned int)c[4 + i] << 24;
+        } else if (memcmp(c, "acTL", 4) == 0) {
+            frames = get_u32(c + 4);
+            plays = get_u32(c + 8);
+            actl++;
+        } else if (memcmp(c, "fcTL", 4) == 0) {
+            seq = get_u32(c + 4);
+            wrong_seq += seq != next_seq++;
+            fc.width = get_u32(c + 8);
+            fc.height = get_u32(c + 12);
+            fc.x = get_u32(c + 16);
+            fc.y = get_u32(c + 20);
+            fc.delay_num = get_u16(c + 24);
+            fc.delay_den = get_u16(c + 26);
+            fc.dispose = c[28];
+            fc.blend = c[29];
+            g = fctl++;
+            if (g >= GROUPS) continue;
+
+            if (fc.x != expected[g].x || fc.y != expected[g].y ||
+                fc.width != expected[g].width || fc.height != expected[g].height ||
+                fc.dispose != 0 || fc.blend != (g == 0 ? 0 : 1))
+                wrong_rects++;
+            rect_pixels += fc.width * fc.height;
+
+            // Durata del gruppo in frazione esatta
+            num = 0;
+            den = 1;
+            for (f = first[g]; f < first[g + 1]; f++) {
+                uint64_t speed = anim.frames[f].frame_speed > 0 ? anim.frames[f].frame_speed
+                                                                : anim.playback_speed;
+                num = num * speed + (uint64_t)animation_get_exposure(&anim, f) * den;
+                den *= speed;
+            }
+            if ((uint64_t)fc.delay_num * den != num * fc.delay_den) wrong_delays++;
+        } else if (memcmp(c, "IDAT", 4) == 0 || memcmp(c, "fdAT", 4) == 0) {
+            uint32_t skip = c[0] == 'f' ? 4 : 0;
+            if (c[0] == 'f') {
+                fdat++;
+                wrong_seq += get_u32(c + 4) != next_seq++;
+            } else {
+                idat++;
+                if (fctl != 1) wrong_seq++;     // IDAT solo dopo il primo fcTL
+            }
+            if (z_size + size - skip > sizeof(z)) {
+                bad_data++;
+            } else {
+                memcpy(z + z_size, c + 4 + skip, size - skip);
+                z_size += size - skip;
+            }
+            in_frame = true;
+        } else if (memcmp(c, "IEND", 4) == 0) {
+            CHECK(pos + 12 == file_size);
+        }
+    }
+
+    printf("  %ld byte, acTL %u frame, %d fcTL, %d IDAT + %d fdAT, rettangoli %.1f%% della tela\n",
+           file_size, frames, fctl, idat, fdat, rect_pixels * 100.0 / ((double)GROUPS * LAYER_PIXELS));
+    CHECK(actl == 1 && frames == GROUPS && fctl == GROUPS);
+    CHECK(plays == 0);
+    CHECK(idat > 0 && fdat >= GROUPS - 1);
+    CHECK(bits == 4);
+    CHECK(wrong_seq == 0);
+    CHECK(wrong_rects == 0);
+    CHECK(wrong_delays == 0);
+    CHECK(bad_data == 0);
+    CHECK(wrong_pixels == 0);
+
+    free(canvas);
+    free(data);
+    sceIoRemove(path);
+    animation_free(&anim);
+    return test_exit("test_apng");
+}
@@ -0,0 +1,196 @@
+// Export AVI riletto chunk per chunk: una voce idx1 per ogni chunk di
+// movi (un JPEG e un blocco audio per tick video), totali degli header
+// coerenti, frame che cambiano esattamente al loro primo tick e audio
+// uguale alla colonna sonora con gli effetti allineati ai tick.
+#include <stdlib.h>
+#include <string.h>
+#include "filemanager.h"
+#include "soundtrack.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES 24
+#define RATE   24      // mcm di 8, 12 e 6 fps
+
+static const char *root = "out/";
+
+typedef struct {
+    char id[4];
+    uint32_t offset;    // Dalla FourCC "movi"
+    uint32_t size;
+} Chunk;
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint8_t *read_file(const char *path, long *size) {
+    char host[512];
+    uint8_t *data;
+    FILE *fp;
+
+    snprintf(host, sizeof(host), "%sux0/%s", root, path + 4);
+    fp = fopen(host, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = malloc(*size);
+    if (data && fread(data, 1, *size, fp) != (size_t)*size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+static uint32_t tick_sample(uint32_t tick) {
+    return (uint32_t)((uint64_t)tick * AUDIO_SAMPLE_RATE / RATE);
+}
+
+int main(int argc, char **argv) {
+    static AnimationContext anim;
+    static AudioContext audio;
+    const char *path = SAVE_DIR "test_avi.avi";
+    uint32_t first_tick[FRAMES + 1], start[FRAMES];
+    uint32_t pos, end, size, movi = 0, movi_end = 0, idx_pos = 0, idx_count = 0;
+    uint32_t avih_frames = 0, video_rate = 0, video_scale = 0, video_length = 0, audio_length = 0;
+    uint32_t samples = 0, expected_samples, k;
+    int16_t *pcm, *ref;
+    uint8_t *data;
+    Chunk *chunks;
+    const Chunk *prev_video = NULL;
+    long file_size;
+    int f, i, count = 0, video = 0, audio_chunks = 0, wrong_index = 0, wrong_changes = 0;
+    double t0, ms;
+
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+
+    // 8 fps di base, frame a 12 e a 6 fps e uno tenuto due tick
+    CHECK(fixture_animation(&anim, FRAMES, FIXTURE_LINEART));
+    anim.playback_speed = 8;
+    anim.frames[5].frame_speed = 12;
+    anim.frames[6].frame_speed = 12;
+    anim.frames[9].exposure = 2;
+    anim.frames[14].frame_speed = 6;
+    fixture_audio(&audio, FRAMES);
+
+    first_tick[0] = 0;
+    for (f = 0; f < FRAMES; f++) {
+        int speed = anim.frames[f].frame_speed > 0 ? anim.frames[f].frame_speed : anim.playback_speed;
+        first_tick[f + 1] = first_tick[f] + animation_get_exposure(&anim, f) * RATE / speed;
+        start[f] = tick_sample(first_tick[f]);
+    }
+
+    t0 = test_now_ms();
+    CHECK(filemanager_export_avi(&anim, &audio, path));
+    ms = test_now_ms() - t0;
+
+    data = read_file(path, &file_size);
+    CHECK(data != NULL);
+    if (!data) return test_exit("test_avi");
+    CHECK(memcmp(data, "RIFF", 4) == 0 && get_u32(data + 4) == (uint32_t)file_size - 8);
+    CHECK(memcmp(data + 8, "AVI ", 4) == 0);
+
+    // Chunk di primo livello; in hdrl avih e i due strh, in movi i dati
+    chunks = calloc(first_tick[FRAMES] * 2 + 1, sizeof(Chunk));
+    for (pos = 12; pos + 8 <= (uint32_t)file_size; pos = end + (end & 1)) {
+        size = get_u32(data + pos + 4);
+        end = pos + 8 + size;
+        CHECK(end <= (uint32_t)file_size);
+        if (end > (uint32_t)file_size) break;
+
+        if (memcmp(data + pos, "LIST", 4) == 0 && memcmp(data + pos + 8, "hdrl", 4) == 0) {
+            const uint8_t *h = data + pos + 12;
+            avih_frames = get_u32(h + 24);
+            for (h += 64; h + 12 <= data + end; h += 8 + get_u32(h + 4)) {
+                if (memcmp(h + 20, "vids", 4) == 0) {
+                    video_scale = get_u32(h + 12 + 28);
+                    video_rate = get_u32(h + 12 + 32);
+                    video_length = get_u32(h + 12 + 40);
+                } else if (memcmp(h + 20, "auds", 4) == 0) {
+                    audio_length = get_u32(h + 12 + 40);
+                }
+            }
+        } else if (memcmp(data + pos, "LIST", 4) == 0 && memcmp(data + pos + 8, "movi", 4) == 0) {
+            movi = pos + 8;
+            movi_end = end;
+        } else if (memcmp(data + pos, "idx1", 4) == 0) {
+            idx_pos = pos + 8;
+            idx_count = size / 16;
+            CHECK(size % 16 == 0);
+        }
+    }
+    CHECK(movi > 0 && idx_pos > 0);
+
+    for (pos = movi + 4; movi && pos + 8 <= movi_end && count <= (int)first_tick[FRAMES] * 2;
+         pos += 8 + size + (size & 1)) {
+        size = get_u32(data + pos + 4);
+        memcpy(chunks[count].id, data + pos, 4);
+        chunks[count].offset = pos - movi;
+        chunks[count].size = size;
+        count++;
+    }
+
+    // idx1: stessa sequenza di movi, tutti keyframe
+    for (i = 0; i < (int)idx_count && i < count; i++) {
+        const uint8_t *e = data + idx_pos + i * 16;
+        if (memcmp(e, chunks[i].id, 4) || get_u32(e + 4) != 0x10 ||
+            get_u32(e + 8) != chunks[i].offset || get_u32(e + 12) != chunks[i].size)
+            wrong_index++;
+    }
+
+    // Un JPEG e il suo audio per tick; il JPEG cambia solo al primo tick
+    // di un frame
+    pcm = malloc(tick_sample(first_tick[FRAMES]) * sizeof(int16_t) + 2);
+    f = 0;
+    for (i = 0; i < count; i++) {
+        const uint8_t *payload = data + movi + chunks[i].offset + 8;
+        if (memcmp(chunks[i].id, "00dc", 4) == 0) {
+            bool changed = !prev_video || prev_video->size != chunks[i].size ||
+                           memcmp(data + movi + prev_video->offset + 8, payload, chunks[i].size);
+            while (f < FRAMES && first_tick[f + 1] <= (uint32_t)video) f++;
+            if (changed != (first_tick[f] == (uint32_t)video)) wrong_changes++;
+            CHECK(payload[0] == 0xFF && payload[1] == 0xD8);
+            prev_video = &chunks[i];
+            video++;
+        } else if (memcmp(chunks[i].id, "01wb", 4) == 0) {
+            if (samples + chunks[i].size / 2 <= tick_sample(first_tick[FRAMES]))
+                memcpy(pcm + samples, payload, chunks[i].size);
+            samples += chunks[i].size / 2;
+            audio_chunks++;
+        }
+    }
+
+    expected_samples = tick_sample(first_tick[FRAMES]);
+    ref = malloc(expected_samples * sizeof(int16_t));
+    soundtrack_render(&audio, start, FRAMES, 0, ref, expected_samples);
+
+    printf("  %u tick a %u/%u fps, %d voci idx1 (%d video + %d audio), %ld byte in %.1f ms\n",
+           first_tick[FRAMES], video_rate, video_scale, idx_count, video, audio_chunks,
+           file_size, ms);
+    CHECK(video_rate == RATE && video_scale == 1);
+    CHECK(video == (int)first_tick[FRAMES] && audio_chunks == video);
+    CHECK((int)idx_count == count && (int)idx_count == video + audio_chunks);
+    CHECK(wrong_index == 0);
+    CHECK(wrong_changes == 0);
+    CHECK(avih_frames == (uint32_t)video && video_length == (uint32_t)video);
+    CHECK(samples == expected_samples && audio_length == samples);
+    if (samples == expected_samples) {
+        for (k = 0; k < samples && pcm[k] == ref[k]; k++);
+        CHECK(k == samples);
+    }
+
+    free(ref);
+    free(pcm);
+    free(chunks);
+    free(data);
+    sceIoRemove(path);
+    audio_free(&audio);
+    animation_free(&anim);
+    return test_exit("test_avi");
+}
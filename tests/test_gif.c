@@ -0,0 +1,277 @@
+// Export GIF decodificato e confrontato con l'animazione: ogni immagine
+// (rettangoli parziali con trasparenza sopra la precedente) deve dare
+// esattamente il frame composto, con un'immagine per gruppo di frame
+// uguali e i ritardi arrotondati come export_frame_time.
+#include <stdlib.h>
+#include <string.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES 40
+
+static const char *root = "out/";
+
+typedef struct {
+    uint8_t *data;
+    long size;
+    long pos;
+} GifReader;
+
+static int gif_byte(GifReader *r) {
+    return r->pos < r->size ? r->data[r->pos++] : -1;
+}
+
+static int gif_word(GifReader *r) {
+    int lo = gif_byte(r);
+    return lo | gif_byte(r) << 8;
+}
+
+// Sotto-blocchi concatenati; ritorna i byte letti
+static long gif_sub_blocks(GifReader *r, uint8_t *out, long max) {
+    long n = 0;
+    int len;
+
+    while ((len = gif_byte(r)) > 0) {
+        if (n + len > max || r->pos + len > r->size) return -1;
+        if (out) memcpy(out + n, r->data + r->pos, len);
+        r->pos += len;
+        n += len;
+    }
+    return len < 0 ? -1 : n;
+}
+
+// LZW del GIF: codici LSB-first da min_size + 1 a 12 bit
+static bool gif_lzw(const uint8_t *in, long in_size, int min_size, uint8_t *out, long count) {
+    static uint16_t prefix[4096];
+    static uint8_t suffix[4096], stack[4097];
+    int clear = 1 << min_size, end = clear + 1;
+    int next = clear + 2, size = min_size + 1, old = -1, code, c, sp, i;
+    uint8_t first = 0;
+    long bit = 0, n = 0;
+
+    for (;;) {
+        if (bit + size > in_size * 8) return false;
+        for (code = 0, i = 0; i < size; i++, bit++)
+            code |= ((in[bit >> 3] >> (bit & 7)) & 1) << i;
+
+        if (code == clear) {
+            next = clear + 2;
+            size = min_size + 1;
+            old = -1;
+            continue;
+        }
+        if (code == end) break;
+
+        if (old < 0) {
+            if (code >= clear || n >= count) return false;
+            out[n++] = (uint8_t)code;
+            old = first = (uint8_t)code;
+            continue;
+        }
+        if (code > next) return false;
+
+        sp = 0;
+        c = code;
+        if (code == next) {
+            stack[sp++] = first;
+            c = old;
+        }
+        while (c >= clear) {
+            stack[sp++] = suffix[c];
+            c = prefix[c];
+        }
+        stack[sp++] = (uint8_t)c;
+        first = (uint8_t)c;
+        while (sp) {
+            if (n >= count) return false;
+            out[n++] = stack[--sp];
+        }
+
+        if (next < 4096) {
+            prefix[next] = (uint16_t)old;
+            suffix[next] = first;
+            next++;
+            if (next == (1 << size) && size < 12) size++;
+        }
+        old = code;
+    }
+    return n == count;
+}
+
+// Colore RGB (senza alpha, come nel GIF) del pixel composto
+static unsigned int expected_rgb(const Frame *f, int p) {
+    int l;
+    for (l = 0; l < MAX_LAYERS; l++) {
+        if (f->layers[l].pixels[p]) return drawing_get_rgba_color(f->layers[l].pixels[p], l) & 0xFFFFFF;
+    }
+    return drawing_get_rgba_color(0, 0) & 0xFFFFFF;
+}
+
+static bool same_layers(AnimationContext *anim, int a, int b) {
+    return memcmp(anim->frames[a].layers, anim->frames[b].layers, sizeof(anim->frames[a].layers)) == 0;
+}
+
+static void make_animation(AnimationContext *anim) {
+    int f, p;
+
+    CHECK(fixture_animation(anim, FRAMES, FIXTURE_LINEART));
+    anim->playback_speed = 8;
+    anim->loop = true;
+    anim->frames[7].frame_speed = 3;
+    anim->frames[12].exposure = 3;
+
+    // 25 e 26 uguali al 24: una sola immagine che dura tre frame
+    for (f = 25; f <= 26; f++) memcpy(anim->frames[f].layers, anim->frames[24].layers, sizeof(anim->frames[f].layers));
+
+    // 30: layer diversi dal 29 ma stessa immagine (il layer 2 cambia
+    // sotto l'inchiostro del layer 0)
+    memcpy(anim->frames[30].layers, anim->frames[29].layers, sizeof(anim->frames[30].layers));
+    for (p = 0; p < LAYER_PIXELS && !anim->frames[30].layers[0].pixels[p]; p++);
+    anim->frames[30].layers[2].pixels[p] = anim->frames[30].layers[2].pixels[p] == 1 ? 2 : 1;
+
+    for (f = 0; f < FRAMES; f++) animation_invalidate_frame_hash(anim, f);
+}
+
+static void test_decode(AnimationContext *anim, const char *path) {
+    char host[512];
+    FILE *fp;
+    GifReader r;
+    unsigned int palette[256], *canvas;
+    uint8_t *lzw, *pixels;
+    long lzw_size;
+    int width, height, packed, colors, block, label, transparent, delay;
+    int x, y, w, h, min_size, i, p, images, src, next, shown, wrong_pixels, wrong_delays;
+    float elapsed;
+
+    snprintf(host, sizeof(host), "%sux0/%s", root, path + 4);
+    fp = fopen(host, "rb");
+    CHECK(fp != NULL);
+    if (!fp) return;
+    fseek(fp, 0, SEEK_END);
+    r.size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    r.data = malloc(r.size);
+    r.pos = 0;
+    CHECK(fread(r.data, 1, r.size, fp) == (size_t)r.size);
+    fclose(fp);
+
+    CHECK(r.size > 6 && memcmp(r.data, "GIF89a", 6) == 0);
+    r.pos = 6;
+    width = gif_word(&r);
+    height = gif_word(&r);
+    packed = gif_byte(&r);
+    gif_byte(&r);
+    gif_byte(&r);
+    CHECK(width == CANVAS_WIDTH && height == CANVAS_HEIGHT && (packed & 0x80));
+    colors = 2 << (packed & 7);
+    for (i = 0; i < colors; i++) {
+        palette[i] = gif_byte(&r);
+        palette[i] |= gif_byte(&r) << 8;
+        palette[i] |= gif_byte(&r) << 16;
+    }
+
+    canvas = calloc(LAYER_PIXELS, sizeof(unsigned int));
+    pixels = malloc(LAYER_PIXELS);
+    lzw = malloc(LAYER_PIXELS * 2);
+    transparent = -1;
+    delay = 0;
+    images = 0;
+    src = 0;
+    shown = 0;
+    elapsed = 0;
+    wrong_pixels = 0;
+    wrong_delays = 0;
+
+    while ((block = gif_byte(&r)) != 0x3B && block >= 0) {
+        if (block == 0x21) {
+            label = gif_byte(&r);
+            if (label == 0xF9) {
+                gif_byte(&r);
+                packed = gif_byte(&r);
+                delay = gif_word(&r);
+                i = gif_byte(&r);
+                transparent = (packed & 1) ? i : -1;
+                gif_byte(&r);
+            } else {
+                CHECK(gif_sub_blocks(&r, NULL, 1 << 20) >= 0);
+            }
+            continue;
+        }
+        CHECK(block == 0x2C);
+        if (block != 0x2C || src >= anim->frame_count) break;
+
+        x = gif_word(&r);
+        y = gif_word(&r);
+        w = gif_word(&r);
+        h = gif_word(&r);
+        packed = gif_byte(&r);
+        CHECK(packed == 0);     // Niente tavolozza locale ne' interlacciamento
+        CHECK(x + w <= width && y + h <= height);
+        min_size = gif_byte(&r);
+        lzw_size = gif_sub_blocks(&r, lzw, LAYER_PIXELS * 2);
+        CHECK(lzw_size > 0 && gif_lzw(lzw, lzw_size, min_size, pixels, (long)w * h));
+
+        for (i = 0; i < w * h; i++) {
+            if (pixels[i] == transparent) continue;
+            canvas[(y + i / w) * width + x + i % w] = palette[pixels[i]];
+        }
+
+        // L'immagine vale per src e i frame uguali che lo seguono
+        for (p = 0; p < LAYER_PIXELS; p++) {
+            if (canvas[p] != expected_rgb(&anim->frames[src], p)) wrong_pixels++;
+        }
+        next = src + 1;
+        while (next < anim->frame_count && same_layers(anim, src, next)) next++;
+        for (i = src; i < next; i++) {
+            float speed = anim->frames[i].frame_speed > 0 ? anim->frames[i].frame_speed
+                                                          : anim->playback_speed;
+            elapsed += animation_get_exposure(anim, i) / speed;
+        }
+        if (delay != (int)(elapsed * 100.0f + 0.5f) - shown) wrong_delays++;
+        shown += delay;
+        src = next;
+        images++;
+    }
+
+    printf("  %ld byte, %d immagini per %d frame, %.2f s\n", r.size, images, anim->frame_count,
+           shown / 100.0);
+    CHECK(block == 0x3B);
+    CHECK(src == anim->frame_count);
+    CHECK(images == FRAMES - 2);
+    CHECK(wrong_pixels == 0);
+    CHECK(wrong_delays == 0);
+
+    free(canvas);
+    free(pixels);
+    free(lzw);
+    free(r.data);
+}
+
+int main(int argc, char **argv) {
+    static AnimationContext anim;
+    const char *path = SAVE_DIR "test_gif.gif";
+    double t0, cold, warm;
+
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+    make_animation(&anim);
+
+    // A freddo si calcolano gli hash; dopo restano in cache come
+    // nell'editor dopo un autosave
+    t0 = test_now_ms();
+    CHECK(filemanager_export_gif(&anim, path));
+    cold = test_now_ms() - t0;
+    t0 = test_now_ms();
+    CHECK(filemanager_export_gif(&anim, path));
+    warm = test_now_ms() - t0;
+    printf("  export: %.1f ms senza hash in cache, %.1f ms con\n", cold, warm);
+
+    test_decode(&anim, path);
+    sceIoRemove(path);
+    animation_free(&anim);
+    return test_exit("test_gif");
+}
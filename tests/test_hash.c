@@ -0,0 +1,195 @@
+// Corpus di collisioni e qualità per animation_hash_data: layer che
+// differiscono per un solo pixel, tratti traslati, scambi di pixel vicini,
+// buffer corti di ogni lunghezza. Nessuna collisione a 64 bit ammessa.
+#include <stdlib.h>
+#include <string.h>
+#include "animation.h"
+#include "colors.h"
+#include "test.h"
+
+#define LAYER_SIZE (CANVAS_WIDTH * CANVAS_HEIGHT)
+
+static uint64_t *hashes;
+static size_t hash_count, hash_capacity;
+
+static void add_hash(uint64_t h) {
+    if (hash_count == hash_capacity) {
+        hash_capacity = hash_capacity ? hash_capacity * 2 : 65536;
+        hashes = realloc(hashes, hash_capacity * sizeof(uint64_t));
+    }
+    hashes[hash_count++] = h;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Disco pieno di raggio r centrato in (cx, cy)
+static void draw_disc(uint8_t *layer, int cx, int cy, int r, uint8_t color) {
+    int x, y;
+    for (y = cy - r; y <= cy + r; y++) {
+        for (x = cx - r; x <= cx + r; x++) {
+            if (x < 0 || y < 0 || x >= CANVAS_WIDTH || y >= CANVAS_HEIGHT) continue;
+            if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r) {
+                layer[y * CANVAS_WIDTH + x] = color;
+            }
+        }
+    }
+}
+
+static void corpus_layers(uint8_t *layer) {
+    int pos, c, dx, dy;
+
+    // Layer vuoto e un solo pixel acceso, in ogni colore
+    memset(layer, 0, LAYER_SIZE);
+    add_hash(animation_hash_data(layer, LAYER_SIZE));
+    for (pos = 0; pos < LAYER_SIZE; pos += 31) {
+        for (c = 1; c < LAYER_COLORS_COUNT; c++) {
+            layer[pos] = (uint8_t)c;
+            add_hash(animation_hash_data(layer, LAYER_SIZE));
+        }
+        layer[pos] = 0;
+    }
+
+    // Lo stesso tratto spostato: contenuto uguale, posizione diversa
+    for (dy = 0; dy < 48; dy++) {
+        for (dx = 0; dx < 64; dx++) {
+            memset(layer, 0, LAYER_SIZE);
+            draw_disc(layer, 100 + dx, 100 + dy, 20, 1);
+            draw_disc(layer, 300 + dx, 200 + dy, 6, 2);
+            add_hash(animation_hash_data(layer, LAYER_SIZE));
+        }
+    }
+
+    // Due pixel vicini con i colori scambiati (stesso multiset di byte)
+    memset(layer, 0, LAYER_SIZE);
+    for (pos = 0; pos + 1 < LAYER_SIZE; pos += 97) {
+        layer[pos] = 1;
+        layer[pos + 1] = 2;
+        add_hash(animation_hash_data(layer, LAYER_SIZE));
+        layer[pos] = 2;
+        layer[pos + 1] = 1;
+        add_hash(animation_hash_data(layer, LAYER_SIZE));
+        layer[pos] = layer[pos + 1] = 0;
+    }
+}
+
+static void corpus_short(void) {
+    uint8_t buf[512];
+    int v, len;
+
+    // Tutti i buffer da 2 byte
+    for (v = 0; v < 65536; v++) {
+        buf[0] = (uint8_t)v;
+        buf[1] = (uint8_t)(v >> 8);
+        add_hash(animation_hash_data(buf, 2));
+    }
+    // Zeri e 0xFF di ogni lunghezza: cambia solo la dimensione (quelli da
+    // 2 byte sono già nel gruppo sopra)
+    memset(buf, 0, sizeof(buf));
+    for (len = 0; len <= 512; len++) {
+        if (len == 2) continue;
+        add_hash(animation_hash_data(buf, len));
+    }
+    memset(buf, 0xFF, sizeof(buf));
+    for (len = 1; len <= 512; len++) {
+        if (len == 2) continue;
+        add_hash(animation_hash_data(buf, len));
+    }
+}
+
+// Un bit in ingresso deve cambiare in media metà dei bit in uscita
+static void check_avalanche(void) {
+    enum { SIZE = 45, TRIALS = 2000 };   // un blocco, 3 parole e 1 byte di coda
+    uint8_t buf[SIZE];
+    long flips[64] = {0};
+    long total = 0, samples = 0;
+    int t, bit, i;
+
+    for (t = 0; t < TRIALS; t++) {
+        uint64_t base;
+        for (i = 0; i < SIZE; i++) buf[i] = (uint8_t)rng();
+        base = animation_hash_data(buf, SIZE);
+        for (bit = 0; bit < SIZE * 8; bit++) {
+            uint64_t diff;
+            buf[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+            diff = base ^ animation_hash_data(buf, SIZE);
+            buf[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+            total += __builtin_popcountll(diff);
+            for (i = 0; i < 64; i++) flips[i] += (diff >> i) & 1;
+            samples++;
+        }
+    }
+
+    printf("  avalanche: %.2f bit su 64 per bit in ingresso\n", (double)total / samples);
+    CHECK((double)total / samples > 31.0 && (double)total / samples < 33.0);
+    for (i = 0; i < 64; i++) {
+        double p = (double)flips[i] / samples;
+        CHECK(p > 0.45 && p < 0.55);
+    }
+}
+
+int main(void) {
+    uint8_t *layer = malloc(LAYER_SIZE + 1);
+    uint8_t *unaligned;
+    LayerData *ld;
+    size_t i, dup64 = 0, dup32 = 0;
+    uint32_t *low;
+    double t0;
+    int k;
+
+    // Valore fisso: NEON e C devono dare lo stesso hash (i file salvati lo
+    // usano per la deduplicazione, non può cambiare tra build)
+    for (k = 0; k < LAYER_SIZE; k++) layer[k] = (uint8_t)((k * 7 + (k >> 9)) & 3);
+    CHECK(animation_hash_data(layer, LAYER_SIZE) == 0x8B850EA7DFE5D929ULL);
+    ld = malloc(sizeof(LayerData));
+    memcpy(ld->pixels, layer, LAYER_SIZE);
+    CHECK(animation_hash_layer(ld) == animation_hash_data(layer, LAYER_SIZE));
+    free(ld);
+
+    // Il puntatore non allineato non cambia il risultato
+    unaligned = malloc(LAYER_SIZE + 1);
+    memcpy(unaligned + 1, layer, LAYER_SIZE);
+    CHECK(animation_hash_data(unaligned + 1, LAYER_SIZE) == animation_hash_data(layer, LAYER_SIZE));
+    free(unaligned);
+
+    t0 = test_now_ms();
+    corpus_layers(layer);
+    corpus_short();
+
+    qsort(hashes, hash_count, sizeof(uint64_t), compare_u64);
+    for (i = 1; i < hash_count; i++) {
+        if (hashes[i] == hashes[i - 1]) dup64++;
+    }
+
+    // Metà bassa a 32 bit: solo informativo (attese ~n^2/2^33 collisioni)
+    low = malloc(hash_count * sizeof(uint32_t));
+    for (i = 0; i < hash_count; i++) low[i] = (uint32_t)hashes[i];
+    for (i = 0; i < hash_count; i++) hashes[i] = low[i];
+    qsort(hashes, hash_count, sizeof(uint64_t), compare_u64);
+    for (i = 1; i < hash_count; i++) {
+        if (hashes[i] == hashes[i - 1]) dup32++;
+    }
+    free(low);
+
+    printf("  corpus: %zu input, %zu collisioni a 64 bit, %zu a 32 bit (attese %.1f), %.0f ms\n",
+           hash_count, dup64, dup32,
+           (double)hash_count * hash_count / 8589934592.0, test_now_ms() - t0);
+    CHECK(dup64 == 0);
+
+    check_avalanche();
+
+    free(hashes);
+    free(layer);
+    return test_exit("test_hash");
+}
@@ -0,0 +1,349 @@
+// Autosave: il checkpoint si scrive su un .tmp rinominato solo a file
+// completo, e il journal si riapplica un gruppo intero alla volta. I JFRM
+// di un gruppo si scrivono in background dallo snapshot, il JCMT al poll.
+// Un frame modificato si riscrive anche se l'hash non cambia.
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES 16
+
+static const char *root = "out/";
+static AnimationContext anim, loaded;
+static AudioContext audio, loaded_audio;
+static DrawingContext *draw;
+
+static void host_file(char *buf, size_t size, const char *name) {
+    snprintf(buf, size, "%sux0/data/FlipnoteVita/%s", root, name);
+}
+
+static bool host_exists(const char *name) {
+    char path[512];
+    struct stat st;
+    host_file(path, sizeof(path), name);
+    return stat(path, &st) == 0;
+}
+
+static void host_remove(const char *name) {
+    char path[512];
+    host_file(path, sizeof(path), name);
+    remove(path);
+    rmdir(path);
+}
+
+static bool same_animation(AnimationContext *a, AnimationContext *b) {
+    int f;
+    if (a->frame_count != b->frame_count) return false;
+    for (f = 0; f < a->frame_count; f++) {
+        if (memcmp(a->frames[f].layers, b->frames[f].layers, sizeof(a->frames[f].layers)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Cambia il frame abbastanza da cambiarne l'hash
+static void touch_frame(AnimationContext *a, int f, int seed) {
+    fixture_disc(&a->frames[f].layers[1], 40 + seed * 37, 300, 18, 2);
+    animation_invalidate_frame_hash(a, f);
+}
+
+static void copy_animation(AnimationContext *dst, AnimationContext *src) {
+    int f;
+    animation_free(dst);
+    animation_init(dst);
+    while (dst->frame_count < src->frame_count) animation_add_frame(dst);
+    for (f = 0; f < src->frame_count; f++) {
+        memcpy(dst->frames[f].layers, src->frames[f].layers, sizeof(src->frames[f].layers));
+        animation_invalidate_frame_hash(dst, f);
+    }
+}
+
+// Offset del payload dell'n-esimo JFRM del journal
+static long journal_jfrm_offset(int n) {
+    char path[512];
+    FILE *fp;
+    FNVChunk chunk;
+    long pos = sizeof(FNVJournalHeader), found = -1;
+
+    host_file(path, sizeof(path), "_autosave.fnj");
+    fp = fopen(path, "rb");
+    if (!fp) return -1;
+    while (fseek(fp, pos, SEEK_SET) == 0 && fread(&chunk, sizeof(chunk), 1, fp) == 1) {
+        if (memcmp(chunk.type, "JFRM", 4) == 0 && n-- == 0) {
+            found = pos + sizeof(chunk);
+            break;
+        }
+        pos += sizeof(chunk) + chunk.size;
+    }
+    fclose(fp);
+    return found;
+}
+
+static long journal_size(void) {
+    char path[512];
+    struct stat st;
+    host_file(path, sizeof(path), "_autosave.fnj");
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static bool load(void) {
+    return filemanager_load_autosave(&loaded, &loaded_audio, draw);
+}
+
+// Gruppo o checkpoint in background: si attende e si raccoglie l'esito
+static bool autosave_journal(void) {
+    bool autosave = false;
+    if (!filemanager_autosave_journal(&anim, &audio)) return false;
+    filemanager_wait_save();
+    return filemanager_poll_save(&autosave) == SAVE_DONE && autosave;
+}
+
+static int journal_count(const char *type) {
+    char path[512];
+    FILE *fp;
+    FNVChunk chunk;
+    long pos = sizeof(FNVJournalHeader);
+    int n = 0;
+
+    host_file(path, sizeof(path), "_autosave.fnj");
+    fp = fopen(path, "rb");
+    if (!fp) return -1;
+    while (fseek(fp, pos, SEEK_SET) == 0 && fread(&chunk, sizeof(chunk), 1, fp) == 1) {
+        n += memcmp(chunk.type, type, 4) == 0;
+        pos += sizeof(chunk) + chunk.size;
+    }
+    fclose(fp);
+    return n;
+}
+
+// Checkpoint e un gruppo: si ricarica tutto e non resta nessun .tmp
+static void test_checkpoint_and_group(void) {
+    filemanager_autosave(&anim, &audio);
+    CHECK(host_exists("_autosave.fnv"));
+    CHECK(!host_exists("_autosave.fnv.tmp"));
+    CHECK(journal_size() == (long)sizeof(FNVJournalHeader));
+
+    touch_frame(&anim, 3, 0);
+    CHECK(autosave_journal());
+    CHECK(journal_size() > (long)sizeof(FNVJournalHeader));
+
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+}
+
+// Un checkpoint che non riesce a scrivere il .tmp lascia intatti il
+// vecchio checkpoint e il suo journal
+static void test_failed_checkpoint(void) {
+    char path[512];
+
+    host_file(path, sizeof(path), "_autosave.fnv.tmp");
+    mkdir(path, 0755);
+    touch_frame(&anim, 7, 1);
+    filemanager_autosave(&anim, &audio);
+    host_remove("_autosave.fnv.tmp");
+
+    // Il frame 7 non e' mai arrivato su disco: si ritrova lo stato precedente
+    CHECK(load());
+    CHECK(memcmp(loaded.frames[3].layers, anim.frames[3].layers, sizeof(anim.frames[3].layers)) == 0);
+    CHECK(memcmp(loaded.frames[7].layers, anim.frames[7].layers, sizeof(anim.frames[7].layers)) != 0);
+
+    filemanager_autosave(&anim, &audio);
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+}
+
+// Crash tra sceIoRemove e sceIoRename: resta solo il .tmp completo.
+// Un .tmp accanto al checkpoint e' invece una scrittura interrotta.
+static void test_rename_window(void) {
+    char from[512], to[512];
+    FILE *fp;
+
+    host_file(from, sizeof(from), "_autosave.fnv");
+    host_file(to, sizeof(to), "_autosave.fnv.tmp");
+    CHECK(rename(from, to) == 0);
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+    CHECK(host_exists("_autosave.fnv"));
+    CHECK(!host_exists("_autosave.fnv.tmp"));
+
+    fp = fopen(to, "wb");
+    if (fp) {
+        fputs("troncato", fp);
+        fclose(fp);
+    }
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+    CHECK(!host_exists("_autosave.fnv.tmp"));
+}
+
+// Secondo gruppo (frame 2 e 5) col payload del frame 5 danneggiato:
+// il frame 2 non deve restare applicato a meta' gruppo
+static void test_corrupt_group(void) {
+    static AnimationContext after_first;
+    char path[512];
+    FILE *fp;
+    long pos;
+    uint8_t bad_codec = 0xFF;
+
+    filemanager_autosave(&anim, &audio);
+    touch_frame(&anim, 2, 2);
+    CHECK(autosave_journal());
+    copy_animation(&after_first, &anim);
+
+    touch_frame(&anim, 2, 3);
+    touch_frame(&anim, 5, 4);
+    CHECK(autosave_journal());
+
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+
+    // JFRM: 0 = frame 2 del primo gruppo, 1 = frame 2 e 2 = frame 5 del secondo
+    pos = journal_jfrm_offset(2);
+    CHECK(pos > 0);
+    host_file(path, sizeof(path), "_autosave.fnj");
+    fp = fopen(path, "r+b");
+    CHECK(fp != NULL);
+    if (fp) {
+        fseek(fp, pos + sizeof(uint32_t) + offsetof(FNVFrameInfo, codec), SEEK_SET);
+        fwrite(&bad_codec, 1, 1, fp);
+        fclose(fp);
+    }
+
+    CHECK(!load());
+    CHECK(same_animation(&loaded, &after_first));
+    animation_free(&after_first);
+
+    // Il journal danneggiato non si estende: il prossimo autosave e' un checkpoint
+    touch_frame(&anim, 9, 5);
+    CHECK(autosave_journal());
+    CHECK(journal_size() == (long)sizeof(FNVJournalHeader));
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+}
+
+// Coda troncata (crash durante l'append): si scarta senza errore
+static void test_truncated_tail(void) {
+    static AnimationContext after_first;
+    char path[512];
+    long size;
+
+    filemanager_autosave(&anim, &audio);
+    touch_frame(&anim, 4, 6);
+    CHECK(autosave_journal());
+    copy_animation(&after_first, &anim);
+    size = journal_size();
+
+    touch_frame(&anim, 4, 7);
+    touch_frame(&anim, 6, 8);
+    CHECK(autosave_journal());
+    host_file(path, sizeof(path), "_autosave.fnj");
+    CHECK(truncate(path, size + (journal_size() - size) / 2) == 0);
+
+    CHECK(load());
+    CHECK(same_animation(&loaded, &after_first));
+    animation_free(&after_first);
+}
+
+// Il chiamante raccoglie solo gli hash: i JFRM arrivano dal thread di
+// salvataggio, e un frame modificato subito dopo la chiamata entra nel
+// gruppo com'era (copy-on-write dello snapshot)
+static void test_background_group(void) {
+    static AnimationContext at_call;
+    double t0, call_ms, total_ms;
+    bool autosave = false;
+    int f;
+
+    filemanager_autosave(&anim, &audio);
+    for (f = 10; f < 16; f++) touch_frame(&anim, f, f - 10);
+    copy_animation(&at_call, &anim);
+
+    t0 = test_now_ms();
+    CHECK(filemanager_autosave_journal(&anim, &audio));
+    call_ms = test_now_ms() - t0;
+
+    anim.current_frame = 12;
+    animation_load_current_from_draw(&anim, draw);
+    fixture_disc(&draw->layers[2], 200, 100, 30, 1);
+    animation_save_current_to_draw(&anim, draw);
+
+    filemanager_wait_save();
+    total_ms = test_now_ms() - t0;
+    CHECK(journal_count("JFRM") == 6 && journal_count("JCMT") == 0);
+    CHECK(filemanager_poll_save(&autosave) == SAVE_DONE && autosave);
+    CHECK(journal_count("JCMT") == 1);
+    printf("  gruppo di 6 frame: %.2f ms nel chiamante, %.2f ms fino alla fine\n",
+           call_ms, total_ms);
+
+    CHECK(load());
+    CHECK(same_animation(&loaded, &at_call));
+    CHECK(autosave_journal());
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+    animation_free(&at_call);
+}
+
+// Collisione forzata: il frame 8 cambia ma la cache degli hash dei layer
+// riporta i valori di prima. Un frame solo visitato non va riscritto.
+static void test_hash_collision(void) {
+    uint64_t old_hash[MAX_LAYERS];
+
+    filemanager_autosave(&anim, &audio);
+    animation_get_frame_hash(&anim, 8);
+    memcpy(old_hash, anim.frames[8].layer_hash, sizeof(old_hash));
+    touch_frame(&anim, 8, 9);
+    memcpy(anim.frames[8].layer_hash, old_hash, sizeof(old_hash));
+    anim.frames[8].hash_valid = (1 << MAX_LAYERS) - 1;
+
+    CHECK(autosave_journal());
+    CHECK(journal_count("JFRM") == 1);
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+
+    // Cambio frame senza disegnare: solo il frame 11 nel gruppo. La cache
+    // falsa va tolta, altrimenti l'hash del checkpoint non torna al load
+    anim.frames[8].hash_valid = 0;
+    filemanager_autosave(&anim, &audio);
+    anim.current_frame = 3;
+    animation_load_current_from_draw(&anim, draw);
+    animation_save_current_to_draw(&anim, draw);
+    touch_frame(&anim, 11, 9);
+    CHECK(autosave_journal());
+    CHECK(journal_count("JFRM") == 1);
+    CHECK(load());
+    CHECK(same_animation(&loaded, &anim));
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+    filemanager_set_tile_store(false);
+    draw = malloc(sizeof(DrawingContext));
+    drawing_init(draw);
+    animation_init(&loaded);
+    audio_init(&audio);
+    audio_init(&loaded_audio);
+    CHECK(fixture_animation(&anim, FRAMES, FIXTURE_LINEART));
+
+    test_checkpoint_and_group();
+    test_failed_checkpoint();
+    test_rename_window();
+    test_corrupt_group();
+    test_truncated_tail();
+    test_background_group();
+    test_hash_collision();
+
+    host_remove("_autosave.fnv");
+    host_remove("_autosave.fnj");
+    animation_free(&anim);
+    animation_free(&loaded);
+    free(draw);
+    return test_exit("test_journal");
+}
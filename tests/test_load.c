@@ -0,0 +1,328 @@
+// Formato .fnv v2 e caricamento: un'animazione piu' lunga di
+// FNV_KEY_INTERVAL, con esposizioni, velocita', frame delta e audio,
+// ricaricata con filemanager_load (decodifica parallela) e frame per
+// frame con FNVReader in ordine casuale; un file v1 scritto a mano; un
+// caricamento annullato che non tocca l'animazione aperta.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES    40
+#define V1_FRAMES 5
+
+// Marcatori delle sezioni opzionali del formato v1 (vedi load_v1)
+#define V1_AUDIO_MARKER    0xADD100
+#define V1_EXPOSURE_MARKER 0xE4905E
+
+static const char *root = "out/";
+static AnimationContext anim, loaded;
+static AudioContext audio, loaded_audio;
+static DrawingContext *draw;
+
+static void host_path(char *host, size_t size, const char *path) {
+    snprintf(host, size, "%sux0/%s", root, path + 4);
+}
+
+static void make_animation(void) {
+    int f;
+
+    animation_free(&anim);
+    CHECK(fixture_animation(&anim, FRAMES, FIXTURE_LINEART));
+    strcpy(anim.title, "test_load");
+    anim.playback_speed = 12;
+    for (f = 0; f < FRAMES; f++) {
+        anim.frames[f].frame_speed = f % 7 == 3 ? (float)(4 + f % 5) : -1;
+        animation_set_exposure(&anim, f, 1 + f % 4);
+    }
+
+    audio_free(&audio);
+    fixture_audio(&audio, FRAMES);
+    fixture_seed = 5;
+    free(audio.sound_effects[1].data);
+    audio.sound_effects[1].sample_count = 3000;
+    audio.sound_effects[1].data = malloc(3000 * sizeof(int16_t));
+    for (f = 0; f < 3000; f++) audio.sound_effects[1].data[f] = (int16_t)fixture_rand();
+}
+
+static int frames_differ(const AnimationContext *a, const AnimationContext *b) {
+    int f, l, diff = 0;
+
+    if (a->frame_count != b->frame_count) return -1;
+    for (f = 0; f < a->frame_count; f++) {
+        for (l = 0; l < MAX_LAYERS; l++)
+            diff += memcmp(&a->frames[f].layers[l], &b->frames[f].layers[l], sizeof(LayerData)) != 0;
+        diff += a->frames[f].frame_speed != b->frames[f].frame_speed;
+        diff += animation_get_exposure((AnimationContext *)a, f) !=
+                animation_get_exposure((AnimationContext *)b, f);
+    }
+    return diff;
+}
+
+static bool audio_equal(const AudioContext *a, const AudioContext *b, int frames) {
+    int f, s;
+
+    for (f = 0; f < frames; f++)
+        for (s = 0; s < MAX_SOUND_EFFECTS; s++)
+            if (!a->se_triggers[f][s] != !b->se_triggers[f][s]) return false;
+    for (s = 0; s < MAX_SOUND_EFFECTS; s++) {
+        if (a->sound_effects[s].sample_count != b->sound_effects[s].sample_count) return false;
+        if (a->sound_effects[s].sample_count > 0 &&
+            memcmp(a->sound_effects[s].data, b->sound_effects[s].data,
+                   a->sound_effects[s].sample_count * sizeof(int16_t)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Conta i chunk FRAM, quelli delta e i FIDX scorrendo il file
+static void count_chunks(const char *path, int *frames, int *deltas, int *index) {
+    char host[512];
+    FNVHeader header;
+    FNVChunk chunk;
+    FNVFrameInfo info;
+    FILE *fp;
+    long start;
+
+    *frames = *deltas = *index = 0;
+    host_path(host, sizeof(host), path);
+    fp = fopen(host, "rb");
+    if (!fp) return;
+    if (fread(&header, sizeof(header), 1, fp) == 1) {
+        while (fread(&chunk, sizeof(chunk), 1, fp) == 1 && memcmp(chunk.type, "END ", 4) != 0) {
+            start = ftell(fp);
+            if (memcmp(chunk.type, "FIDX", 4) == 0) (*index)++;
+            if (memcmp(chunk.type, "FRAM", 4) == 0 && fread(&info, sizeof(info), 1, fp) == 1) {
+                (*frames)++;
+                *deltas += (info.flags & FNV_FRAME_DELTA) != 0;
+            }
+            fseek(fp, start + chunk.size, SEEK_SET);
+        }
+    }
+    fclose(fp);
+}
+
+static void test_roundtrip(void) {
+    const char *path = SAVE_DIR "test_load.fnv";
+    int frames, deltas, index, diff;
+    double t0, ms;
+
+    make_animation();
+    CHECK(filemanager_save(&anim, &audio, path));
+    count_chunks(path, &frames, &deltas, &index);
+    CHECK(index == 1 && frames == FRAMES);
+    CHECK(deltas == FRAMES - (FRAMES + FNV_KEY_INTERVAL - 1) / FNV_KEY_INTERVAL);
+
+    animation_init(&loaded);
+    audio_init(&loaded_audio);
+    t0 = test_now_ms();
+    CHECK(filemanager_load(&loaded, &loaded_audio, draw, path));
+    ms = test_now_ms() - t0;
+    diff = frames_differ(&anim, &loaded);
+    CHECK(diff == 0);
+    CHECK(strcmp(loaded.title, "test_load") == 0 && loaded.playback_speed == 12);
+    CHECK(audio_equal(&audio, &loaded_audio, FRAMES));
+    printf("  v2: %d frame, %d delta, caricati in %.1f ms, %d differenze\n",
+           frames, deltas, ms, diff);
+}
+
+// Ordine casuale: salti in avanti e indietro dentro e fuori dalle catene
+// di delta, lo stesso frame due volte di fila
+static void test_reader_seek(void) {
+    const char *path = SAVE_DIR "test_load.fnv";
+    FNVReader reader;
+    Frame *out = calloc(1, sizeof(Frame));
+    int order[FRAMES * 2], i, j, t, f, l, wrong = 0;
+
+    for (i = 0; i < FRAMES; i++) order[i] = order[FRAMES + i] = i;
+    fixture_seed = 17;
+    for (i = FRAMES * 2 - 1; i > 0; i--) {
+        j = fixture_rand() % (i + 1);
+        t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    order[1] = order[0];
+
+    CHECK(filemanager_reader_open(&reader, path));
+    for (i = 0; i < FRAMES * 2; i++) {
+        f = order[i];
+        if (!filemanager_reader_read_frame(&reader, f, out)) {
+            wrong++;
+            continue;
+        }
+        for (l = 0; l < MAX_LAYERS; l++)
+            wrong += memcmp(&out->layers[l], &anim.frames[f].layers[l], sizeof(LayerData)) != 0;
+        wrong += out->exposure != animation_get_exposure(&anim, f);
+    }
+    CHECK(wrong == 0);
+    CHECK(!filemanager_reader_read_frame(&reader, FRAMES, out));
+    filemanager_reader_close(&reader);
+    free(out);
+}
+
+static void put_run(FILE *fp, int count, uint8_t val) {
+    fputc(count, fp);
+    fputc(val, fp);
+}
+
+// Stream RLE del v1: coppie {conteggio, valore}, poi {0, 0xFF}
+static void write_v1_layer(FILE *fp, const LayerData *layer) {
+    int pos = 0, run;
+
+    while (pos < CANVAS_WIDTH * CANVAS_HEIGHT) {
+        run = 1;
+        while (run < 255 && pos + run < CANVAS_WIDTH * CANVAS_HEIGHT &&
+               layer->pixels[pos + run] == layer->pixels[pos])
+            run++;
+        put_run(fp, run, layer->pixels[pos]);
+        pos += run;
+    }
+    put_run(fp, 0, 0xFF);
+}
+
+static void test_v1(void) {
+    const char *path = SAVE_DIR "test_load_v1.fnv";
+    char host[512];
+    FNVHeader header;
+    FNVReader reader;
+    uint32_t marker;
+    int32_t keyframe, count;
+    FILE *fp;
+    int f, l, s;
+
+    make_animation();
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "FNVT", 4);
+    header.version = 1;
+    strcpy(header.title, "v1");
+    header.frame_count = V1_FRAMES;
+    header.playback_speed = 6;
+    header.loop = true;
+    header.canvas_width = CANVAS_WIDTH;
+    header.canvas_height = CANVAS_HEIGHT;
+    header.layers_per_frame = MAX_LAYERS;
+
+    host_path(host, sizeof(host), path);
+    fp = fopen(host, "wb");
+    CHECK(fp != NULL);
+    if (!fp) return;
+    fwrite(&header, sizeof(header), 1, fp);
+    for (f = 0; f < V1_FRAMES; f++) {
+        keyframe = f == 0;
+        fwrite(&anim.frames[f].frame_speed, sizeof(float), 1, fp);
+        fwrite(&keyframe, sizeof(keyframe), 1, fp);
+        for (l = 0; l < MAX_LAYERS; l++) write_v1_layer(fp, &anim.frames[f].layers[l]);
+    }
+    marker = V1_AUDIO_MARKER;
+    fwrite(&marker, sizeof(marker), 1, fp);
+    for (f = 0; f < V1_FRAMES; f++)
+        for (s = 0; s < MAX_SOUND_EFFECTS; s++) fputc(audio.se_triggers[f][s], fp);
+    for (s = 0; s < MAX_SOUND_EFFECTS; s++) {
+        count = audio.sound_effects[s].sample_count;
+        fwrite(&count, sizeof(count), 1, fp);
+        fwrite(audio.sound_effects[s].data, sizeof(int16_t), count, fp);
+    }
+    marker = V1_EXPOSURE_MARKER;
+    fwrite(&marker, sizeof(marker), 1, fp);
+    for (f = 0; f < V1_FRAMES; f++) fputc(animation_get_exposure(&anim, f), fp);
+    fclose(fp);
+
+    animation_free(&loaded);
+    animation_init(&loaded);
+    CHECK(filemanager_load(&loaded, &loaded_audio, draw, path));
+    CHECK(loaded.frame_count == V1_FRAMES);
+    CHECK(strcmp(loaded.title, "v1") == 0 && loaded.playback_speed == 6 && loaded.loop);
+    CHECK(audio_equal(&audio, &loaded_audio, V1_FRAMES));
+
+    // Solo i primi V1_FRAMES: il confronto usa un'animazione troncata
+    while (anim.frame_count > V1_FRAMES) animation_delete_frame(&anim, anim.frame_count - 1);
+    CHECK(frames_differ(&anim, &loaded) == 0);
+    CHECK(!filemanager_reader_open(&reader, path));
+    filemanager_reader_close(&reader);
+    sceIoRemove(path);
+}
+
+static bool cancel_at_half(int done, int total, void *user) {
+    *(int *)user = done;
+    return done < total / 2;
+}
+
+// L'animazione aperta (loaded, dal file v2) resta identica dopo un
+// caricamento fermato a meta' e dopo uno annullato in background
+static void test_cancel(void) {
+    const char *path = SAVE_DIR "test_load.fnv";
+    const char *other = SAVE_DIR "test_load_other.fnv";
+    AnimationContext *before = calloc(1, sizeof(AnimationContext));
+    LoadStatus status;
+    int stopped = 0, done, total, f;
+
+    make_animation();
+    for (f = 0; f < FRAMES; f++) {
+        fixture_frame(&anim.frames[f], f + 100, FIXTURE_LINEART);
+        animation_invalidate_frame_hash(&anim, f);
+    }
+    CHECK(filemanager_save(&anim, &audio, other));
+
+    animation_free(&loaded);
+    animation_init(&loaded);
+    CHECK(filemanager_load(&loaded, &loaded_audio, draw, path));
+    animation_init(before);
+    CHECK(filemanager_load(before, &loaded_audio, draw, path));
+
+    CHECK(!filemanager_load_ex(&loaded, &loaded_audio, draw, other, cancel_at_half, &stopped));
+    CHECK(stopped == FRAMES / 2);
+    CHECK(frames_differ(before, &loaded) == 0);
+    CHECK(strcmp(loaded.title, "test_load") == 0);
+
+    CHECK(filemanager_load_async(&loaded_audio, other));
+    CHECK(filemanager_load_busy());
+    filemanager_cancel_load();
+    filemanager_wait_load();
+    filemanager_load_progress(&done, &total);
+    status = filemanager_poll_load(&loaded, &loaded_audio, draw);
+    CHECK(status == LOAD_CANCELLED);
+    CHECK(!filemanager_load_busy());
+    CHECK(frames_differ(before, &loaded) == 0);
+    printf("  annullati: in linea al frame %d di %d, in background al %d\n",
+           stopped, FRAMES, done);
+
+    // Lo stesso file senza annullare arriva in fondo
+    CHECK(filemanager_load_async(&loaded_audio, other));
+    filemanager_wait_load();
+    CHECK(filemanager_poll_load(&loaded, &loaded_audio, draw) == LOAD_DONE);
+    CHECK(frames_differ(&anim, &loaded) == 0);
+
+    animation_free(before);
+    free(before);
+    sceIoRemove(other);
+    sceIoRemove(path);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+    filemanager_set_tile_store(false);
+    draw = malloc(sizeof(DrawingContext));
+    drawing_init(draw);
+    animation_init(&anim);
+    audio_init(&audio);
+
+    test_roundtrip();
+    test_reader_seek();
+    test_v1();
+    test_cancel();
+
+    animation_free(&anim);
+    animation_free(&loaded);
+    audio_free(&audio);
+    audio_free(&loaded_audio);
+    drawing_free(draw);
+    free(draw);
+    return test_exit("test_load");
+}
@@ -0,0 +1,144 @@
+// Riproduzione in streaming di 999 frame: ogni frame arriva in ordine e
+// uguale all'originale, e la memoria resta quella della finestra di
+// PLAYER_WINDOW frame invece dei 999 dell'animazione caricata.
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include "player.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES 999
+
+// Conteggio dell'heap: malloc & co. del programma passano da qui
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static long heap_live, heap_peak;
+
+static void heap_add(long bytes) {
+    long live = __atomic_add_fetch(&heap_live, bytes, __ATOMIC_RELAXED);
+    long peak = __atomic_load_n(&heap_peak, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&heap_peak, &peak, live, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    if (p) heap_add((long)malloc_usable_size(p));
+    return p;
+}
+
+void *calloc(size_t count, size_t size) {
+    void *p = __libc_calloc(count, size);
+    if (p) heap_add((long)malloc_usable_size(p));
+    return p;
+}
+
+void *realloc(void *ptr, size_t size) {
+    long old = ptr ? (long)malloc_usable_size(ptr) : 0;
+    void *p = __libc_realloc(ptr, size);
+    if (p) heap_add((long)malloc_usable_size(p) - old);
+    else if (size == 0) heap_add(-old);
+    return p;
+}
+
+void free(void *ptr) {
+    if (ptr) heap_add(-(long)malloc_usable_size(ptr));
+    __libc_free(ptr);
+}
+
+static void make_file(const char *path) {
+    static AnimationContext anim;
+    static AudioContext audio;
+    int i;
+
+    CHECK(fixture_animation(&anim, FRAMES, FIXTURE_LINEART));
+    for (i = 0; i < FRAMES; i++) {
+        if (i % 50 == 7) anim.frames[i].exposure = 3;
+        if (i % 100 == 20) anim.frames[i].frame_speed = 12;
+    }
+    anim.playback_speed = 24;
+    anim.loop = false;
+    audio_init(&audio);
+    CHECK(filemanager_save(&anim, &audio, path));
+    animation_free(&anim);
+}
+
+int main(int argc, char **argv) {
+    static StreamPlayer player;
+    const char *path = SAVE_DIR "test_player.fnv";
+    Frame *expected = malloc(sizeof(Frame));
+    const Frame *frame;
+    long base, window;
+    int last, idx, wrong = 0, skipped = 0, updates = 0, stalls = 0;
+    double t0, elapsed, first_ms = -1;
+
+    if (argc > 1) sce_host_set_root(argv[1]);
+    filemanager_init();
+    filemanager_set_tile_store(false);
+    make_file(path);
+
+    base = heap_live;
+    heap_peak = base;
+    t0 = test_now_ms();
+    CHECK(player_open(&player, path));
+    CHECK(player.frame_count == FRAMES);
+
+    // 60 aggiornamenti al secondo come il loop principale. Il tempo e'
+    // simulato e corre molto piu' veloce della decodifica: dopo ogni
+    // update si attende il lavoro del thread del player, come se la
+    // decodifica stesse sempre al passo (il suo costo e' misurato a parte)
+    last = -1;
+    while (player.is_playing && updates < FRAMES * 20) {
+        player_update(&player, 1.0f / 60.0f);
+        updates++;
+        if (player.worker_ready) worker_wait(&player.worker);
+
+        frame = player_get_frame(&player);
+        if (!frame) {
+            stalls++;
+            continue;
+        }
+        if (first_ms < 0) first_ms = test_now_ms() - t0;
+
+        idx = player_get_frame_index(&player);
+        if (idx == last) continue;
+        if (idx != last + 1) skipped++;
+        last = idx;
+
+        fixture_frame(expected, idx, FIXTURE_LINEART);
+        if (memcmp(frame->layers, expected->layers, sizeof(expected->layers)) != 0 ||
+            frame->exposure != (idx % 50 == 7 ? 3 : 1) ||
+            frame->frame_speed != (idx % 100 == 20 ? 12 : -1))
+            wrong++;
+    }
+    elapsed = test_now_ms() - t0;
+    window = heap_peak - base;
+    player_close(&player);
+
+    printf("  %d frame in %d aggiornamenti, primo frame dopo %.1f ms, %.2f ms a frame "
+           "(confronto compreso), %d aggiornamenti senza frame\n",
+           last + 1, updates, first_ms, elapsed / FRAMES, stalls);
+    printf("  heap in riproduzione: %.2f MB (finestra %d x %.2f MB), caricata: %.1f MB\n",
+           window / 1048576.0, PLAYER_WINDOW, sizeof(Frame) / 1048576.0,
+           (double)FRAMES * sizeof(Frame) / 1048576.0);
+
+    CHECK(!player.failed);
+    CHECK(last == FRAMES - 1);
+    CHECK(skipped == 0);
+    CHECK(wrong == 0);
+
+    // Finestra piu' i buffer fissi del reader: layer precedenti per i
+    // delta, frame sorgente dei riferimenti, payload compresso e indice.
+    // Nessuno cresce col numero di frame.
+    CHECK(window <= (long)((PLAYER_WINDOW + 2) * sizeof(Frame)) + 512 * 1024);
+    CHECK(heap_live - base < 64 * 1024);
+
+    sceIoRemove(path);
+    free(expected);
+    return test_exit("test_player");
+}
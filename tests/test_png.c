@@ -0,0 +1,216 @@
+// Sequenza PNG decodificata con libpng: ogni file e' a tavolozza con le
+// sole voci diverse dei layer, e l'indice di ogni pixel e' quello del
+// colore composto. Un file per tick di esposizione, copie identiche per
+// i frame tenuti, e l'export del singolo frame da' gli stessi byte.
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES 30
+#define DIR    SAVE_DIR "test_png"
+
+static const char *root = "out/";
+
+// Tavolozza attesa: sfondo poi i colori dei layer dall'alto, senza doppi
+static int reference_palette(unsigned int *palette) {
+    unsigned int c;
+    int l, k, j, colors = 0;
+
+    for (l = 0; l < MAX_LAYERS; l++) {
+        for (k = l == 0 ? 0 : 1; k < LAYER_COLORS_COUNT; k++) {
+            c = drawing_get_rgba_color(k, l);
+            for (j = 0; j < colors && palette[j] != c; j++);
+            if (j == colors) palette[colors++] = c;
+        }
+    }
+    return colors;
+}
+
+static unsigned int expected_rgba(const Frame *f, int p) {
+    int l;
+    for (l = 0; l < MAX_LAYERS; l++) {
+        if (f->layers[l].pixels[p]) return drawing_get_rgba_color(f->layers[l].pixels[p], l);
+    }
+    return drawing_get_rgba_color(0, 0);
+}
+
+static uint8_t *read_file(const char *path, long *size) {
+    char host[512];
+    uint8_t *data;
+    FILE *fp;
+
+    snprintf(host, sizeof(host), "%sux0/%s", root, path + 4);
+    fp = fopen(host, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = malloc(*size);
+    if (data && fread(data, 1, *size, fp) != (size_t)*size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+typedef struct {
+    const uint8_t *data;
+    long size;
+    long pos;
+} PngSource;
+
+static void source_read(png_structp png, png_bytep out, png_size_t n) {
+    PngSource *s = (PngSource *)png_get_io_ptr(png);
+    if (s->pos + (long)n > s->size) png_error(png, "fine del file");
+    memcpy(out, s->data + s->pos, n);
+    s->pos += n;
+}
+
+// Indici della tavolozza un byte per pixel, tavolozza in RGBA8
+static bool decode(const uint8_t *data, long size, uint8_t *indices, unsigned int *palette,
+                   int *colors, int *bits) {
+    PngSource src = {data, size, 0};
+    png_structp png;
+    png_infop info;
+    png_colorp pal;
+    png_bytep alpha;
+    png_bytep rows[CANVAS_HEIGHT];
+    int i, count, transparent = 0;
+
+    png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info = png ? png_create_info_struct(png) : NULL;
+    if (!info) {
+        png_destroy_read_struct(&png, NULL, NULL);
+        return false;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, NULL);
+        return false;
+    }
+
+    png_set_read_fn(png, &src, source_read);
+    png_read_info(png, info);
+    if (png_get_image_width(png, info) != CANVAS_WIDTH ||
+        png_get_image_height(png, info) != CANVAS_HEIGHT ||
+        png_get_color_type(png, info) != PNG_COLOR_TYPE_PALETTE ||
+        !png_get_PLTE(png, info, &pal, &count))
+        png_error(png, "formato");
+    *bits = png_get_bit_depth(png, info);
+    if (!png_get_tRNS(png, info, &alpha, &transparent, NULL)) transparent = 0;
+
+    *colors = count;
+    for (i = 0; i < count; i++) {
+        palette[i] = pal[i].red | pal[i].green << 8 | pal[i].blue << 16 |
+                     (unsigned int)(i < transparent ? alpha[i] : 0xFF) << 24;
+    }
+
+    png_set_packing(png);
+    png_read_update_info(png, info);
+    for (i = 0; i < CANVAS_HEIGHT; i++) rows[i] = indices + i * CANVAS_WIDTH;
+    png_read_image(png, rows);
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static AnimationContext anim;
+    unsigned int ref[256], palette[256], c;
+    uint8_t *indices, *data, *copy, *single;
+    long size, copy_size, single_size, bytes = 0;
+    char path[256];
+    int f, t, p, j, l, k, ref_colors, colors, bits, tick, files = 0;
+    int bad_palette = 0, wrong_pixels = 0, wrong_copies = 0;
+    double t0, ms;
+
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+    CHECK(fixture_animation(&anim, FRAMES, FIXTURE_LINEART));
+    anim.frames[4].exposure = 3;
+    anim.frames[17].exposure = 2;
+
+    // Nel frame 10 ogni colore di ogni layer, in un quadretto scoperto
+    for (l = 0; l < MAX_LAYERS; l++)
+        for (k = 1; k < LAYER_COLORS_COUNT; k++)
+            for (p = 0; p < 16; p++)
+                anim.frames[10].layers[l].pixels[(360 + p / 4) * CANVAS_WIDTH +
+                                                 20 + (l * LAYER_COLORS_COUNT + k) * 8 + p % 4] = k;
+    animation_invalidate_frame_hash(&anim, 10);
+    ref_colors = reference_palette(ref);
+
+    t0 = test_now_ms();
+    CHECK(filemanager_export_png_sequence(&anim, DIR));
+    ms = test_now_ms() - t0;
+
+    indices = malloc(LAYER_PIXELS);
+    tick = 0;
+    for (f = 0; f < FRAMES; f++) {
+        snprintf(path, sizeof(path), DIR "/frame_%04d.png", tick);
+        data = read_file(path, &size);
+        CHECK(data != NULL);
+        if (!data) break;
+        files++;
+        bytes += size;
+
+        if (!decode(data, size, indices, palette, &colors, &bits)) {
+            CHECK(!"PNG illeggibile");
+        } else {
+            if (colors != ref_colors || memcmp(palette, ref, colors * sizeof(unsigned int)))
+                bad_palette++;
+            if (bits != (ref_colors <= 2 ? 1 : ref_colors <= 4 ? 2 : ref_colors <= 16 ? 4 : 8))
+                bad_palette++;
+            for (p = 0; p < LAYER_PIXELS; p++) {
+                c = expected_rgba(&anim.frames[f], p);
+                for (j = 0; j < ref_colors && ref[j] != c; j++);
+                if (indices[p] != j) wrong_pixels++;
+            }
+        }
+
+        // I tick successivi del frame sono copie
+        for (t = 1; t < animation_get_exposure(&anim, f); t++) {
+            snprintf(path, sizeof(path), DIR "/frame_%04d.png", tick + t);
+            copy = read_file(path, &copy_size);
+            if (!copy || copy_size != size || memcmp(copy, data, size)) wrong_copies++;
+            if (copy) files++;
+            free(copy);
+        }
+
+        // Stesso frame esportato da solo
+        if (f == 4 || f == 23) {
+            snprintf(path, sizeof(path), DIR "/single.png");
+            CHECK(filemanager_export_frame_png(&anim, f, path));
+            single = read_file(path, &single_size);
+            CHECK(single && single_size == size && memcmp(single, data, size) == 0);
+            free(single);
+            sceIoRemove(path);
+        }
+
+        free(data);
+        tick += animation_get_exposure(&anim, f);
+    }
+
+    snprintf(path, sizeof(path), DIR "/frame_%04d.png", tick);
+    CHECK(!filemanager_exists(path));
+    printf("  %d file per %d frame, %d colori a %d bit, %.1f KB per file, %.1f ms\n", files,
+           FRAMES, ref_colors, bits, bytes / 1024.0 / FRAMES, ms);
+    CHECK(files == tick);
+    CHECK(ref_colors == 4);
+    CHECK(bad_palette == 0);
+    CHECK(wrong_pixels == 0);
+    CHECK(wrong_copies == 0);
+
+    for (t = 0; t < tick; t++) {
+        snprintf(path, sizeof(path), DIR "/frame_%04d.png", t);
+        sceIoRemove(path);
+    }
+    free(indices);
+    animation_free(&anim);
+    return test_exit("test_png");
+}
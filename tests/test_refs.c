@@ -0,0 +1,113 @@
+// Layer ripetuti salvati come riferimenti (FNV_FRAME_REFS): un ciclo di
+// frame ripetuti costa poco piu' dei frame distinti, e due layer con lo
+// stesso hash ma pixel diversi restano ognuno nel proprio payload.
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define CYCLE   6
+#define REPEATS 10
+
+static AnimationContext anim, loaded;
+static AudioContext audio;
+static DrawingContext *draw;
+
+static long file_size(const char *path) {
+    SceIoStat st;
+    return sceIoGetstat(path, &st) >= 0 ? (long)st.st_size : -1;
+}
+
+static void make_animation(int count, int cycle) {
+    int i;
+    CHECK(fixture_animation(&anim, count, FIXTURE_LINEART));
+    for (i = 0; i < count; i++) {
+        fixture_frame(&anim.frames[i], i % cycle, FIXTURE_LINEART);
+        animation_invalidate_frame_hash(&anim, i);
+    }
+}
+
+static bool reload_equal(const char *path) {
+    int f;
+
+    animation_free(&loaded);
+    animation_init(&loaded);
+    if (!filemanager_load(&loaded, &audio, draw, path)) return false;
+    if (loaded.frame_count != anim.frame_count) return false;
+    for (f = 0; f < anim.frame_count; f++) {
+        if (memcmp(loaded.frames[f].layers, anim.frames[f].layers, sizeof(anim.frames[f].layers)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// CYCLE frame distinti, poi gli stessi ripetuti REPEATS volte, poi
+// CYCLE * REPEATS frame tutti distinti
+static void test_repeated_size(void) {
+    const char *path = SAVE_DIR "test_refs.fnv";
+    long distinct, repeated, all_distinct, per_repeat, per_new;
+
+    make_animation(CYCLE, CYCLE);
+    CHECK(filemanager_save(&anim, &audio, path));
+    distinct = file_size(path);
+    animation_free(&anim);
+
+    make_animation(CYCLE * REPEATS, CYCLE);
+    CHECK(filemanager_save(&anim, &audio, path));
+    repeated = file_size(path);
+    CHECK(reload_equal(path));
+    animation_free(&anim);
+
+    make_animation(CYCLE * REPEATS, CYCLE * REPEATS);
+    CHECK(filemanager_save(&anim, &audio, path));
+    all_distinct = file_size(path);
+    animation_free(&anim);
+
+    // Un frame ripetuto costa chunk, FNVFrameInfo, 3 riferimenti, voce
+    // dell'indice e anteprima; uno nuovo anche il delta dal precedente
+    per_repeat = (repeated - distinct) / (CYCLE * (REPEATS - 1));
+    per_new = (all_distinct - distinct) / (CYCLE * (REPEATS - 1));
+    printf("  %d frame distinti: %ld byte; %d in ciclo: %ld byte, %d distinti: %ld byte "
+           "(%ld contro %ld byte a frame oltre i primi %d)\n",
+           CYCLE, distinct, CYCLE * REPEATS, repeated, CYCLE * REPEATS, all_distinct,
+           per_repeat, per_new, CYCLE);
+    CHECK(per_repeat * 2 < per_new);
+    sceIoRemove(path);
+}
+
+// Collisione forzata: la cache degli hash del frame 5 dichiara per il
+// layer 1 lo stesso hash del frame 2, ma i pixel sono diversi
+static void test_forced_collision(void) {
+    const char *path = SAVE_DIR "test_refs_collision.fnv";
+
+    make_animation(8, 8);
+    animation_get_frame_hash(&anim, 2);
+    animation_get_frame_hash(&anim, 5);
+    CHECK(memcmp(&anim.frames[2].layers[1], &anim.frames[5].layers[1], sizeof(LayerData)) != 0);
+    anim.frames[5].layer_hash[1] = anim.frames[2].layer_hash[1];
+    CHECK(anim.frames[5].hash_valid & (1 << 1));
+
+    CHECK(filemanager_save(&anim, &audio, path));
+    CHECK(reload_equal(path));
+    animation_free(&anim);
+    sceIoRemove(path);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) sce_host_set_root(argv[1]);
+    filemanager_init();
+    filemanager_set_tile_store(false);
+    draw = malloc(sizeof(DrawingContext));
+    drawing_init(draw);
+    audio_init(&audio);
+    animation_init(&loaded);
+
+    test_repeated_size();
+    test_forced_collision();
+
+    animation_free(&loaded);
+    free(draw);
+    return test_exit("test_refs");
+}
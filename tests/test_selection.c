@@ -0,0 +1,238 @@
+// Trasformazioni e combinazioni della selezione: la rotazione di 90 gradi
+// sposta solo i pixel selezionati (come i flip), L/R nella UI scelgono
+// unione, sottrazione e intersezione. Un lazo piu' lungo del buffer
+// viene sfoltito, non troncato. Il paste per run dello stamp da' gli
+// stessi pixel di una copia pixel per pixel.
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "drawing.h"
+#include "selection.h"
+#include "test.h"
+
+static DrawingContext *ctx;
+
+static uint8_t *pix(int x, int y) {
+    return &ctx->layers[ctx->active_layer].pixels[y * CANVAS_WIDTH + x];
+}
+
+static void fill_pattern(void) {
+    int x, y;
+    for (y = 0; y < CANVAS_HEIGHT; y++)
+        for (x = 0; x < CANVAS_WIDTH; x++)
+            *pix(x, y) = (uint8_t)((x * 3 + y * 5 + (x * y >> 4)) & 3);
+}
+
+static int count_selected(void) {
+    int x, y, n = 0;
+    for (y = 0; y < CANVAS_HEIGHT; y++)
+        for (x = 0; x < CANVAS_WIDTH; x++)
+            n += selection_test(&ctx->selection_mask, x, y);
+    return n;
+}
+
+static void test_rotate_inside(void) {
+    LayerData *before = malloc(sizeof(LayerData));
+    int x0 = 100, y0 = 50, w = 11, h = 21;
+    int x, y, i, changed_outside = 0, wrong = 0;
+
+    fill_pattern();
+    memcpy(before, &ctx->layers[0], sizeof(LayerData));
+    drawing_select_area(ctx, x0, y0, w, h);
+    drawing_rotate_90(ctx);
+
+    // Centro (105, 60): (x, y) -> (165 - y, x - 45)
+    CHECK(ctx->has_selection);
+    CHECK(ctx->sel_x == 95 && ctx->sel_y == 55 && ctx->sel_w == h && ctx->sel_h == w);
+    for (y = y0; y < y0 + h; y++)
+        for (x = x0; x < x0 + w; x++)
+            if (*pix(165 - y, x - 45) != before->pixels[y * CANVAS_WIDTH + x]) wrong++;
+    CHECK(wrong == 0);
+    CHECK(count_selected() == w * h);
+
+    // Fuori dall'unione dei due rettangoli nulla cambia
+    for (y = 0; y < CANVAS_HEIGHT; y++) {
+        for (x = 0; x < CANVAS_WIDTH; x++) {
+            int in_old = x >= x0 && x < x0 + w && y >= y0 && y < y0 + h;
+            int in_new = x >= 95 && x < 95 + h && y >= 55 && y < 55 + w;
+            if (!in_old && !in_new && *pix(x, y) != before->pixels[y * CANVAS_WIDTH + x])
+                changed_outside++;
+        }
+    }
+    CHECK(changed_outside == 0);
+
+    // Quattro rotazioni riportano il contenuto selezionato al suo posto
+    for (i = 0; i < 3; i++) drawing_rotate_90(ctx);
+    CHECK(ctx->sel_x == x0 && ctx->sel_y == y0 && ctx->sel_w == w && ctx->sel_h == h);
+    wrong = 0;
+    for (y = y0; y < y0 + h; y++)
+        for (x = x0; x < x0 + w; x++)
+            if (*pix(x, y) != before->pixels[y * CANVAS_WIDTH + x]) wrong++;
+    CHECK(wrong == 0);
+
+    drawing_clear_selection(ctx);
+    free(before);
+}
+
+static void test_rotate_clipped(void) {
+    // Striscia orizzontale sul bordo destro: ruotata diventa verticale e
+    // la parte che esce dal canvas in basso va persa
+    fill_pattern();
+    drawing_select_area(ctx, 400, 370, 100, 5);
+    drawing_rotate_90(ctx);
+    CHECK(ctx->has_selection);
+    CHECK(ctx->sel_y + ctx->sel_h <= CANVAS_HEIGHT);
+    CHECK(ctx->sel_w == 5);
+    CHECK(count_selected() == 5 * (CANVAS_HEIGHT - ctx->sel_y));
+    drawing_clear_selection(ctx);
+}
+
+static void test_flip_keeps_outside(void) {
+    LayerData *before = malloc(sizeof(LayerData));
+    int wrong = 0, x, y;
+
+    fill_pattern();
+    memcpy(before, &ctx->layers[0], sizeof(LayerData));
+    drawing_select_area(ctx, 10, 10, 30, 20);
+    drawing_flip_horizontal(ctx);
+    for (y = 10; y < 30; y++)
+        for (x = 10; x < 40; x++)
+            if (*pix(x, y) != before->pixels[y * CANVAS_WIDTH + (49 - x)]) wrong++;
+    CHECK(wrong == 0);
+    CHECK(*pix(9, 10) == before->pixels[10 * CANVAS_WIDTH + 9]);
+    drawing_clear_selection(ctx);
+    free(before);
+}
+
+static void select_rect(int x, int y, int w, int h, SelectionOp op) {
+    SelectionMask *m = malloc(sizeof(SelectionMask));
+    selection_clear(m);
+    selection_rect(m, x, y, w, h);
+    drawing_select_mask(ctx, m, op);
+    free(m);
+}
+
+static void test_combine(void) {
+    // A = 20x20 in (0,0), B = 20x20 in (10,10): sovrapposti 10x10
+    drawing_clear_selection(ctx);
+    select_rect(0, 0, 20, 20, SEL_REPLACE);
+    CHECK(count_selected() == 400);
+    select_rect(10, 10, 20, 20, SEL_UNION);
+    CHECK(count_selected() == 700);
+    CHECK(ctx->sel_x == 0 && ctx->sel_y == 0 && ctx->sel_w == 30 && ctx->sel_h == 30);
+
+    select_rect(0, 0, 20, 20, SEL_REPLACE);
+    select_rect(10, 10, 20, 20, SEL_SUBTRACT);
+    CHECK(count_selected() == 300);
+
+    select_rect(0, 0, 20, 20, SEL_REPLACE);
+    select_rect(10, 10, 20, 20, SEL_INTERSECT);
+    CHECK(count_selected() == 100);
+    CHECK(ctx->sel_x == 10 && ctx->sel_y == 10 && ctx->sel_w == 10 && ctx->sel_h == 10);
+
+    // Sottrarre tutto lascia senza selezione
+    select_rect(0, 0, 40, 40, SEL_SUBTRACT);
+    CHECK(!ctx->has_selection);
+}
+
+static int count_diff(const SelectionMask *a, const SelectionMask *b) {
+    int x, y, n = 0;
+    for (y = 0; y < CANVAS_HEIGHT; y++)
+        for (x = 0; x < CANVAS_WIDTH; x++)
+            n += selection_test(a, x, y) != selection_test(b, x, y);
+    return n;
+}
+
+// Fiore a 8 petali tracciato a passi di un pixel circa: molti piu'
+// campioni di MAX_LASSO_POINTS, confrontato col poligono completo
+static void test_lasso_long(void) {
+    enum { SAMPLES = 4000 };
+    static int xs[SAMPLES], ys[SAMPLES];
+    SelectionMask *full = malloc(sizeof(SelectionMask));
+    SelectionMask *truncated = malloc(sizeof(SelectionMask));
+    double a, r;
+    int i, area, diff, diff_truncated;
+
+    drawing_clear_selection(ctx);
+    for (i = 0; i < SAMPLES; i++) {
+        a = 2 * M_PI * i / SAMPLES;
+        r = 90 + 25 * sin(8 * a);
+        xs[i] = 240 + (int)lround(r * cos(a));
+        ys[i] = 136 + (int)lround(r * sin(a));
+        drawing_lasso_add_point(ctx, xs[i], ys[i]);
+        CHECK(ctx->lasso_count <= MAX_LASSO_POINTS);
+    }
+    CHECK(ctx->lasso_count >= MAX_LASSO_POINTS / 2);
+    CHECK(abs(ctx->lasso_x[ctx->lasso_count - 1] - xs[SAMPLES - 1]) < LASSO_MIN_DIST);
+    CHECK(abs(ctx->lasso_y[ctx->lasso_count - 1] - ys[SAMPLES - 1]) < LASSO_MIN_DIST);
+
+    selection_lasso(full, xs, ys, SAMPLES);
+    selection_lasso(truncated, xs, ys, MAX_LASSO_POINTS);
+    drawing_select_lasso(ctx, ctx->lasso_x, ctx->lasso_y, ctx->lasso_count, SEL_REPLACE);
+    area = count_selected();
+    diff = count_diff(&ctx->selection_mask, full);
+    diff_truncated = count_diff(truncated, full);
+    printf("  lazo: %d campioni -> %d punti, %d pixel, %d diversi dal poligono completo "
+           "(%d troncando)\n", SAMPLES, ctx->lasso_count, area, diff, diff_truncated);
+    CHECK(diff * 100 < area);
+
+    drawing_clear_selection(ctx);
+    free(full);
+    free(truncated);
+}
+
+// Stamp da un lazo sul motivo (con pixel trasparenti dentro), incollato
+// anche a cavallo dei bordi
+static void test_stamp_paste(void) {
+    static const int pos[][2] = {{0, 0}, {37, 11}, {-60, -40}, {400, 200}, {-5, 250}, {470, 0}};
+    static const int xs[] = {30, 170, 150, 60, 10}, ys[] = {20, 5, 120, 140, 90};
+    LayerData *expected = malloc(sizeof(LayerData));
+    int i, px, py, x, y, wrong = 0;
+    uint8_t v;
+
+    fill_pattern();
+    drawing_select_lasso(ctx, xs, ys, 5, SEL_REPLACE);
+    drawing_copy_selection(ctx);
+    CHECK(ctx->has_stamp && ctx->stamp_runs != NULL);
+    if (!ctx->has_stamp) return;
+
+    for (i = 0; i < (int)(sizeof(pos) / sizeof(pos[0])); i++) {
+        memset(&ctx->layers[0], 3, sizeof(LayerData));
+        memset(expected, 3, sizeof(LayerData));
+        for (py = 0; py < ctx->stamp_h; py++) {
+            for (px = 0; px < ctx->stamp_w; px++) {
+                v = ctx->stamp_buffer[py * CANVAS_WIDTH + px];
+                x = pos[i][0] + px;
+                y = pos[i][1] + py;
+                if (v && x >= 0 && x < CANVAS_WIDTH && y >= 0 && y < CANVAS_HEIGHT)
+                    expected->pixels[y * CANVAS_WIDTH + x] = v;
+            }
+        }
+        drawing_paste_selection(ctx, pos[i][0], pos[i][1]);
+        wrong += memcmp(&ctx->layers[0], expected, sizeof(LayerData)) != 0;
+    }
+    CHECK(wrong == 0);
+    printf("  stamp %dx%d: %d run, %u byte\n", ctx->stamp_w, ctx->stamp_h,
+           ctx->stamp_row_start[ctx->stamp_h],
+           (unsigned)(ctx->stamp_row_start[ctx->stamp_h] * sizeof(StampRun)));
+
+    drawing_reset(ctx);
+    CHECK(!ctx->has_stamp && ctx->stamp_runs == NULL);
+    free(expected);
+}
+
+int main(void) {
+    ctx = malloc(sizeof(DrawingContext));
+    drawing_init(ctx);
+
+    test_rotate_inside();
+    test_rotate_clipped();
+    test_flip_keeps_outside();
+    test_combine();
+    test_lasso_long();
+    test_stamp_paste();
+
+    drawing_free(ctx);
+    free(ctx);
+    return test_exit("test_selection");
+}
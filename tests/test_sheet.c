@@ -0,0 +1,242 @@
+// Sprite sheet riletto: sheet.json e gli atlanti decodificati con libpng.
+// Due frame condividono la cella solo se le immagini composte sono
+// identiche (memcmp), ogni cella e' ritagliata sull'inchiostro del suo
+// frame, le celle non si sovrappongono e rimettendo la cella al suo
+// offset si riottiene ogni frame pixel per pixel.
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES    40
+#define DIR       SAVE_DIR "test_sheet"
+#define MAX_PAGES 8
+
+static const char *root = "out/";
+
+typedef struct {
+    int atlas, x, y, w, h, offset_x, offset_y;
+} Cell;
+
+static Cell cells[FRAMES];
+static int cell_of[FRAMES];
+static double duration[FRAMES];
+static uint16_t composite[FRAMES][LAYER_PIXELS];    // layer << 8 | colore, 0 = vuoto
+
+static void compose(const Frame *f, uint16_t *out) {
+    int p, l;
+
+    for (p = 0; p < LAYER_PIXELS; p++) {
+        out[p] = 0;
+        for (l = 0; l < MAX_LAYERS && !out[p]; l++) {
+            if (f->layers[l].pixels[p]) out[p] = (uint16_t)(l << 8 | f->layers[l].pixels[p]);
+        }
+    }
+}
+
+static unsigned int composite_rgba(uint16_t v) {
+    return v ? drawing_get_rgba_color(v & 0xFF, v >> 8) : 0;
+}
+
+static void make_animation(AnimationContext *anim) {
+    int f, p;
+
+    CHECK(fixture_animation(anim, FRAMES, FIXTURE_LINEART));
+    anim->playback_speed = 8;
+    anim->frames[9].frame_speed = 3;
+    anim->frames[15].exposure = 4;
+
+    // 5 e 6 uguali al 3 (non consecutivi), 20 come 19 ma con un pixel
+    // coperto diverso, 30 e 31 vuoti
+    for (f = 5; f <= 6; f++) memcpy(anim->frames[f].layers, anim->frames[3].layers, sizeof(anim->frames[f].layers));
+    memcpy(anim->frames[20].layers, anim->frames[19].layers, sizeof(anim->frames[20].layers));
+    for (p = 0; p < LAYER_PIXELS && !anim->frames[20].layers[0].pixels[p]; p++);
+    anim->frames[20].layers[2].pixels[p] = anim->frames[20].layers[2].pixels[p] == 1 ? 2 : 1;
+    memset(anim->frames[30].layers, 0, sizeof(anim->frames[30].layers));
+    memset(anim->frames[31].layers, 0, sizeof(anim->frames[31].layers));
+
+    for (f = 0; f < FRAMES; f++) animation_invalidate_frame_hash(anim, f);
+}
+
+// Una riga per cella e una per frame, come le scrive l'export
+static int read_sheet(int *atlases) {
+    char host[512], line[512];
+    int count = 0, frames = 0, i;
+    const char *s;
+    FILE *fp;
+
+    *atlases = 0;
+    snprintf(host, sizeof(host), "%sux0/%s", root, DIR "/sheet.json" + 4);
+    fp = fopen(host, "r");
+    if (!fp) return -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strstr(line, "\"atlases\"")) {
+            for (s = line; (s = strstr(s, "atlas_")) != NULL; s++) (*atlases)++;
+        } else if (count < FRAMES && strstr(line, "\"offset_x\"")) {
+            Cell *c = &cells[count++];
+            if (sscanf(line, " { \"atlas\": %d, \"x\": %d, \"y\": %d, \"w\": %d, \"h\": %d, "
+                             "\"offset_x\": %d, \"offset_y\": %d }",
+                       &c->atlas, &c->x, &c->y, &c->w, &c->h, &c->offset_x, &c->offset_y) != 7)
+                count = -FRAMES;
+        } else if (frames < FRAMES && strstr(line, "\"cell\"")) {
+            i = frames++;
+            if (sscanf(line, " { \"cell\": %d, \"duration_ms\": %lf }", &cell_of[i], &duration[i]) != 2)
+                count = -FRAMES;
+        }
+    }
+    fclose(fp);
+    return frames == FRAMES ? count : -1;
+}
+
+static uint8_t *read_atlas(int page, int *w, int *h) {
+    char host[512];
+    png_image image;
+    uint8_t *rgba;
+
+    snprintf(host, sizeof(host), "%sux0/%s/atlas_%d.png", root, DIR + 4, page);
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&image, host)) return NULL;
+    image.format = PNG_FORMAT_RGBA;
+    rgba = malloc(PNG_IMAGE_SIZE(image));
+    if (!rgba || !png_image_finish_read(&image, NULL, rgba, 0, NULL)) {
+        png_image_free(&image);
+        free(rgba);
+        return NULL;
+    }
+    *w = image.width;
+    *h = image.height;
+    return rgba;
+}
+
+// Riquadro dell'inchiostro; false se il frame e' vuoto
+static bool ink_rect(const uint16_t *img, int *x0, int *y0, int *x1, int *y1) {
+    int p;
+
+    *x0 = CANVAS_WIDTH;
+    *y0 = CANVAS_HEIGHT;
+    *x1 = *y1 = -1;
+    for (p = 0; p < LAYER_PIXELS; p++) {
+        if (!img[p]) continue;
+        if (p % CANVAS_WIDTH < *x0) *x0 = p % CANVAS_WIDTH;
+        if (p % CANVAS_WIDTH > *x1) *x1 = p % CANVAS_WIDTH;
+        if (p / CANVAS_WIDTH < *y0) *y0 = p / CANVAS_WIDTH;
+        if (p / CANVAS_WIDTH > *y1) *y1 = p / CANVAS_WIDTH;
+    }
+    return *x1 >= 0;
+}
+
+int main(int argc, char **argv) {
+    static AnimationContext anim;
+    uint8_t *atlas[MAX_PAGES];
+    int atlas_w[MAX_PAGES], atlas_h[MAX_PAGES];
+    int count, atlases, distinct, f, g, c, d, x, y, x0, y0, x1, y1, speed, p;
+    int wrong_dedup = 0, wrong_rects = 0, overlaps = 0, wrong_pixels = 0, wrong_durations = 0;
+    long cell_area = 0, atlas_area = 0;
+    unsigned int want, got;
+    const uint8_t *px;
+    double t0, ms;
+
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+    make_animation(&anim);
+    for (f = 0; f < FRAMES; f++) compose(&anim.frames[f], composite[f]);
+
+    t0 = test_now_ms();
+    CHECK(filemanager_export_sprite_sheet(&anim, DIR));
+    ms = test_now_ms() - t0;
+
+    count = read_sheet(&atlases);
+    CHECK(count > 0 && atlases > 0 && atlases <= MAX_PAGES);
+    if (count <= 0 || atlases <= 0 || atlases > MAX_PAGES) return test_exit("test_sheet");
+    for (p = 0; p < atlases; p++) {
+        atlas[p] = read_atlas(p, &atlas_w[p], &atlas_h[p]);
+        CHECK(atlas[p] != NULL);
+        if (!atlas[p]) return test_exit("test_sheet");
+    }
+
+    // Stessa cella se e solo se le immagini composte sono identiche
+    distinct = 0;
+    for (f = 0; f < FRAMES; f++) {
+        for (g = 0; g < f && memcmp(composite[g], composite[f], sizeof(composite[f])); g++);
+        if (g == f) distinct++;
+        for (g = 0; g < f; g++) {
+            bool same = memcmp(composite[g], composite[f], sizeof(composite[f])) == 0;
+            if (same != (cell_of[g] == cell_of[f])) wrong_dedup++;
+        }
+    }
+
+    // Ogni cella ritagliata sull'inchiostro del frame, dentro l'atlante
+    for (f = 0; f < FRAMES; f++) {
+        const Cell *cell;
+        c = cell_of[f];
+        if (c < 0 || c >= count) {
+            wrong_rects++;
+            continue;
+        }
+        cell = &cells[c];
+        if (!ink_rect(composite[f], &x0, &y0, &x1, &y1)) {
+            if (cell->atlas != -1 || cell->w != 0 || cell->h != 0) wrong_rects++;
+            continue;
+        }
+        if (cell->atlas < 0 || cell->atlas >= atlases || cell->offset_x != x0 ||
+            cell->offset_y != y0 || cell->w != x1 - x0 + 1 || cell->h != y1 - y0 + 1 ||
+            cell->x + cell->w > atlas_w[cell->atlas] || cell->y + cell->h > atlas_h[cell->atlas]) {
+            wrong_rects++;
+            continue;
+        }
+
+        // La cella al suo offset rida' il frame
+        for (y = 0; y < cell->h; y++) {
+            for (x = 0; x < cell->w; x++) {
+                px = atlas[cell->atlas] + ((cell->y + y) * atlas_w[cell->atlas] + cell->x + x) * 4;
+                got = px[0] | px[1] << 8 | px[2] << 16 | (unsigned int)px[3] << 24;
+                want = composite_rgba(composite[f][(y0 + y) * CANVAS_WIDTH + x0 + x]);
+                if (got != want && !(px[3] == 0 && want == 0)) wrong_pixels++;
+            }
+        }
+    }
+
+    for (p = 0; p < atlases; p++) atlas_area += (long)atlas_w[p] * atlas_h[p];
+    for (c = 0; c < count; c++) {
+        cell_area += (long)cells[c].w * cells[c].h;
+        for (d = 0; d < c; d++) {
+            if (cells[c].atlas < 0 || cells[c].atlas != cells[d].atlas) continue;
+            if (cells[c].x < cells[d].x + cells[d].w && cells[d].x < cells[c].x + cells[c].w &&
+                cells[c].y < cells[d].y + cells[d].h && cells[d].y < cells[c].y + cells[c].h)
+                overlaps++;
+        }
+    }
+
+    for (f = 0; f < FRAMES; f++) {
+        speed = anim.frames[f].frame_speed > 0 ? anim.frames[f].frame_speed : anim.playback_speed;
+        if (duration[f] < animation_get_exposure(&anim, f) * 1000.0 / speed - 0.001 ||
+            duration[f] > animation_get_exposure(&anim, f) * 1000.0 / speed + 0.001)
+            wrong_durations++;
+    }
+
+    printf("  %d frame, %d celle, %d atlanti, celle %.1f%% dell'area degli atlanti, %.1f ms\n",
+           FRAMES, count, atlases, cell_area * 100.0 / atlas_area, ms);
+    CHECK(count == distinct);
+    CHECK(count == FRAMES - 4);
+    CHECK(wrong_dedup == 0);
+    CHECK(wrong_rects == 0);
+    CHECK(overlaps == 0);
+    CHECK(wrong_pixels == 0);
+    CHECK(wrong_durations == 0);
+
+    for (p = 0; p < atlases; p++) {
+        char path[256];
+        free(atlas[p]);
+        snprintf(path, sizeof(path), DIR "/atlas_%d.png", p);
+        sceIoRemove(path);
+    }
+    sceIoRemove(DIR "/sheet.json");
+    animation_free(&anim);
+    return test_exit("test_sheet");
+}
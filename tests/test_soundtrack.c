@@ -0,0 +1,218 @@
+// Colonna sonora fuori linea confrontata campione per campione con un
+// mixer di riferimento scritto in modo diverso (ogni clip sommata per
+// intero in un accumulatore lungo quanto la traccia), poi l'export WAV:
+// header, lunghezza e campioni.
+#include <stdlib.h>
+#include <string.h>
+#include "filemanager.h"
+#include "soundtrack.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES      300
+#define WAV_FRAMES  48
+
+static const char *root = "out/";
+static AudioContext audio;
+
+static int16_t *noise_clip(int count, uint32_t seed) {
+    int16_t *data = malloc(count * sizeof(int16_t));
+    int i;
+    fixture_seed = seed;
+    for (i = 0; i < count; i++) data[i] = (int16_t)(fixture_rand() & 0xFFFF);
+    return data;
+}
+
+static void set_clip(SoundClip *clip, int count, int rate, uint32_t seed) {
+    free(clip->data);
+    clip->data = noise_clip(count, seed);
+    clip->sample_count = count;
+    clip->sample_rate = rate;
+}
+
+// SE 2 spento, SE 3 registrato a 22050 Hz, metronomo ogni 4 frame, BGM
+static void make_audio(int frames) {
+    int f, s;
+
+    memset(&audio, 0, sizeof(audio));
+    for (s = 0; s < MAX_SOUND_EFFECTS; s++) {
+        set_clip(&audio.sound_effects[s], 2000 + s * 3000, AUDIO_SAMPLE_RATE, 11 + s);
+        audio.se_enabled[s] = 1;
+    }
+    audio.sound_effects[3].sample_rate = 22050;
+    audio.se_enabled[2] = 0;
+    set_clip(&audio.bgm, 500000, AUDIO_SAMPLE_RATE, 99);
+    audio.bgm_enabled = 1;
+    audio.bgm_volume = 0.25f;
+    audio.se_volume = 0.7f;
+    audio.metronome_enabled = 1;
+    audio.metronome_interval = 4;
+
+    fixture_seed = 7;
+    for (f = 0; f < frames; f++) {
+        for (s = 0; s < MAX_SOUND_EFFECTS; s++) audio.se_triggers[f][s] = fixture_rand() % 5 == 0;
+    }
+}
+
+// Riferimento: volumi in 1/4096 arrotondati, clip a un'altra frequenza
+// col campione sorgente piu' vicino per difetto, saturazione a 16 bit
+static int16_t *reference_mix(const uint32_t *start, int frames, uint32_t total) {
+    int64_t *se = calloc(total, sizeof(int64_t));
+    int16_t *out = malloc(total * sizeof(int16_t));
+    int64_t se_q12 = (int64_t)(audio.se_volume * 4096 + 0.5f);
+    int64_t bgm_q12 = audio.bgm_enabled ? (int64_t)(audio.bgm_volume * 4096 + 0.5f) : 0;
+    int64_t v, bgm;
+    uint32_t k, len;
+    int f, s;
+
+    for (f = 0; f < frames; f++) {
+        for (s = 0; s < MAX_SOUND_EFFECTS; s++) {
+            const SoundClip *c = &audio.sound_effects[s];
+            if (!audio.se_enabled[s]) continue;
+            if (!audio.se_triggers[f][s] &&
+                !(s == 0 && audio.metronome_enabled && f % audio.metronome_interval == 0))
+                continue;
+            len = (uint32_t)((uint64_t)c->sample_count * AUDIO_SAMPLE_RATE / c->sample_rate);
+            for (k = 0; k < len && start[f] + k < total; k++)
+                se[start[f] + k] += c->data[(uint64_t)k * c->sample_rate / AUDIO_SAMPLE_RATE];
+        }
+    }
+    for (k = 0; k < total; k++) {
+        bgm = k < (uint32_t)audio.bgm.sample_count ? audio.bgm.data[k] : 0;
+        v = (se[k] * se_q12 + bgm * bgm_q12) >> 12;
+        out[k] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+    }
+    free(se);
+    return out;
+}
+
+static long count_diff(const int16_t *a, const int16_t *b, uint32_t n) {
+    long diff = 0;
+    uint32_t i;
+    for (i = 0; i < n; i++) diff += a[i] != b[i];
+    return diff;
+}
+
+// 300 frame a passo irregolare, in un colpo solo e a blocchi casuali
+static void test_render(void) {
+    uint32_t start[FRAMES], total, pos, n;
+    int16_t *whole, *blocks, *ref;
+    double t0, ms;
+    long clipped = 0;
+    uint32_t k;
+    int f;
+
+    make_audio(FRAMES);
+    for (f = 0; f < FRAMES; f++) start[f] = f * 5512 + (f * 3) / 8;
+    total = FRAMES * 5513;
+
+    whole = malloc(total * sizeof(int16_t));
+    blocks = malloc(total * sizeof(int16_t));
+    t0 = test_now_ms();
+    soundtrack_render(&audio, start, FRAMES, 0, whole, total);
+    ms = test_now_ms() - t0;
+
+    fixture_seed = 3;
+    for (pos = 0; pos < total; pos += n) {
+        n = 1 + fixture_rand() % 7000;
+        if (n > total - pos) n = total - pos;
+        soundtrack_render(&audio, start, FRAMES, pos, blocks + pos, n);
+    }
+
+    ref = reference_mix(start, FRAMES, total);
+    for (k = 0; k < total; k++) clipped += ref[k] == 32767 || ref[k] == -32768;
+    printf("  %u campioni (%.1f s) in %.1f ms, %ld saturati\n", total,
+           total / (double)AUDIO_SAMPLE_RATE, ms, clipped);
+    CHECK(count_diff(whole, ref, total) == 0);
+    CHECK(count_diff(blocks, whole, total) == 0);
+    CHECK(clipped > 0);
+
+    free(whole);
+    free(blocks);
+    free(ref);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+// Velocita' 8, 12, 24 e 3 fps con esposizioni 1..3: in 24esimi di
+// secondo ogni durata e' intera, e l'inizio di ogni frame e' il campione
+// piu' vicino
+static void test_export_wav(void) {
+    static AnimationContext anim;
+    const char *path = SAVE_DIR "test_soundtrack.wav";
+    static const int speeds[] = {8, 12, 24, 3};
+    uint32_t start[WAV_FRAMES], total, t24;
+    uint8_t *data;
+    int16_t *ref;
+    char host[512];
+    FILE *fp;
+    long size;
+    int f;
+
+    CHECK(fixture_animation(&anim, WAV_FRAMES, FIXTURE_LINEART));
+    anim.playback_speed = 12;
+    t24 = 0;
+    for (f = 0; f < WAV_FRAMES; f++) {
+        anim.frames[f].frame_speed = f % 5 == 4 ? -1 : speeds[f % 4];
+        anim.frames[f].exposure = 1 + f % 3;
+        start[f] = (t24 * AUDIO_SAMPLE_RATE + 12) / 24;
+        t24 += anim.frames[f].exposure * 24 / (f % 5 == 4 ? 12 : speeds[f % 4]);
+    }
+    total = (t24 * AUDIO_SAMPLE_RATE + 12) / 24;
+
+    make_audio(WAV_FRAMES);
+    CHECK(filemanager_export_wav(&anim, &audio, path));
+
+    snprintf(host, sizeof(host), "%sux0/%s", root, path + 4);
+    fp = fopen(host, "rb");
+    CHECK(fp != NULL);
+    if (!fp) return;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = malloc(size);
+    CHECK(fread(data, 1, size, fp) == (size_t)size);
+    fclose(fp);
+
+    CHECK(size == SOUNDTRACK_WAV_HEADER + (long)total * 2);
+    CHECK(memcmp(data, "RIFF", 4) == 0 && get_u32(data + 4) == (uint32_t)size - 8);
+    CHECK(memcmp(data + 8, "WAVEfmt ", 8) == 0 && get_u32(data + 16) == 16);
+    CHECK(get_u16(data + 20) == 1 && get_u16(data + 22) == 1);
+    CHECK(get_u32(data + 24) == AUDIO_SAMPLE_RATE && get_u32(data + 28) == AUDIO_SAMPLE_RATE * 2);
+    CHECK(get_u16(data + 32) == 2 && get_u16(data + 34) == 16);
+    CHECK(memcmp(data + 36, "data", 4) == 0 && get_u32(data + 40) == total * 2);
+
+    ref = reference_mix(start, WAV_FRAMES, total);
+    if (size == SOUNDTRACK_WAV_HEADER + (long)total * 2)
+        CHECK(count_diff((const int16_t *)(data + SOUNDTRACK_WAV_HEADER), ref, total) == 0);
+    printf("  WAV: %d frame, %u campioni (%.3f s), %ld byte\n", WAV_FRAMES, total,
+           total / (double)AUDIO_SAMPLE_RATE, size);
+
+    free(ref);
+    free(data);
+    sceIoRemove(path);
+    animation_free(&anim);
+}
+
+int main(int argc, char **argv) {
+    int s;
+
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+
+    test_render();
+    test_export_wav();
+
+    for (s = 0; s < MAX_SOUND_EFFECTS; s++) free(audio.sound_effects[s].data);
+    free(audio.bgm.data);
+    return test_exit("test_soundtrack");
+}
@@ -0,0 +1,247 @@
+// Log dei tratti: rieseguire il log di ogni layer su un layer vuoto deve
+// dare gli stessi byte, nel DrawingContext, nei Frame (duplicati, copiati,
+// in uno snapshot) e dopo salvataggio e caricamento del .fnv.
+#include <stdlib.h>
+#include <string.h>
+#include "filemanager.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES 30
+
+static AnimationContext anim, loaded;
+static AudioContext audio;
+static DrawingContext *draw, *scratch;
+
+// Tratti casuali come dalla UI: penna, gomma, forme, secchiello, con
+// qualche undo/redo in mezzo
+static void draw_scene(DrawingContext *d, uint32_t seed, int count) {
+    int k, j, n, x, y;
+
+    fixture_seed = seed;
+    for (k = 0; k < count; k++) {
+        d->active_layer = fixture_rand() % MAX_LAYERS;
+        d->current_color = 1 + fixture_rand() % 3;
+        d->brush_size = 1 + fixture_rand() % 6;
+        x = fixture_rand() % CANVAS_WIDTH;
+        y = fixture_rand() % CANVAS_HEIGHT;
+        if (k % 9 == 4) drawing_save_undo(d);
+
+        switch (fixture_rand() % 7) {
+            case 0:
+            case 1:
+                d->current_tool = TOOL_PEN;
+                d->is_drawing = 0;
+                n = 2 + fixture_rand() % 40;
+                for (j = 0; j < n; j++) {
+                    x += (int)(fixture_rand() % 21) - 10;
+                    y += (int)(fixture_rand() % 21) - 10;
+                    drawing_pen_stroke(d, x, y);
+                }
+                break;
+            case 2:
+                d->is_drawing = 0;
+                for (j = 0; j < 10; j++) drawing_eraser_stroke(d, x + j * 3, y + j);
+                break;
+            case 3:
+                drawing_line(d, x, y, fixture_rand() % CANVAS_WIDTH, fixture_rand() % CANVAS_HEIGHT);
+                break;
+            case 4:
+                drawing_rect(d, x, y, x + (int)(fixture_rand() % 80) - 40,
+                             y + (int)(fixture_rand() % 80) - 40, fixture_rand() % 2);
+                break;
+            case 5:
+                drawing_circle(d, x, y, 1 + fixture_rand() % 50, fixture_rand() % 2);
+                break;
+            case 6:
+                drawing_bucket_fill(d, x, y);
+                break;
+        }
+
+        // Un tratto annullato e ripristinato, uno annullato e sostituito
+        if (k % 9 == 4) {
+            drawing_save_undo(d);
+            drawing_undo(d);
+            if (k % 2) drawing_redo(d);
+        }
+    }
+    d->is_drawing = 0;
+}
+
+static bool replay_equal(DrawingContext *d, int layer, const LayerData *expected) {
+    return drawing_replay_strokes(d, layer) &&
+           memcmp(&d->layers[layer], expected, sizeof(LayerData)) == 0;
+}
+
+// Il log del frame rieseguito in scratch da' i pixel del frame
+static bool frame_replay_equal(const Frame *f, int layer) {
+    if (!f->strokes[layer] || !strokes_copy(&scratch->strokes[layer], f->strokes[layer])) return false;
+    return replay_equal(scratch, layer, &f->layers[layer]);
+}
+
+static void test_draw_replay(void) {
+    static LayerData before[MAX_LAYERS];
+    uint32_t bytes = 0;
+    int l, strokes = 0, points = 0;
+    double t0, ms;
+
+    drawing_reset(draw);
+    draw_scene(draw, 12345, 400);
+    memcpy(before, draw->layers, sizeof(before));
+
+    t0 = test_now_ms();
+    for (l = 0; l < MAX_LAYERS; l++) {
+        CHECK(draw->strokes[l].valid);
+        CHECK(replay_equal(draw, l, &before[l]));
+        strokes += draw->strokes[l].count;
+        points += strokes_point_count(&draw->strokes[l]);
+        bytes += strokes_serialized_size(&draw->strokes[l]);
+    }
+    ms = test_now_ms() - t0;
+    printf("  400 operazioni: %d tratti, %d punti, %u byte di log contro %u di raster, "
+           "replay %.2f ms\n", strokes, points, bytes,
+           (unsigned)(MAX_LAYERS * sizeof(LayerData)), ms);
+
+    // Una modifica solo raster invalida il log del layer
+    draw->active_layer = 1;
+    drawing_flip_horizontal(draw);
+    CHECK(!draw->strokes[1].valid);
+    CHECK(!drawing_replay_strokes(draw, 1));
+    CHECK(draw->strokes[0].valid && draw->strokes[2].valid);
+}
+
+static void make_animation(void) {
+    int f;
+
+    animation_free(&anim);
+    animation_init(&anim);
+    drawing_reset(draw);
+    for (f = 0; f < FRAMES; f++) {
+        if (f > 0) {
+            animation_add_frame(&anim);
+            animation_goto_frame(&anim, draw, f);
+        }
+        draw_scene(draw, 1000 + f, 20 + f % 7);
+        if (f == 7) {
+            draw->active_layer = 1;
+            drawing_invert_colors(draw);
+        }
+    }
+    animation_goto_frame(&anim, draw, 0);
+}
+
+static int check_frames(AnimationContext *a, int *with_log) {
+    int f, l, wrong = 0;
+
+    *with_log = 0;
+    for (f = 0; f < a->frame_count; f++) {
+        for (l = 0; l < MAX_LAYERS; l++) {
+            if (!a->frames[f].strokes[l]) continue;
+            (*with_log)++;
+            if (!frame_replay_equal(&a->frames[f], l)) wrong++;
+        }
+    }
+    return wrong;
+}
+
+// Duplica, copia/incolla, cancella e sposta: ogni frame ha il proprio log
+static void test_frame_ops(void) {
+    AnimationSnapshot *snap;
+    const Frame *old;
+    int with_log;
+
+    make_animation();
+    CHECK(anim.frames[7].strokes[1] == NULL);
+    CHECK(anim.frames[7].strokes[0] != NULL);
+
+    animation_duplicate_frame(&anim, 3);
+    CHECK(anim.frames[4].strokes[0] && anim.frames[4].strokes[0] != anim.frames[3].strokes[0]);
+    animation_copy_frame(&anim, 5);
+    animation_paste_frame(&anim, 12);
+    animation_delete_frame(&anim, 9);
+    animation_move_frame(&anim, 2, 20);
+    animation_swap_frames(&anim, 0, 1);
+    animation_clear_frame(&anim, 15);
+    CHECK(anim.frames[15].strokes[0] == NULL);
+    CHECK(check_frames(&anim, &with_log) == 0);
+    CHECK(with_log > anim.frame_count);
+
+    // Lo snapshot conserva il log del frame com'era
+    snap = animation_snapshot_begin(&anim);
+    CHECK(snap != NULL);
+    animation_goto_frame(&anim, draw, 6);
+    draw_scene(draw, 777, 10);
+    animation_goto_frame(&anim, draw, 0);
+    old = animation_snapshot_acquire(snap, 6);
+    CHECK(old && old != &anim.frames[6]);
+    CHECK(old && frame_replay_equal(old, 0) && frame_replay_equal(old, 2));
+    animation_snapshot_release(snap, 6);
+    animation_snapshot_end(&anim, snap);
+    CHECK(check_frames(&anim, &with_log) == 0);
+}
+
+static void test_save_load(void) {
+    const char *path = SAVE_DIR "test_strokes.fnv";
+    const char *raster = SAVE_DIR "test_strokes_raster.fnv";
+    SceIoStat st;
+    long with_size, raster_size;
+    int f, l, with_log, loaded_log, missing = 0;
+
+    make_animation();
+    CHECK(filemanager_save(&anim, &audio, path));
+    CHECK(filemanager_load(&loaded, &audio, scratch, path));
+    CHECK(loaded.frame_count == anim.frame_count);
+    CHECK(check_frames(&anim, &with_log) == 0);
+    CHECK(check_frames(&loaded, &loaded_log) == 0);
+    CHECK(loaded_log == with_log);
+
+    for (f = 0; f < anim.frame_count && f < loaded.frame_count; f++) {
+        for (l = 0; l < MAX_LAYERS; l++) {
+            if (memcmp(&anim.frames[f].layers[l], &loaded.frames[f].layers[l], sizeof(LayerData)))
+                missing++;
+            if (!anim.frames[f].strokes[l] != !loaded.frames[f].strokes[l]) missing++;
+        }
+    }
+    CHECK(missing == 0);
+
+    // Il frame caricato nel disegno riprende il log e continua a registrare
+    animation_goto_frame(&loaded, scratch, 3);
+    CHECK(scratch->strokes[0].valid && scratch->strokes[0].count > 0);
+
+    // Stessa animazione senza log, per il costo su disco
+    with_size = sceIoGetstat(path, &st) >= 0 ? (long)st.st_size : -1;
+    for (f = 0; f < anim.frame_count; f++) animation_frame_free_strokes(&anim.frames[f]);
+    CHECK(filemanager_save(&anim, &audio, raster));
+    raster_size = sceIoGetstat(raster, &st) >= 0 ? (long)st.st_size : -1;
+    printf("  %d frame, %d layer con log: %ld byte, %ld senza log (+%.1f%%)\n", anim.frame_count,
+           with_log, with_size, raster_size, (with_size - raster_size) * 100.0 / raster_size);
+
+    sceIoRemove(path);
+    sceIoRemove(raster);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) sce_host_set_root(argv[1]);
+    filemanager_init();
+    filemanager_set_tile_store(false);
+    draw = malloc(sizeof(DrawingContext));
+    scratch = malloc(sizeof(DrawingContext));
+    drawing_init(draw);
+    drawing_init(scratch);
+    audio_init(&audio);
+    animation_init(&anim);
+    animation_init(&loaded);
+
+    test_draw_replay();
+    test_frame_ops();
+    test_save_load();
+
+    animation_free(&anim);
+    animation_free(&loaded);
+    audio_free(&audio);
+    drawing_free(draw);
+    drawing_free(scratch);
+    free(draw);
+    free(scratch);
+    return test_exit("test_strokes");
+}
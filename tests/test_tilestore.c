@@ -0,0 +1,257 @@
+// Archivio di tile: due file che condividono tile, eliminazione di uno e
+// collector, ricaricamento dell'altro pixel per pixel; un salvataggio
+// fallito lascia record orfani nel pack, che il collector elimina sia
+// nello stesso processo sia dopo il riavvio (indice rovinato, pack
+// riletto da capo: lo fa un secondo processo, lo stato e' statico).
+#include <stdlib.h>
+#include <string.h>
+#include "filemanager.h"
+#include "tilestore.h"
+#include "fixture.h"
+#include "test.h"
+
+#define FRAMES   24
+#define SHARED   12     // Frame di B uguali ad A
+#define ORPHANS  8
+
+#define PATH_A      SAVE_DIR "test_tiles_a.fnv"
+#define PATH_B      SAVE_DIR "test_tiles_b.fnv"
+#define TILES_DIR   SAVE_DIR "tiles/"
+#define PACK_PATH   TILES_DIR "tiles.pak"
+#define INDEX_PATH  TILES_DIR "tiles.idx"
+
+static const char *root = "out/";
+static AnimationContext a, b, loaded;
+static AudioContext audio;
+static DrawingContext *draw;
+
+// B: i primi SHARED frame come A, gli altri diversi
+static bool make_b(void) {
+    int i;
+
+    if (!fixture_animation(&b, FRAMES, FIXTURE_LINEART)) return false;
+    for (i = SHARED; i < FRAMES; i++) {
+        fixture_frame(&b.frames[i], i + 100, FIXTURE_LINEART);
+        animation_invalidate_frame_hash(&b, i);
+    }
+    return true;
+}
+
+static bool add_tiles(TileSet *set, const AnimationContext *anim) {
+    static uint8_t pixels[TILE_PIXELS];
+    int f, l, t;
+
+    for (f = 0; f < anim->frame_count; f++)
+        for (l = 0; l < MAX_LAYERS; l++)
+            for (t = 0; t < TILES_PER_LAYER; t++)
+                if (tile_extract(&anim->frames[f].layers[l], t, pixels) &&
+                    !tileset_add(set, tile_hash(pixels), 1))
+                    return false;
+    return true;
+}
+
+static long file_size(const char *path) {
+    SceIoStat st;
+    return sceIoGetstat(path, &st) >= 0 ? (long)st.st_size : -1;
+}
+
+static int count_diff_frames(const AnimationContext *x, const AnimationContext *y) {
+    int f, diff = 0;
+
+    if (x->frame_count != y->frame_count) return -1;
+    for (f = 0; f < x->frame_count; f++)
+        diff += memcmp(x->frames[f].layers, y->frames[f].layers, sizeof(x->frames[f].layers)) != 0;
+    return diff;
+}
+
+static bool load_b_equal(void) {
+    bool ok;
+
+    animation_free(&loaded);
+    animation_init(&loaded);
+    ok = filemanager_load(&loaded, &audio, draw, PATH_B) && count_diff_frames(&b, &loaded) == 0;
+    animation_free(&loaded);
+    animation_init(&loaded);
+    return ok;
+}
+
+// Come un salvataggio interrotto dopo aver scritto i tile nel pack
+static void failed_save(uint32_t seed) {
+    static uint8_t pixels[TILE_PIXELS], data[TILE_MAX_DATA];
+    TileCoder coder;
+    uint8_t format;
+    uint32_t size;
+    uint64_t hashes[ORPHANS];
+    int i, k, present = 0;
+
+    tile_coder_init(&coder);
+    fixture_seed = seed;
+    CHECK(tilestore_begin());
+    for (i = 0; i < ORPHANS; i++) {
+        for (k = 0; k < TILE_PIXELS; k++) pixels[k] = (uint8_t)(fixture_rand() % 4);
+        hashes[i] = tile_hash(pixels);
+        size = tile_compress(&coder, pixels, data, &format);
+        CHECK(size > 0 && tilestore_put(hashes[i], data, size, format));
+    }
+    CHECK(!tilestore_end(false));
+    tile_coder_free(&coder);
+
+    for (i = 0; i < ORPHANS; i++) present += tilestore_contains(hashes[i]);
+    CHECK(present == 0);
+}
+
+static void test_shared_gc(int *live_count, long *live_pack) {
+    TileSet set_a, set_b, both;
+    int count_a, count_ab;
+    long pack_ab, pack;
+    double t0, ms;
+
+    tileset_init(&set_a);
+    tileset_init(&set_b);
+    tileset_init(&both);
+    CHECK(fixture_animation(&a, FRAMES, FIXTURE_LINEART));
+    CHECK(make_b());
+    CHECK(add_tiles(&set_a, &a) && add_tiles(&set_b, &b));
+    CHECK(add_tiles(&both, &a) && add_tiles(&both, &b));
+
+    // Ogni tile una volta sola: B aggiunge solo i suoi, risalvare A nulla
+    CHECK(tilestore_count() == 0);
+    CHECK(filemanager_save(&a, &audio, PATH_A));
+    count_a = tilestore_count();
+    CHECK(count_a == set_a.count);
+    CHECK(filemanager_save(&b, &audio, PATH_B));
+    count_ab = tilestore_count();
+    pack_ab = file_size(PACK_PATH);
+    CHECK(count_ab == both.count);
+    CHECK(count_ab < set_a.count + set_b.count);
+
+    // Primo conteggio dei riferimenti dai file: niente da raccogliere
+    CHECK(!filemanager_collect_tiles(false));
+    CHECK(tilestore_refs_ready() && tilestore_garbage() == 0);
+    CHECK(filemanager_save(&a, &audio, PATH_A));
+    CHECK(tilestore_count() == count_ab && file_size(PACK_PATH) == pack_ab);
+    CHECK(tilestore_garbage() == 0);
+
+    // Eliminare A toglie i suoi riferimenti; sotto la soglia il collector
+    // aspetta, forzato lascia solo i tile di B
+    CHECK(filemanager_delete(PATH_A));
+    printf("  A %d tile, B %d, in comune %d; dopo l'eliminazione di A %u byte senza "
+           "riferimenti\n", set_a.count, set_b.count, set_a.count + set_b.count - both.count,
+           tilestore_garbage());
+    CHECK(tilestore_garbage() > 0);
+
+    t0 = test_now_ms();
+    CHECK(filemanager_collect_tiles(true));
+    ms = test_now_ms() - t0;
+    pack = file_size(PACK_PATH);
+    CHECK(tilestore_count() == set_b.count);
+    CHECK(tilestore_garbage() == 0);
+    CHECK(pack > 0 && pack < pack_ab);
+    printf("  collector: %d -> %d tile, pack %ld -> %ld byte in %.1f ms\n", count_ab,
+           tilestore_count(), pack_ab, pack, ms);
+    CHECK(load_b_equal());
+
+    *live_count = tilestore_count();
+    *live_pack = pack;
+    tileset_free(&set_a);
+    tileset_free(&set_b);
+    tileset_free(&both);
+}
+
+// Orfani nello stesso processo: fuori dall'indice e dal conteggio, il
+// collector li toglie dal pack
+static void test_failed_save(int live_count, long live_pack) {
+    long pack;
+
+    failed_save(1234);
+    pack = file_size(PACK_PATH);
+    CHECK(tilestore_count() == live_count);
+    CHECK(pack > live_pack);
+    CHECK(load_b_equal());
+
+    CHECK(filemanager_collect_tiles(true));
+    CHECK(tilestore_count() == live_count);
+    CHECK(file_size(PACK_PATH) == live_pack);
+    CHECK(load_b_equal());
+    printf("  %d orfani (%ld byte) eliminati\n", ORPHANS, pack - live_pack);
+}
+
+// Secondo processo: indice rovinato, il pack si rilegge e gli orfani
+// tornano voci senza riferimenti
+static int recover(long live_pack) {
+    int count;
+
+    CHECK(make_b());
+    count = tilestore_count();
+    CHECK(filemanager_collect_tiles(true));
+    printf("  riavvio: %d tile dal pack riletto, %d dopo il collector, pack %ld byte\n",
+           count, tilestore_count(), file_size(PACK_PATH));
+    CHECK(count == tilestore_count() + ORPHANS);
+    CHECK(file_size(PACK_PATH) == live_pack);
+    CHECK(load_b_equal());
+    return test_exit("test_tilestore (riavvio)");
+}
+
+static void test_restart(const char *self, long live_pack) {
+    char cmd[1024], host[512];
+    FILE *fp;
+
+    failed_save(5678);
+
+    // Una voce scritta a meta' invalida l'indice
+    snprintf(host, sizeof(host), "%sux0/%s", root, INDEX_PATH + 4);
+    fp = fopen(host, "ab");
+    CHECK(fp != NULL);
+    if (!fp) return;
+    fwrite("TILE", 1, 5, fp);
+    fclose(fp);
+
+    snprintf(cmd, sizeof(cmd), "%s %s recover %ld", self, root, live_pack);
+    fflush(stdout);
+    CHECK(system(cmd) == 0);
+}
+
+static void cleanup(void) {
+    sceIoRemove(PATH_A);
+    sceIoRemove(PATH_B);
+    sceIoRemove(PACK_PATH);
+    sceIoRemove(INDEX_PATH);
+    sceIoRemove(TILES_DIR "tiles.new");
+}
+
+int main(int argc, char **argv) {
+    int live_count = 0;
+    long live_pack = 0;
+    int result;
+
+    if (argc > 1) {
+        root = argv[1];
+        sce_host_set_root(root);
+    }
+    filemanager_init();
+    filemanager_set_tile_store(true);
+    draw = malloc(sizeof(DrawingContext));
+    drawing_init(draw);
+    audio_init(&audio);
+    animation_init(&loaded);
+
+    // a e b li crea fixture_animation
+    if (argc > 3 && strcmp(argv[2], "recover") == 0) {
+        result = recover(atol(argv[3]));
+    } else {
+        cleanup();
+        test_shared_gc(&live_count, &live_pack);
+        test_failed_save(live_count, live_pack);
+        test_restart(argv[0], live_pack);
+        cleanup();
+        result = test_exit("test_tilestore");
+    }
+
+    animation_free(&a);
+    animation_free(&b);
+    animation_free(&loaded);
+    audio_free(&audio);
+    drawing_free(draw);
+    free(draw);
+    return result;
+}